@@ -0,0 +1,35 @@
+#ifndef ARQ_H
+#define ARQ_H
+
+#include "GeneralLib.h"
+#include "PacketBuffer.h"
+
+#define ARQ_WINDOW 4             // Number of commands the controller may have in flight (same on the controller)
+#define ARQ_DUPLICATE_WINDOW 64  // Already processed sequence numbers closer than this are recognised as duplicates
+
+// Acknowledgement carried in every MEASURED_DATA packet:
+// [flags, next expected sequence number (2 bytes), held bitmap, refused bitmap]
+#define ARQ_ACK_SIZE 5
+#define ARQ_ACK_SESSION 0x01  // at least one command arrived, the sequence number is valid
+#define ARQ_ACK_RESEND 0x02   // a corrupted frame arrived, the controller should retransmit without waiting
+
+// One received command waiting for process_command()
+struct CommandRecord {
+  uint16_t seq;        // sequence number assigned by the controller
+  unsigned char cmdID; // command ID
+  int32_t value;       // value of SET_EXACT_HEIGHT, POTENTIOMETR_ANGLE and SET_MOTOR_POWER
+  bool valid;          // false if the command ID is unknown or the value is missing
+};
+
+enum CommandAcceptance {
+  COMMAND_NEW,        // stored, it will be processed and confirmed by the main loop
+  COMMAND_DUPLICATE,  // already processed, only the confirmation has to be repeated
+  COMMAND_PENDING     // already stored and not processed yet, nothing to do
+};
+
+CommandAcceptance accept_command(const CommandRecord &rec);
+bool next_command(CommandRecord &rec);
+void command_processed(bool refused);
+void write_command_ack(PacketWriter &writer, bool resend);
+
+#endif // ARQ_H
@@ -0,0 +1,50 @@
+#ifndef ACTUATORS_H
+#define ACTUATORS_H
+
+#include "GeneralLib.h"
+#include <Servo.h>
+
+#define ACTUATOR_PERIOD 20        // Period of thread_actuators() [ms], one frame of the servo pulses
+#define ACTUATOR_REFRESH 1000     // An output that did not change is written again after this time [ms]
+#define ACTUATOR_ESC_SLEW 300     // The largest change of the height control engines [units/s], 60 per SampleTime
+#define ACTUATOR_FORWARD_SLEW 120 // The largest change of the direction control engine [units/s]
+#define ACTUATOR_SERVO_SLEW 240   // The largest change of the servo [deg/s]
+
+/*
+Actuator manager: the only owner of the ESCs and of the servo. The control code only sets the wanted values
+(actuator_set()), thread_actuators() moves each output towards its value at most by its slew rate and writes it
+to the Servo library only when the written value changes or once per ACTUATOR_REFRESH. The pulses themselves
+are generated by the timer of the Servo library, so nothing needs to be written while the value stays.
+The safe stop puts all ESCs to STOP_POWER at once, without the slew limit, and holds them there
+until it is released; the servo keeps its position. It is engaged while the motors are switched off (DoNotMove).
+Values are those of Servo::write(): 0 - 180, 90 is the stop of the ESCs.
+*/
+
+enum ActuatorOutput {
+  ACTUATOR_HEIGHT_1,    // altitude control engine 1
+  ACTUATOR_HEIGHT_2,    // altitude control engine 2
+  ACTUATOR_FORWARD,     // direction control engine
+  ACTUATOR_SERVO,       // steering servo
+  ACTUATOR_COUNT
+};
+
+struct Actuator {
+  Servo servo;
+  unsigned int pin;
+  bool esc;                // stopped by the safe stop
+  float slew;              // [units/s]
+  volatile int target;     // the wanted value, set by actuator_set()
+  float value;             // the value on the way to the target
+  int written;             // the last value written to the Servo library
+  unsigned long writtenAt;
+};
+
+extern unsigned int STOP_POWER;
+extern volatile unsigned long actuatorWrites;  // values written to the Servo library so far
+
+void actuators_begin(void);
+void actuator_set(ActuatorOutput output, int value);
+void actuators_safe_stop(bool stop);
+void thread_actuators(void);
+
+#endif // ACTUATORS_H
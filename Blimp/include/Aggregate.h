@@ -0,0 +1,45 @@
+#ifndef AGGREGATE_H
+#define AGGREGATE_H
+
+#include "GeneralLib.h"
+#include "PacketBuffer.h"
+
+#define AGGREGATE_MIN_FIELD_BUDGET 8  // Bytes that must stay for the telemetry fields, otherwise the aggregates wait for the next beacon
+#define AGGREGATE_MAX_VALUES (AGGREGATE_FIELD_COUNT * 5)
+
+/*
+Windowed aggregates of the values that change faster than the beacons are sent.
+Every sample is added to a running aggregate (count, minimum, maximum, mean and the sum of squared deviations,
+updated in O(1) by Welford's method). A beacon takes the aggregates of the window since the previous one and
+starts a new window; the section takes its bytes from the field budget of the delta frame, like the link
+statistics, so the packet does not grow. Beacons with a keyframe or a query section carry no aggregates,
+the window then goes on until the next beacon that has room for them.
+Section (status bit A): for each field in the order of AggregateField:
+[number of samples (varint), optionally(mean (zig-zag varint), mean - minimum (varint), maximum - mean (varint),
+standard deviation in tenths (varint))], the values are in the units of the field; a field without samples has only the 0.
+*/
+
+// The units are those sent, i.e. after the scaling by aggregate_sample()'s caller
+enum AggregateField {
+  AGGREGATE_HEIGHT,       // CURRENT_HEIGHT [cm], every pass of the main loop
+  AGGREGATE_POWER,        // POWER of the height control engines [0 - 180], every SampleTime
+  AGGREGATE_ULTRASONIC,   // ultrasonic_distance [mm], every reading of the US-100
+  AGGREGATE_FIELD_COUNT
+};
+
+struct RunningAggregate {
+  unsigned long count;
+  float min;
+  float max;
+  float mean;
+  float m2;   // sum of the squared deviations from the mean
+};
+
+void aggregate_sample(AggregateField field, float value);
+void aggregate_peek(RunningAggregate *window);
+void aggregate_take(RunningAggregate *window);
+void write_aggregates(const RunningAggregate *window, PacketWriter &writer);
+unsigned int aggregate_section_size(const RunningAggregate *window);
+unsigned int aggregate_values(const RunningAggregate *window, uint32_t *values);
+
+#endif // AGGREGATE_H
@@ -0,0 +1,33 @@
+#ifndef BACKLOG_H
+#define BACKLOG_H
+
+#include "GeneralLib.h"
+#include "PacketBuffer.h"
+#include "Telemetry.h"
+
+#define BACKLOG_SIZE 512              // Telemetry frames kept in RAM (about 6 minutes of beacons)
+#define BACKLOG_LINK_TIMEOUT 3000     // Frames recorded when the controller has not been heard for this long are kept for download [ms]
+#define BACKLOG_RECORD_SIZE 33        // Age (4 bytes) + the fields of a keyframe (TELEMETRY_FRAME_SIZE - 2)
+#define BACKLOG_RECORDS_PER_PACKET 4  // At most this many records are added to one beacon (183 bytes at most with them)
+#define BACKLOG_HEADER_SIZE 3         // Number of records + number of records still waiting (2 bytes)
+#define BACKLOG_SD_FILE "backlog.bin" // Every recorded frame is also appended here if an SD card is present
+
+/*
+Store-and-forward of the telemetry, airship side.
+Every beacon frame is recorded with its time. Frames recorded while the link is down are kept for download
+and, once the controller is heard again, the beacons carry them to the controller in bulk (see send_measured_data()).
+The controller can also ask for all frames in RAM by the BACKLOG_REQUEST command.
+Section of the beacon: [number of records, number of records still waiting (2 bytes), records]
+Record: [age (4 bytes) [ms], current height, ..., longitude (as in a keyframe, see Telemetry.h)]
+Record on the SD card: [time since the start of the airship (4 bytes) [ms], fields as in a keyframe]
+*/
+
+extern bool sdPresent;  // checked by backlog_begin()
+
+void backlog_begin(void);
+void backlog_record(const TelemetryFrame &frame);
+void backlog_request(void);
+unsigned int backlog_waiting(void);
+unsigned int write_backlog(PacketWriter &writer, unsigned int records);
+
+#endif // BACKLOG_H
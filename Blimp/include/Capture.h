@@ -0,0 +1,37 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include "GeneralLib.h"
+#include "PacketBuffer.h"
+
+#define CAPTURE_MAGIC 0x50434C42        // "BLCP" in the first 4 bytes of a capture
+#define CAPTURE_VERSION 1
+#define CAPTURE_DEVICE_CONTROLLER 0
+#define CAPTURE_DEVICE_AIRSHIP 1
+#define CAPTURE_HEADER_SIZE 8           // magic (4 bytes), version, device, 2 reserved bytes
+#define CAPTURE_RECORD_HEADER_SIZE 9    // time (4 bytes), direction, RSSI, SNR, link profile, length
+#define CAPTURE_RECEIVED 0
+#define CAPTURE_SENT 1
+#define CAPTURE_BUFFER_SIZE 4096        // Records waiting to be written to the SD card
+#define CAPTURE_FLUSH_INTERVAL 1000     // The records are written at most this often, unless the buffer is half full [ms]
+#define CAPTURE_SD_FILE "capture.bin"
+
+/*
+Capture of the radio traffic: every packet received or sent is recorded with its time, direction and signal quality,
+the whole packet including its CRC and FEC as it went through the radio. The records are written to the SD card,
+a header is written at every start of the airship. The controller writes the same format to the serial monitor
+(see Capture.h of the controller). Tools/CaptureTool decodes captures and replays them into the receive path.
+All numbers are little endian, as in the packets.
+Header: [magic (4 bytes), version, device (0 = controller, 1 = airship), 0, 0]
+Record: [time (4 bytes) [ms since the start], direction (0 = received, 1 = sent), RSSI [dBm], SNR [quarters of dB],
+         link profile (see LinkAdaptation.h), length, packet]
+RSSI and SNR are signed bytes, both are 0 for sent packets.
+*/
+
+void capture_begin(void);
+void capture_packet(unsigned char direction, const unsigned char *data, unsigned int length, unsigned long time, int rssi, float snr);
+void capture_service(void);
+void capture_replay(const unsigned char *data, unsigned int length);
+void write_capture_header(PacketWriter &writer, unsigned char device);
+
+#endif // CAPTURE_H
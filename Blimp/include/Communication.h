@@ -3,6 +3,24 @@
 
 #include "GeneralLib.h"
 #include <LoRa.h>
+#include "Telemetry.h"
+#include "PacketBuffer.h"
+#include "Framing.h"
+#include "ARQ.h"
+#include "LinkAdaptation.h"
+#include "TDMA.h"
+#include "LinkStats.h"
+#include "TelemetryScheduler.h"
+#include "Airtime.h"
+#include "Fleet.h"
+#include "Steering.h"
+#include "Backlog.h"
+#include "Hopping.h"
+#include "Capture.h"
+#include "Query.h"
+#include "Aggregate.h"
+#include "ReceiveQueue.h"
+#include "Profiler.h"
 
 const int csPin = 9;          // LoRa radio chip select //3
 const int resetPin = 15;       // LoRa radio reset //1
@@ -18,33 +36,46 @@ struct commandIDs {
   static const unsigned char FLY_FORWARD = 0x99; // Zapni/vypni řídící motor
   static const unsigned char SET_MOTOR_POWER = 0x3C; // Nastavuje vykon zataceciho motoru
   static const unsigned char MOTORS_OFF = 0x55;
+  static const unsigned char TELEMETRY_ACK = 0xAA; // Acknowledges a received telemetry frame (no confirmation is sent back)
+  static const unsigned char LINK_PROFILE = 0x5A; // Switches the radio parameters (see LinkAdaptation.h)
+  static const unsigned char ASSIGN_ADDRESS = 0xA5; // Answers a join request with the address of the airship (see Fleet.h)
+  static const unsigned char FLEET_SLOTS = 0xC3; // Number of TDMA slots of the fleet (see TDMA.h)
+  static const unsigned char CONTROL_SETPOINT = 0x6C; // Steering angle and power, newest value wins (see Steering.h)
+  static const unsigned char BACKLOG_REQUEST = 0xB4; // Download all recorded telemetry frames (see Backlog.h)
+  static const unsigned char HOP_MODE = 0x4B; // Frequency hopping on (value = channel mask) or off (0) (see Hopping.h)
+  static const unsigned char QUERY = 0x2D; // Snapshot of or subscription to chosen variables (see Query.h)
+  static const unsigned char PROFILE_DUMP = 0xD2; // Prints the runtime profile to the USB serial and the SD card (see Profiler.h)
 };
 extern commandIDs all_ids;
 
 struct BalloonREPORT {
-  static const unsigned char CONFIRMATION = 0x00;
-  static const unsigned char MEASURED_DATA = 0xFF;
+  static const unsigned char MEASURED_DATA = 0xFF; // telemetry, it also acknowledges the received commands
+  static const unsigned char JOIN_REQUEST = 0x4A; // asks the controller for an address (see Fleet.h)
 }; 
 extern BalloonREPORT report;
 
-const unsigned char localAddress = 0x11;     // address of this device
-const unsigned char destinationAddress = 0xBB;      // address of reciver
+const unsigned char destinationAddress = 0xBB;      // address of reciver, the address of this device is in Fleet.h
+
+extern PacketBuffer rxPacket;
 
 void onReceive(int packetSize);
+void receive_service(void);
+void process_received_packet(void);
 bool MsgIsForMe(unsigned char recipientAddres);
-bool check_parity(unsigned int number, bool originalParity);
+void handle_fleet_packet(PacketReader &reader);
 bool check_cmdID(unsigned char cmdID);
-bool handleDuplicateMessage(bool valid_msg, unsigned char cmdID, unsigned int counter);
-void read_specific_value(bool &valid_msg, unsigned char cmdID);
-void sendMessage(String msg, unsigned char type_of_msg, bool land, bool fly_forward, unsigned int cnt = 127);
-unsigned char encode_to_byte(bool x, bool y, bool z, bool w);
-void send_measured_data(void);
-char createCounterByte(unsigned int counter);
-void ExtractCounterFromByte(unsigned int &counter, bool &counterParity, unsigned char rByte);
-bool get_even_parity(unsigned int number);
-void process_command(void);
+bool read_command(PacketReader &reader, CommandRecord &rec);
+void handle_received_command(const CommandRecord &rec);
+void handleCorruptedMessage(void);
+void handleDuplicateMessage(uint16_t seq);
+bool command_has_value(unsigned char cmdID);
+void apply_command_value(const CommandRecord &rec);
+void write_message_header(PacketWriter &writer, unsigned char type_of_msg, bool land, bool fly_forward, bool beacon, bool stats, bool backlog, bool hop, bool query, bool aggregates);
+unsigned char encode_status_byte(bool land, bool fly_forward, bool beacon, bool stats, bool backlog, bool hop, bool query, bool aggregates);
+void send_measured_data(bool beacon);
+void send_join_request(void);
+void process_command(const CommandRecord &rec);
 void SetLAND(void);
 void set_new_required_height(void);
-void decodeValueAndParity(int receivedValue ,int &newValue, bool &originalParity);
 
 #endif // COMMUNICATION_H
\ No newline at end of file
@@ -4,23 +4,25 @@
 #include "GeneralLib.h"
 #include <Servo.h>
 #include "PID.h"
+#include "Actuators.h"
+#include "StateBus.h"
 
 // motors pins
 const unsigned int ESC_H_1 = 8; // altitude control engine 1
 const unsigned int ESC_H_2 = 20; // altitude control engine 2
 const unsigned int FORWARD_ESC = 23; // direction control engine
 const unsigned int SERVO_PIN = 22;
+const int SERVO_OFFSET = 87; // servo position for ANGLE = 0
 
-void InitializeESCs(void);
-void InitializeSERVO(void);
 void ControlSteeringMotor(void);
 void ControlServo(float angle);
+void ReleaseHeightControl(void);
 void ControlHeight(void);
 void InputShaping(float &CurrentRequiredHeight, float &LastRequiredHeight, float TargetRequiredHeight, float RateOfChange, float SampleTimeInSec, float alpha);
 void IntegrateInput(float &CurrentRequiredHeight, float TargetRequiredHeight, float RateOfChange, float dt);
 void FirstOrderFilter(float &CurrentRequiredHeight, float LastRequiredHeight, float alpha);
-void DeadZoneControll(float RequiredHeight, float& Force, float& Thrust, float& PW, bool& Manual);
-void AutomaticControl(float RequiredHeight, float& Force, float& Thrust, float& PW);
+void DeadZoneControll(float RequiredHeight, const HeightSample &Height, float& Force, float& Thrust, float& PW, bool& Manual, float dt);
+void AutomaticControl(float RequiredHeight, const HeightSample &Height, float& Force, float& Thrust, float& PW, float dt);
 float force_to_thrust(float val);
 int thrust_to_PWM(float thrust);
 void WaitWhileDoNotMove(void);
@@ -0,0 +1,29 @@
+#ifndef FLEET_H
+#define FLEET_H
+
+#include "GeneralLib.h"
+
+#define FLEET_SIZE 8                 // Number of airships the controller can run at once (same on the controller)
+#define FLEET_FIRST_ADDRESS 0x11     // Airship i has the address FLEET_FIRST_ADDRESS + i
+#define FLEET_JOIN_ADDRESS 0x10      // Address of an airship that has not been assigned one yet
+#define FLEET_JOIN_INTERVAL 1000     // Period of the join requests, a random part of up to the same length is added [ms]
+#define FLEET_STATIC_INDEX -1        // Index in the fleet used from the start without joining, -1 to join
+
+/*
+Membership of the airship in the fleet of the controller (see Fleet.h of the controller).
+Until the airship has an address, it sends join requests with its random number instead of telemetry.
+The controller answers with the ASSIGN_ADDRESS command, which gives the index of the airship in the fleet
+and the number of TDMA slots; the airship then sends its beacon in its own frame of every superframe (see TDMA.h).
+*/
+extern volatile unsigned char localAddress;     // address of this device
+extern volatile unsigned int vehicleIndex;      // index in the fleet, valid once an address is assigned
+extern volatile unsigned int fleetSlots;        // number of frames in a TDMA superframe
+
+void fleet_begin(void);
+bool fleet_assigned(void);
+bool fleet_join_due(void);
+uint16_t fleet_join_nonce(void);
+void fleet_assign(int32_t value);
+void fleet_set_slots(int32_t slots);
+
+#endif // FLEET_H
@@ -6,18 +6,7 @@
 #include <TeensyThreads.h>
 #include <Wire.h>
 
-//MPL3115A2
-extern float pressure;
-extern float altitude;
-extern float temperature_MPL3115A2;
-
-//DHT_22
-extern float humidity;
-extern float temperature_DHT22;
-
-//GPS modul
-extern float latitude, longitude, speed, altitudeGPS;
-extern unsigned long fix_age, date, tm;
+// The readings of the sensors are published on the state bus (see StateBus.h)
 
 //communication
 extern bool LAND, FLY_FORWARD;
@@ -26,18 +15,18 @@ extern float C_R_H; // Current target height in m // finally it should have same
 extern float CURRENT_HEIGHT;
 extern int ANGLE;
 extern int POWER_OF_STEERING_MOTOR;
-extern unsigned int LAST_COUNTER;
 extern unsigned char RECEIVED_ID;
 extern int RECEIVED_REQ_HEIGHT; // Required height sent from controller
 extern bool VALID_MSG;
-extern bool NEW_MSG;
+extern volatile bool NACK_PENDING; // a corrupted frame for this device arrived, controller should resend
+extern volatile bool ACK_PENDING;  // received commands should be acknowledged without waiting for the telemetry period
+extern bool DUPLICATE_ACK_PENDING; // only a duplicate command arrived, its acknowledgement may wait for the airtime budget
+
 extern long lastSendTime;        // last send time
 extern long lastReceivedTime;        // last received time
 
 // US-100
-extern int ultrasonic_distance;
 extern bool ultrasonicDistanceIsValid;
-extern float USValidityRate;
 
 // Motor controll
 extern unsigned int SampleTime;
@@ -0,0 +1,32 @@
+#ifndef HOPPING_H
+#define HOPPING_H
+
+#include "GeneralLib.h"
+#include "PacketBuffer.h"
+
+#define HOP_CHANNELS 8                  // Hopping channels, HOP_CHANNEL_SPACING apart from HOP_FIRST_FREQUENCY (same on the controller)
+#define HOP_FIRST_FREQUENCY 433175000   // [Hz]
+#define HOP_CHANNEL_SPACING 200000      // [Hz]
+#define HOP_RENDEZVOUS_FREQUENCY 433E6  // Frequency without hopping, also used by every HOP_RENDEZVOUS_PERIOD-th frame [Hz]
+#define HOP_RENDEZVOUS_PERIOD 8         // Frames whose number is divisible by this use the rendezvous frequency
+#define HOP_SEED 0x5EED                 // Seed of the hop sequence (same on the controller)
+#define HOP_FALLBACK_TIMEOUT 20000      // Nothing heard from the controller for this long => hopping stops [ms], covers its search (see Hopping.cpp)
+#define HOP_STATE_SIZE 2                // [frame number, channel mask] in each beacon while hopping
+
+/*
+Frequency hopping, airship side.
+While hopping is on, every TDMA frame (see TDMA.h) uses its own channel, chosen by hop_channel() from the frame number
+and the mask of the channels that are not blacklisted; the airship tunes to it right before the beacon.
+The beacons carry the frame number and the mask, so the controller can follow the sequence and find it again
+on the rendezvous frequency, which every HOP_RENDEZVOUS_PERIOD-th frame uses whatever the mask is.
+The controller turns hopping on and off and changes the mask by the HOP_MODE command (value = channel mask, 0 = off).
+*/
+
+bool hop_active(void);
+void hop_request(unsigned int mask);
+void hop_next_frame(void);
+void write_hop_state(PacketWriter &writer);
+int hop_channel(unsigned char frame, unsigned char mask);
+long hop_frequency(int channel);
+
+#endif // HOPPING_H
@@ -0,0 +1,33 @@
+#ifndef LINK_ADAPTATION_H
+#define LINK_ADAPTATION_H
+
+#include "GeneralLib.h"
+#include <LoRa.h>
+#include "PacketBuffer.h"
+
+#define LINK_PROFILE_COUNT 5
+#define LINK_RENDEZVOUS_PROFILE 2     // LoRa library defaults (SF7, 125 kHz), used after start and after a failed switch
+#define LINK_FALLBACK_TIMEOUT 8000    // Nothing heard for this long on another profile => back to the rendezvous profile [ms]
+#define LINK_RADIO_CRC false          // Payload CRC of the radio (off in the LoRa library), it lengthens the time on air
+
+// Radio parameters of one link profile (the same table is on the controller)
+struct LinkProfile {
+  int spreadingFactor;
+  long bandwidth;      // [Hz]
+  int txPower;         // [dBm]
+  float requiredSnr;   // SNR needed for demodulation at this spreading factor [dB]
+};
+
+extern const LinkProfile linkProfiles[LINK_PROFILE_COUNT];
+extern unsigned int currentProfile;
+extern volatile float lastPacketSnr;   // SNR of the last packet from the controller [dB]
+extern volatile int lastPacketRssi;    // RSSI of the last packet from the controller [dBm]
+
+void link_record_packet(float snr, int rssi);
+void link_request_profile(unsigned int profile);
+void link_service(void);
+void link_apply_profile(unsigned int profile);
+unsigned long link_airtime(unsigned int profile, unsigned int bytes);
+void write_link_report(PacketWriter &writer);
+
+#endif // LINK_ADAPTATION_H
@@ -0,0 +1,27 @@
+#ifndef LINK_STATS_H
+#define LINK_STATS_H
+
+#include "GeneralLib.h"
+#include "PacketBuffer.h"
+#include "Framing.h"
+#include "LoopTiming.h"
+
+#define LINK_STATS_REPORT_PERIOD 5000  // The counters are sent to the controller at most once per this period [ms]
+#define LINK_STATS_REPORT_SIZE (8 + LOOP_TIMING_REPORT_SIZE)  // [received, corrupted, corrected, duplicates], 16 bits each, and the timing of the height loop
+
+/*
+Counters of the airship's side of the link. They only grow (and wrap around at 16 bits in the report),
+the controller computes the rates and the loss from the differences of two reports (see LinkStats.h of the controller).
+*/
+extern volatile unsigned long packetsReceived;    // packets for this device that passed the CRC check
+extern volatile unsigned long corruptedFrames;    // frames that failed the CRC check even after the FEC
+extern volatile unsigned long correctedFrames;    // frames with a bit error corrected by the FEC
+extern unsigned long duplicateCommands;           // commands that had already been processed
+
+void link_stats_frame_checked(FrameStatus status);
+void link_stats_packet_received(void);
+void link_stats_duplicate(void);
+bool link_stats_report_due(void);
+void write_link_statistics(PacketWriter &writer);
+
+#endif // LINK_STATS_H
@@ -0,0 +1,29 @@
+#ifndef LOOP_TIMING_H
+#define LOOP_TIMING_H
+
+#include "GeneralLib.h"
+#include "PacketBuffer.h"
+
+#define LOOP_TIMING_BUCKETS 18      // Bucket 0 holds 0 us, bucket i holds [2^(i-1), 2^i) us, the last one also everything above
+#define LOOP_TIMING_REPORT_SIZE 10  // [jitter min, jitter max, jitter 99th percentile, execution 99th percentile, execution max], 16 bits each
+
+/*
+Timing of the height control loop (see ControlHeight()). Each pass records the jitter of its period
+(the time since the start of the previous pass minus SampleTime) and its execution time.
+The statistics cover the window since the last report; the report goes with the link statistics
+(see write_link_statistics()) and starts a new window. The percentiles come from histograms with
+power-of-two buckets, the upper edge of the bucket is sent. All values are in microseconds,
+limited to the range of 16 bits (the minimum and maximum of the jitter are signed).
+*/
+
+struct TimingHistogram {
+  unsigned long count;
+  unsigned long buckets[LOOP_TIMING_BUCKETS];
+};
+
+void timing_histogram_add(TimingHistogram &histogram, unsigned long value);
+void loop_timing_record(long jitter, unsigned long execution);
+void write_loop_timing(PacketWriter &writer);
+unsigned long timing_percentile(const TimingHistogram &histogram, unsigned int percent);
+
+#endif // LOOP_TIMING_H
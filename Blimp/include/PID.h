@@ -4,10 +4,15 @@
 #include <Arduino.h>
 #include "GeneralLib.h"
 
+// State of the controller, also readable by the telemetry queries (see Query.h)
+extern float filteredD;
+extern float clasicD;
+extern float IntegralPart;
+
 // function declarations
 void setParametres(float Kp, float Ki, float Kd, float n, unsigned SampleTime);
 void setLimits(float Max, float Min);
-void CalculateOutput(float &Output, double CurrentValue, double RequiredValue);
+void CalculateOutput(float &Output, double CurrentValue, double RequiredValue, float dt);
 void checkLimits(float &val);
 void initialization(void);
 
@@ -0,0 +1,63 @@
+#ifndef PACKET_BUFFER_H
+#define PACKET_BUFFER_H
+
+#include "GeneralLib.h"
+#include <LoRa.h>
+
+#define PACKET_CAPACITY 255 // Maximal payload of one LoRa packet
+#define LORA_REG_FIFO 0x00  // FIFO register of the SX127x, a read of it auto-increments the FIFO pointer
+
+// Received packet, filled by one burst read of the radio FIFO in onReceive()
+struct PacketBuffer {
+  unsigned char data[PACKET_CAPACITY];
+  unsigned int length;
+  unsigned long time;         // millis() at the reception
+  unsigned long timeMicros;   // micros() at the start of onReceive(), for the statistics of the receive path (see ReceiveQueue.h)
+  int rssi;                   // [dBm]
+  float snr;                  // [dB]
+};
+
+// Bounds-checked cursor for parsing a packet. Once a read fails, all following reads fail too.
+class PacketReader {
+  public:
+    PacketReader(const unsigned char *data, unsigned int length);
+    bool read_byte(unsigned char &value);
+    bool read_int16(int16_t &value);
+    bool read_int32(int32_t &value);
+    bool read_varint(uint32_t &value);
+    unsigned int remaining(void) const;
+    const unsigned char *current(void) const;
+    bool ok(void) const;
+  private:
+    const unsigned char *buffer;
+    unsigned int size;
+    unsigned int pos;
+    bool valid;
+};
+
+// Bounds-checked cursor for building a packet in a fixed-capacity buffer. Once a write fails, all following writes fail too.
+class PacketWriter {
+  public:
+    PacketWriter(unsigned char *data, unsigned int capacity);
+    bool put_byte(unsigned char value);
+    bool put_bytes(const unsigned char *values, unsigned int count);
+    bool put_int16(int16_t value);
+    bool put_int32(int32_t value);
+    bool put_varint(uint32_t value);
+    bool reserve(unsigned int count, unsigned int &at);
+    void patch_int16(unsigned int at, int16_t value);
+    unsigned int length(void) const;
+    const unsigned char *data(void) const;
+    bool ok(void) const;
+  private:
+    unsigned char *buffer;
+    unsigned int capacity;
+    unsigned int pos;
+    bool valid;
+};
+
+bool receive_packet(PacketBuffer &packet, int packetSize);
+void read_fifo(unsigned char *data, unsigned int length);
+bool transmit_packet(PacketWriter &writer);
+
+#endif // PACKET_BUFFER_H
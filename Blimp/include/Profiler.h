@@ -0,0 +1,88 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "GeneralLib.h"
+
+#define PROFILE_BUCKETS 12               // Histogram of a section: bucket i counts the runs shorter than 2^i us, the last one all longer runs
+#define PROFILE_MAX_THREADS 8            // Threads of TeensyThreads (MAX_THREADS of the library)
+#define PROFILE_STACK_PATTERN 0xA5       // Painted into the free stacks, the used part is where it was overwritten
+#define PROFILE_MAIN_STACK_RESERVE 1024  // Part of the main stack below the stack pointer of setup() that is not painted [bytes]
+#define PROFILE_SD_FILE "profile.txt"    // Every dump of the profile is also appended here if an SD card is present
+#define THREAD_STACK_SIZE 1024           // Stack of a thread [bytes], the default of TeensyThreads
+
+/*
+Runtime profiler of the airship. It is built only with PROFILING defined (the environment teensy40_profiling
+in platformio.ini); without it the macros below are empty, no counters are kept and the threads get their stacks
+from TeensyThreads as before.
+- Sections: PROFILE_SECTION(id) at the start of a block measures the block by the cycle counter of the Cortex-M7 (DWT).
+  Each section keeps the number of runs, the total and maximal time and a histogram of the times. The time of a section
+  in a thread includes the interrupts and the slices of other threads that came during it. Every section has one writer
+  (one thread or one interrupt), so the counters are not locked.
+- Interrupts: the sections marked as interrupts also give the share of the CPU spent in the measured interrupts.
+- Threads: the timer of the CPU samples (see sample_cpu() in Scheduler.cpp) charges the cycles since the previous
+  sample, without the measured interrupts, to the thread running at the sample. It is a statistical estimate; a thread
+  that waits in threads.yield() or threads.delay() is charged for the turns it takes.
+- Stacks: the stacks of the threads (profile_add_thread()) and the free part of the main stack are painted
+  at the start, the high-water mark is the deepest byte that was overwritten since then.
+The profile is printed by the PROFILE_DUMP command of the controller (to the USB serial and PROFILE_SD_FILE).
+*/
+
+enum ProfileSectionId {
+  PROFILE_ON_RECEIVE,           // onReceive(), interrupt of the radio
+  PROFILE_RELEASE_HEIGHT,       // ReleaseHeightControl(), interrupt of heightTimer
+  PROFILE_CALCULATE_OUTPUT,     // CalculateOutput() of the height control
+  PROFILE_SEND_MEASURED_DATA,   // send_measured_data()
+  PROFILE_RECEIVE_SERVICE,      // receive_service()
+  PROFILE_SECTION_COUNT
+};
+
+void profiler_begin(void);
+int profile_add_thread(const char *name, void (*entry)(void), unsigned int stackSize = THREAD_STACK_SIZE);
+void print_profile(Print &out);
+void profile_dump(void);
+
+#ifdef PROFILING
+
+struct ProfileSection {
+  const char *name;
+  bool interrupt;
+  volatile unsigned long runs;
+  volatile uint64_t cycles;
+  volatile uint32_t maxCycles;
+  volatile unsigned long buckets[PROFILE_BUCKETS];
+};
+
+struct ProfileThread {
+  const char *name;                   // NULL if the thread is not known
+  unsigned char *stackLow;            // lowest address of the stack
+  unsigned int stackSize;             // [bytes]
+  volatile uint64_t cycles;           // charged by the samples
+};
+
+extern ProfileSection profileSections[PROFILE_SECTION_COUNT];
+extern ProfileThread profileThreads[PROFILE_MAX_THREADS];
+
+void profile_record(ProfileSectionId id, uint32_t cycles);
+void profile_sample_thread(void);
+
+// Measures the block in which it is declared (see PROFILE_SECTION)
+class ProfileScope {
+  public:
+    ProfileScope(ProfileSectionId id) : id(id), start(ARM_DWT_CYCCNT) {}
+    ~ProfileScope() { profile_record(id, ARM_DWT_CYCCNT - start); }
+  private:
+    ProfileSectionId id;
+    uint32_t start;
+};
+
+#define PROFILE_SECTION(id) ProfileScope profileScope(id)
+#define PROFILE_THREAD_SAMPLE() profile_sample_thread()
+
+#else
+
+#define PROFILE_SECTION(id)
+#define PROFILE_THREAD_SAMPLE()
+
+#endif // PROFILING
+
+#endif // PROFILER_H
@@ -0,0 +1,51 @@
+#ifndef QUERY_H
+#define QUERY_H
+
+#include "GeneralLib.h"
+#include "PacketBuffer.h"
+#include "StateBus.h"
+
+#define QUERY_VARIABLE_COUNT 24   // Variables that can be queried, at most 24 (same on the controller), so every bitmap names existing ones
+#define QUERY_HEADER_SIZE 3       // Bitmap of the variables in the section
+#define QUERY_PERIOD_UNIT 100     // Unit of the period in the QUERY command [ms]
+
+#if QUERY_VARIABLE_COUNT > 24
+#error "The bitmap of the QUERY command has 24 bits"
+#endif
+
+/*
+Telemetry queries, airship side.
+The controller asks for variables by the QUERY command. Value: [period (upper byte, in QUERY_PERIOD_UNIT), bitmap of the variables (3 bytes)]
+Period 0 asks for a snapshot: the variables are sent once, in the next packet. Any other period subscribes
+to the variables: they are sent at most once per period and, as long as the subscription lasts, the packets
+carry only them instead of the telemetry frame (status bit Q). A subscription with an empty bitmap ends it.
+Section: [bitmap of the variables in this packet (3 bytes), zig-zag varint of each of them in the order of the ids]
+The values are fixed-point numbers (value * scale, see queryVariables). Variables that do not fit into the packet
+are sent in the next one. The readings of the sensors are read from their topics on the state bus (see StateBus.h).
+*/
+
+enum QueryType {
+  QUERY_FLOAT,
+  QUERY_INT,
+  QUERY_UINT,
+  QUERY_ULONG,
+  QUERY_TOPIC_FLOAT,     // a field of the newest sample of a topic
+  QUERY_TOPIC_INT,
+  QUERY_TOPIC_ULONG,
+  QUERY_TOPIC_SEQUENCE   // the number of samples of a topic
+};
+
+struct QueryVariable {
+  const void *address;   // NULL for the QUERY_TOPIC types
+  QueryType type;
+  float scale;           // fixed-point steps per unit of the variable
+  TopicId topic;         // only for the QUERY_TOPIC types
+  unsigned int offset;   // of the field in the sample
+};
+
+void query_request(uint32_t value);
+bool query_active(void);
+unsigned int write_query(PacketWriter &writer, unsigned int budget);
+int32_t query_value(unsigned int id);
+
+#endif // QUERY_H
@@ -0,0 +1,69 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "GeneralLib.h"
+#include "TaskTable.h"
+#include "Profiler.h"
+
+#define TASK_SAMPLE_PERIOD 997          // Period of the samples of the running thread [us], not a multiple of the tick, so it does not follow the switches
+#define TASK_STATISTICS_PERIOD 60000    // Period of printing the statistics of the tasks [ms]
+
+/*
+Priorities of the threads (see TaskTable.h). TeensyThreads only switches the threads round-robin, so the priorities
+are kept at the points where it can be done without changing the library:
+- The height control sleeps between its jobs: task_wait_release() suspends its thread and the release in the interrupt
+  of its timer restarts it, so it takes no turns while it waits and does not poll.
+- Every thread except the height control has a time slice of one tick, so a released height job waits
+  at most one tick for each thread that is busy at the moment.
+- A task starts a job (task_job_start()) only when no task of a higher priority is waiting to start one,
+  until then it yields.
+- The reading of the DHT22 cannot be interrupted, so it runs with the switching stopped and only when the next release
+  of the height control is far enough (task_atomic_begin()).
+Each job is accounted: the time from the release to the end (response), misses of the deadline, releases that came
+while the previous job was still running (overruns). A timer samples the running thread, the samples taken inside
+the jobs of a task give its share of the CPU. The statistics are printed every TASK_STATISTICS_PERIOD.
+*/
+
+struct Task {
+  const char *name;
+  unsigned long period;               // [us]
+  unsigned long deadline;             // [us]
+  unsigned long atomic;               // [us]
+  unsigned int slice;                 // [ticks]
+  int thread;                         // ID of the thread, -1 until it is created
+  bool timed;                         // released by a timer (see task_release())
+  volatile bool waiting;              // released, the job has not started yet
+  volatile bool sleeping;             // the thread is suspended until the next release (task_wait_release())
+  volatile bool running;              // the job has started and not ended yet
+  volatile bool pending;              // released, the job has not ended yet
+  volatile unsigned long releasedAt;  // [us]
+  unsigned long startedAt;            // [us]
+
+  // Statistics since the start, times in microseconds
+  unsigned long jobs;
+  unsigned long responseTotal;
+  unsigned long responseMax;
+  unsigned long executionMax;         // from the start to the end of a job, including the slices of other threads
+  unsigned long misses;               // jobs that ended after the deadline
+  volatile unsigned long overruns;    // releases merged into a job that had not ended
+  volatile unsigned long samples;     // samples of the CPU taken in the jobs of the task
+};
+
+extern Task tasks[TASK_COUNT];
+
+void scheduler_begin(void);
+int task_create(TaskId id, void (*entry)(void));
+void task_set_period(TaskId id, unsigned long period);
+void task_release(TaskId id);
+void task_cancel(TaskId id);
+void task_wait_release(TaskId id);
+bool higher_task_waiting(TaskId id);
+void task_job_start(TaskId id);
+void task_job_end(TaskId id);
+void task_atomic_begin(TaskId id);
+void task_atomic_end(void);
+void sample_cpu(void);
+void scheduler_service(void);
+void print_task_statistics(void);
+
+#endif // SCHEDULER_H
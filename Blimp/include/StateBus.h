@@ -0,0 +1,90 @@
+#ifndef STATE_BUS_H
+#define STATE_BUS_H
+
+#include "GeneralLib.h"
+
+#define TOPIC_MAX_SIZE 40  // Largest sample of a topic [bytes], GPSData takes 28 on the Teensy and 40 with a 64-bit unsigned long (native builds)
+#define TOPIC_BUFFERS 4    // Buffers of a topic, a power of two; a read fails only if the publisher fills TOPIC_BUFFERS - 1 of them during it
+#define BUS_READ_ATTEMPTS 3  // Copies a read tries before it holds off the publisher (see bus_read())
+
+/*
+State bus of the airship. Each sensor thread publishes its readings as one sample of a topic, stamped with micros()
+and numbered; the other threads take a whole sample at once, so a GPS fix or a pair of humidity and temperature
+cannot be mixed from two readings. Every topic has exactly one publisher.
+The publisher writes publication n into buffer n % TOPIC_BUFFERS and only then advances the sequence number to n.
+A reader copies the buffer of the sequence number it saw and then checks the sequence number again: the copied buffer
+is written again only by publication n + TOPIC_BUFFERS, which starts after n + TOPIC_BUFFERS - 1 was published,
+so the copy is whole if the sequence number advanced by less than TOPIC_BUFFERS - 1; otherwise the read is repeated.
+The read never waits for a publisher that was switched out in the middle of a sample, and it is wait-free: after
+BUS_READ_ATTEMPTS failed copies (the publisher completed TOPIC_BUFFERS - 1 publications during each of them, which
+needs the reader to be switched out in the middle of a copy of well under a microsecond for three periods of the
+fastest publisher, the ultrasonic sensor at 30 ms) it takes the newest sample with interrupts off. The threads are switched
+by an interrupt, so no publication can start then, and the buffer of the newest sample is only written again by a
+later one; the interrupts stay off for one copy of at most TOPIC_MAX_SIZE bytes.
+Sequence number 0 means that nothing was published yet.
+The sequence number tells a consumer whether a new sample arrived, the stamp how old it is.
+Single values written only by the main loop (the setpoints, CURRENT_HEIGHT for the commands) stay plain globals.
+*/
+
+enum TopicId {
+  TOPIC_HEIGHT,       // HeightSample, main loop
+  TOPIC_ULTRASONIC,   // UltrasonicSample, thread_ultrasonic()
+  TOPIC_BAROMETER,    // BarometerSample, thread_MPL3115A2(), only valid readings
+  TOPIC_HUMIDITY,     // HumiditySample, thread_DHT22(), also failed readings (INVALID_VALUE)
+  TOPIC_GPS,          // GPSData, thread_GPS(), only new fixes
+  TOPIC_COUNT
+};
+
+struct HeightSample {
+  float height;            // [m] (see get_current_height())
+  bool ultrasonicValid;    // the height comes from the ultrasonic sensor
+};
+
+struct UltrasonicSample {
+  int distance;            // [mm], filtered, INVALID_VALUE without an echo
+  float validityRate;      // share of valid measurements of the last ones (see ValidityRate())
+};
+
+struct BarometerSample {
+  float pressure;          // [Pa], filtered
+  float altitude;          // [m]
+  float temperature;       // [°C]
+};
+
+struct HumiditySample {
+  float humidity;          // [%]
+  float temperature;       // [°C]
+};
+
+// Structure to hold GPS data
+struct GPSData {
+    float flat; // latitude
+    float flon; // longitude
+    float ss; // speed in km per hour
+    float altitude; // height above sea level
+    unsigned long date; // date [ddmmyy]
+    unsigned long time; // time [hhmmsscc]
+    unsigned long age; // time since the last GPS signal reception
+};
+
+// Identification of a sample
+struct SampleInfo {
+  unsigned long seq;       // number of the publication, 0 if there is none
+  unsigned long stamp;     // micros() given by the publisher
+};
+
+struct Topic {
+  unsigned int size;                      // of the sample
+  volatile unsigned long seq;             // the newest sample is in buffers[seq % TOPIC_BUFFERS]
+  volatile unsigned long stamps[TOPIC_BUFFERS];
+  unsigned char buffers[TOPIC_BUFFERS][TOPIC_MAX_SIZE];
+};
+
+extern Topic topics[TOPIC_COUNT];
+
+void bus_publish(TopicId topic, const void *sample, unsigned int size, unsigned long stamp);
+SampleInfo bus_read(TopicId topic, void *sample, unsigned int size);
+unsigned long bus_sequence(TopicId topic);
+unsigned long sample_age(const SampleInfo &info);
+
+#endif // STATE_BUS_H
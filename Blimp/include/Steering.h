@@ -0,0 +1,23 @@
+#ifndef STEERING_H
+#define STEERING_H
+
+#include "GeneralLib.h"
+
+#define STEERING_TIMEOUT_SUPERFRAMES 3  // Without a new setpoint for this many TDMA superframes, the steering stops
+
+/*
+Latest-value-wins channel for the continuous controls (see Steering.h of the controller).
+Value of CONTROL_SETPOINT: steering angle * 256 + power of the steering motor (0 to 180)
+The controller streams the setpoint in its uplink or contention slot at least once per superframe. When no setpoint
+came for STEERING_TIMEOUT_SUPERFRAMES superframes, the steering is frozen: the servo holds its angle and the steering
+motor is stopped (STOP_POWER) until the next setpoint arrives.
+*/
+extern volatile unsigned long staleSetpoints;   // setpoints dropped because a newer one had already arrived
+
+int setpoint_angle(int32_t value);
+int setpoint_power(int32_t value);
+void steering_received(uint16_t seq, int32_t value);
+void steering_service(void);
+bool steering_frozen(void);
+
+#endif // STEERING_H
@@ -0,0 +1,40 @@
+#ifndef TDMA_H
+#define TDMA_H
+
+#include "GeneralLib.h"
+
+#define TDMA_MIN_FRAME 700        // Shortest period of the beacons (telemetry cadence) [ms]
+#define TDMA_GUARD 10             // Gap around each transmission [ms]
+#define TDMA_MAX_PACKET 48        // Longest packet planned into a slot [bytes]
+#define TDMA_UPLINK_WINDOW 50     // The controller may start its commands this long after the uplink slot opens [ms]
+#define TDMA_LOOP_PERIOD 100      // Period of the airship's main loop, the acknowledgement slot must be longer [ms]
+#define TDMA_CONTENTION_WINDOW 100 // The contention slot accepts transmissions starting within this time [ms]
+#define TDMA_MAX_BEACON_GAP 2     // Beacons delayed by the airtime budget are sent at the latest after this many superframes
+                                  // (the controller stays synchronised for three superframes)
+
+/*
+Slots of one TDMA frame, as offsets from the end of the beacon (the airship's periodic telemetry packet) [ms].
+Transmissions have to start within their slot, the slots are spaced so that a packet of TDMA_MAX_PACKET
+bytes ends before the next slot opens:
+  beacon (airship) | uplink (controller: commands) | acknowledgement (airship) | contention (controller: "SAY_HI") | next beacon
+With a fleet of airships (see Fleet.h), a superframe has one frame per airship, airship i sends its beacon in frame i:
+  frame of airship 0 | frame of airship 1 | ... | frame of airship fleetSlots - 1 | frame of airship 0 | ...
+*/
+struct TdmaLayout {
+  unsigned long uplinkStart;
+  unsigned long uplinkEnd;
+  unsigned long ackStart;
+  unsigned long ackEnd;
+  unsigned long contentionStart;
+  unsigned long contentionEnd;
+  unsigned long frame;        // from the end of one beacon to the start of the next one
+};
+
+void tdma_layout(TdmaLayout &layout);
+bool tdma_beacon_due(void);
+bool tdma_beacon_overdue(void);
+void tdma_beacon_sent(void);
+bool tdma_ack_slot_open(void);
+void tdma_fleet_beacon(unsigned int index, unsigned long time);
+
+#endif // TDMA_H
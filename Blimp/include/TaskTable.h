@@ -0,0 +1,38 @@
+#ifndef TASK_TABLE_H
+#define TASK_TABLE_H
+
+/*
+The tasks of the airship in the order of their priority, the first one is the highest. The order is rate-monotonic
+(the shorter the period, the higher the priority), the actuators go with the height control they serve.
+The table is shared by the firmware (see Scheduler.h) and the host tool Tools/ScheduleCheck, which checks by a simulation
+that every task meets its deadline, so it must not depend on Arduino. All times are in microseconds.
+  period    shortest time between two releases (the height loop uses SampleTime at run time)
+  deadline  longest allowed time from the release to the end of a job
+  wcet      longest processing of a job, estimated
+  spin      longest busy waiting on a device in a job, it ends at a given time but takes every time slice it gets until then
+  atomic    processing that must not be interrupted by other threads (see task_atomic_begin())
+  slice     time slice of the thread [ticks of TeensyThreads, 1 ms]
+The radio task is the main loop, released every 100 ms by threads.delay(100) at the end of loop(). A pass that sends
+a packet busy waits in LoRa.endPacket() for its whole time on air, which depends on the link profile; the checker adds
+these waits to the passes that send the beacon and the acknowledgement of each TDMA frame. A pass must end within
+the shortest TDMA frame, so that no beacon is skipped.
+*/
+
+//      id               name          period   deadline    wcet     spin   atomic  slice
+#define TASK_TABLE(X) \
+  X(TASK_HEIGHT,     "height",       200000,    10000,    300,        0,      0,     2)  /* released by heightTimer */ \
+  X(TASK_ACTUATORS,  "actuators",     20000,    20000,    200,        0,      0,     1) \
+  X(TASK_ULTRASONIC, "ultrasonic",    30000,    30000,    100,        0,      0,     1) \
+  X(TASK_RADIO,      "radio",        100000,   700000,  10000,        0,      0,     1)  /* the main loop, see below */ \
+  X(TASK_BAROMETER,  "barometer",   1300000,  1300000,    200,  1030000,      0,     1)  /* two conversions at oversampling 128 */ \
+  X(TASK_GPS,        "gps",         1500000,  1500000,    500,        0,      0,     1) \
+  X(TASK_HUMIDITY,   "humidity",    2500000,  2500000,   6000,        0,   6000,     1)  /* the DHT22 protocol */
+
+#define TASK_ID(id, name, period, deadline, wcet, spin, atomic, slice) id,
+
+enum TaskId {
+  TASK_TABLE(TASK_ID)
+  TASK_COUNT
+};
+
+#endif // TASK_TABLE_H
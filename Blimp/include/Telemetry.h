@@ -0,0 +1,46 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "GeneralLib.h"
+#include "PacketBuffer.h"
+
+#define TELEMETRY_FULL_FRAME 0x01   // Format byte of a complete fixed-layout frame (keyframe)
+#define TELEMETRY_DELTA_FRAME 0x02  // Format byte of a frame with varint deltas against an acknowledged frame
+#define TELEMETRY_FRAME_SIZE 31     // Format byte + sequence number + 29 bytes of fixed-point fields
+#define TELEMETRY_MAX_FRAME_SIZE 64 // Worst case of the delta frame is 5 header bytes + 11 five-byte varints
+#define TELEMETRY_FIELD_COUNT 11
+#define TELEMETRY_HISTORY 16        // Number of sent frames that can be used as a reference (same on the controller)
+#define TELEMETRY_KEYFRAME_PERIOD 12 // Maximal number of delta frames between two keyframes
+#define TELEMETRY_INVALID_16 INT16_MIN // Sent instead of a 16-bit field whose sensor reports INVALID_VALUE
+
+// Fixed-point image of one telemetry report (all multi-byte fields are sent little-endian)
+struct TelemetryFrame {
+    int16_t currentHeight;         // [cm]
+    int16_t requiredHeight;        // [cm]
+    int16_t currentRequiredHeight; // [cm]
+    int16_t temperature;           // DHT22 temperature [0.01 °C]
+    int16_t humidity;              // DHT22 relative humidity [0.01 %]
+    uint8_t power;                 // power of the height control engines [0 - 180]
+    int32_t altitude;              // barometric altitude [cm]
+    int32_t pressure;              // [Pa]
+    uint16_t speed;                // GPS speed [0.01 km/h]
+    int32_t latitude;              // [1e-7 deg]
+    int32_t longitude;             // [1e-7 deg]
+};
+
+extern bool DELTA_TELEMETRY;
+
+void fill_telemetry_frame(TelemetryFrame &frame);
+bool encode_telemetry(const TelemetryFrame &frame, PacketWriter &writer, unsigned int fieldBudget);
+bool keyframe_is_needed(unsigned char seq);
+bool keyframe_is_next(void);
+void telemetry_acknowledged(unsigned int seq);
+bool encode_telemetry_frame(const TelemetryFrame &frame, unsigned char seq, PacketWriter &writer);
+bool write_telemetry_fields(const TelemetryFrame &frame, PacketWriter &writer);
+bool encode_delta_frame(const int32_t *fields, const int32_t *reference, uint16_t selected, unsigned char seq, unsigned char refSeq, PacketWriter &writer);
+void frame_to_fields(const TelemetryFrame &frame, int32_t *fields);
+uint32_t zigzag_encode(int32_t value);
+int16_t to_fixed_16(float value, float scale);
+int32_t to_fixed_32(double value, double scale);
+
+#endif // TELEMETRY_H
@@ -0,0 +1,35 @@
+#ifndef TELEMETRY_SCHEDULER_H
+#define TELEMETRY_SCHEDULER_H
+
+#include "GeneralLib.h"
+#include "Telemetry.h"
+
+#define TELEMETRY_FIELD_BUDGET 28  // Bytes for field deltas in one frame, so that the packet fits a TDMA slot (see TDMA.h)
+
+// Priority classes of the telemetry fields, a lower number is sent first
+enum TelemetryPriority {
+  PRIORITY_CONTROL,      // values needed for flying
+  PRIORITY_NAVIGATION,   // GPS position and speed, barometric altitude
+  PRIORITY_ENVIRONMENT   // slow environmental readings
+};
+
+// Source of a telemetry field, i.e. which counter tells that a new sample exists
+enum TelemetrySource {
+  SOURCE_CONTROL,   // updated in every pass of the main loop
+  SOURCE_DHT22,     // TOPIC_HUMIDITY
+  SOURCE_PRESSURE,  // TOPIC_BAROMETER
+  SOURCE_GPS        // TOPIC_GPS
+};
+
+struct TelemetryFieldSchedule {
+  unsigned int period;          // the field is sent at most once per this period [ms]
+  TelemetryPriority priority;
+  TelemetrySource source;
+};
+
+uint16_t select_telemetry_fields(const int32_t *fields, const int32_t *reference, unsigned int budget);
+void telemetry_fields_sent(uint16_t selected);
+unsigned long telemetry_source_samples(TelemetrySource source);
+unsigned int varint_size(uint32_t value);
+
+#endif // TELEMETRY_SCHEDULER_H
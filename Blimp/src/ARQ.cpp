@@ -0,0 +1,91 @@
+#include "ARQ.h"
+
+/*
+Receiving side of the selective-repeat ARQ.
+The controller may have up to ARQ_WINDOW commands in flight. Commands that arrive out of order are kept
+in the receive window until the missing ones arrive, so process_command() always gets them in the order
+in which they were entered on the controller. All functions are called from the main loop:
+receive_service() puts the received commands into the window, the main loop then processes them.
+The commands are not confirmed one by one. write_command_ack() puts the state of the whole window into
+the next telemetry packet: everything before the next expected sequence number has been processed,
+the held bitmap tells which of the following ones already arrived (bit i = next expected + i)
+and the refused bitmap which of the last 8 processed commands were invalid (bit i = next expected - 1 - i).
+*/
+
+CommandRecord receiveWindow[ARQ_WINDOW];   // slot = seq % ARQ_WINDOW
+bool slotFilled[ARQ_WINDOW] = {false};
+uint16_t expectedSeq = 0;                  // sequence number of the next command to be processed
+bool sessionStarted = false;               // false until the first command arrives
+unsigned char refusedBits = 0;             // invalid commands among the last 8 processed ones
+
+/**
+ * Stores a received command in the receive window.
+ * A sequence number that is neither in the window nor among the recently processed ones means that
+ * the controller was restarted, so the window is synchronised to it.
+ *
+ * @param rec The received command.
+ * @return What has to be done with the command.
+ */
+CommandAcceptance accept_command(const CommandRecord &rec) {
+  int16_t distance = (int16_t)(rec.seq - expectedSeq);
+  if (sessionStarted && distance < 0 && distance >= -ARQ_DUPLICATE_WINDOW) return COMMAND_DUPLICATE;
+
+  if (!sessionStarted || distance < 0 || distance >= ARQ_WINDOW) {
+    Serial.print("Command window synchronised to "), Serial.println(rec.seq);
+    for (unsigned int i = 0; i < ARQ_WINDOW; i++) slotFilled[i] = false;
+    expectedSeq = rec.seq;
+    refusedBits = 0;
+    sessionStarted = true;
+  }
+
+  unsigned int slot = rec.seq % ARQ_WINDOW;
+  if (slotFilled[slot]) return COMMAND_PENDING;
+  receiveWindow[slot] = rec;
+  slotFilled[slot] = true;
+  return COMMAND_NEW;
+}
+
+/**
+ * Returns the next command in order, if it has already arrived. The command stays in the window
+ * until command_processed() is called, so its retransmissions are not taken as new commands.
+ *
+ * @param rec Reference to store the command.
+ * @return True if there is a command to be processed.
+ */
+bool next_command(CommandRecord &rec) {
+  unsigned int slot = expectedSeq % ARQ_WINDOW;
+  if (!slotFilled[slot]) return false;
+  rec = receiveWindow[slot];
+  return true;
+}
+
+/**
+ * Releases the command returned by next_command() and moves the window forward.
+ *
+ * @param refused True if the command was invalid, the controller then does not retransmit it.
+ */
+void command_processed(bool refused) {
+  slotFilled[expectedSeq % ARQ_WINDOW] = false;
+  expectedSeq++;
+  refusedBits = (refusedBits << 1) | (refused ? 1 : 0);
+}
+
+/**
+ * Writes the acknowledgement of the receive window (see the format in ARQ.h).
+ *
+ * @param writer The packet being built.
+ * @param resend True if the controller should retransmit its unacknowledged commands immediately.
+ */
+void write_command_ack(PacketWriter &writer, bool resend) {
+  unsigned char flags = resend ? ARQ_ACK_RESEND : 0;
+  unsigned char held = 0;
+  if (sessionStarted) flags |= ARQ_ACK_SESSION;
+  for (unsigned int i = 0; i < ARQ_WINDOW; i++) {
+    if (slotFilled[(uint16_t)(expectedSeq + i) % ARQ_WINDOW]) held |= 1 << i;
+  }
+
+  writer.put_byte(flags);
+  writer.put_int16(expectedSeq);
+  writer.put_byte(held);
+  writer.put_byte(refusedBits);
+}
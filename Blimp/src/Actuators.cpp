@@ -0,0 +1,88 @@
+#include "Actuators.h"
+#include "ControlMotors.h"
+#include "Scheduler.h"
+
+Actuator actuators[ACTUATOR_COUNT];  // indexed by ActuatorOutput
+volatile bool safeStop = true;       // until the control code releases it
+volatile unsigned long actuatorWrites = 0;
+
+/**
+ * Attaches the ESCs and the servo and calibrates the ESCs at the stop power.
+ * It must be called before the threads that set the outputs are started, it takes 1.5 seconds.
+ */
+void actuators_begin(void) {
+  const unsigned int pins[ACTUATOR_COUNT] = {ESC_H_1, ESC_H_2, FORWARD_ESC, SERVO_PIN};
+  const float slews[ACTUATOR_COUNT] = {ACTUATOR_ESC_SLEW, ACTUATOR_ESC_SLEW, ACTUATOR_FORWARD_SLEW, ACTUATOR_SERVO_SLEW};
+  for (unsigned int i = 0; i < ACTUATOR_COUNT; i++) {
+    Actuator &a = actuators[i];
+    a.pin = pins[i];
+    a.esc = i != ACTUATOR_SERVO;
+    a.slew = slews[i];
+    a.writtenAt = 0;
+    if (a.esc) {
+      a.servo.attach(a.pin, 1000, 2000);  // pulse width range 1000 to 2000 microseconds
+      a.target = STOP_POWER;
+    } else {
+      a.servo.attach(a.pin);
+      a.target = SERVO_OFFSET;  // straight ahead
+    }
+    a.value = a.target;
+    a.servo.write(a.target);  // the ESCs are calibrated at the stop power
+    a.written = a.target;
+  }
+  delay(1500);
+}
+
+/**
+ * Sets the wanted value of an output. It may be called from any thread, the output follows in thread_actuators().
+ *
+ * @param output The output.
+ * @param value The value of Servo::write() (0 - 180).
+ */
+void actuator_set(ActuatorOutput output, int value) {
+  actuators[output].target = constrain(value, 0, 180);
+}
+
+/**
+ * Engages or releases the safe stop of all ESCs.
+ *
+ * @param stop True to stop the ESCs, false to let them follow their values again.
+ */
+void actuators_safe_stop(bool stop) {
+  safeStop = stop;
+}
+
+/**
+ * An infinite loop that moves the outputs towards their values. It is intended to run as a separate thread.
+ */
+void thread_actuators(void) {
+  unsigned long lastTime = millis();
+  while (true) {
+    task_job_start(TASK_ACTUATORS);  // see Scheduler.h
+    unsigned long now = millis();
+    float dt = (now - lastTime) / 1000.0;
+    lastTime = now;
+    bool stop = safeStop;
+    for (unsigned int i = 0; i < ACTUATOR_COUNT; i++) {
+      Actuator &a = actuators[i];
+      int target = a.target;
+      if (stop && a.esc) {
+        a.value = STOP_POWER;  // at once
+      } else {
+        float step = a.slew * dt;
+        if (target > a.value + step) a.value += step;
+        else if (target < a.value - step) a.value -= step;
+        else a.value = target;
+      }
+      int out = lroundf(a.value);
+      if (out != a.written || now - a.writtenAt >= ACTUATOR_REFRESH) {
+        a.servo.write(out);
+        a.written = out;
+        a.writtenAt = now;
+        actuatorWrites++;
+      }
+    }
+    task_job_end(TASK_ACTUATORS);
+    threads.delay(ACTUATOR_PERIOD);
+  }
+}
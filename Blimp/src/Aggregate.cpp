@@ -0,0 +1,99 @@
+#include "Aggregate.h"
+#include "TelemetryScheduler.h"
+
+RunningAggregate aggregates[AGGREGATE_FIELD_COUNT];  // the current window, samples come from several threads
+
+/**
+ * Adds a sample to the current window of a field. It may be called from any thread.
+ *
+ * @param field The field.
+ * @param value The sample in the units of the field.
+ */
+void aggregate_sample(AggregateField field, float value) {
+  noInterrupts();  // the threads are switched by an interrupt
+  RunningAggregate &a = aggregates[field];
+  a.count++;
+  if (a.count == 1) {
+    a.min = a.max = a.mean = value;
+    a.m2 = 0;
+  } else {
+    if (value < a.min) a.min = value;
+    if (value > a.max) a.max = value;
+    float delta = value - a.mean;
+    a.mean += delta / a.count;
+    a.m2 += delta * (value - a.mean);
+  }
+  interrupts();
+}
+
+/**
+ * Copies the current window without ending it.
+ *
+ * @param window Array of AGGREGATE_FIELD_COUNT aggregates.
+ */
+void aggregate_peek(RunningAggregate *window) {
+  noInterrupts();
+  for (unsigned int i = 0; i < AGGREGATE_FIELD_COUNT; i++) window[i] = aggregates[i];
+  interrupts();
+}
+
+/**
+ * Copies the current window and starts a new one.
+ *
+ * @param window Array of AGGREGATE_FIELD_COUNT aggregates.
+ */
+void aggregate_take(RunningAggregate *window) {
+  noInterrupts();
+  for (unsigned int i = 0; i < AGGREGATE_FIELD_COUNT; i++) {
+    window[i] = aggregates[i];
+    aggregates[i].count = 0;
+  }
+  interrupts();
+}
+
+/**
+ * Writes the aggregates section (see Aggregate.h).
+ *
+ * @param window Array of AGGREGATE_FIELD_COUNT aggregates.
+ * @param writer The packet.
+ */
+void write_aggregates(const RunningAggregate *window, PacketWriter &writer) {
+  uint32_t values[AGGREGATE_MAX_VALUES];
+  unsigned int n = aggregate_values(window, values);
+  for (unsigned int i = 0; i < n; i++) writer.put_varint(values[i]);
+}
+
+/**
+ * Returns the size of the aggregates section.
+ *
+ * @param window Array of AGGREGATE_FIELD_COUNT aggregates.
+ */
+unsigned int aggregate_section_size(const RunningAggregate *window) {
+  uint32_t values[AGGREGATE_MAX_VALUES];
+  unsigned int n = aggregate_values(window, values);
+  unsigned int size = 0;
+  for (unsigned int i = 0; i < n; i++) size += varint_size(values[i]);
+  return size;
+}
+
+/**
+ * Converts the aggregates to the numbers of the section.
+ *
+ * @param window Array of AGGREGATE_FIELD_COUNT aggregates.
+ * @param values Filled with the numbers, at most AGGREGATE_MAX_VALUES.
+ * @return Count of the numbers.
+ */
+unsigned int aggregate_values(const RunningAggregate *window, uint32_t *values) {
+  unsigned int n = 0;
+  for (unsigned int i = 0; i < AGGREGATE_FIELD_COUNT; i++) {
+    const RunningAggregate &a = window[i];
+    values[n++] = a.count;
+    if (a.count == 0) continue;
+    int32_t mean = lroundf(a.mean);
+    values[n++] = zigzag_encode(mean);
+    values[n++] = (mean > a.min) ? (uint32_t)lroundf(mean - a.min) : 0;
+    values[n++] = (a.max > mean) ? (uint32_t)lroundf(a.max - mean) : 0;
+    values[n++] = (uint32_t)lroundf(sqrtf(a.m2 / a.count) * 10);  // population standard deviation of the window
+  }
+  return n;
+}
@@ -0,0 +1,73 @@
+#include "Airtime.h"
+#include "LinkAdaptation.h"
+
+/*
+Duty-cycle governor.
+Transmissions are paid from a token bucket that holds airtime in ms. It refills at airtimeDutyCycle of the real time
+and holds at most the airtime allowed in AIRTIME_WINDOW, so no window of that length can have more airtime than
+the duty cycle permits (except for the full bucket after a quiet period, which is the point of the window).
+Every transmitted packet is charged by transmit_packet() at its real time on air for the current link profile.
+Commands may use the whole bucket, telemetry and background traffic have to leave a reserve,
+so when the budget is tight, they are deferred (or downsampled by the caller) and the commands still get through.
+*/
+
+float airtimeDutyCycle = AIRTIME_DUTY_CYCLE;
+float airtimeTokens = 0;             // available airtime [ms]
+bool airtimeStarted = false;         // the bucket is full at the start
+unsigned long airtimeRefilledAt = 0;
+
+/**
+ * Adds the airtime earned since the last call.
+ */
+void airtime_refill(void) {
+  unsigned long now = millis();
+  float capacity = airtime_capacity();
+  if (!airtimeStarted) {
+    airtimeTokens = capacity;
+    airtimeStarted = true;
+  }
+  airtimeTokens += (now - airtimeRefilledAt) * airtimeDutyCycle / 100;
+  if (airtimeTokens > capacity) airtimeTokens = capacity;
+  airtimeRefilledAt = now;
+}
+
+/**
+ * Checks whether a packet of a traffic class may be sent now.
+ *
+ * @param trafficClass The traffic class of the packet.
+ * @param bytes Length of the packet including the frame check (see Framing.h).
+ * @return True if the budget allows it.
+ */
+bool airtime_allowed(AirtimeClass trafficClass, unsigned int bytes) {
+  airtime_refill();
+  float reserve = 0;
+  if (trafficClass == AIRTIME_TELEMETRY) reserve = airtime_capacity() * AIRTIME_TELEMETRY_RESERVE / 100;
+  else if (trafficClass == AIRTIME_BACKGROUND) reserve = airtime_capacity() * AIRTIME_BACKGROUND_RESERVE / 100;
+  return airtimeTokens - reserve >= link_airtime(currentProfile, bytes);
+}
+
+/**
+ * Pays for a transmitted packet. The bucket may go below zero (a packet sent without asking),
+ * the following packets then wait until the debt is paid.
+ *
+ * @param bytes Length of the packet including the frame check.
+ */
+void airtime_charge(unsigned int bytes) {
+  airtime_refill();
+  airtimeTokens -= link_airtime(currentProfile, bytes);
+}
+
+/**
+ * Returns the airtime that is available now [ms].
+ */
+float airtime_available(void) {
+  airtime_refill();
+  return airtimeTokens;
+}
+
+/**
+ * Returns the size of the bucket, i.e. the airtime allowed in AIRTIME_WINDOW [ms].
+ */
+float airtime_capacity(void) {
+  return AIRTIME_WINDOW * airtimeDutyCycle / 100;
+}
@@ -0,0 +1,103 @@
+#include "Backlog.h"
+#include "SD_card.h"
+
+/*
+The frames are kept in a ring: when it is full, the oldest frame is overwritten, even if it has not been downloaded.
+A frame is sent to the controller once, a lost download packet is not repeated; the controller can ask for
+the whole ring again. The download rides on the beacons, which are then longer than TDMA_MAX_PACKET. The TDMA
+slots are counted from the end of the beacon (see TDMA.h), so the longer beacon does not reach into them,
+and the airtime budget (see Airtime.h) lets the download use only the spare airtime.
+*/
+
+struct BacklogEntry {
+  unsigned long time;       // millis() when the frame was recorded
+  TelemetryFrame frame;
+  bool waiting;             // not downloaded yet
+};
+
+BacklogEntry backlog[BACKLOG_SIZE];
+unsigned long backlogRecorded = 0;  // number of frames recorded so far, the newest is at (backlogRecorded - 1) % BACKLOG_SIZE
+unsigned long backlogNext = 0;      // the oldest frame that may still be waiting
+unsigned int backlogWaiting = 0;
+bool sdPresent = false;
+
+/**
+ * Checks whether an SD card is present. It is called once from setup().
+ */
+void backlog_begin(void) {
+  sdPresent = SD.begin(chipSelect);
+  Serial.println(sdPresent ? "SD card found, the telemetry is recorded." : "No SD card, the telemetry is kept in RAM only.");
+}
+
+/**
+ * Records a telemetry frame. It is called for every beacon.
+ * The frame waits for download if the controller has not been heard for BACKLOG_LINK_TIMEOUT.
+ *
+ * @param frame The frame that is being sent.
+ */
+void backlog_record(const TelemetryFrame &frame) {
+  BacklogEntry &entry = backlog[backlogRecorded % BACKLOG_SIZE];
+  if (backlogRecorded >= BACKLOG_SIZE && entry.waiting) backlogWaiting--;  // the oldest frame is lost
+  entry.time = millis();
+  entry.frame = frame;
+  entry.waiting = lastReceivedTime == 0 || millis() - (unsigned long)lastReceivedTime > BACKLOG_LINK_TIMEOUT;
+  if (entry.waiting) backlogWaiting++;
+  backlogRecorded++;
+  if (backlogRecorded - backlogNext > BACKLOG_SIZE) backlogNext = backlogRecorded - BACKLOG_SIZE;
+
+  if (sdPresent) {
+    unsigned char data[4 + BACKLOG_RECORD_SIZE];
+    PacketWriter writer(data, sizeof(data));
+    writer.put_int32(entry.time);
+    write_telemetry_fields(frame, writer);
+    File file = SD.open(BACKLOG_SD_FILE, FILE_WRITE);
+    if (file) {
+      file.write(data, writer.length());
+      file.close();
+    }
+  }
+}
+
+/**
+ * Marks all frames in RAM for download (the BACKLOG_REQUEST command).
+ */
+void backlog_request(void) {
+  backlogNext = (backlogRecorded > BACKLOG_SIZE) ? backlogRecorded - BACKLOG_SIZE : 0;
+  backlogWaiting = backlogRecorded - backlogNext;
+  for (unsigned long i = backlogNext; i < backlogRecorded; i++) backlog[i % BACKLOG_SIZE].waiting = true;
+  Serial.print("Backlog requested: "), Serial.print(backlogWaiting), Serial.println(" frames");
+}
+
+/**
+ * Returns the number of frames waiting for download. They are sent only while the controller is heard.
+ */
+unsigned int backlog_waiting(void) {
+  if (lastReceivedTime == 0 || millis() - (unsigned long)lastReceivedTime > BACKLOG_LINK_TIMEOUT) return 0;
+  return backlogWaiting;
+}
+
+/**
+ * Writes the oldest waiting frames to a packet, they are then no longer waiting.
+ * Format: [number of records, number of records still waiting (2 bytes), records] (see Backlog.h)
+ *
+ * @param writer The packet.
+ * @param records The maximal number of records.
+ * @return The number of records written.
+ */
+unsigned int write_backlog(PacketWriter &writer, unsigned int records) {
+  if (records > backlogWaiting) records = backlogWaiting;
+  writer.put_byte(records);
+  writer.put_int16(backlogWaiting - records);
+  unsigned long now = millis();
+  unsigned int written = 0;
+  for (; backlogNext < backlogRecorded && written < records; backlogNext++) {
+    BacklogEntry &entry = backlog[backlogNext % BACKLOG_SIZE];
+    if (!entry.waiting) continue;
+    writer.put_int32(now - entry.time);
+    write_telemetry_fields(entry.frame, writer);
+    entry.waiting = false;
+    backlogWaiting--;
+    written++;
+  }
+  return written;
+}
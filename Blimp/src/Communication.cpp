@@ -6,54 +6,162 @@ float REQ_HEIGHT = 0; // Target height in m
 float CURRENT_HEIGHT = 0;
 float C_R_H = 0;
 int ANGLE = 0;
-unsigned int LAST_COUNTER = 127;
 unsigned char RECEIVED_ID = 0x11;
 int RECEIVED_REQ_HEIGHT = 0; // Required height sent from controller
 int POWER_OF_STEERING_MOTOR = 110;
 bool VALID_MSG = false;
-bool NEW_MSG = false;
+volatile bool NACK_PENDING = false;
+volatile bool ACK_PENDING = false;
+bool DUPLICATE_ACK_PENDING = false;
 long lastSendTime = 0;        // last send time
 long lastReceivedTime = 0;        // last received time
 
+PacketBuffer rxPacket;  // The packet being processed, it is written only from receive_service() (and capture_replay())
+
 /**
- * Handles incoming LoRa packets.
+ * Handles incoming LoRa packets. It runs in the LoRa interrupt, so it only puts the packet into
+ * the receive queue (see ReceiveQueue.h), the packet is processed by receive_service().
  *
  * @param packetSize The size of the received packet.
  */
 void onReceive(int packetSize) {
+  PROFILE_SECTION(PROFILE_ON_RECEIVE);  // see Profiler.h
   if (packetSize == 0) return;  // if there's no packet, return
-  Serial.print("Message received");
+  receive_queue_push(packetSize);
+}
+
+/**
+ * Processes the packets received since the last pass of the main loop.
+ */
+void receive_service(void) {
+  PROFILE_SECTION(PROFILE_RECEIVE_SERVICE);
+  while (receive_queue_pop(rxPacket)) {
+    Serial.println("Message received");
+    capture_packet(CAPTURE_RECEIVED, rxPacket.data, rxPacket.length, rxPacket.time, rxPacket.rssi, rxPacket.snr);  // see Capture.h
+    process_received_packet();
+  }
 
-  unsigned char recipientAddres = LoRa.read();  // recipient address
+  static unsigned long lastReport = 0;
+  if (millis() - lastReport >= RECEIVE_STATISTICS_PERIOD) {
+    print_receive_statistics();
+    lastReport = millis();
+  }
+}
+
+/**
+ * Checks the frame in rxPacket and processes the commands of the controller or the beacon of another airship.
+ */
+void process_received_packet(void) {
+  FrameStatus status = check_frame(rxPacket);
+  link_stats_frame_checked(status);
+  if (status == FRAME_CORRUPTED) {  // CRC does not match and the error could not be corrected
+    handleCorruptedMessage();
+    return;
+  }
+  PacketReader reader(rxPacket.data, rxPacket.length);
+
+  unsigned char recipientAddres;
+  if (!reader.read_byte(recipientAddres)) return;
+  if (recipientAddres == destinationAddress) {  // telemetry of another airship in the fleet
+    handle_fleet_packet(reader);
+    return;
+  }
   if (!MsgIsForMe(recipientAddres)){return;}  // if msg is not for me, skip rest of function
   
-  lastReceivedTime = millis();  // Record the time when the message was received
+  lastReceivedTime = rxPacket.time;  // Record the time when the message was received
+  link_record_packet(rxPacket.snr, rxPacket.rssi);  // SNR and RSSI for the link adaptation
+  link_stats_packet_received();
   
-  unsigned char senderAddres = LoRa.read(); // sender address
-  
-  unsigned int counter; // counter
-  bool counterParity;  // parity for counter
-  ExtractCounterFromByte(counter, counterParity, LoRa.read());  // read counter and his parity
-  bool valid_msg = check_parity(counter, counterParity);  // If the parities differ, then "valid_msg" will be set to "false"
-
-  unsigned char cmdID = LoRa.read();  // command ID
-  valid_msg = valid_msg && check_cmdID(cmdID);  // If cmdID is invalid, then valid_msg will be set to "false"
+  unsigned char senderAddres;  // sender address
+  unsigned char count;  // number of commands in the packet
+  reader.read_byte(senderAddres);
+  reader.read_byte(count);
+  if (!reader.ok()) return;  // truncated header
 
-  if (handleDuplicateMessage(valid_msg, cmdID, counter)) return;  // Exit if a duplicate message was handled
+  // The controller packs all commands that are waiting for transmission into one packet
+  CommandRecord rec;
+  for (unsigned int i = 0; i < count && read_command(reader, rec); i++) {
+    handle_received_command(rec);
+  }
+}
 
-  if (cmdID == all_ids.SET_EXACT_HEIGHT || cmdID == all_ids.POTENTIOMETR_ANGLE || cmdID == all_ids.SET_MOTOR_POWER){
-    read_specific_value(valid_msg, cmdID);
+/**
+ * Follows the beacons of the other airships of the fleet, so that this airship keeps to its own frame
+ * of the TDMA superframe (see TDMA.h).
+ * Format: [sender address, status, message type, ...] (see write_message_header())
+ *
+ * @param reader The received packet, positioned behind the recipient address.
+ */
+void handle_fleet_packet(PacketReader &reader) {
+  unsigned char senderAddres, status, type_of_msg;
+  reader.read_byte(senderAddres);
+  reader.read_byte(status);
+  reader.read_byte(type_of_msg);
+  if (!reader.ok() || !fleet_assigned() || senderAddres == localAddress) return;
+  if (senderAddres < FLEET_FIRST_ADDRESS || senderAddres >= FLEET_FIRST_ADDRESS + FLEET_SIZE) return;
+  if (type_of_msg == report.MEASURED_DATA && ((status >> 2) & 1)) {
+    tdma_fleet_beacon(senderAddres - FLEET_FIRST_ADDRESS, rxPacket.time);
   }
+}
+
+/**
+ * Reads one command of a received packet.
+ * Format: [sequence number (2 bytes), command ID, optionally(value)]
+ *
+ * @param reader The received packet, positioned at the command.
+ * @param rec Reference to store the command.
+ * @return False if the packet ends before the command ID.
+ */
+bool read_command(PacketReader &reader, CommandRecord &rec) {
+  int16_t seq;  // sequence number
+  unsigned char cmdID;  // command ID
+  reader.read_int16(seq);
+  reader.read_byte(cmdID);
+  if (!reader.ok()) return false;
 
-  if (cmdID != all_ids.SAY_HI){  // Handle non-"SAY_HI" commands
-    RECEIVED_ID = cmdID;
-    VALID_MSG = valid_msg;
-    NEW_MSG = true;
+  rec.seq = (uint16_t)seq;
+  rec.cmdID = cmdID;
+  rec.value = 0;
+  rec.valid = check_cmdID(cmdID);  // If cmdID is invalid, then valid will be set to "false"
+  if (command_has_value(cmdID)) {
+    rec.valid = reader.read_int32(rec.value) && rec.valid;
+  }
+  if (cmdID == all_ids.LINK_PROFILE && (rec.value < 0 || rec.value >= LINK_PROFILE_COUNT)) {
+    rec.valid = false;  // unknown profile
   }
+  if (cmdID == all_ids.HOP_MODE && (rec.value < 0 || rec.value >= (1 << HOP_CHANNELS))) {
+    rec.valid = false;  // unknown channels
+  }
+  if (cmdID == all_ids.FLEET_SLOTS && (rec.value < 1 || rec.value > FLEET_SIZE)) {
+    rec.valid = false;
+  }
+  if (cmdID == all_ids.CONTROL_SETPOINT && (abs(setpoint_angle(rec.value)) > 270 || setpoint_power(rec.value) > 180)) {
+    rec.valid = false;  // [degrees], power as in SET_MOTOR_POWER
+  }
+  return true;
+}
 
-  if (valid_msg) {
-    LAST_COUNTER = counter;
+/**
+ * Puts a received command into the receive window (see ARQ.h), unless it is handled right away.
+ * It runs in the main loop, as receive_service(), so the window needs no lock.
+ *
+ * @param rec The received command.
+ */
+void handle_received_command(const CommandRecord &rec) {
+  if (rec.cmdID == all_ids.SAY_HI) return;  // "SAY_HI" only keeps the connection alive
+  if (rec.cmdID == all_ids.TELEMETRY_ACK) {  // Acknowledgement of telemetry is not acknowledged and does not use the sequence number
+    if (rec.valid) telemetry_acknowledged(rec.value);
+    return;
+  }
+  if (rec.cmdID == all_ids.CONTROL_SETPOINT) {  // Not acknowledged, the newest setpoint wins (see Steering.h)
+    if (rec.valid) steering_received(rec.seq, rec.value);
+    return;
   }
+  if (rec.cmdID == all_ids.ASSIGN_ADDRESS) {  // Answer to a join request, it is not confirmed either (see Fleet.h)
+    if (rec.valid) fleet_assign(rec.value);
+    return;
+  }
+  if (accept_command(rec) == COMMAND_DUPLICATE) handleDuplicateMessage(rec.seq);
 }
 
 /**
@@ -70,31 +178,6 @@ bool MsgIsForMe(unsigned char recipientAddres){
   else {return true;}
 }
 
-/**
- * Extracts counter value and its parity from a received byte.
- * 
- * @param counter Reference to store the extracted counter.
- * @param counterParity Reference to store the extracted parity.
- * @param rByte The byte from which the counter and parity are extracted.
- */
-void ExtractCounterFromByte(unsigned int &counter, bool &counterParity, unsigned char rByte){
-  counter = rByte & 0x7F;
-  counterParity = (rByte >> 7) & 1;
-}
-
-/**
- * Checks if the parity of a given number matches the provided original parity.
- * 
- * @param number The number whose parity is to be checked.
- * @param originalParity The original parity bit received with the number.
- * @return True if the calculated parity matches the original parity, False otherwise.
- */
-bool check_parity(unsigned int number, bool originalParity){
-  bool currentParity = get_even_parity(number);
-  if (currentParity == originalParity){return true;}
-  else {return false;}
-}
-
 /**
  * Checks if the received command ID is a valid command.
  *
@@ -103,7 +186,9 @@ bool check_parity(unsigned int number, bool originalParity){
  */
 bool check_cmdID(unsigned char cmdID){
   if (cmdID == all_ids.DOWN || cmdID == all_ids.LAND || cmdID == all_ids.SAY_HI || cmdID == all_ids.SET_EXACT_HEIGHT || cmdID == all_ids.UP 
-  || cmdID == all_ids.POTENTIOMETR_ANGLE || cmdID == all_ids.FLY_FORWARD || cmdID == all_ids.SET_MOTOR_POWER || cmdID == all_ids.MOTORS_OFF){
+  || cmdID == all_ids.POTENTIOMETR_ANGLE || cmdID == all_ids.FLY_FORWARD || cmdID == all_ids.SET_MOTOR_POWER || cmdID == all_ids.MOTORS_OFF || cmdID == all_ids.TELEMETRY_ACK || cmdID == all_ids.LINK_PROFILE
+  || cmdID == all_ids.ASSIGN_ADDRESS || cmdID == all_ids.FLEET_SLOTS || cmdID == all_ids.CONTROL_SETPOINT
+  || cmdID == all_ids.BACKLOG_REQUEST || cmdID == all_ids.HOP_MODE || cmdID == all_ids.QUERY || cmdID == all_ids.PROFILE_DUMP){
     return true;
   }
   else {
@@ -112,167 +197,194 @@ bool check_cmdID(unsigned char cmdID){
 }
 
 /**
- * Handles potential duplicate messages based on command ID and counter.
- *
- * @param valid_msg Indicates whether the message is still valid.
- * @param cmdID The command ID of the received message.
- * @param counter The counter value of the received message.
- * @return true if a duplicate message was detected and handled, false otherwise.
+ * Handles a frame that failed the CRC check. If it still seems to be addressed to this device,
+ * the next telemetry packet asks the controller to retransmit immediately instead of waiting for its timeout.
  */
-bool handleDuplicateMessage(bool valid_msg, unsigned char cmdID, unsigned int counter) {
-    if (valid_msg && LAST_COUNTER == counter && cmdID != all_ids.SAY_HI) {
-        Serial.println("Duplicate counter detected");
-        sendMessage("VALID", report.CONFIRMATION, LAND, FLY_FORWARD, LAST_COUNTER);
-        LoRa.receive();
-        return true;  // Indicates a duplicate message was handled
-    }
-    return false;  // Indicates no duplicate message was found
+void handleCorruptedMessage(void) {
+  Serial.println("Corrupted frame");
+  if (rxPacket.length > 0 && rxPacket.data[0] == localAddress) {
+    NACK_PENDING = true;
+  }
 }
 
 /**
- * Reads and processes specific values from the received LoRa message.
- *
- * This function is called when the command ID indicates that a specific value needs to be read (e.g., SET_EXACT_HEIGHT or POTENTIOMETR_ANGLE).
- * It reads the additional data from the LoRa module, checks its parity, and if valid, processes the data based on the command ID.
+ * Handles a command that has already been processed. Its acknowledgement was probably lost,
+ * so the main loop sends the next telemetry packet right away, if the airtime budget allows it.
  *
- * @param valid_msg Indicates whether the message is valid. It will be updated based on the parity check.
- * @param cmdID The command ID of the received message.
+ * @param seq The sequence number of the received command.
  */
-void read_specific_value(bool &valid_msg, byte cmdID) {
-  String value = "";
-  while (LoRa.available()) {
-    value += (char)LoRa.read();      // add bytes one by one
-  }
-  int receivedValue = value.toInt();
-  
-  int newValue;
-  bool originalParity;
-  decodeValueAndParity(receivedValue, newValue, originalParity);
-
-  valid_msg = check_parity(newValue, originalParity) && valid_msg;
-
-  if (valid_msg){
-    if (cmdID == all_ids.SET_EXACT_HEIGHT){
-      RECEIVED_REQ_HEIGHT = newValue;
-    } else if (cmdID == all_ids.POTENTIOMETR_ANGLE){
-      ANGLE = newValue;
-    } else if (cmdID == all_ids.SET_MOTOR_POWER){
-      POWER_OF_STEERING_MOTOR = newValue;
-    }
-  }
+void handleDuplicateMessage(uint16_t seq) {
+    Serial.print("Duplicate sequence number detected: "), Serial.println(seq);
+    link_stats_duplicate();
+    DUPLICATE_ACK_PENDING = true;
 }
 
 /**
- * Decodes a value received that includes a value and a parity bit.
- * This function extracts the parity bit and the actual value from a received integer where
- * the least significant bit is the parity and the other bits represent the value.
- * 
- * @param receivedValue The received integer containing both the value and the parity.
- * @param newValue Reference to store the extracted value.
- * @param originalParity Reference to store the extracted parity.
+ * Checks whether a command carries a value (e.g., SET_EXACT_HEIGHT or POTENTIOMETR_ANGLE).
  */
-void decodeValueAndParity(int receivedValue ,int &newValue, bool &originalParity) {
-  originalParity = receivedValue & 1;
-  newValue = receivedValue >> 1;
+bool command_has_value(unsigned char cmdID) {
+  return cmdID == all_ids.SET_EXACT_HEIGHT || cmdID == all_ids.POTENTIOMETR_ANGLE || cmdID == all_ids.SET_MOTOR_POWER || cmdID == all_ids.TELEMETRY_ACK
+      || cmdID == all_ids.LINK_PROFILE || cmdID == all_ids.ASSIGN_ADDRESS || cmdID == all_ids.FLEET_SLOTS
+      || cmdID == all_ids.CONTROL_SETPOINT || cmdID == all_ids.HOP_MODE || cmdID == all_ids.QUERY;
 }
 
 /**
- * Sends a message using LoRa communication in a specific format.
- * Format: [recipient address, local address, land, parity for land, fly_forward, parity for fly_forward, command ID, 
- * optionally(counter, parity for counter), message]
+ * Applies the value carried by a command. It is called right before the command is processed,
+ * so a value never overtakes the commands that were entered before it.
  *
- * @param msg The message string to be sent.
- * @param type_of_msg The type of the message being sent.
- * @param land A boolean variable indicating whether to land.
- * @param fly_forward A boolean variable indicating whether to fly forward.
- * @param cnt An optional counter value representing the last correctly received message (default is 127).
+ * @param rec The command being processed.
  */
-void sendMessage(String msg, unsigned char type_of_msg, bool land, bool fly_forward, unsigned int cnt = 127) {
-  LoRa.beginPacket();                   // start packet
-  LoRa.write(destinationAddress);       // add destination address
-  LoRa.write(localAddress);             // add sender address
-  LoRa.write(encode_to_byte(land, get_even_parity(land), fly_forward, get_even_parity(fly_forward))); // add land, parity for land, fly_forward and parity for fly_forward
-  LoRa.write(type_of_msg);             // add type of msg
-  if(type_of_msg == report.CONFIRMATION){
-    LoRa.write(createCounterByte(cnt));
+void apply_command_value(const CommandRecord &rec) {
+  if (!rec.valid) return;
+  if (rec.cmdID == all_ids.SET_EXACT_HEIGHT){
+    RECEIVED_REQ_HEIGHT = rec.value;
+  } else if (rec.cmdID == all_ids.POTENTIOMETR_ANGLE){
+    ANGLE = rec.value;
+  } else if (rec.cmdID == all_ids.SET_MOTOR_POWER){
+    POWER_OF_STEERING_MOTOR = rec.value;
   }
-  LoRa.print(msg);                      // add payload
-  LoRa.endPacket();                     // finish packet and send it
-  lastSendTime = millis();
 }
 
 /**
- * Function to write the values of boolean variables x, y, z, w into a single unsigned char variable one_byte.
- * format is '0x0y 0z0w'
-*/
-unsigned char encode_to_byte(bool x, bool y, bool z, bool w){
-  unsigned char one_byte = 0; // Initialize to zero
-
-  // Bitwise operations to store the values of variables x, y, z, w into one_byte
-  one_byte |= (x << 6);
-  one_byte |= (y << 4);
-  one_byte |= (z << 2);
-  one_byte |= w;
-
-  return one_byte;
+ * Writes the common message header to a packet.
+ * Format: [recipient address, local address, status (aggregates, query, hopping, backlog, link statistics, beacon, land, fly_forward), message type]
+ */
+void write_message_header(PacketWriter &writer, unsigned char type_of_msg, bool land, bool fly_forward, bool beacon, bool stats, bool backlog, bool hop, bool query, bool aggregates) {
+  writer.put_byte(destinationAddress);  // add destination address
+  writer.put_byte(localAddress);        // add sender address
+  writer.put_byte(encode_status_byte(land, fly_forward, beacon, stats, backlog, hop, query, aggregates)); // add land, fly_forward, beacon, link statistics, backlog, hopping, query and aggregates
+  writer.put_byte(type_of_msg);         // add type of msg
 }
 
 /**
- * Creates a byte containing a counter and its parity.
- * This function packs a 7-bit counter and a 1-bit parity into an 8
- * 
- * @param counter The counter value to be packed into the byte.
- * @return A byte with the 7 least significant bits as the counter and the most significant bit as the parity.
-*/
-char createCounterByte(unsigned int counter){
-  unsigned char inp = (unsigned char)(counter & 0x7F);
-  bool parityBit = get_even_parity(counter);
-  if (parityBit)
-    inp |= 0x80; // set MSB to 1
-  return inp;
+ * Packs the airship status into one byte. Format is 'AQHK SBLF' (A = aggregates follow the backlog,
+ * Q = query section instead of the telemetry frame,
+ * H = hopping state follows the link report,
+ * K = backlog records follow the link statistics, S = link statistics follow the link report or the hopping state,
+ * B = beacon of a TDMA frame, L = land, F = fly_forward).
+ */
+unsigned char encode_status_byte(bool land, bool fly_forward, bool beacon, bool stats, bool backlog, bool hop, bool query, bool aggregates){
+  return (aggregates << 7) | (query << 6) | (hop << 5) | (backlog << 4) | (stats << 3) | (beacon << 2) | (land << 1) | fly_forward;
 }
 
 /**
- * Calculates the even parity bit for a given number.
- * 
- * @param number The number for which to calculate the parity bit.
- * @return The calculated parity bit (0 or 1).
- */
-bool get_even_parity(unsigned int number){
-  bool parityBit = 0;
-  while (number) {
-    parityBit ^= number & 1; // XOR operation between the LSB of the current number and the current parity bit
-    number >>= 1;  // Shift one bit to the right
+ * Packs selected measured data into a binary telemetry frame (see Telemetry.h) and sends it.
+ * Depending on the acknowledgements from the controller, the frame is sent either whole or as a delta.
+ * Every packet also acknowledges the received commands (see ARQ.h), there are no separate confirmations.
+ * Now and then a delta frame gives up part of its field budget to the link statistics (see LinkStats.h).
+ * Beacons are recorded and, after a loss of the link, also carry the recorded frames (see Backlog.h)
+ * as far as the airtime budget allows. While hopping, each beacon goes out on the channel of its frame (see Hopping.h).
+ * While the controller has a query open, the variables it asked for replace the telemetry frame (see Query.h).
+ * A beacon with a delta frame and enough room also carries the aggregates of the fast values since the previous one (see Aggregate.h).
+ * Format: [header, command acknowledgement, link report, optionally(hopping state), optionally(link statistics),
+ * optionally(backlog), optionally(aggregates), telemetry frame or query section, CRC, FEC]
+ *
+ * @param beacon True for the periodic packet that starts a TDMA frame (see TDMA.h).
+*/
+void send_measured_data(bool beacon) {
+  PROFILE_SECTION(PROFILE_SEND_MEASURED_DATA);
+  TelemetryFrame frame;
+  unsigned char data[PACKET_CAPACITY];
+  PacketWriter writer(data, sizeof(data));
+  fill_telemetry_frame(frame);
+  if (beacon) hop_next_frame();  // tune to the channel of the new frame
+  bool hop = beacon && hop_active();
+
+  ACK_PENDING = false;  // cleared before the acknowledgement is written, so a command received meanwhile is not missed
+  DUPLICATE_ACK_PENDING = false;
+  bool resend = NACK_PENDING;
+  NACK_PENDING = false;
+
+  bool query = query_active();
+  bool stats = link_stats_report_due() && (query || !keyframe_is_next());  // a keyframe leaves no room for them
+  unsigned int fieldBudget = TELEMETRY_FIELD_BUDGET;
+  unsigned int records = 0;
+  if (beacon) {
+    backlog_record(frame);
+    records = backlog_waiting();
+    if (records > BACKLOG_RECORDS_PER_PACKET) records = BACKLOG_RECORDS_PER_PACKET;
+    while (records > 0 && !airtime_allowed(AIRTIME_BACKGROUND, TDMA_MAX_PACKET + BACKLOG_HEADER_SIZE + records * BACKLOG_RECORD_SIZE)) records--;
+  }
+  RunningAggregate window[AGGREGATE_FIELD_COUNT];
+  unsigned int aggregatesSize = 0;
+  if (beacon && !query && !keyframe_is_next()) {
+    aggregate_peek(window);
+    unsigned int used = (hop ? HOP_STATE_SIZE : 0) + (stats ? LINK_STATS_REPORT_SIZE : 0);
+    aggregatesSize = aggregate_section_size(window);
+    if (used + aggregatesSize + AGGREGATE_MIN_FIELD_BUDGET <= TELEMETRY_FIELD_BUDGET) {
+      aggregate_take(window);  // samples added since the peek also belong to this window
+      aggregatesSize = aggregate_section_size(window);
+    } else {
+      aggregatesSize = 0;  // the window goes on until the next beacon
+    }
+  }
+  write_message_header(writer, report.MEASURED_DATA, LAND, FLY_FORWARD, beacon, stats, records > 0, hop, query, aggregatesSize > 0);
+  write_command_ack(writer, resend);
+  write_link_report(writer);
+  if (hop) {
+    write_hop_state(writer);
+    fieldBudget -= HOP_STATE_SIZE;
   }
-  return parityBit;
+  if (stats) {
+    write_link_statistics(writer);
+    fieldBudget -= LINK_STATS_REPORT_SIZE;
+  }
+  if (records > 0) write_backlog(writer, records);
+  if (aggregatesSize > 0) {
+    write_aggregates(window, writer);
+    fieldBudget -= aggregatesSize;
+  }
+  if (query) {
+    write_query(writer, TELEMETRY_FRAME_SIZE - (TELEMETRY_FIELD_BUDGET - fieldBudget));  // in place of a keyframe
+  } else {
+    encode_telemetry(frame, writer, fieldBudget);
+  }
+  if (transmit_packet(writer)) {
+    lastSendTime = millis();
+  }
+  if (beacon) tdma_beacon_sent();  // also if the transmission failed, so the schedule keeps going
 }
 
 /**
- * Formats and subsequently sends selected measured data.
-*/
-void send_measured_data(void) {
-  String msg = "CurrentHeight : " + String(CURRENT_HEIGHT) + "\n" + 
-  "RequiredHeight : " + String(REQ_HEIGHT) + "\n" +
-  "CurrentRequiredHeight : " + String(C_R_H) + "\n" +
-  "Temperature : " + String(temperature_DHT22) + "\n" +
-  "Humidity : " + String(humidity) + "\n" +
-  "Power : " + String(POWER) + "\n" + 
-  "Altitude : " + String(altitude) + "\n" +
-  "Pressure : " + String(pressure) + "\n" +
-  "SpeedGPS : " + String(speed) + "\n" + 
-  "LatitudeGPS : " + String(latitude) + "\n" + 
-  "LongitudeGPS : " + String(longitude) + "\n";
-
-  sendMessage(msg, report.MEASURED_DATA, LAND, FLY_FORWARD, LAST_COUNTER);
+ * Asks the controller for an address (see Fleet.h). It is sent instead of telemetry until the address is assigned.
+ * Format: [header, random number of the airship (2 bytes), CRC, FEC]
+ */
+void send_join_request(void) {
+  unsigned char data[PACKET_CAPACITY];
+  PacketWriter writer(data, sizeof(data));
+  write_message_header(writer, report.JOIN_REQUEST, LAND, FLY_FORWARD, false, false, false, false, false, false);
+  writer.put_int16(fleet_join_nonce());
+  if (transmit_packet(writer)) {
+    lastSendTime = millis();
+  }
 }
 
 /**
  * Process incoming commands by adjusting balloon operations and communication states.
  * 
- * Program should enter this function only if the message has not yet been processed. I.e. NEW_MSG == TRUE.
+ * Commands are taken from the receive window (see ARQ.h) in order, each of them exactly once.
+ * The controller learns the result from the acknowledgement in the next telemetry packet.
+ *
+ * @param rec The command to be processed.
 */
-void process_command(void){
+void process_command(const CommandRecord &rec){
+  RECEIVED_ID = rec.cmdID;
+  VALID_MSG = rec.valid;
+  apply_command_value(rec);
   if (VALID_MSG){
+    if(RECEIVED_ID == all_ids.LINK_PROFILE){
+      link_request_profile(rec.value);  // applied after the acknowledgement is sent
+    }else if(RECEIVED_ID == all_ids.FLEET_SLOTS){
+      fleet_set_slots(rec.value);
+    }else if(RECEIVED_ID == all_ids.BACKLOG_REQUEST){
+      backlog_request();
+    }else if(RECEIVED_ID == all_ids.HOP_MODE){
+      hop_request(rec.value);  // applied with the next beacon
+    }else if(RECEIVED_ID == all_ids.QUERY){
+      query_request(rec.value);  // answered in the next packets
+    }else if(RECEIVED_ID == all_ids.PROFILE_DUMP){
+      profile_dump();
+    }
     if(LAND == true){
       if(RECEIVED_ID == all_ids.LAND){
         LAND = false;
@@ -309,10 +421,8 @@ void process_command(void){
         Serial.println("Motors are shutting down.");
       }
     }
-    // Send a message to the controller to inform him that his message has arrived successfully.
-    sendMessage("VALID", report.CONFIRMATION, LAND, FLY_FORWARD, LAST_COUNTER);
   } else{
-    sendMessage("ERROR", report.CONFIRMATION, LAND, FLY_FORWARD, LAST_COUNTER);
+    Serial.print("Invalid command refused: "), Serial.println(rec.seq);
   }
 }
 
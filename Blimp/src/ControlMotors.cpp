@@ -1,12 +1,8 @@
 #include "ControlMotors.h"
-
-// Create servo objects to control the ESCs
-Servo ESC_1;
-Servo ESC_2;
-Servo ESC_FLY_FORWARD;
-
-// Create a servo object to control a servo
-Servo SERVO;
+#include "Aggregate.h"
+#include "LoopTiming.h"
+#include "Scheduler.h"
+#include "Steering.h"
 
 // If it is set to 0, a band is created around the desired value in which the height is not regulated. This should save energy
 #define DEAD_ZONE 0 
@@ -14,43 +10,14 @@ Servo SERVO;
 unsigned int STOP_POWER = 90; // Default stop power level for ESCs, corresponding to the neutral position.
 unsigned int POWER = STOP_POWER;  // Power level for ESCs, ranging from 0 to 180.
 
-/**
- * Initializes all ESCs by attaching them to specific pins and setting initial power levels.
- *
- * This function should be called at the start to ensure all ESCs are properly calibrated
- * and ready to receive further commands.
- */
-void InitializeESCs(void) {
-    ESC_1.attach(ESC_H_1,1000,2000); // Attach ESC_1 to pin ESC_H_1 with pulse width range 1000 to 2000 microseconds.
-    ESC_2.attach(ESC_H_2,1000,2000);
-    ESC_FLY_FORWARD.attach(FORWARD_ESC,1000,2000);
-
-    // Calibration - Set all ESCs to stop power
-    ESC_1.write(STOP_POWER);
-    ESC_2.write(STOP_POWER);
-    ESC_FLY_FORWARD.write(STOP_POWER);
-    delay(1500);
-}
-
-/**
- * Attaches the main servo to a designated pin.
- */
-void InitializeSERVO(void) {
-    SERVO.attach(SERVO_PIN);
-}
-
+IntervalTimer heightTimer;  // releases the passes of ControlHeight()
 
 /**
- * Controls the steering motor based on input steering angles.
+ * Controls the steering motor according to FLY_FORWARD. It stops while the steering setpoints from the controller
+ * have stopped (see Steering.h). The engine follows in thread_actuators() (see Actuators.h).
  */
 void ControlSteeringMotor(void){
-    while(true){
-        if (FLY_FORWARD) {
-            ESC_FLY_FORWARD.write(POWER_OF_STEERING_MOTOR);
-        }else {
-            ESC_FLY_FORWARD.write(STOP_POWER);
-        }
-    }
+    actuator_set(ACTUATOR_FORWARD, FLY_FORWARD && !steering_frozen() ? POWER_OF_STEERING_MOTOR : STOP_POWER);
 }
 
 /**
@@ -58,10 +25,18 @@ void ControlSteeringMotor(void){
  *
  * This function directs the servo to specific positions, typically in response
  * to user inputs or automatic control signals that adjust device orientation or positioning.
+ * The servo follows in thread_actuators() (see Actuators.h).
  */
 void ControlServo(float angle) {
-    float offset = 87;
-    SERVO.write(-angle + offset);
+    actuator_set(ACTUATOR_SERVO, -angle + SERVO_OFFSET);
+}
+
+/**
+ * Starts a period of the height control loop. It runs in the interrupt of heightTimer.
+ */
+void ReleaseHeightControl(void) {
+    PROFILE_SECTION(PROFILE_RELEASE_HEIGHT);  // see Profiler.h
+    task_release(TASK_HEIGHT);  // see Scheduler.h
 }
 
 /**
@@ -69,44 +44,71 @@ void ControlServo(float angle) {
  *
  * This function calculates the necessary adjustments to the motor power to maintain
  * or reach the desired height, factoring in real-time sensor feedback and pre-defined limits.
+ * Each pass is released by the hardware timer heightTimer every SampleTime, so the rate does not depend
+ * on the other threads. Between the passes the thread sleeps and the interrupt of the timer wakes it (see Scheduler.h). The controller and the input shaping get the measured time since the previous pass,
+ * so a late pass does not change the control law, and neither does a different SampleTime.
+ * The output is computed only when a new height was published (see StateBus.h), with the time between
+ * the readings behind the two heights; in between the engines keep their power.
+ * The jitter of the period and the execution time of each pass go to the statistics (see LoopTiming.h).
  */
 void ControlHeight() {
-    unsigned long lastTime = millis(); // Record the current time to manage the timing of the control loop.
     float RateOfChange = 0.3; //[m/s] Define the maximum rate of change for the height adjustment.
     float SampleTimeInSec = ((float)SampleTime)/1000; // Convert sample time from milliseconds to seconds for calculations.
     float CurrentRequiredHeight = CURRENT_HEIGHT;
     float LastRequiredHeight = CurrentRequiredHeight;
-    //float alpha = SampleTimeInSec * 0.4; // This was gained from the original filter by Laplace transformation //1.3
-    float alpha = SampleTimeInSec / (0.4 + SampleTimeInSec); // This was generated by AI and it works pretty well
     float Force; // Variable to store calculated force.
     float Thrust; // Variable to store calculated thrust.
     float PW; // Variable to store pulse width.
     bool Manual = false;
+    HeightSample Height = {CURRENT_HEIGHT, false};
+    SampleInfo LastHeight = {0, 0};
     WaitWhileDoNotMove();
+    task_set_period(TASK_HEIGHT, SampleTime * 1000);
+    heightTimer.begin(ReleaseHeightControl, SampleTime * 1000);
+    unsigned long lastStart = 0;
+    bool first = true; // the first pass after a start has no previous one
     while(true){
-        unsigned long now = millis();
-        double dt = (double)(now - lastTime);
-        if(dt >= SampleTime){
-            // Shape input data before processing.
-            InputShaping(CurrentRequiredHeight, LastRequiredHeight, REQ_HEIGHT, RateOfChange, SampleTimeInSec, alpha);
-            C_R_H = CurrentRequiredHeight;
+        task_wait_release(TASK_HEIGHT); // periods missed while a pass was late are merged into it (overruns)
+        task_job_start(TASK_HEIGHT);
+        unsigned long start = micros();
+        float dt = first ? SampleTimeInSec : (start - lastStart) / 1000000.0;
+        if (dt < SampleTimeInSec / 2) dt = SampleTimeInSec / 2; // a pass released right after a late one
+        //float alpha = dt * 0.4; // This was gained from the original filter by Laplace transformation //1.3
+        float alpha = dt / (0.4 + dt); // This was generated by AI and it works pretty well
+
+        // Shape input data before processing.
+        InputShaping(CurrentRequiredHeight, LastRequiredHeight, REQ_HEIGHT, RateOfChange, dt, alpha);
+        C_R_H = CurrentRequiredHeight;
+        SampleInfo HeightInfo = bus_read(TOPIC_HEIGHT, &Height, sizeof(Height));
+        if (HeightInfo.seq != LastHeight.seq){ // nothing to do without a new height
+            long age = (long)(HeightInfo.stamp - LastHeight.stamp); // the heights can come from different sensors
+            float controlDt = (first || LastHeight.seq == 0 || age <= 0) ? dt : age / 1000000.0;
+            LastHeight = HeightInfo;
             // Choose controll method
             if (DEAD_ZONE){
-                DeadZoneControll(CurrentRequiredHeight, Force, Thrust, PW, Manual);
+                DeadZoneControll(CurrentRequiredHeight, Height, Force, Thrust, PW, Manual, controlDt);
             }else{
-                AutomaticControl(CurrentRequiredHeight, Force, Thrust, PW);
+                AutomaticControl(CurrentRequiredHeight, Height, Force, Thrust, PW, controlDt);
             }
-            lastTime = now;
-        }else if(dt + 10 < SampleTime) {
-            threads.delay(10);
+            aggregate_sample(AGGREGATE_POWER, POWER);
         }
-        ESC_1.write(POWER);
-        ESC_2.write(POWER);
-
-        while (DoNotMove){ // Pokud jsou manuálně vypnuty motory.
-            ESC_1.write(STOP_POWER);
-            ESC_2.write(STOP_POWER);
-            threads.delay(100);
+        actuator_set(ACTUATOR_HEIGHT_1, POWER);
+        actuator_set(ACTUATOR_HEIGHT_2, POWER);
+        if (!first) loop_timing_record((long)(start - lastStart) - (long)SampleTime * 1000, micros() - start);
+        lastStart = start;
+        first = false;
+        task_job_end(TASK_HEIGHT);
+
+        if (DoNotMove){
+            heightTimer.end(); // no releases, so they are not counted as overruns
+            task_cancel(TASK_HEIGHT);
+            while (DoNotMove){ // Pokud jsou manuálně vypnuty motory.
+                actuator_set(ACTUATOR_HEIGHT_1, STOP_POWER);
+                actuator_set(ACTUATOR_HEIGHT_2, STOP_POWER);
+                threads.delay(100);
+            }
+            first = true;
+            heightTimer.begin(ReleaseHeightControl, SampleTime * 1000);
         }
     }
 }
@@ -125,7 +127,7 @@ void WaitWhileDoNotMove(void){
  * @param LastRequiredHeight Last required height.
  * @param TargetRequiredHeight Target height.
  * @param RateOfChange Rate of change of height.
- * @param SampleTimeInSec 
+ * @param SampleTimeInSec Time since the previous pass [s].
  * @param alpha Smoothing factor for filtering the input.
  */
 void InputShaping(float &CurrentRequiredHeight, float &LastRequiredHeight, float TargetRequiredHeight, float RateOfChange, float SampleTimeInSec, float alpha) {
@@ -171,28 +173,30 @@ void FirstOrderFilter(float &CurrentRequiredHeight, float LastRequiredHeight, fl
  * Manages control operations with the dead zone.
  *
  * @param RequiredHeight Current required height
+ * @param Height The newest height from the state bus
  * @param Force Applied force
  * @param Thrust Level of thrust
  * @param PW Pulse width
  * @param Manual Flag indicating if manual control is enabled.
+ * @param dt Time since the previous output [s].
  */
-void DeadZoneControll(float RequiredHeight, float& Force, float& Thrust, float& PW, bool& Manual){
-    if (ultrasonicDistanceIsValid && !Manual && abs(CURRENT_HEIGHT-RequiredHeight) < 0.2){ 
+void DeadZoneControll(float RequiredHeight, const HeightSample &Height, float& Force, float& Thrust, float& PW, bool& Manual, float dt){
+    if (Height.ultrasonicValid && !Manual && abs(Height.height-RequiredHeight) < 0.2){ 
         // Vysoko nad zemí se může vytvořit mrtvé pásmo, které šetří baterii
         Manual = true;
         POWER = STOP_POWER;
     }
     else if(!Manual){ // Blízko země => Přesné řízení
-        AutomaticControl(RequiredHeight, Force, Thrust, PW);
+        AutomaticControl(RequiredHeight, Height, Force, Thrust, PW, dt);
     }
-    else if(Manual && abs(REQ_HEIGHT - CURRENT_HEIGHT) > 0.5){
+    else if(Manual && abs(REQ_HEIGHT - Height.height) > 0.5){
         Manual = false;
         initialization(); // TODO - možná dát pryč
     }
 }
 
-void AutomaticControl(float RequiredHeight, float& Force, float& Thrust, float& PW){
-    CalculateOutput(Force, CURRENT_HEIGHT, RequiredHeight);
+void AutomaticControl(float RequiredHeight, const HeightSample &Height, float& Force, float& Thrust, float& PW, float dt){
+    CalculateOutput(Force, Height.height, RequiredHeight, dt);
     Thrust = force_to_thrust(Force);
     PW = thrust_to_PWM(Thrust);
     POWER = map(PW, 1000, 2000, 0, 180);
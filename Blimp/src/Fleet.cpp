@@ -0,0 +1,80 @@
+#include "Fleet.h"
+#include <LoRa.h>
+
+/*
+Joining the fleet, airship side.
+The random number of the join request tells apart airships that ask at the same time: each of them takes
+only the answer with its own number. The requests are spread by a random delay, so that two airships
+switched on together do not keep colliding. The controller repeats nothing by itself, a lost request
+or answer is covered by the next request.
+*/
+
+volatile unsigned char localAddress = FLEET_JOIN_ADDRESS;
+volatile unsigned int vehicleIndex = 0;
+volatile unsigned int fleetSlots = 1;
+uint16_t joinNonce = 0;               // random number of this airship, never 0 (see Fleet.h of the controller)
+unsigned long nextJoinRequest = 0;    // time of the next join request
+
+/**
+ * Chooses the random number of the airship, or takes the fixed address of FLEET_STATIC_INDEX.
+ * It has to be called after the LoRa module is initialised, its wideband RSSI seeds the random numbers.
+ */
+void fleet_begin(void) {
+  randomSeed(((unsigned long)LoRa.random() << 8 | LoRa.random()) ^ micros());
+  joinNonce = random(1, 0x10000);
+  nextJoinRequest = millis() + random(FLEET_JOIN_INTERVAL);
+  if (FLEET_STATIC_INDEX >= 0) {
+    vehicleIndex = FLEET_STATIC_INDEX;
+    localAddress = FLEET_FIRST_ADDRESS + FLEET_STATIC_INDEX;
+  }
+}
+
+/**
+ * Checks whether the airship has its address.
+ */
+bool fleet_assigned(void) {
+  return localAddress != FLEET_JOIN_ADDRESS;
+}
+
+/**
+ * Checks whether the next join request should be sent and plans the one after it.
+ */
+bool fleet_join_due(void) {
+  if ((long)(millis() - nextJoinRequest) < 0) return false;
+  nextJoinRequest = millis() + FLEET_JOIN_INTERVAL + random(FLEET_JOIN_INTERVAL);
+  return true;
+}
+
+/**
+ * Returns the random number sent in the join requests.
+ */
+uint16_t fleet_join_nonce(void) {
+  return joinNonce;
+}
+
+/**
+ * Takes the address from the ASSIGN_ADDRESS command, if it answers this airship. It is called from receive_service().
+ * Format of the value: [random number of the airship (upper 2 bytes), index in the fleet, number of TDMA slots]
+ *
+ * @param value The value of the command.
+ */
+void fleet_assign(int32_t value) {
+  uint16_t nonce = (uint32_t)value >> 16;
+  unsigned int index = (value >> 8) & 0xFF;
+  unsigned int slots = value & 0xFF;
+  if (fleet_assigned() || nonce != joinNonce || index >= FLEET_SIZE || slots == 0 || slots > FLEET_SIZE) return;
+  vehicleIndex = index;
+  fleetSlots = slots;
+  localAddress = FLEET_FIRST_ADDRESS + index;
+  Serial.print("Joined the fleet, address 0x"), Serial.println(localAddress, HEX);
+}
+
+/**
+ * Sets the number of TDMA slots from the FLEET_SLOTS command.
+ *
+ * @param slots Number of frames in a superframe, 1 to FLEET_SIZE.
+ */
+void fleet_set_slots(int32_t slots) {
+  fleetSlots = slots;
+  Serial.print("TDMA slots: "), Serial.println(slots);
+}
@@ -0,0 +1,87 @@
+#include "Framing.h"
+
+// If it is set to false, only the CRC is appended (2 bytes less per packet, but no correction)
+bool FRAME_FEC = true;
+
+/**
+ * Appends the CRC of the packet and, if enabled, the FEC check word.
+ * Format: [packet, CRC-16 (2 bytes), optionally(FEC word (2 bytes))]
+ *
+ * @param writer The finished packet.
+ * @return False if the trailer did not fit into the packet.
+ */
+bool append_frame_check(PacketWriter &writer) {
+  writer.put_int16((int16_t)crc16(writer.data(), writer.length()));
+  if (FRAME_FEC) {
+    writer.put_int16((int16_t)fec_word(writer.data(), writer.length()));
+  }
+  return writer.ok();
+}
+
+/**
+ * Verifies a received frame and removes its trailer. If the CRC does not match and FEC is enabled,
+ * a single flipped bit (in the packet or in its CRC) is located by the Hamming syndrome and corrected in place.
+ * The correction is accepted only if the CRC matches afterwards.
+ *
+ * @param packet The received frame, on success its length is reduced to the packet itself.
+ * @return The result of the check.
+ */
+FrameStatus check_frame(PacketBuffer &packet) {
+  unsigned int trailer = CRC_SIZE + (FRAME_FEC ? FEC_SIZE : 0);
+  if (packet.length <= trailer) return FRAME_CORRUPTED;
+  unsigned int length = packet.length - trailer;
+  unsigned char *crcBytes = packet.data + length;
+
+  uint16_t receivedCrc = crcBytes[0] | (crcBytes[1] << 8);
+  if (crc16(packet.data, length) == receivedCrc) {
+    packet.length = length;
+    return FRAME_OK;
+  }
+  if (!FRAME_FEC) return FRAME_CORRUPTED;
+
+  // The FEC word protects the packet together with its CRC
+  uint16_t receivedFec = crcBytes[2] | (crcBytes[3] << 8);
+  uint16_t difference = receivedFec ^ fec_word(packet.data, length + CRC_SIZE);
+  unsigned int position = difference & ~FEC_PARITY_BIT;
+  // A single bit error flips the overall parity and its syndrome is the position of the bit
+  if (!(difference & FEC_PARITY_BIT) || position == 0 || position > (length + CRC_SIZE) * 8) return FRAME_CORRUPTED;
+
+  packet.data[(position - 1) / 8] ^= 1 << ((position - 1) % 8);
+  receivedCrc = crcBytes[0] | (crcBytes[1] << 8);
+  if (crc16(packet.data, length) != receivedCrc) return FRAME_CORRUPTED;
+  packet.length = length;
+  return FRAME_CORRECTED;
+}
+
+/**
+ * Calculates CRC-16/CCITT-FALSE (polynomial 0x1021, initial value 0xFFFF).
+ */
+uint16_t crc16(const unsigned char *data, unsigned int length) {
+  uint16_t crc = 0xFFFF;
+  for (unsigned int i = 0; i < length; i++) {
+    crc ^= (uint16_t)data[i] << 8;
+    for (unsigned int bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+    }
+  }
+  return crc;
+}
+
+/**
+ * Calculates the Hamming check word of the data: the XOR of the (1-based) positions of all set bits
+ * and the overall parity in FEC_PARITY_BIT. Positions fit into 12 bits for every packet up to PACKET_CAPACITY bytes.
+ */
+uint16_t fec_word(const unsigned char *data, unsigned int length) {
+  uint16_t syndrome = 0;
+  bool parity = false;
+  for (unsigned int i = 0; i < length; i++) {
+    unsigned char b = data[i];
+    for (unsigned int bit = 0; b != 0; bit++, b >>= 1) {
+      if (b & 1) {
+        syndrome ^= i * 8 + bit + 1;
+        parity = !parity;
+      }
+    }
+  }
+  return parity ? (syndrome | FEC_PARITY_BIT) : syndrome;
+}
@@ -0,0 +1,99 @@
+#include "Hopping.h"
+#include <LoRa.h>
+
+/*
+A new mask takes effect at the next rendezvous frame. Both ends hear that beacon whatever the masks are,
+so a lost acknowledgement of HOP_MODE cannot leave them on different sequences for longer than one period.
+Hopping starts with a beacon on the rendezvous frequency too (frame 0), where the controller is waiting,
+and it stops at the next beacon, which is then sent on the rendezvous frequency without the hopping state.
+The controller is silent while it searches for the sequence, so the airship keeps hopping long enough for it to miss
+its beacons and wait for two rendezvous frames (HOP_FALLBACK_TIMEOUT).
+*/
+
+bool hopping = false;
+unsigned char hopFrame = 0;          // number of the current frame
+unsigned char hopMask = 0;           // channels in use, bit i = channel i
+volatile int requestedMask = -1;     // mask from the last HOP_MODE command, -1 if there is none
+
+/**
+ * Checks whether the airship is hopping.
+ */
+bool hop_active(void) {
+  return hopping;
+}
+
+/**
+ * Remembers the mask from the HOP_MODE command. It is applied by hop_next_frame().
+ *
+ * @param mask Channels to be used, 0 to stop hopping.
+ */
+void hop_request(unsigned int mask) {
+  requestedMask = mask & 0xFF;
+  Serial.print("Hopping requested, channel mask: "), Serial.println(mask, BIN);
+}
+
+/**
+ * Starts the next frame on its channel. It is called right before a beacon is sent.
+ */
+void hop_next_frame(void) {
+  int requested = requestedMask;
+  if (hopping && (requested == 0 || millis() - (unsigned long)lastReceivedTime > HOP_FALLBACK_TIMEOUT)) {
+    hopping = false;
+    requestedMask = -1;
+    LoRa.idle();
+    LoRa.setFrequency(HOP_RENDEZVOUS_FREQUENCY);
+    Serial.println("Hopping stopped");
+    return;
+  }
+  if (!hopping) {
+    if (requested <= 0) return;
+    hopping = true;
+    hopFrame = 0;
+  } else {
+    hopFrame++;
+  }
+  if (requested > 0 && hopFrame % HOP_RENDEZVOUS_PERIOD == 0) {
+    hopMask = requested;
+    requestedMask = -1;
+  }
+  LoRa.idle();
+  LoRa.setFrequency(hop_frequency(hop_channel(hopFrame, hopMask)));
+}
+
+/**
+ * Writes the hopping state to a beacon.
+ * Format: [frame number, channel mask]
+ */
+void write_hop_state(PacketWriter &writer) {
+  writer.put_byte(hopFrame);
+  writer.put_byte(hopMask);
+}
+
+/**
+ * Chooses the channel of a frame. The same function is on the controller.
+ *
+ * @param frame The frame number.
+ * @param mask Channels in use, bit i = channel i.
+ * @return The channel, or -1 for the rendezvous frequency.
+ */
+int hop_channel(unsigned char frame, unsigned char mask) {
+  if (frame % HOP_RENDEZVOUS_PERIOD == 0 || mask == 0) return -1;
+  uint32_t h = ((uint32_t)frame << 16 | HOP_SEED) * 2654435761u;  // multiplicative hash
+  h ^= h >> 15;
+  h *= 0x2C1B3C6Du;
+  h ^= h >> 12;
+  unsigned int count = 0;
+  for (unsigned int i = 0; i < HOP_CHANNELS; i++) count += (mask >> i) & 1;
+  unsigned int pick = h % count;
+  for (unsigned int i = 0; i < HOP_CHANNELS; i++) {
+    if (((mask >> i) & 1) && pick-- == 0) return i;
+  }
+  return -1;
+}
+
+/**
+ * Returns the frequency of a channel (-1 = the rendezvous frequency) [Hz].
+ */
+long hop_frequency(int channel) {
+  return (channel < 0) ? (long)HOP_RENDEZVOUS_FREQUENCY : HOP_FIRST_FREQUENCY + channel * HOP_CHANNEL_SPACING;
+}
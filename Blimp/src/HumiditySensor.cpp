@@ -1,23 +1,28 @@
 #include "HumiditySensor.h"
 #include "US_100.h"
-
-float humidity = 0;
-float temperature_DHT22 = 0;
+#include "Scheduler.h"
+#include "StateBus.h"
 
 SimpleDHT22 dht22(DHTPIN);
 
 /**
  * This thread is dedicated to measuring humidity and temperature using the DHT22 sensor.
- * It runs continuously in a loop, updating the humidity and temperature readings.
+ * It runs continuously in a loop, publishing the humidity and temperature readings (see StateBus.h).
  */
 void thread_DHT22(void){
   while(1){
-    int err = SimpleDHTErrSuccess;
-    if ((err = dht22.read2(&temperature_DHT22, &humidity, NULL)) != SimpleDHTErrSuccess) {
+    task_job_start(TASK_HUMIDITY);  // see Scheduler.h
+    task_atomic_begin(TASK_HUMIDITY);  // the timing of the DHT22 protocol breaks if another thread runs in between
+    HumiditySample sample;
+    int err = dht22.read2(&sample.temperature, &sample.humidity, NULL);
+    task_atomic_end();
+    if (err != SimpleDHTErrSuccess) {
       Serial.println("Read DHT22 failed.");
-      temperature_DHT22 = INVALID_VALUE;
-      humidity = INVALID_VALUE;
+      sample.temperature = INVALID_VALUE;
+      sample.humidity = INVALID_VALUE;
     }
+    bus_publish(TOPIC_HUMIDITY, &sample, sizeof(sample), micros());  // also an invalid reading is news for the telemetry
+    task_job_end(TASK_HUMIDITY);
 
     threads.delay(2500);
   }
@@ -0,0 +1,115 @@
+#include "LinkAdaptation.h"
+
+/*
+Link adaptation, airship side.
+The controller decides which profile to use (see LinkAdaptation.cpp of the controller) and sends it as the
+LINK_PROFILE command. The airship switches only after the telemetry packet with the acknowledgement of that command
+has been sent, so the acknowledgement still uses the old profile. If nothing arrives from the controller
+for LINK_FALLBACK_TIMEOUT, the switch (or the link) failed and the airship returns to the rendezvous profile,
+where the controller will look for it too.
+Every telemetry packet reports the SNR and RSSI measured on the packets from the controller.
+*/
+
+const LinkProfile linkProfiles[LINK_PROFILE_COUNT] = {
+  {10, 125000, 20, -15.0},  // the most robust
+  {9, 125000, 20, -12.5},
+  {7, 125000, 17, -7.5},    // rendezvous
+  {7, 250000, 17, -7.5},
+  {7, 500000, 14, -7.5},    // the fastest
+};
+
+unsigned int currentProfile = LINK_RENDEZVOUS_PROFILE;
+volatile float lastPacketSnr = 0;
+volatile int lastPacketRssi = 0;
+int requestedProfile = -1;          // profile to be used after the next telemetry packet
+unsigned long profileSince = 0;     // time of the last switch
+
+/**
+ * Records the signal quality of the packet just received. It is called from receive_service().
+ *
+ * @param snr SNR of the packet [dB].
+ * @param rssi RSSI of the packet [dBm].
+ */
+void link_record_packet(float snr, int rssi) {
+  lastPacketSnr = snr;
+  lastPacketRssi = rssi;
+}
+
+/**
+ * Remembers the profile requested by the controller. It is applied by link_service().
+ *
+ * @param profile Index into linkProfiles.
+ */
+void link_request_profile(unsigned int profile) {
+  if (profile >= LINK_PROFILE_COUNT) return;
+  requestedProfile = profile;
+  Serial.print("Link profile requested: "), Serial.println(profile);
+}
+
+/**
+ * Applies the requested profile, or returns to the rendezvous profile if the controller has not been heard for too long.
+ * It is called from the main loop after the telemetry packet (with the acknowledgement) was sent.
+ */
+void link_service(void) {
+  if (requestedProfile >= 0) {
+    link_apply_profile(requestedProfile);
+    requestedProfile = -1;
+    return;
+  }
+
+  unsigned long lastHeard = ((unsigned long)lastReceivedTime > profileSince) ? (unsigned long)lastReceivedTime : profileSince;
+  if (currentProfile != LINK_RENDEZVOUS_PROFILE && millis() - lastHeard > LINK_FALLBACK_TIMEOUT) {
+    Serial.println("Controller lost, back to the rendezvous link profile");
+    link_apply_profile(LINK_RENDEZVOUS_PROFILE);
+  }
+}
+
+/**
+ * Sets the radio parameters of a profile and starts receiving again.
+ *
+ * @param profile Index into linkProfiles.
+ */
+void link_apply_profile(unsigned int profile) {
+  const LinkProfile &p = linkProfiles[profile];
+  LoRa.idle();
+  LoRa.setSpreadingFactor(p.spreadingFactor);
+  LoRa.setSignalBandwidth(p.bandwidth);
+  LoRa.setTxPower(p.txPower);
+  LoRa.receive();
+  currentProfile = profile;
+  profileSince = millis();
+  Serial.print("Link profile "), Serial.print(profile);
+  Serial.print(": SF"), Serial.print(p.spreadingFactor), Serial.print(", BW "), Serial.print(p.bandwidth);
+  Serial.print(" Hz, "), Serial.print(p.txPower), Serial.println(" dBm");
+}
+
+/**
+ * Writes the signal quality of the last packet from the controller.
+ * Format: [SNR in quarters of dB, RSSI in dBm] (both signed bytes)
+ */
+void write_link_report(PacketWriter &writer) {
+  float snr = lastPacketSnr;
+  int rssi = lastPacketRssi;
+  writer.put_byte((unsigned char)(int8_t)constrain((int)(snr * 4), -128, 127));
+  writer.put_byte((unsigned char)(int8_t)constrain(rssi, -128, 127));
+}
+
+/**
+ * Estimates the time on air of a packet (formula from the Semtech datasheet: explicit header, coding rate 4/5,
+ * 8 preamble symbols, low data rate optimisation for symbols longer than 16 ms). The LoRa library leaves the radio's
+ * payload CRC off, the frames carry their own (see Framing.h).
+ *
+ * @param profile Index into linkProfiles.
+ * @param bytes Length of the packet.
+ * @return Time on air [ms].
+ */
+unsigned long link_airtime(unsigned int profile, unsigned int bytes) {
+  const LinkProfile &p = linkProfiles[profile];
+  int sf = p.spreadingFactor;
+  float symbolTime = (float)(1L << sf) * 1000 / p.bandwidth;  // [ms]
+  bool lowDataRate = symbolTime > 16;
+  long numerator = 8L * bytes - 4 * sf + 28 + (LINK_RADIO_CRC ? 16 : 0);
+  long denominator = 4L * (sf - (lowDataRate ? 2 : 0));
+  long payloadSymbols = 8 + ((numerator > 0) ? (numerator + denominator - 1) / denominator * 5 : 0);
+  return (unsigned long)((12.25 + payloadSymbols) * symbolTime) + 1;
+}
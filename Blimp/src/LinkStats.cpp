@@ -0,0 +1,57 @@
+#include "LinkStats.h"
+
+/*
+Link statistics, airship side.
+receive_service() counts the received, corrupted and corrected frames, handle_received_command() counts the duplicate commands.
+From time to time a telemetry packet carries the counters to the controller, which keeps the histograms
+and prints everything on request (see LinkStats.h of the controller). The timing of the height control loop
+goes with them (see LoopTiming.h).
+*/
+
+volatile unsigned long packetsReceived = 0;
+volatile unsigned long corruptedFrames = 0;
+volatile unsigned long correctedFrames = 0;
+unsigned long duplicateCommands = 0;
+unsigned long lastStatsReport = 0;   // time of the last report sent to the controller
+
+/**
+ * Counts the result of the CRC and FEC check of a received frame. It is called from receive_service().
+ */
+void link_stats_frame_checked(FrameStatus status) {
+  if (status == FRAME_CORRUPTED) corruptedFrames++;
+  else if (status == FRAME_CORRECTED) correctedFrames++;
+}
+
+/**
+ * Counts a packet addressed to this device. It is called from receive_service().
+ */
+void link_stats_packet_received(void) {
+  packetsReceived++;
+}
+
+/**
+ * Counts a command that arrived again after it had been processed (its acknowledgement was lost).
+ */
+void link_stats_duplicate(void) {
+  duplicateCommands++;
+}
+
+/**
+ * Checks whether the counters should go with the next telemetry packet.
+ */
+bool link_stats_report_due(void) {
+  return millis() - lastStatsReport >= LINK_STATS_REPORT_PERIOD;
+}
+
+/**
+ * Writes the counters to a telemetry packet.
+ * Format: [received, corrupted, corrected, duplicates (lower 16 bits of each counter), timing of the height loop (see write_loop_timing())]
+ */
+void write_link_statistics(PacketWriter &writer) {
+  writer.put_int16((int16_t)packetsReceived);
+  writer.put_int16((int16_t)corruptedFrames);
+  writer.put_int16((int16_t)correctedFrames);
+  writer.put_int16((int16_t)duplicateCommands);
+  write_loop_timing(writer);
+  lastStatsReport = millis();
+}
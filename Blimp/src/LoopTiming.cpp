@@ -0,0 +1,80 @@
+#include "LoopTiming.h"
+
+long jitterMin = 0;   // of the current window [us]
+long jitterMax = 0;
+unsigned long executionMax = 0;
+TimingHistogram jitterHistogram;     // absolute values of the jitter
+TimingHistogram executionHistogram;
+
+/**
+ * Adds a value to a histogram.
+ *
+ * @param histogram The histogram.
+ * @param value The value [us].
+ */
+void timing_histogram_add(TimingHistogram &histogram, unsigned long value) {
+  unsigned int bucket = 0;
+  while (value > 0 && bucket < LOOP_TIMING_BUCKETS - 1) {
+    value >>= 1;
+    bucket++;
+  }
+  histogram.buckets[bucket]++;
+  histogram.count++;
+}
+
+/**
+ * Returns the upper edge of the bucket in which the given percentile of a histogram lies.
+ *
+ * @param histogram The histogram.
+ * @param percent The percentile, e.g. 99.
+ * @return The upper edge [us], 0 for an empty histogram.
+ */
+unsigned long timing_percentile(const TimingHistogram &histogram, unsigned int percent) {
+  if (histogram.count == 0) return 0;
+  unsigned long wanted = (histogram.count * percent + 99) / 100;  // rounded up, so that 99 % of 10 values is the 10th
+  unsigned long seen = 0;
+  for (unsigned int i = 0; i < LOOP_TIMING_BUCKETS; i++) {
+    seen += histogram.buckets[i];
+    if (seen >= wanted) return i == 0 ? 0 : (1UL << i) - 1;
+  }
+  return (1UL << (LOOP_TIMING_BUCKETS - 1)) - 1;
+}
+
+/**
+ * Records one pass of the height control loop. It is called only from ControlHeight().
+ *
+ * @param jitter The period of this pass minus SampleTime [us].
+ * @param execution The time the pass took [us].
+ */
+void loop_timing_record(long jitter, unsigned long execution) {
+  noInterrupts();  // write_loop_timing() runs in the main loop
+  if (jitterHistogram.count == 0 || jitter < jitterMin) jitterMin = jitter;
+  if (jitterHistogram.count == 0 || jitter > jitterMax) jitterMax = jitter;
+  if (execution > executionMax) executionMax = execution;
+  timing_histogram_add(jitterHistogram, jitter < 0 ? -jitter : jitter);
+  timing_histogram_add(executionHistogram, execution);
+  interrupts();
+}
+
+/**
+ * Writes the statistics of the window to a telemetry packet and starts a new window.
+ * Format: [jitter min, jitter max, jitter 99th percentile, execution 99th percentile, execution max] (16 bits each)
+ */
+void write_loop_timing(PacketWriter &writer) {
+  noInterrupts();
+  long low = jitterMin, high = jitterMax;
+  unsigned long jitter99 = timing_percentile(jitterHistogram, 99);
+  unsigned long execution99 = timing_percentile(executionHistogram, 99);
+  unsigned long executionHigh = executionMax;
+  memset(&jitterHistogram, 0, sizeof(jitterHistogram));
+  memset(&executionHistogram, 0, sizeof(executionHistogram));
+  jitterMin = jitterMax = 0;
+  executionMax = 0;
+  interrupts();
+
+  writer.put_int16(constrain(low, -32768L, 32767L));
+  writer.put_int16(constrain(high, -32768L, 32767L));
+  writer.put_int16((int16_t)(jitter99 < 65535 ? jitter99 : 65535));
+  writer.put_int16((int16_t)(execution99 < 65535 ? execution99 : 65535));
+  writer.put_int16((int16_t)(executionHigh < 65535 ? executionHigh : 65535));
+}
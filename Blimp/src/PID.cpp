@@ -1,10 +1,11 @@
 /* While writing this PID controller, my work was more than inspired by PID controller created by Brett Beauregard (https://github.com/br3ttb/Arduino-PID-Library).*/
 
 #include "PID.h"
+#include "Profiler.h"
 
 // Global variable declarations
 double lastError;
-float kp, ki, kd, N; // Proportional, Integral, and Derivative gains and smoothing factor
+float kp, ki, kd, N; // Proportional, Integral [1/s], and Derivative [s] gains and smoothing factor
 float PrecalculatedForD1, PrecalculatedForD2;
 float SampleTimeInSec;
 float filteredD = 0; 
@@ -28,11 +29,11 @@ void setParametres(float Kp, float Ki, float Kd, float n, unsigned int SampleTim
   SampleTimeInSec = ((float)SampleTime)/1000;
 
   kp = Kp;
-  ki = Ki * SampleTimeInSec; // Integral gain adjusted for sampling time
-  kd = Kd / SampleTimeInSec; // Derivative gain adjusted for sampling time
+  ki = Ki; // Adjusted for the actual sampling time in CalculateOutput()
+  kd = Kd;
   N = n; 
 
-  PrecalculatedForD1 = (kd) * ((N*SampleTimeInSec) / (1+N*SampleTimeInSec));
+  PrecalculatedForD1 = (kd / SampleTimeInSec) * ((N*SampleTimeInSec) / (1+N*SampleTimeInSec));
   PrecalculatedForD2 = (1 / (1+N*SampleTimeInSec));
   
   lastError = 0;
@@ -57,24 +58,27 @@ void setLimits(float Max, float Min){
 
 /**
  * Calculates the PID output based on the current and required values.
- * This function has to be called at fixed intervals which are given by SampleTime (lastTime - now = SampleTime)
+ * It should be called at intervals close to SampleTime, but the integral and derivative parts use the measured
+ * time since the previous call, so a late call does not change the control law.
  * 
  * @param Output Reference to store the calculated output.
  * @param CurrentValue The current value from the sensor.
  * @param RequiredValue The desired setpoint value.
+ * @param dt Time since the previous call [s].
  */
-void CalculateOutput(float &Output, double CurrentValue, double RequiredValue){
+void CalculateOutput(float &Output, double CurrentValue, double RequiredValue, float dt){
+  PROFILE_SECTION(PROFILE_CALCULATE_OUTPUT);  // see Profiler.h
   //Calculate all the working error variables
   float error = RequiredValue - CurrentValue;
   double dErr = error - lastError;
-  IntegralPart += error * ki;
+  IntegralPart += error * ki * dt;
 
   // Apply limits to integral component
   checkLimits(IntegralPart);
 
   //Calculate PID Output
   //filteredD = PrecalculatedForD1 * dErr + PrecalculatedForD2 * filteredD;
-  clasicD = kd * dErr;
+  clasicD = kd * dErr / dt;
   Output = kp * error + IntegralPart + clasicD;
 
   // Apply limits to output
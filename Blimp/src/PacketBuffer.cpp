@@ -0,0 +1,205 @@
+#include "PacketBuffer.h"
+#include "Framing.h"
+#include "Airtime.h"
+#include "Capture.h"
+#include "Communication.h"
+
+/**
+ * Copies the whole received packet from the radio into a preallocated buffer, together with its time
+ * and signal quality. It runs in the LoRa interrupt, so it only reads the radio, the packet is parsed later.
+ *
+ * @param packet The buffer to be filled.
+ * @param packetSize The size of the received packet reported by the LoRa library.
+ * @return False if the packet does not fit into the buffer (it is discarded), True otherwise.
+ */
+bool receive_packet(PacketBuffer &packet, int packetSize) {
+  packet.length = 0;
+  if (packetSize <= 0 || packetSize > PACKET_CAPACITY) return false;  // the next reception overwrites the FIFO
+  read_fifo(packet.data, packetSize);
+  packet.length = packetSize;
+  packet.time = millis();
+  packet.rssi = LoRa.packetRssi();
+  packet.snr = LoRa.packetSnr();
+  return true;
+}
+
+/**
+ * Reads bytes from the FIFO of the radio in one SPI transaction. LoRa.read() needs two register accesses
+ * per byte (it asks LoRa.available() first), the burst read sends the address once and then only clocks the data in.
+ * The LoRa library points the FIFO to the start of the packet before it calls onReceive().
+ *
+ * @param data Buffer for the bytes.
+ * @param length Number of bytes to be read.
+ */
+void read_fifo(unsigned char *data, unsigned int length) {
+  SPI.beginTransaction(SPISettings(LORA_DEFAULT_SPI_FREQUENCY, MSBFIRST, SPI_MODE0));  // the settings of the LoRa library
+  digitalWriteFast(csPin, LOW);
+  SPI.transfer(LORA_REG_FIFO);  // address with the write bit clear
+  SPI.transfer(data, length);   // the bytes sent meanwhile are ignored by the radio
+  digitalWriteFast(csPin, HIGH);
+  SPI.endTransaction();
+}
+
+/**
+ * Appends the frame check (CRC and FEC, see Framing.h) and sends a packet built by the writer.
+ * Nothing is sent if the writer ran out of space.
+ *
+ * @return True if the packet was sent.
+ */
+bool transmit_packet(PacketWriter &writer) {
+  if (!append_frame_check(writer)) return false;
+  LoRa.beginPacket();                             // start packet
+  LoRa.write(writer.data(), writer.length());     // add the whole content at once
+  LoRa.endPacket();                               // finish packet and send it
+  capture_packet(CAPTURE_SENT, writer.data(), writer.length(), millis(), 0, 0);  // see Capture.h
+  airtime_charge(writer.length());                // see Airtime.h
+  return true;
+}
+
+PacketReader::PacketReader(const unsigned char *data, unsigned int length) {
+  buffer = data;
+  size = length;
+  pos = 0;
+  valid = true;
+}
+
+bool PacketReader::read_byte(unsigned char &value) {
+  if (!valid || pos >= size) return valid = false;
+  value = buffer[pos++];
+  return true;
+}
+
+/**
+ * Reads a little-endian 16-bit value.
+ */
+bool PacketReader::read_int16(int16_t &value) {
+  if (!valid || size - pos < 2) return valid = false;
+  value = (int16_t)(buffer[pos] | (buffer[pos + 1] << 8));
+  pos += 2;
+  return true;
+}
+
+/**
+ * Reads a little-endian 32-bit value.
+ */
+bool PacketReader::read_int32(int32_t &value) {
+  if (!valid || size - pos < 4) return valid = false;
+  uint32_t v = 0;
+  for (unsigned int i = 0; i < 4; i++) {
+    v |= (uint32_t)buffer[pos++] << (8 * i);
+  }
+  value = (int32_t)v;
+  return true;
+}
+
+/**
+ * Reads a varint (7 bits per byte, MSB set if another byte follows). Varints longer than 5 bytes are rejected.
+ */
+bool PacketReader::read_varint(uint32_t &value) {
+  value = 0;
+  for (unsigned int shift = 0; shift < 35; shift += 7) {
+    unsigned char b;
+    if (!read_byte(b)) return false;
+    value |= (uint32_t)(b & 0x7F) << shift;
+    if (!(b & 0x80)) return true;
+  }
+  return valid = false;
+}
+
+unsigned int PacketReader::remaining(void) const {
+  return size - pos;
+}
+
+const unsigned char *PacketReader::current(void) const {
+  return buffer + pos;
+}
+
+bool PacketReader::ok(void) const {
+  return valid;
+}
+
+PacketWriter::PacketWriter(unsigned char *data, unsigned int capacity) {
+  buffer = data;
+  this->capacity = capacity;
+  pos = 0;
+  valid = true;
+}
+
+bool PacketWriter::put_byte(unsigned char value) {
+  if (!valid || pos >= capacity) return valid = false;
+  buffer[pos++] = value;
+  return true;
+}
+
+bool PacketWriter::put_bytes(const unsigned char *values, unsigned int count) {
+  if (!valid || capacity - pos < count) return valid = false;
+  memcpy(buffer + pos, values, count);
+  pos += count;
+  return true;
+}
+
+/**
+ * Writes a 16-bit value in little-endian order.
+ */
+bool PacketWriter::put_int16(int16_t value) {
+  if (!valid || capacity - pos < 2) return valid = false;
+  buffer[pos++] = (uint16_t)value & 0xFF;
+  buffer[pos++] = ((uint16_t)value >> 8) & 0xFF;
+  return true;
+}
+
+/**
+ * Writes a 32-bit value in little-endian order.
+ */
+bool PacketWriter::put_int32(int32_t value) {
+  if (!valid || capacity - pos < 4) return valid = false;
+  for (unsigned int i = 0; i < 4; i++) {
+    buffer[pos++] = ((uint32_t)value >> (8 * i)) & 0xFF;
+  }
+  return true;
+}
+
+/**
+ * Writes an unsigned number as a varint (7 bits per byte, MSB set if another byte follows).
+ */
+bool PacketWriter::put_varint(uint32_t value) {
+  while (value >= 0x80) {
+    if (!put_byte((value & 0x7F) | 0x80)) return false;
+    value >>= 7;
+  }
+  return put_byte(value);
+}
+
+/**
+ * Skips a number of bytes that will be filled in later by patch_int16().
+ *
+ * @param count Number of bytes to be reserved.
+ * @param at Reference to store the position of the reserved bytes.
+ */
+bool PacketWriter::reserve(unsigned int count, unsigned int &at) {
+  if (!valid || capacity - pos < count) return valid = false;
+  at = pos;
+  pos += count;
+  return true;
+}
+
+/**
+ * Overwrites two previously reserved bytes with a little-endian 16-bit value.
+ */
+void PacketWriter::patch_int16(unsigned int at, int16_t value) {
+  if (at + 2 > pos) return;
+  buffer[at] = (uint16_t)value & 0xFF;
+  buffer[at + 1] = ((uint16_t)value >> 8) & 0xFF;
+}
+
+unsigned int PacketWriter::length(void) const {
+  return pos;
+}
+
+const unsigned char *PacketWriter::data(void) const {
+  return buffer;
+}
+
+bool PacketWriter::ok(void) const {
+  return valid;
+}
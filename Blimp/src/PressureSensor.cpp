@@ -1,5 +1,7 @@
 #include "PressureSensor.h"
 #include "US_100.h"
+#include "Scheduler.h"
+#include "StateBus.h"
 #include <math.h>
 
 const float SEA_LEVEL_PRESSURE = 102630; // (Pa)
@@ -9,16 +11,13 @@ const float GIVEN_TEMPERATURE = 273.15 + 15; // (K)
 // to determine the altitude, but it is not as accurate. For Automatic set AUTOMATIC to true
 bool AUTOMATIC = false;
 
-float pressure = 0;
-float altitude = 0;
-float temperature_MPL3115A2 = 0;
-
 MPL3115A2 MPL;
 
 /**
  * This thread continuously reads temperature and pressure data from the MPL3115A2 sensor.
  * It applies an Exponential Moving Average (EMA) low pass filter to smooth the data.
  * Also, it calculates the altitude based on the pressure and temperature readings.
+ * Every valid reading is published on the state bus (see StateBus.h).
  */
 void thread_MPL3115A2(void){
   // auxiliary variables
@@ -26,15 +25,18 @@ void thread_MPL3115A2(void){
   float old_avg_temperature = 0;
   float avg_pressure = 0;
   float old_avg_pressure = 0;
+  float temperature_MPL3115A2 = 0;
   int cnt = 0;
   while(1){
-    // Read the current values
+    task_job_start(TASK_BAROMETER);  // see Scheduler.h
+    // Read the current values, both wait for a conversion
     float temp = MPL.readTemp();
     float press = MPL.readPressure();
 
     // Skip initial sensor readings
     if (cnt < 7) {
       cnt += 1;
+      task_job_end(TASK_BAROMETER);
       continue;
     }
 
@@ -50,15 +52,18 @@ void thread_MPL3115A2(void){
       old_avg_pressure = (avg_pressure == 0) ? press : avg_pressure;
       avg_pressure = pressure_EMA(press, old_avg_pressure);
       // Calculate altitude
+      float altitude;
       if (AUTOMATIC){
         altitude = calculate_altitude(avg_pressure, SEA_LEVEL_PRESSURE, temperature_MPL3115A2 + 273.15); // This 
       }else{
         altitude = calculate_altitude(avg_pressure, SEA_LEVEL_PRESSURE, GIVEN_TEMPERATURE);
       }
-      //Serial.print("Altitude: "), Serial.print(altitude), Serial.print(", Pressure: "), Serial.print(pressure);
+      //Serial.print("Altitude: "), Serial.print(altitude), Serial.print(", Pressure: "), Serial.print(avg_pressure);
       //Serial.print(", Actual pressure: "), Serial.println(press);
-      pressure = avg_pressure;
+      BarometerSample sample = {avg_pressure, altitude, temperature_MPL3115A2};
+      bus_publish(TOPIC_BAROMETER, &sample, sizeof(sample), micros());
     }
+    task_job_end(TASK_BAROMETER);
     // Delay the thread for 512 milliseconds before the next iteration
     threads.delay(256);
   }
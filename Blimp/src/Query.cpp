@@ -0,0 +1,124 @@
+#include "Query.h"
+#include "Telemetry.h"
+#include "TelemetryScheduler.h"
+#include "US_100.h"
+#include "PID.h"
+
+// Indexed by the id of the variable, the names and units are on the controller (same order)
+const QueryVariable queryVariables[QUERY_VARIABLE_COUNT] = {
+  {&CURRENT_HEIGHT, QUERY_FLOAT, 100},            // 0 [cm]
+  {&REQ_HEIGHT, QUERY_FLOAT, 100},                // 1 [cm]
+  {&C_R_H, QUERY_FLOAT, 100},                     // 2 [cm]
+  {NULL, QUERY_TOPIC_FLOAT, 100, TOPIC_HUMIDITY, offsetof(HumiditySample, temperature)},   // 3 [0.01 °C]
+  {NULL, QUERY_TOPIC_FLOAT, 100, TOPIC_HUMIDITY, offsetof(HumiditySample, humidity)},      // 4 [0.01 %]
+  {&POWER, QUERY_UINT, 1},                        // 5
+  {NULL, QUERY_TOPIC_FLOAT, 100, TOPIC_BAROMETER, offsetof(BarometerSample, altitude)},    // 6 [cm]
+  {NULL, QUERY_TOPIC_FLOAT, 1, TOPIC_BAROMETER, offsetof(BarometerSample, pressure)},      // 7 [Pa]
+  {NULL, QUERY_TOPIC_FLOAT, 100, TOPIC_GPS, offsetof(GPSData, ss)},                        // 8 [0.01 km/h]
+  {NULL, QUERY_TOPIC_FLOAT, 1e7, TOPIC_GPS, offsetof(GPSData, flat)},                      // 9 [1e-7 deg]
+  {NULL, QUERY_TOPIC_FLOAT, 1e7, TOPIC_GPS, offsetof(GPSData, flon)},                      // 10 [1e-7 deg]
+  {NULL, QUERY_TOPIC_FLOAT, 100, TOPIC_BAROMETER, offsetof(BarometerSample, temperature)}, // 11 [0.01 °C]
+  {NULL, QUERY_TOPIC_FLOAT, 100, TOPIC_GPS, offsetof(GPSData, altitude)},                  // 12 [cm]
+  {NULL, QUERY_TOPIC_ULONG, 1, TOPIC_GPS, offsetof(GPSData, age)},                         // 13 [ms]
+  {NULL, QUERY_TOPIC_INT, 1, TOPIC_ULTRASONIC, offsetof(UltrasonicSample, distance)},      // 14
+  {NULL, QUERY_TOPIC_FLOAT, 1000, TOPIC_ULTRASONIC, offsetof(UltrasonicSample, validityRate)},  // 15 [0.1 %]
+  {&filteredD, QUERY_FLOAT, 1000},                // 16
+  {&clasicD, QUERY_FLOAT, 1000},                  // 17
+  {&IntegralPart, QUERY_FLOAT, 1000},             // 18
+  {&ANGLE, QUERY_INT, 1},                         // 19 [deg]
+  {&POWER_OF_STEERING_MOTOR, QUERY_INT, 1},       // 20
+  {NULL, QUERY_TOPIC_SEQUENCE, 1, TOPIC_HUMIDITY},     // 21
+  {NULL, QUERY_TOPIC_SEQUENCE, 1, TOPIC_BAROMETER},    // 22
+  {NULL, QUERY_TOPIC_SEQUENCE, 1, TOPIC_GPS},          // 23
+};
+
+uint32_t querySubscription = 0;     // bitmap of the subscribed variables
+unsigned long queryPeriod = 0;      // [ms]
+unsigned long lastQueryAnswer = 0;
+uint32_t queryPending = 0;          // variables to be sent in the next packets
+
+/**
+ * Takes the QUERY command. It is called from process_command().
+ *
+ * @param value [period (upper byte), bitmap of the variables (3 bytes)], validated by read_command().
+ */
+void query_request(uint32_t value) {
+  uint32_t variables = value & 0xFFFFFF;
+  unsigned int period = value >> 24;
+  if (period == 0) {
+    queryPending |= variables;  // snapshot
+    return;
+  }
+  querySubscription = variables;
+  queryPeriod = (unsigned long)period * QUERY_PERIOD_UNIT;
+  lastQueryAnswer = millis() - queryPeriod;  // the first answer goes with the next packet
+  queryPending &= variables;
+}
+
+/**
+ * Checks whether the next packet carries the query section instead of the telemetry frame.
+ */
+bool query_active(void) {
+  return querySubscription != 0 || queryPending != 0;
+}
+
+/**
+ * Writes the query section: the pending variables, as many as fit into the budget.
+ *
+ * @param writer The packet.
+ * @param budget Bytes available for the section, including its header.
+ * @return Number of variables written.
+ */
+unsigned int write_query(PacketWriter &writer, unsigned int budget) {
+  if (querySubscription != 0 && millis() - lastQueryAnswer >= queryPeriod) {
+    queryPending |= querySubscription;
+    lastQueryAnswer = millis();
+  }
+  int32_t values[QUERY_VARIABLE_COUNT];
+  uint32_t sent = 0;
+  unsigned int count = 0;
+  budget = (budget > QUERY_HEADER_SIZE) ? budget - QUERY_HEADER_SIZE : 0;
+  for (unsigned int i = 0; i < QUERY_VARIABLE_COUNT; i++) {
+    if (!(queryPending & ((uint32_t)1 << i))) continue;
+    values[i] = query_value(i);
+    unsigned int cost = varint_size(zigzag_encode(values[i]));
+    if (cost > budget) continue;  // a smaller value may still fit
+    budget -= cost;
+    sent |= (uint32_t)1 << i;
+    count++;
+  }
+
+  writer.put_byte(sent & 0xFF);
+  writer.put_byte((sent >> 8) & 0xFF);
+  writer.put_byte((sent >> 16) & 0xFF);
+  for (unsigned int i = 0; i < QUERY_VARIABLE_COUNT; i++) {
+    if (sent & ((uint32_t)1 << i)) writer.put_varint(zigzag_encode(values[i]));
+  }
+  queryPending &= ~sent;
+  return count;
+}
+
+/**
+ * Reads a variable and converts it to its fixed-point number.
+ *
+ * @param id Index into queryVariables.
+ */
+int32_t query_value(unsigned int id) {
+  const QueryVariable &q = queryVariables[id];
+  uint32_t buffer[TOPIC_MAX_SIZE / 4] = {0};  // zeros until the first sample
+  const unsigned char *sample = (const unsigned char *)buffer;
+  if (q.type == QUERY_TOPIC_FLOAT || q.type == QUERY_TOPIC_INT || q.type == QUERY_TOPIC_ULONG) {
+    bus_read(q.topic, buffer, topics[q.topic].size);
+  }
+  switch (q.type) {
+    case QUERY_FLOAT: return to_fixed_32(*(const float *)q.address, q.scale);
+    case QUERY_INT: return *(const int *)q.address;
+    case QUERY_UINT: return *(const unsigned int *)q.address;
+    case QUERY_ULONG: return *(const unsigned long *)q.address;
+    case QUERY_TOPIC_FLOAT: return to_fixed_32(*(const float *)(sample + q.offset), q.scale);
+    case QUERY_TOPIC_INT: return *(const int *)(sample + q.offset);
+    case QUERY_TOPIC_ULONG: return *(const unsigned long *)(sample + q.offset);
+    case QUERY_TOPIC_SEQUENCE: return bus_sequence(q.topic);
+    default: return 0;
+  }
+}
@@ -0,0 +1,242 @@
+#include "Scheduler.h"
+
+#define TASK_ENTRY(id, name, period, deadline, wcet, spin, atomic, slice) {name, period, deadline, atomic, slice, -1},
+
+Task tasks[TASK_COUNT] = {
+  TASK_TABLE(TASK_ENTRY)
+};
+
+IntervalTimer cpuTimer;              // takes the samples of the running thread
+volatile unsigned long cpuSamples = 0;
+int atomicState;                     // state of the scheduler before task_atomic_begin()
+
+/**
+ * Starts the accounting of the CPU. It is called from setup(), which runs in the thread of the main loop (TASK_RADIO).
+ */
+void scheduler_begin(void) {
+  Task &radio = tasks[TASK_RADIO];
+  radio.thread = threads.id();
+  threads.setTimeSlice(radio.thread, radio.slice);
+  cpuTimer.begin(sample_cpu, TASK_SAMPLE_PERIOD);
+}
+
+/**
+ * Starts the thread of a task with the time slice of the task.
+ *
+ * @param id The task.
+ * @param entry The function of the thread.
+ * @return ID of the thread, negative if it could not be created.
+ */
+int task_create(TaskId id, void (*entry)(void)) {
+  int thread = profile_add_thread(tasks[id].name, entry);  // with a painted stack when profiling (see Profiler.h)
+  if (thread >= 0) threads.setTimeSlice(thread, tasks[id].slice);
+  tasks[id].thread = thread;
+  return thread;
+}
+
+/**
+ * Changes the period of a task, e.g. of the height control to SampleTime. The deadline stays.
+ *
+ * @param id The task.
+ * @param period The period [us].
+ */
+void task_set_period(TaskId id, unsigned long period) {
+  tasks[id].period = period;
+}
+
+/**
+ * Releases a job of a task. It runs in the interrupt of the timer that paces the task.
+ * A release that comes before the previous job ended is merged into it and counted as an overrun.
+ * The thread of the task is restarted if it sleeps in task_wait_release().
+ *
+ * @param id The task.
+ */
+void task_release(TaskId id) {
+  Task &task = tasks[id];
+  task.timed = true;
+  if (task.pending) {
+    task.overruns++;
+    return;
+  }
+  task.releasedAt = micros();
+  task.pending = true;
+  task.waiting = true;
+  if (task.sleeping) {
+    task.sleeping = false;
+    threads.restart(task.thread);
+  }
+}
+
+/**
+ * Forgets a release whose job will not run, e.g. when the timer of the task was stopped.
+ *
+ * @param id The task.
+ */
+void task_cancel(TaskId id) {
+  noInterrupts();
+  tasks[id].pending = false;
+  tasks[id].waiting = false;
+  interrupts();
+}
+
+/**
+ * Suspends the thread of a task paced by a timer until the timer releases its next job. It returns at once if a job
+ * is already released. threads.suspend() turns the interrupts on inside (setState() of TeensyThreads), so a release
+ * can come while the thread is being suspended; its restart is then overwritten by the suspension. Therefore the
+ * release is checked again after the suspension and the thread restarts itself if it came. Otherwise the thread
+ * leaves the round-robin at the yield and comes back after the release.
+ *
+ * @param id The task, it must be the one of the calling thread.
+ */
+void task_wait_release(TaskId id) {
+  Task &task = tasks[id];
+  while (true) {
+    noInterrupts();
+    if (task.pending) {
+      interrupts();
+      return;
+    }
+    task.sleeping = true;
+    interrupts();
+    threads.suspend(task.thread);
+    noInterrupts();
+    if (task.pending) {  // released during or after the suspension, its restart may have been lost
+      task.sleeping = false;
+      interrupts();
+      threads.restart(task.thread);
+      return;
+    }
+    interrupts();
+    threads.yield();
+  }
+}
+
+/**
+ * @param id The task.
+ * @return True if a task of a higher priority than the given one is released and has not started its job.
+ */
+bool higher_task_waiting(TaskId id) {
+  for (unsigned int i = 0; i < (unsigned int)id; i++) {
+    if (tasks[i].waiting) return true;
+  }
+  return false;
+}
+
+/**
+ * Starts a job of a task. A task that is not paced by a timer is released here.
+ * The job starts only when no task of a higher priority is waiting to start its own, until then the thread yields.
+ *
+ * @param id The task.
+ */
+void task_job_start(TaskId id) {
+  Task &task = tasks[id];
+  noInterrupts();
+  if (!task.pending) {
+    task.releasedAt = micros();
+    task.pending = true;
+    task.waiting = true;
+  }
+  interrupts();
+  while (higher_task_waiting(id)) threads.yield();
+  task.startedAt = micros();
+  task.waiting = false;
+  task.running = true;
+}
+
+/**
+ * Ends a job of a task and accounts it.
+ *
+ * @param id The task.
+ */
+void task_job_end(TaskId id) {
+  Task &task = tasks[id];
+  unsigned long now = micros();
+  noInterrupts();  // print_task_statistics() runs in the main loop
+  unsigned long response = now - task.releasedAt;
+  unsigned long execution = now - task.startedAt;
+  task.jobs++;
+  task.responseTotal += response;
+  if (response > task.responseMax) task.responseMax = response;
+  if (execution > task.executionMax) task.executionMax = execution;
+  if (response > task.deadline) task.misses++;
+  task.running = false;
+  task.pending = false;
+  interrupts();
+}
+
+/**
+ * Stops the switching of threads for the atomic part of a job (see TaskTable.h).
+ * It waits until no task of a higher priority is waiting and the next release of every task of a higher priority
+ * paced by a timer is at least the atomic time of the task away. task_atomic_end() must follow.
+ *
+ * @param id The task.
+ */
+void task_atomic_begin(TaskId id) {
+  Task &task = tasks[id];
+  while (true) {
+    bool clear = !higher_task_waiting(id);
+    unsigned long now = micros();
+    for (unsigned int i = 0; i < (unsigned int)id && clear; i++) {
+      const Task &other = tasks[i];
+      if (other.timed && other.period - (now - other.releasedAt) % other.period < task.atomic) clear = false;
+    }
+    if (clear) break;
+    threads.yield();
+  }
+  atomicState = threads.stop();
+}
+
+/**
+ * Lets the threads switch again after task_atomic_begin().
+ */
+void task_atomic_end(void) {
+  threads.start(atomicState);
+}
+
+/**
+ * Counts a sample of the CPU for the task whose job is running at the moment. It runs in the interrupt of cpuTimer.
+ * Threads that only wait (threads.delay(), threads.yield()) outside of a job count as idle.
+ */
+void sample_cpu(void) {
+  PROFILE_THREAD_SAMPLE();  // the cycles of the running thread (see Profiler.h)
+  int thread = threads.id();
+  cpuSamples++;
+  for (unsigned int i = 0; i < TASK_COUNT; i++) {
+    if (tasks[i].thread == thread) {
+      if (tasks[i].running) tasks[i].samples++;
+      return;
+    }
+  }
+}
+
+/**
+ * Prints the statistics of the tasks every TASK_STATISTICS_PERIOD. It is called from the main loop.
+ */
+void scheduler_service(void) {
+  static unsigned long lastReport = 0;
+  if (millis() - lastReport >= TASK_STATISTICS_PERIOD) {
+    print_task_statistics();
+    lastReport = millis();
+  }
+}
+
+/**
+ * Prints the statistics of the tasks in the order of their priority.
+ */
+void print_task_statistics(void) {
+  Serial.println("Tasks:");
+  unsigned long total = cpuSamples;
+  unsigned long busy = 0;
+  for (unsigned int i = 0; i < TASK_COUNT; i++) {
+    noInterrupts();
+    Task t = tasks[i];
+    interrupts();
+    busy += t.samples;
+    Serial.print("  "), Serial.print(t.name), Serial.print(" : "), Serial.print(t.jobs), Serial.print(" jobs, response ");
+    Serial.print(t.jobs > 0 ? t.responseTotal / t.jobs : 0), Serial.print(" us mean, "), Serial.print(t.responseMax);
+    Serial.print(" us max (deadline "), Serial.print(t.deadline), Serial.print(" us), execution ");
+    Serial.print(t.executionMax), Serial.print(" us max, "), Serial.print(t.misses), Serial.print(" missed, ");
+    Serial.print(t.overruns), Serial.print(" overruns, CPU "), Serial.print(total > 0 ? 100.0 * t.samples / total : 0.0), Serial.println(" %");
+  }
+  Serial.print("  idle : CPU "), Serial.print(total > 0 ? 100.0 * (total - busy) / total : 0.0), Serial.println(" %");
+}
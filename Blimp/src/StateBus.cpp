@@ -0,0 +1,83 @@
+#include "StateBus.h"
+
+// Indexed by TopicId
+Topic topics[TOPIC_COUNT] = {
+  {sizeof(HeightSample)},
+  {sizeof(UltrasonicSample)},
+  {sizeof(BarometerSample)},
+  {sizeof(HumiditySample)},
+  {sizeof(GPSData)},
+};
+
+static_assert(sizeof(HeightSample) <= TOPIC_MAX_SIZE && sizeof(UltrasonicSample) <= TOPIC_MAX_SIZE
+              && sizeof(BarometerSample) <= TOPIC_MAX_SIZE && sizeof(HumiditySample) <= TOPIC_MAX_SIZE
+              && sizeof(GPSData) <= TOPIC_MAX_SIZE, "a sample does not fit into the buffers of its topic");
+
+/**
+ * Publishes a sample. Only the one publisher of the topic may call it.
+ *
+ * @param topic The topic.
+ * @param sample The sample, of the type of the topic.
+ * @param size Size of the sample, it must match the topic.
+ * @param stamp micros() at which the sample was taken.
+ */
+void bus_publish(TopicId topic, const void *sample, unsigned int size, unsigned long stamp) {
+  Topic &t = topics[topic];
+  if (size != t.size) return;
+  unsigned long next = t.seq + 1;
+  memcpy(t.buffers[next % TOPIC_BUFFERS], sample, size);  // no reader that can still succeed copies this buffer
+  t.stamps[next % TOPIC_BUFFERS] = stamp;
+  __sync_synchronize();  // the sample is complete before it is published
+  t.seq = next;
+}
+
+/**
+ * Takes the newest sample of a topic. It can be called from any thread. The copy is repeated if the publisher
+ * could have overwritten it meanwhile, at most BUS_READ_ATTEMPTS times, and then taken with interrupts off
+ * (see StateBus.h).
+ *
+ * @param topic The topic.
+ * @param sample Where the sample is copied, of the type of the topic.
+ * @param size Size of the sample, it must match the topic.
+ * @return Sequence number and stamp of the sample, sequence number 0 (and the sample unchanged) if there is none.
+ */
+SampleInfo bus_read(TopicId topic, void *sample, unsigned int size) {
+  Topic &t = topics[topic];
+  SampleInfo info = {0, 0};
+  if (size != t.size) return info;
+  for (unsigned int attempt = 0; attempt < BUS_READ_ATTEMPTS; attempt++) {
+    unsigned long seq = t.seq;
+    if (seq == 0) return info;
+    __sync_synchronize();
+    memcpy(sample, t.buffers[seq % TOPIC_BUFFERS], size);
+    unsigned long stamp = t.stamps[seq % TOPIC_BUFFERS];
+    __sync_synchronize();
+    if (t.seq - seq < TOPIC_BUFFERS - 1) {  // publication seq + TOPIC_BUFFERS, which reuses the buffer, has not started
+      info.seq = seq;
+      info.stamp = stamp;
+      return info;
+    }
+  }
+  noInterrupts();  // the publisher cannot be switched in, a publication in progress writes another buffer
+  info.seq = t.seq;
+  memcpy(sample, t.buffers[info.seq % TOPIC_BUFFERS], size);
+  info.stamp = t.stamps[info.seq % TOPIC_BUFFERS];
+  interrupts();
+  return info;
+}
+
+/**
+ * @param topic The topic.
+ * @return Sequence number of the newest sample, it changes with every publication.
+ */
+unsigned long bus_sequence(TopicId topic) {
+  return topics[topic].seq;
+}
+
+/**
+ * @param info A sample read from the bus.
+ * @return Time since the sample was taken [us].
+ */
+unsigned long sample_age(const SampleInfo &info) {
+  return micros() - info.stamp;
+}
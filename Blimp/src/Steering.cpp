@@ -0,0 +1,90 @@
+#include "Steering.h"
+#include "TDMA.h"
+#include "Fleet.h"
+
+/*
+Continuous controls, airship side.
+receive_service() keeps only the newest setpoint: one with an older sequence number than the last one is dropped,
+so a delayed packet never moves the servo back. The main loop applies the setpoint in its next pass.
+If no setpoint arrives for STEERING_TIMEOUT_SUPERFRAMES, the servo is held in its position and the steering
+motor stops (see ControlSteeringMotor()); the setpoints are applied again when the stream resumes. The sequence numbers are separate from those of the commands (see ARQ.h).
+*/
+
+volatile uint16_t setpointSeq = 0;
+volatile int setpointAngle = 0;
+volatile int setpointPower = 0;
+volatile unsigned long setpointAt = 0;      // time at which the newest setpoint arrived
+volatile bool setpointStarted = false;      // false until the first setpoint arrives
+volatile bool setpointPending = false;      // a setpoint arrived and has not been applied yet
+volatile unsigned long staleSetpoints = 0;
+bool frozen = false;
+
+/**
+ * @param value The value of CONTROL_SETPOINT.
+ * @return The steering angle [degrees].
+ */
+int setpoint_angle(int32_t value) {
+  return (value - setpoint_power(value)) / 256;  // exact, unlike a shift of a negative value
+}
+
+/**
+ * @param value The value of CONTROL_SETPOINT.
+ * @return The power of the steering motor.
+ */
+int setpoint_power(int32_t value) {
+  return (uint32_t)value & 0xFF;
+}
+
+/**
+ * Takes a received setpoint, if it is newer than the last one. It is called from receive_service().
+ *
+ * @param seq The sequence number of the setpoint.
+ * @param value The value of CONTROL_SETPOINT.
+ */
+void steering_received(uint16_t seq, int32_t value) {
+  if (setpointStarted && (int16_t)(seq - setpointSeq) <= 0) {
+    staleSetpoints++;
+    return;
+  }
+  setpointSeq = seq;
+  setpointAngle = setpoint_angle(value);
+  setpointPower = setpoint_power(value);
+  setpointAt = millis();
+  setpointStarted = true;
+  setpointPending = true;
+}
+
+/**
+ * Applies the newest setpoint to the steering angle and the power of the steering motor,
+ * or freezes the steering when the setpoints have stopped. It is called in every pass of the main loop.
+ */
+void steering_service(void) {
+  noInterrupts();
+  bool pending = setpointPending;
+  int angle = setpointAngle;
+  int power = setpointPower;
+  setpointPending = false;
+  interrupts();
+
+  if (pending) {
+    if (frozen) Serial.println("Steering setpoints resumed");
+    frozen = false;
+    ANGLE = angle;
+    POWER_OF_STEERING_MOTOR = power;
+  } else if (setpointStarted && !frozen) {
+    TdmaLayout layout;
+    tdma_layout(layout);
+    if (millis() - setpointAt > STEERING_TIMEOUT_SUPERFRAMES * fleetSlots * layout.frame) {
+      frozen = true;
+      Serial.print("Steering setpoints stopped, servo held at "), Serial.print(ANGLE), Serial.println(", steering motor stopped");
+    }
+  }
+}
+
+/**
+ * @return True while the steering is frozen because the setpoints stopped.
+ */
+bool steering_frozen(void) {
+  return frozen;
+}
+
@@ -0,0 +1,85 @@
+#include "TDMA.h"
+#include "LinkAdaptation.h"
+#include "Fleet.h"
+
+/*
+Time-slotted channel access, airship side.
+The airship is the master of the schedule: its periodic telemetry packet is the beacon that starts a frame.
+The acknowledgement of commands (telemetry sent out of the period) may only go out in the acknowledgement slot,
+otherwise it waits for the next beacon, which carries the acknowledgement as well.
+The controller sends only in its slots (see TDMA.cpp of the controller), so the airship is never transmitting
+when a command arrives.
+In a fleet, the beacons are sent once per superframe. The airships have no common clock, every airship
+keeps its frame at the right distance behind the beacons of the others it hears (tdma_fleet_beacon()).
+*/
+
+unsigned long beaconEnd = 0;  // time at which the last beacon was sent
+
+/**
+ * Computes the slots of the TDMA frame for the current link profile (see LinkAdaptation.h).
+ * Both ends compute the same layout, so only the beacon has to be transmitted.
+ *
+ * @param layout Reference to store the slots.
+ */
+void tdma_layout(TdmaLayout &layout) {
+  unsigned long slot = link_airtime(currentProfile, TDMA_MAX_PACKET) + TDMA_GUARD;  // one packet with its guard
+  layout.uplinkStart = TDMA_GUARD;
+  layout.uplinkEnd = layout.uplinkStart + TDMA_UPLINK_WINDOW;
+  layout.ackStart = layout.uplinkEnd + slot;
+  layout.ackEnd = layout.ackStart + TDMA_LOOP_PERIOD + TDMA_GUARD;
+  layout.contentionStart = layout.ackEnd + slot;
+  layout.contentionEnd = layout.contentionStart + TDMA_CONTENTION_WINDOW;
+  layout.frame = layout.contentionEnd + slot;
+  if (layout.frame < TDMA_MIN_FRAME) layout.frame = TDMA_MIN_FRAME;
+}
+
+/**
+ * Checks whether the next beacon should be sent, i.e. the frame of this airship in the next superframe has started.
+ */
+bool tdma_beacon_due(void) {
+  TdmaLayout layout;
+  tdma_layout(layout);
+  return millis() - beaconEnd >= fleetSlots * layout.frame;
+}
+
+/**
+ * Checks whether the beacon has been delayed so long that it has to be sent regardless of the airtime budget.
+ */
+bool tdma_beacon_overdue(void) {
+  TdmaLayout layout;
+  tdma_layout(layout);
+  return millis() - beaconEnd >= TDMA_MAX_BEACON_GAP * fleetSlots * layout.frame;
+}
+
+/**
+ * Starts a new frame. It is called right after the beacon was transmitted.
+ */
+void tdma_beacon_sent(void) {
+  beaconEnd = millis();
+}
+
+/**
+ * Moves the frame of this airship behind the beacon of another airship of the fleet. It is called from receive_service().
+ * Airship i starts its frame (i - index) frames after the frame of the airship with the given index.
+ *
+ * @param index The index of the airship whose beacon was received.
+ * @param time millis() at the reception of the beacon.
+ */
+void tdma_fleet_beacon(unsigned int index, unsigned long time) {
+  unsigned int slots = fleetSlots;
+  if (index >= slots || index == vehicleIndex) return;
+  TdmaLayout layout;
+  tdma_layout(layout);
+  unsigned int ahead = (vehicleIndex + slots - index) % slots;  // frames from the received beacon to the next one of this airship
+  beaconEnd = time - (slots - ahead) * layout.frame;
+}
+
+/**
+ * Checks whether the acknowledgement slot of the current frame is open.
+ */
+bool tdma_ack_slot_open(void) {
+  TdmaLayout layout;
+  tdma_layout(layout);
+  unsigned long t = millis() - beaconEnd;
+  return t >= layout.ackStart && t < layout.ackEnd;
+}
@@ -0,0 +1,224 @@
+#include "Telemetry.h"
+#include "US_100.h"
+#include "TelemetryScheduler.h"
+#include "StateBus.h"
+
+// If it is set to false, every report is sent as a keyframe
+bool DELTA_TELEMETRY = true;
+
+unsigned char telemetrySeq = 0;  // sequence number of the next telemetry frame
+unsigned int framesSinceKeyframe = 0;
+int32_t telemetryHistory[TELEMETRY_HISTORY][TELEMETRY_FIELD_COUNT]; // fields of the recently sent frames, indexed by seq
+volatile int telemetryAckedSeq = -1; // last frame acknowledged by the controller, -1 if there is none
+
+/**
+ * Takes a snapshot of the measured values and converts them to the fixed-point units of the telemetry frame.
+ * The readings of the sensors come from the state bus (see StateBus.h), each one whole.
+ *
+ * @param frame Reference to the frame that will be filled.
+ */
+void fill_telemetry_frame(TelemetryFrame &frame) {
+  HumiditySample humidity = {0, 0};
+  BarometerSample barometer = {0, 0, 0};
+  GPSData gps = {};
+  bus_read(TOPIC_HUMIDITY, &humidity, sizeof(humidity));
+  bus_read(TOPIC_BAROMETER, &barometer, sizeof(barometer));
+  bus_read(TOPIC_GPS, &gps, sizeof(gps));
+  frame.currentHeight = to_fixed_16(CURRENT_HEIGHT, 100);
+  frame.requiredHeight = to_fixed_16(REQ_HEIGHT, 100);
+  frame.currentRequiredHeight = to_fixed_16(C_R_H, 100);
+  frame.temperature = (humidity.temperature == INVALID_VALUE) ? TELEMETRY_INVALID_16 : to_fixed_16(humidity.temperature, 100);
+  frame.humidity = (humidity.humidity == INVALID_VALUE) ? TELEMETRY_INVALID_16 : to_fixed_16(humidity.humidity, 100);
+  frame.power = (POWER > 255) ? 255 : POWER;
+  frame.altitude = to_fixed_32(barometer.altitude, 100);
+  frame.pressure = to_fixed_32(barometer.pressure, 1);
+  frame.speed = (gps.ss <= 0) ? 0 : ((gps.ss * 100 >= UINT16_MAX) ? UINT16_MAX : (uint16_t)(gps.ss * 100 + 0.5));
+  frame.latitude = to_fixed_32(gps.flat, 1e7);
+  frame.longitude = to_fixed_32(gps.flon, 1e7);
+}
+
+/**
+ * Serializes the next report of the telemetry stream. A keyframe is sent when the controller has no usable
+ * reference, otherwise only the fields chosen by the telemetry scheduler (see TelemetryScheduler.h) are sent
+ * as deltas against the last acknowledged frame.
+ *
+ * @param frame The frame to be serialized.
+ * @param writer The packet to which the frame is appended.
+ * @param fieldBudget Bytes available for the field deltas of a delta frame.
+ * @return False if the frame did not fit into the packet.
+ */
+bool encode_telemetry(const TelemetryFrame &frame, PacketWriter &writer, unsigned int fieldBudget) {
+  unsigned char seq = telemetrySeq++;
+  int refSeq = telemetryAckedSeq; // read once, it is updated by the receive path
+  bool keyframe = keyframe_is_needed(seq);
+
+  int32_t *fields = telemetryHistory[seq % TELEMETRY_HISTORY];
+  frame_to_fields(frame, fields);
+
+  if (keyframe) {
+    framesSinceKeyframe = 0;
+    telemetry_fields_sent((1 << TELEMETRY_FIELD_COUNT) - 1);
+    return encode_telemetry_frame(frame, seq, writer);
+  }
+  framesSinceKeyframe++;
+  const int32_t *reference = telemetryHistory[refSeq % TELEMETRY_HISTORY];
+  uint16_t selected = select_telemetry_fields(fields, reference, fieldBudget);
+  telemetry_fields_sent(selected);
+  return encode_delta_frame(fields, reference, selected, seq, refSeq, writer);
+}
+
+/**
+ * Decides whether the frame with the given sequence number has to be sent as a keyframe.
+ * It is needed if delta mode is off, if no frame has been acknowledged yet, if the acknowledged frame
+ * is no longer in the history, or periodically so that the controller can resynchronize after losses.
+ *
+ * @param seq The sequence number of the frame that is being sent.
+ */
+bool keyframe_is_needed(unsigned char seq) {
+  int refSeq = telemetryAckedSeq;
+  if (!DELTA_TELEMETRY || refSeq < 0) return true;
+  if ((unsigned char)(seq - refSeq) >= TELEMETRY_HISTORY) return true;
+  return framesSinceKeyframe >= TELEMETRY_KEYFRAME_PERIOD;
+}
+
+/**
+ * Decides whether the next encoded frame will be a keyframe (see keyframe_is_needed()).
+ */
+bool keyframe_is_next(void) {
+  return keyframe_is_needed(telemetrySeq);
+}
+
+/**
+ * Records that the controller has received and stored the frame with the given sequence number.
+ * Acknowledgements of frames that are no longer in the history or that are older than the current reference are ignored.
+ *
+ * @param seq The acknowledged sequence number.
+ */
+void telemetry_acknowledged(unsigned int seq) {
+  unsigned char age = (unsigned char)(telemetrySeq - 1 - seq);
+  if (seq > 0xFF || age >= TELEMETRY_HISTORY) return;
+  int refSeq = telemetryAckedSeq;
+  if (refSeq >= 0 && (unsigned char)(telemetrySeq - 1 - refSeq) < age) return;
+  telemetryAckedSeq = seq;
+}
+
+/**
+ * Serializes a telemetry frame into a byte buffer as a keyframe.
+ * Format: [TELEMETRY_FULL_FRAME, seq, current height, required height, current required height, temperature, humidity,
+ * power, altitude, pressure, speed, latitude, longitude]
+ *
+ * @param frame The frame to be serialized.
+ * @param seq The sequence number of the frame.
+ * @param writer The packet to which the frame is appended (TELEMETRY_FRAME_SIZE bytes).
+ * @return False if the frame did not fit into the packet.
+ */
+bool encode_telemetry_frame(const TelemetryFrame &frame, unsigned char seq, PacketWriter &writer) {
+  writer.put_byte(TELEMETRY_FULL_FRAME);
+  writer.put_byte(seq);
+  return write_telemetry_fields(frame, writer);
+}
+
+/**
+ * Serializes the fields of a telemetry frame, i.e. the body of a keyframe (also used by the backlog, see Backlog.h).
+ *
+ * @param frame The frame to be serialized.
+ * @param writer The packet to which the fields are appended (TELEMETRY_FRAME_SIZE - 2 bytes).
+ * @return False if the fields did not fit into the packet.
+ */
+bool write_telemetry_fields(const TelemetryFrame &frame, PacketWriter &writer) {
+  writer.put_int16(frame.currentHeight);
+  writer.put_int16(frame.requiredHeight);
+  writer.put_int16(frame.currentRequiredHeight);
+  writer.put_int16(frame.temperature);
+  writer.put_int16(frame.humidity);
+  writer.put_byte(frame.power);
+  writer.put_int32(frame.altitude);
+  writer.put_int32(frame.pressure);
+  writer.put_int16((int16_t)frame.speed);
+  writer.put_int32(frame.latitude);
+  writer.put_int32(frame.longitude);
+  return writer.ok();
+}
+
+/**
+ * Serializes the selected fields of a frame as differences against a reference frame.
+ * Format: [TELEMETRY_DELTA_FRAME, seq, reference seq, presence bitmap (2 bytes), zig-zag varint delta of each present field]
+ * Bit i of the bitmap is set if field i (in the order of TelemetryFrame) is present. A missing field has no new value,
+ * the controller keeps the last one it received.
+ *
+ * @param fields Fields of the frame to be serialized.
+ * @param reference Fields of the acknowledged reference frame.
+ * @param selected Bitmap of the fields to be sent.
+ * @param seq The sequence number of the frame.
+ * @param refSeq The sequence number of the reference frame.
+ * @param writer The packet to which the frame is appended (at most TELEMETRY_MAX_FRAME_SIZE bytes).
+ * @return False if the frame did not fit into the packet.
+ */
+bool encode_delta_frame(const int32_t *fields, const int32_t *reference, uint16_t selected, unsigned char seq, unsigned char refSeq, PacketWriter &writer) {
+  writer.put_byte(TELEMETRY_DELTA_FRAME);
+  writer.put_byte(seq);
+  writer.put_byte(refSeq);
+  writer.put_int16((int16_t)selected);
+
+  for (unsigned int i = 0; i < TELEMETRY_FIELD_COUNT; i++) {
+    if (selected & (1 << i)) {
+      writer.put_varint(zigzag_encode((int32_t)((uint32_t)fields[i] - (uint32_t)reference[i])));
+    }
+  }
+  return writer.ok();
+}
+
+/**
+ * Copies the fields of a frame into an array in the order of TelemetryFrame, so that they can be compared in a loop.
+ */
+void frame_to_fields(const TelemetryFrame &frame, int32_t *fields) {
+  fields[0] = frame.currentHeight;
+  fields[1] = frame.requiredHeight;
+  fields[2] = frame.currentRequiredHeight;
+  fields[3] = frame.temperature;
+  fields[4] = frame.humidity;
+  fields[5] = frame.power;
+  fields[6] = frame.altitude;
+  fields[7] = frame.pressure;
+  fields[8] = frame.speed;
+  fields[9] = frame.latitude;
+  fields[10] = frame.longitude;
+}
+
+/**
+ * Maps a signed number to an unsigned one so that small magnitudes give small numbers (0, -1, 1, -2 -> 0, 1, 2, 3).
+ */
+uint32_t zigzag_encode(int32_t value) {
+  return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+/**
+ * Converts a value to a rounded 16-bit fixed-point number. Values out of range are saturated,
+ * so that they can never collide with TELEMETRY_INVALID_16.
+ *
+ * @param value The value in base units (e.g. m).
+ * @param scale Number of fixed-point steps per base unit (e.g. 100 for cm).
+ * @return The fixed-point representation of the value.
+ */
+int16_t to_fixed_16(float value, float scale) {
+  float scaled = value * scale;
+  if (isnan(scaled)) return 0;
+  if (scaled >= INT16_MAX) return INT16_MAX;
+  if (scaled <= INT16_MIN + 1) return INT16_MIN + 1;
+  return (int16_t)lroundf(scaled);
+}
+
+/**
+ * Converts a value to a rounded 32-bit fixed-point number. Values out of range are saturated.
+ *
+ * @param value The value in base units (e.g. deg).
+ * @param scale Number of fixed-point steps per base unit (e.g. 1e7 for GPS coordinates).
+ * @return The fixed-point representation of the value.
+ */
+int32_t to_fixed_32(double value, double scale) {
+  double scaled = value * scale;
+  if (isnan(scaled)) return 0;
+  if (scaled >= INT32_MAX) return INT32_MAX;
+  if (scaled <= INT32_MIN) return INT32_MIN;
+  return (int32_t)lround(scaled);
+}
@@ -0,0 +1,109 @@
+#include "TelemetryScheduler.h"
+#include "StateBus.h"
+
+/*
+Multi-rate telemetry scheduler.
+Every field of TelemetryFrame has its own period and priority class. A delta frame carries only the fields
+whose source produced a new sample since the field was last sent and whose period has elapsed.
+They are taken by priority class and, inside a class, by how long they are overdue, until the byte budget
+of the frame is used up. The rest waits for the next frame, so urgent fields get the bandwidth first
+and fields without new samples are not resent at all. Keyframes still carry every field.
+*/
+
+// In the order of TelemetryFrame
+const TelemetryFieldSchedule telemetrySchedule[TELEMETRY_FIELD_COUNT] = {
+  {0, PRIORITY_CONTROL, SOURCE_CONTROL},            // current height
+  {0, PRIORITY_CONTROL, SOURCE_CONTROL},            // required height
+  {0, PRIORITY_CONTROL, SOURCE_CONTROL},            // current required height
+  {5000, PRIORITY_ENVIRONMENT, SOURCE_DHT22},       // temperature
+  {5000, PRIORITY_ENVIRONMENT, SOURCE_DHT22},       // humidity
+  {0, PRIORITY_CONTROL, SOURCE_CONTROL},            // power
+  {1000, PRIORITY_NAVIGATION, SOURCE_PRESSURE},     // altitude
+  {3000, PRIORITY_ENVIRONMENT, SOURCE_PRESSURE},    // pressure
+  {1000, PRIORITY_NAVIGATION, SOURCE_GPS},          // speed
+  {1000, PRIORITY_NAVIGATION, SOURCE_GPS},          // latitude
+  {1000, PRIORITY_NAVIGATION, SOURCE_GPS},          // longitude
+};
+
+unsigned long fieldSentAt[TELEMETRY_FIELD_COUNT] = {0};       // time of the last send of each field
+unsigned long fieldSentSample[TELEMETRY_FIELD_COUNT] = {0};   // sample counter of its source at that time
+
+/**
+ * Chooses the fields of the next delta frame.
+ *
+ * @param fields Current fields.
+ * @param reference Fields of the acknowledged reference frame, against which the deltas are computed.
+ * @param budget Bytes available for the deltas, normally TELEMETRY_FIELD_BUDGET.
+ * @return Bitmap of the chosen fields (bit i = field i).
+ */
+uint16_t select_telemetry_fields(const int32_t *fields, const int32_t *reference, unsigned int budget) {
+  unsigned long now = millis();
+  uint16_t candidates = 0;
+  for (unsigned int i = 0; i < TELEMETRY_FIELD_COUNT; i++) {
+    const TelemetryFieldSchedule &s = telemetrySchedule[i];
+    bool fresh = s.source == SOURCE_CONTROL || telemetry_source_samples(s.source) != fieldSentSample[i];
+    if (fresh && now - fieldSentAt[i] >= s.period) candidates |= 1 << i;
+  }
+
+  uint16_t selected = 0;
+  while (candidates) {
+    // The most urgent candidate: the best priority class, then the longest overdue relative to its period
+    int best = -1;
+    float bestLateness = 0;
+    for (unsigned int i = 0; i < TELEMETRY_FIELD_COUNT; i++) {
+      if (!(candidates & (1 << i))) continue;
+      const TelemetryFieldSchedule &s = telemetrySchedule[i];
+      float lateness = (float)(now - fieldSentAt[i]) / (s.period + 1);
+      if (best < 0 || s.priority < telemetrySchedule[best].priority
+          || (s.priority == telemetrySchedule[best].priority && lateness > bestLateness)) {
+        best = i;
+        bestLateness = lateness;
+      }
+    }
+    candidates &= ~(1 << best);
+
+    unsigned int cost = varint_size(zigzag_encode((int32_t)((uint32_t)fields[best] - (uint32_t)reference[best])));
+    if (cost > budget) continue;  // a smaller field may still fit
+    budget -= cost;
+    selected |= 1 << best;
+  }
+  return selected;
+}
+
+/**
+ * Records that the fields were sent, so they wait for their period and for a new sample.
+ *
+ * @param selected Bitmap of the sent fields (bit i = field i).
+ */
+void telemetry_fields_sent(uint16_t selected) {
+  unsigned long now = millis();
+  for (unsigned int i = 0; i < TELEMETRY_FIELD_COUNT; i++) {
+    if (!(selected & (1 << i))) continue;
+    fieldSentAt[i] = now;
+    fieldSentSample[i] = telemetry_source_samples(telemetrySchedule[i].source);
+  }
+}
+
+/**
+ * Returns the sample counter of a source, the sequence number of its topic (see StateBus.h).
+ */
+unsigned long telemetry_source_samples(TelemetrySource source) {
+  switch (source) {
+    case SOURCE_DHT22: return bus_sequence(TOPIC_HUMIDITY);
+    case SOURCE_PRESSURE: return bus_sequence(TOPIC_BAROMETER);
+    case SOURCE_GPS: return bus_sequence(TOPIC_GPS);
+    default: return 0;
+  }
+}
+
+/**
+ * Returns the number of bytes of a value encoded as a varint (see PacketWriter::put_varint()).
+ */
+unsigned int varint_size(uint32_t value) {
+  unsigned int size = 1;
+  while (value >= 0x80) {
+    value >>= 7;
+    size++;
+  }
+  return size;
+}
@@ -1,7 +1,8 @@
 #include "US_100.h"
+#include "Aggregate.h"
+#include "Scheduler.h"
+#include "StateBus.h"
 
-int ultrasonic_distance = 0;
-float USValidityRate = 0.5;
 const unsigned int BUFFER_SIZE = 40;
 bool US_buffer[BUFFER_SIZE];
 
@@ -52,6 +53,7 @@ void thread_ultrasonic(void) {
             threads.delay(10);
         }
 
+        task_job_start(TASK_ULTRASONIC);  // released by the answer or the timeout (see Scheduler.h)
         if (SONAR_SERIAL.available() >= 2) {
             HighByte = SONAR_SERIAL.read();
             LowByte  = SONAR_SERIAL.read();
@@ -61,8 +63,10 @@ void thread_ultrasonic(void) {
         }
 
         old_avg_distance = distance_EMA(current_dist, old_avg_distance);
-        ultrasonic_distance = old_avg_distance;
-        USValidityRate = ValidityRate((old_avg_distance != INVALID_VALUE));
+        UltrasonicSample sample = {old_avg_distance, ValidityRate((old_avg_distance != INVALID_VALUE))};
+        bus_publish(TOPIC_ULTRASONIC, &sample, sizeof(sample), micros());  // see StateBus.h
+        if (old_avg_distance != INVALID_VALUE) aggregate_sample(AGGREGATE_ULTRASONIC, old_avg_distance);
+        task_job_end(TASK_ULTRASONIC);
         threads.delay(10);
     }
 }
@@ -15,12 +15,18 @@
 #include "Communication.h"
 #include <Servo.h>
 #include "ControlMotors.h"
+#include "Scheduler.h"
+#include "StateBus.h"
+#include "Profiler.h"
 
 const unsigned int LED = 2;
 bool LED_shine = false;
 
 double initial_height = 0;
 bool ultrasonicDistanceIsValid = false;
+UltrasonicSample ultrasonic = {0, 0.5};  // the last readings taken from the state bus
+BarometerSample barometer = {0, 0, 0};
+unsigned long heightInputs = 0;  // sum of the sequence numbers of the readings behind the last published height
 bool DoNotMove = true;
 unsigned int EmergencyPeriod = 50000; 
 unsigned long int lastLedTime = millis();
@@ -63,25 +69,29 @@ void setup() {
   }
 
   // must be done before ControlHeight threat is started
-  InitializeESCs(); // takes 1.5 seconds
+  actuators_begin(); // ESCs and servo, takes 1.5 seconds
   setParametres(Kp, Ki, Kd, n, SampleTime);
   setLimits(Upper, Lower);
-  
-  InitializeSERVO();
+
+  backlog_begin();  // SD card for the telemetry record
+  capture_begin();  // record of the radio traffic on the SD card
   
   // Initialize led pin as output
   pinMode(LED, OUTPUT);
   // Set led pin to LOW
   digitalWrite(LED, LOW);
 
-  //threads
-  threads.addThread(thread_ultrasonic);
-  threads.addThread(thread_DHT22);
-  threads.addThread(thread_MPL3115A2);
-  threads.addThread(thread_GPS);
-  threads.addThread(ControlHeight);
-  threads.addThread(ControlSteeringMotor);
+  //threads, with the priorities and the accounting of Scheduler.h
+  profiler_begin();  // before the threads, it paints the main stack (see Profiler.h)
+  scheduler_begin();  // this thread runs the main loop
+  task_create(TASK_ULTRASONIC, thread_ultrasonic);
+  task_create(TASK_HUMIDITY, thread_DHT22);
+  task_create(TASK_BAROMETER, thread_MPL3115A2);
+  task_create(TASK_GPS, thread_GPS);
+  task_create(TASK_HEIGHT, ControlHeight);
+  task_create(TASK_ACTUATORS, thread_actuators);
   
+  fleet_begin();  // the random number for joining the fleet
   LoRa.onReceive(onReceive);
   LoRa.receive();
 
@@ -89,47 +99,86 @@ void setup() {
 }
 
 void loop() {
+  task_job_start(TASK_RADIO);  // see Scheduler.h
+  steering_service();  // the newest steering setpoint, or the servo stays if they stopped (see Steering.h)
   ControlServo(ANGLE);
+  ControlSteeringMotor();
+  actuators_safe_stop(DoNotMove);  // all ESCs stop at once while the motors are switched off (see Actuators.h)
 
   if(lastReceivedTime != 0 && abs(millis() - lastReceivedTime) > EmergencyPeriod){
     SetLAND();
   }
 
+  SampleInfo ultrasonicInfo = bus_read(TOPIC_ULTRASONIC, &ultrasonic, sizeof(ultrasonic));
+  SampleInfo barometerInfo = bus_read(TOPIC_BAROMETER, &barometer, sizeof(barometer));
   lastUltrasonicDistanceWasValid = ultrasonicDistanceIsValid;
   old_height = CURRENT_HEIGHT;
   CURRENT_HEIGHT = get_current_height();
+  if (ultrasonicInfo.seq + barometerInfo.seq != heightInputs) {  // only a new reading gives a new height
+    heightInputs = ultrasonicInfo.seq + barometerInfo.seq;
+    HeightSample height = {CURRENT_HEIGHT, ultrasonicDistanceIsValid};
+    bus_publish(TOPIC_HEIGHT, &height, sizeof(height), ultrasonicDistanceIsValid ? ultrasonicInfo.stamp : barometerInfo.stamp);
+    aggregate_sample(AGGREGATE_HEIGHT, CURRENT_HEIGHT * 100);  // in cm
+  }
   handle_validity_of_required_height(old_height, lastUltrasonicDistanceWasValid);
 
   ControlSignalingDiode();
 
-  if (NEW_MSG == true){
-    process_command();
-    NEW_MSG = false;
+  receive_service();  // the packets received since the last pass (see ReceiveQueue.h)
+  CommandRecord rec;
+  if (next_command(rec)){
+    do {
+      process_command(rec);
+      command_processed(!rec.valid);
+    } while (next_command(rec));
+    ACK_PENDING = true;  // one acknowledgement for the whole batch
+  }
+
+  // Telemetry is sent periodically as the beacon of a TDMA frame (see TDMA.h) and also right after commands,
+  // because it carries their acknowledgement. That one has its own slot, otherwise it waits for the beacon.
+  // When the airtime budget is tight (see Airtime.h), plain telemetry and repeated acknowledgements wait,
+  // the beacons are then sent less often, but at least every TDMA_MAX_BEACON_GAP frames to keep the controller synchronised.
+  // While hopping (see Hopping.h), the beacons are always sent, the controller follows the channels by them.
+  // Until the airship has joined the fleet (see Fleet.h), it only sends join requests.
+  AirtimeClass trafficClass = (ACK_PENDING || NACK_PENDING) ? AIRTIME_COMMAND : (DUPLICATE_ACK_PENDING ? AIRTIME_BACKGROUND : AIRTIME_TELEMETRY);
+  bool budget = airtime_allowed(trafficClass, TDMA_MAX_PACKET);
+  if (!fleet_assigned()){
+    if (fleet_join_due() && airtime_allowed(AIRTIME_TELEMETRY, TDMA_MAX_PACKET)){
+      send_join_request();
+      LoRa.receive();
+    }
+  }else if (tdma_beacon_due() && (budget || tdma_beacon_overdue() || hop_active())){
+    send_measured_data(true);
     LoRa.receive();
-  }else if (abs(millis() - lastSendTime) > 700){
-    send_measured_data();
+  }else if ((ACK_PENDING || NACK_PENDING || DUPLICATE_ACK_PENDING) && tdma_ack_slot_open() && budget){
+    send_measured_data(false);
     LoRa.receive();
   }
+  link_service();  // switch the radio parameters if requested, or fall back if the controller is lost
+  capture_service();  // captured packets to the SD card
+  scheduler_service();  // statistics of the tasks
+  task_job_end(TASK_RADIO);
  
   threads.delay(100);
 }
 
 /**
  * Based on the measurements of the ultrasonic sensor and the pressure sensor, it determines the current height.
+ * It uses the readings last taken from the state bus (ultrasonic, barometer).
  * 
  * @return Current height [m]
 */
 double get_current_height(void) {
-  if (initial_height == 0) initial_height = altitude;
-  if (ultrasonic_distance != INVALID_VALUE){
+  if (initial_height == 0) initial_height = barometer.altitude;
+  if (ultrasonic.distance != INVALID_VALUE){
     ultrasonicDistanceIsValid = true;
-    double ultrasonic_distance_in_m = ((double)ultrasonic_distance)/1000; //converting mm to m
-    initial_height = altitude - ultrasonic_distance_in_m; // After each successful measurement of the ultrasonic sensor, the initial height is calibrated
+    double ultrasonic_distance_in_m = ((double)ultrasonic.distance)/1000; //converting mm to m
+    initial_height = barometer.altitude - ultrasonic_distance_in_m; // After each successful measurement of the ultrasonic sensor, the initial height is calibrated
     return ultrasonic_distance_in_m;
   }
   else{
     ultrasonicDistanceIsValid = false;
-    return altitude - initial_height;
+    return barometer.altitude - initial_height;
   }
 }
 
@@ -144,7 +193,7 @@ double get_current_height(void) {
  * @param lastUltrasonicDistanceWasValid Indicates whether the last ultrasonic measurement before the current one was valid.
 */
 void handle_validity_of_required_height(float old_height, bool lastUltrasonicDistanceWasValid){
-  if (USValidityRate <= 0.4 && !lastUltrasonicDistanceWasValid && ultrasonicDistanceIsValid && !DoNotMove && !LAND) {
+  if (ultrasonic.validityRate <= 0.4 && !lastUltrasonicDistanceWasValid && ultrasonicDistanceIsValid && !DoNotMove && !LAND) {
     float r;
     if (old_height >= REQ_HEIGHT){
       r = CURRENT_HEIGHT - abs(old_height - REQ_HEIGHT);
@@ -160,9 +209,9 @@ void handle_validity_of_required_height(float old_height, bool lastUltrasonicDis
       REQ_HEIGHT = 0.5;
     }else if(ultrasonicDistanceIsValid && CURRENT_HEIGHT < 1 && !(REQ_HEIGHT >= 0.04 && REQ_HEIGHT < 0.06)){
       REQ_HEIGHT = 0.05;
-    }else if(USValidityRate == 0 && (CURRENT_HEIGHT - REQ_HEIGHT) < 1){
+    }else if(ultrasonic.validityRate == 0 && (CURRENT_HEIGHT - REQ_HEIGHT) < 1){
       REQ_HEIGHT -= 1;
-    }else if(USValidityRate >= 0.85 && ultrasonicDistanceIsValid && CURRENT_HEIGHT < 0.1){
+    }else if(ultrasonic.validityRate >= 0.85 && ultrasonicDistanceIsValid && CURRENT_HEIGHT < 0.1){
       DoNotMove = true;
     }
   }
@@ -172,22 +221,26 @@ void handle_validity_of_required_height(float old_height, bool lastUltrasonicDis
  * Display measured values.
 */
 void display_values(void) {
+  HumiditySample humidity = {0, 0};
+  GPSData gps = {};
+  bus_read(TOPIC_HUMIDITY, &humidity, sizeof(humidity));
+  bus_read(TOPIC_GPS, &gps, sizeof(gps));
   Serial.println();
   Serial.print("CurrentHeight : "); Serial.println(CURRENT_HEIGHT);
   Serial.print("RequiredHeight: "); Serial.println(REQ_HEIGHT);
-  Serial.print("Ultrasonic : "); Serial.println(ultrasonic_distance);
-  Serial.print("Humidity : "); Serial.println(humidity);
-  Serial.print("Temperature : "); Serial.println(temperature_DHT22);
-  Serial.print("Pressure : "); Serial.println(pressure);
-  Serial.print("Altitude : "); Serial.println(altitude, 2);
-  Serial.print("Temperature_MPL3115A2 : "); Serial.println(temperature_MPL3115A2);
+  Serial.print("Ultrasonic : "); Serial.println(ultrasonic.distance);
+  Serial.print("Humidity : "); Serial.println(humidity.humidity);
+  Serial.print("Temperature : "); Serial.println(humidity.temperature);
+  Serial.print("Pressure : "); Serial.println(barometer.pressure);
+  Serial.print("Altitude : "); Serial.println(barometer.altitude, 2);
+  Serial.print("Temperature_MPL3115A2 : "); Serial.println(barometer.temperature);
   // Display GPS data
   Serial.println("------------- GPS Acquired data");
-  Serial.print("Altitude: "), Serial.println(altitudeGPS);
-  Serial.print("Speed: "), Serial.println(speed);
-  Serial.print("latitude: "), Serial.println(latitude, 6);
-  Serial.print("longitude: "), Serial.println(longitude, 6);
-  Serial.print("Time: "), Serial.println(tm);
+  Serial.print("Altitude: "), Serial.println(gps.altitude);
+  Serial.print("Speed: "), Serial.println(gps.ss);
+  Serial.print("latitude: "), Serial.println(gps.flat, 6);
+  Serial.print("longitude: "), Serial.println(gps.flon, 6);
+  Serial.print("Time: "), Serial.println(gps.time);
   Serial.println("-------------");
   Serial.println();
 }
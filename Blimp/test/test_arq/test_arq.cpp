@@ -0,0 +1,188 @@
+/*
+Receiving side of the selective-repeat ARQ (see ARQ.h): the commands are processed in order whatever order they
+arrive in, retransmissions of processed commands are recognised as duplicates within ARQ_DUPLICATE_WINDOW, also
+across the wrap of the 16-bit sequence numbers, and the acknowledgement reports the window. Then the commands
+of a controller that keeps ARQ_WINDOW in flight arrive over a channel that loses, duplicates and reorders them,
+and every one must be processed exactly once and in order.
+Run: pio test -e native -f test_arq
+*/
+#include <unity.h>
+#include "ARQ.h"
+
+#define CHANNEL_COMMANDS 20000
+
+uint32_t channelState = 521288629UL;
+
+// Deterministic uniform numbers in <0, 1)
+double channel_random(void) {
+  channelState ^= channelState << 13;
+  channelState ^= channelState >> 17;
+  channelState ^= channelState << 5;
+  return channelState / 4294967296.0;
+}
+
+CommandRecord record(uint16_t seq, int32_t value = 0) {
+  CommandRecord rec;
+  rec.seq = seq;
+  rec.cmdID = 0xF0;
+  rec.value = value;
+  rec.valid = true;
+  return rec;
+}
+
+/**
+ * Processes the commands that are ready, as the main loop does.
+ *
+ * @return Number of the processed commands.
+ */
+unsigned int process_ready(int32_t *values = NULL) {
+  unsigned int n = 0;
+  CommandRecord rec;
+  while (next_command(rec)) {
+    if (values != NULL) values[n] = rec.value;
+    command_processed(rec.value < 0);
+    n++;
+  }
+  return n;
+}
+
+struct Ack {
+  unsigned char flags, held, refused;
+  uint16_t nextExpected;
+};
+
+Ack read_ack(bool resend = false) {
+  unsigned char data[ARQ_ACK_SIZE];
+  PacketWriter writer(data, sizeof(data));
+  write_command_ack(writer, resend);
+  TEST_ASSERT_EQUAL_UINT(ARQ_ACK_SIZE, writer.length());
+  Ack ack;
+  int16_t next;
+  PacketReader reader(data, sizeof(data));
+  reader.read_byte(ack.flags), reader.read_int16(next), reader.read_byte(ack.held), reader.read_byte(ack.refused);
+  ack.nextExpected = next;
+  return ack;
+}
+
+/**
+ * Starts a new session of the controller at the given sequence number.
+ */
+void start_session(uint16_t seq) {
+  TEST_ASSERT_EQUAL(COMMAND_NEW, accept_command(record(seq)));
+  TEST_ASSERT_EQUAL_UINT(1, process_ready());
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void test_out_of_order_commands_are_processed_in_order(void) {
+  start_session(100);
+  TEST_ASSERT_EQUAL(COMMAND_NEW, accept_command(record(103, 3)));
+  TEST_ASSERT_EQUAL(COMMAND_NEW, accept_command(record(102, 2)));
+  TEST_ASSERT_EQUAL_UINT(0, process_ready());
+  Ack ack = read_ack();
+  TEST_ASSERT_EQUAL_HEX8(ARQ_ACK_SESSION, ack.flags);
+  TEST_ASSERT_EQUAL_UINT16(101, ack.nextExpected);
+  TEST_ASSERT_EQUAL_HEX8(0x06, ack.held);  // 102 and 103
+  TEST_ASSERT_EQUAL(COMMAND_PENDING, accept_command(record(103, 3)));
+
+  TEST_ASSERT_EQUAL(COMMAND_NEW, accept_command(record(101, 1)));
+  int32_t values[ARQ_WINDOW];
+  TEST_ASSERT_EQUAL_UINT(3, process_ready(values));
+  TEST_ASSERT_EQUAL_INT32(1, values[0]);
+  TEST_ASSERT_EQUAL_INT32(2, values[1]);
+  TEST_ASSERT_EQUAL_INT32(3, values[2]);
+  ack = read_ack(true);
+  TEST_ASSERT_EQUAL_HEX8(ARQ_ACK_SESSION | ARQ_ACK_RESEND, ack.flags);
+  TEST_ASSERT_EQUAL_UINT16(104, ack.nextExpected);
+  TEST_ASSERT_EQUAL_HEX8(0, ack.held);
+}
+
+void test_refused_commands_are_reported(void) {
+  start_session(500);
+  accept_command(record(501, -1));  // refused by process_ready()
+  accept_command(record(502, 1));
+  process_ready();
+  TEST_ASSERT_EQUAL_HEX8(0x02, read_ack().refused);  // bit i = next expected - 1 - i
+}
+
+void test_duplicate_window(void) {
+  start_session(1000);
+  for (uint16_t seq = 1001; seq < 1000 + ARQ_DUPLICATE_WINDOW + 10; seq++) {
+    accept_command(record(seq));
+    process_ready();
+  }
+  uint16_t next = read_ack().nextExpected;
+  TEST_ASSERT_EQUAL(COMMAND_DUPLICATE, accept_command(record(next - 1)));
+  TEST_ASSERT_EQUAL(COMMAND_DUPLICATE, accept_command(record(next - ARQ_DUPLICATE_WINDOW)));
+  TEST_ASSERT_EQUAL_UINT16(next, read_ack().nextExpected);
+
+  // Older, or beyond the window: the controller was restarted, the window follows it
+  TEST_ASSERT_EQUAL(COMMAND_NEW, accept_command(record(next - ARQ_DUPLICATE_WINDOW - 1)));
+  TEST_ASSERT_EQUAL_UINT16(next - ARQ_DUPLICATE_WINDOW - 1, read_ack().nextExpected);
+  process_ready();
+  TEST_ASSERT_EQUAL(COMMAND_NEW, accept_command(record(30000)));
+  TEST_ASSERT_EQUAL_UINT16(30000, read_ack().nextExpected);
+  process_ready();
+}
+
+void test_sequence_numbers_wrap(void) {
+  start_session(0xFFFD);
+  TEST_ASSERT_EQUAL(COMMAND_NEW, accept_command(record(0x0000, 2)));
+  TEST_ASSERT_EQUAL(COMMAND_NEW, accept_command(record(0xFFFE, 0)));
+  TEST_ASSERT_EQUAL_HEX8(0x05, read_ack().held);  // 0xFFFE and 0x0000
+  TEST_ASSERT_EQUAL(COMMAND_NEW, accept_command(record(0xFFFF, 1)));
+  int32_t values[ARQ_WINDOW];
+  TEST_ASSERT_EQUAL_UINT(3, process_ready(values));
+  TEST_ASSERT_EQUAL_INT32(0, values[0]);
+  TEST_ASSERT_EQUAL_INT32(2, values[2]);
+  TEST_ASSERT_EQUAL_UINT16(1, read_ack().nextExpected);
+  TEST_ASSERT_EQUAL(COMMAND_DUPLICATE, accept_command(record(0xFFFF)));
+  TEST_ASSERT_EQUAL(COMMAND_DUPLICATE, accept_command(record(0xFFFD)));
+}
+
+void test_lossy_reordering_channel(void) {
+  // The controller keeps ARQ_WINDOW commands in flight and sends each of the unacknowledged ones with probability 1/2
+  // in every round (loss and timeouts), in a random order; the sequence numbers wrap several times
+  uint16_t base = 0xFF00;
+  start_session(base - 1);
+  unsigned long processed = 0, duplicates = 0, rounds = 0;
+  int32_t values[ARQ_WINDOW];
+  while (processed < CHANNEL_COMMANDS) {
+    uint16_t next = read_ack().nextExpected;
+    TEST_ASSERT_EQUAL_UINT16((uint16_t)(base + processed), next);
+    unsigned int order[ARQ_WINDOW];
+    for (unsigned int i = 0; i < ARQ_WINDOW; i++) order[i] = i;
+    for (unsigned int i = ARQ_WINDOW - 1; i > 0; i--) {
+      unsigned int j = channel_random() * (i + 1), swap = order[i];
+      order[i] = order[j], order[j] = swap;
+    }
+    for (unsigned int i = 0; i < ARQ_WINDOW; i++) {
+      if (channel_random() < 0.5) continue;
+      uint16_t seq = next + order[i];
+      if (processed + order[i] >= CHANNEL_COMMANDS) continue;
+      if (accept_command(record(seq, processed + order[i])) != COMMAND_NEW) duplicates++;
+    }
+    if (channel_random() < 0.3) {  // a retransmission of a command that was already processed
+      TEST_ASSERT_EQUAL(COMMAND_DUPLICATE, accept_command(record(next - 1 - (unsigned int)(channel_random() * 8))));
+    }
+    unsigned int n = process_ready(values);
+    for (unsigned int i = 0; i < n; i++) TEST_ASSERT_EQUAL_INT32(processed + i, values[i]);
+    processed += n;
+    rounds++;
+  }
+  TEST_ASSERT_GREATER_THAN_UINT32(0, duplicates);
+  TEST_ASSERT_LESS_THAN_UINT32(CHANNEL_COMMANDS, rounds);
+}
+
+int main(int argc, char **argv) {
+  nativeSerialOutput = false;
+  UNITY_BEGIN();
+  RUN_TEST(test_out_of_order_commands_are_processed_in_order);
+  RUN_TEST(test_refused_commands_are_reported);
+  RUN_TEST(test_duplicate_window);
+  RUN_TEST(test_sequence_numbers_wrap);
+  RUN_TEST(test_lossy_reordering_channel);
+  return UNITY_END();
+}
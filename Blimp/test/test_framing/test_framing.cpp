@@ -0,0 +1,182 @@
+/*
+Framing (see Framing.h), the same on the controller. The CRC is checked against the published check value,
+every single flipped bit of a frame is corrected and every double one detected. Then frames of a command packet
+are sent over a channel that flips each bit with a given probability, and the test prints and checks the residual
+error rate (frames accepted with a wrong content) and the retransmission rate (frames discarded) with and without
+the FEC. Without the FEC every damaged frame is retransmitted; with it only the frames with two or more errors are.
+Run: pio test -e native -f test_framing -v
+*/
+#include <unity.h>
+#include "Framing.h"
+
+#define CHANNEL_FRAMES 200000
+#define COMMAND_PACKET_SIZE 17      // recipient, sender, count and two commands with a value
+
+uint32_t channelState = 2463534242UL;
+
+// Deterministic uniform numbers in <0, 1)
+double channel_random(void) {
+  channelState ^= channelState << 13;
+  channelState ^= channelState >> 17;
+  channelState ^= channelState << 5;
+  return channelState / 4294967296.0;
+}
+
+/**
+ * Builds a framed packet of the given size with a varying content.
+ *
+ * @return Length of the frame.
+ */
+unsigned int build_frame(unsigned char *data, unsigned int size, unsigned char seed) {
+  PacketWriter writer(data, PACKET_CAPACITY);
+  for (unsigned int i = 0; i < size; i++) writer.put_byte((unsigned char)(seed + i * 37));
+  append_frame_check(writer);
+  return writer.length();
+}
+
+void flip(PacketBuffer &packet, unsigned int bit) {
+  packet.data[bit / 8] ^= 1 << (bit % 8);
+}
+
+struct ChannelResult {
+  unsigned long damaged;        // frames with at least one flipped bit
+  unsigned long corrected;
+  unsigned long retransmitted;  // FRAME_CORRUPTED
+  unsigned long residual;       // accepted with a content different from the sent one
+};
+
+/**
+ * Sends CHANNEL_FRAMES frames over a binary symmetric channel.
+ *
+ * @param bitErrorRate Probability of a flip of each bit.
+ */
+ChannelResult run_channel(double bitErrorRate) {
+  ChannelResult result = {0, 0, 0, 0};
+  unsigned char sent[PACKET_CAPACITY];
+  for (unsigned long n = 0; n < CHANNEL_FRAMES; n++) {
+    unsigned int length = build_frame(sent, COMMAND_PACKET_SIZE, (unsigned char)n);
+    PacketBuffer packet;
+    memcpy(packet.data, sent, length);
+    packet.length = length;
+    bool damaged = false;
+    for (unsigned int bit = 0; bit < length * 8; bit++) {
+      if (channel_random() < bitErrorRate) flip(packet, bit), damaged = true;
+    }
+    if (damaged) result.damaged++;
+    FrameStatus status = check_frame(packet);
+    if (status == FRAME_CORRUPTED) {
+      result.retransmitted++;
+    } else {
+      if (status == FRAME_CORRECTED) result.corrected++;
+      if (packet.length != COMMAND_PACKET_SIZE || memcmp(packet.data, sent, COMMAND_PACKET_SIZE) != 0) result.residual++;
+    }
+  }
+  return result;
+}
+
+void print_result(const char *name, double bitErrorRate, const ChannelResult &r) {
+  printf("%s, BER %.0e: damaged %.4f, corrected %.4f, retransmitted %.4f, residual %.2e\n", name, bitErrorRate,
+         (double)r.damaged / CHANNEL_FRAMES, (double)r.corrected / CHANNEL_FRAMES,
+         (double)r.retransmitted / CHANNEL_FRAMES, (double)r.residual / CHANNEL_FRAMES);
+}
+
+void setUp(void) {
+  FRAME_FEC = true;
+}
+
+void tearDown(void) {
+  FRAME_FEC = true;
+}
+
+void test_crc_check_value(void) {
+  TEST_ASSERT_EQUAL_HEX16(0x29B1, crc16((const unsigned char *)"123456789", 9));  // CRC-16/CCITT-FALSE
+}
+
+void test_intact_frame_is_accepted(void) {
+  PacketBuffer packet;
+  packet.length = build_frame(packet.data, COMMAND_PACKET_SIZE, 1);
+  TEST_ASSERT_EQUAL_UINT(COMMAND_PACKET_SIZE + CRC_SIZE + FEC_SIZE, packet.length);
+  TEST_ASSERT_EQUAL(FRAME_OK, check_frame(packet));
+  TEST_ASSERT_EQUAL_UINT(COMMAND_PACKET_SIZE, packet.length);
+}
+
+void test_every_single_bit_error_is_corrected(void) {
+  unsigned char sent[PACKET_CAPACITY];
+  unsigned int length = build_frame(sent, COMMAND_PACKET_SIZE, 2);
+  for (unsigned int bit = 0; bit < length * 8; bit++) {
+    PacketBuffer packet;
+    memcpy(packet.data, sent, length);
+    packet.length = length;
+    flip(packet, bit);
+    FrameStatus status = check_frame(packet);
+    // A flip in the FEC word leaves the packet and its CRC intact
+    TEST_ASSERT_EQUAL(bit < (length - FEC_SIZE) * 8 ? FRAME_CORRECTED : FRAME_OK, status);
+    TEST_ASSERT_EQUAL_UINT(COMMAND_PACKET_SIZE, packet.length);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(sent, packet.data, COMMAND_PACKET_SIZE);
+  }
+}
+
+void test_every_double_bit_error_is_detected(void) {
+  unsigned char sent[PACKET_CAPACITY];
+  unsigned int length = build_frame(sent, COMMAND_PACKET_SIZE, 3);
+  unsigned int protectedBits = (length - FEC_SIZE) * 8;
+  for (unsigned int a = 0; a < protectedBits; a++) {
+    for (unsigned int b = a + 1; b < protectedBits; b++) {
+      PacketBuffer packet;
+      memcpy(packet.data, sent, length);
+      packet.length = length;
+      flip(packet, a);
+      flip(packet, b);
+      TEST_ASSERT_EQUAL(FRAME_CORRUPTED, check_frame(packet));
+    }
+  }
+}
+
+void test_full_packet_single_bit_error_is_corrected(void) {
+  // The Hamming positions must reach the last bit of the CRC of the longest packet
+  unsigned char sent[PACKET_CAPACITY];
+  unsigned int length = build_frame(sent, PACKET_CAPACITY - CRC_SIZE - FEC_SIZE, 4);
+  TEST_ASSERT_EQUAL_UINT(PACKET_CAPACITY, length);
+  PacketBuffer packet;
+  memcpy(packet.data, sent, length);
+  packet.length = length;
+  flip(packet, (length - FEC_SIZE) * 8 - 1);
+  TEST_ASSERT_EQUAL(FRAME_CORRECTED, check_frame(packet));
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(sent, packet.data, PACKET_CAPACITY - CRC_SIZE - FEC_SIZE);
+}
+
+void test_noisy_channel_rates(void) {
+  const double rates[] = {1e-4, 1e-3, 1e-2};
+  for (unsigned int i = 0; i < sizeof(rates) / sizeof(rates[0]); i++) {
+    double p = rates[i];
+    FRAME_FEC = false;
+    ChannelResult crcOnly = run_channel(p);
+    FRAME_FEC = true;
+    ChannelResult fec = run_channel(p);
+    print_result("CRC only", p, crcOnly);
+    print_result("CRC + FEC", p, fec);
+
+    // Without the FEC, every damaged frame is retransmitted
+    TEST_ASSERT_EQUAL_UINT32(crcOnly.damaged, crcOnly.retransmitted);
+    // With it, a frame is kept if its packet and CRC are intact, or have one error and the FEC word is intact
+    double bits = (COMMAND_PACKET_SIZE + CRC_SIZE) * 8;
+    double expected = 1 - pow(1 - p, bits) - bits * p * pow(1 - p, bits - 1 + FEC_SIZE * 8);
+    double measured = (double)fec.retransmitted / CHANNEL_FRAMES;
+    TEST_ASSERT_DOUBLE_WITHIN(5 * sqrt(expected / CHANNEL_FRAMES) + 1e-5, expected, measured);
+    TEST_ASSERT_TRUE(fec.retransmitted < crcOnly.retransmitted);
+    // No wrong frame may pass; three or more errors could fool the CRC with a probability of about 2^-16
+    TEST_ASSERT_EQUAL_UINT32(0, crcOnly.residual);
+    TEST_ASSERT_LESS_OR_EQUAL_DOUBLE(1e-4, (double)fec.residual / CHANNEL_FRAMES);
+  }
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_crc_check_value);
+  RUN_TEST(test_intact_frame_is_accepted);
+  RUN_TEST(test_every_single_bit_error_is_corrected);
+  RUN_TEST(test_every_double_bit_error_is_detected);
+  RUN_TEST(test_full_packet_single_bit_error_is_corrected);
+  RUN_TEST(test_noisy_channel_rates);
+  return UNITY_END();
+}
@@ -0,0 +1,129 @@
+/*
+The radio path of the airship must not use the heap (see PacketBuffer.h). The global operator new is replaced by one
+that counts the allocations; the Arduino String allocates through it in the native build, as it does with malloc()
+on the Teensy. A packet of commands goes through the receive interrupt, the receive queue, the parsing, the processing
+of the commands and the telemetry with their acknowledgement, and the count must stay zero.
+Run: pio test -e native -f test_packet_io
+*/
+#include <unity.h>
+#include <new>
+#include "Communication.h"
+
+unsigned long allocations = 0;
+bool countAllocations = false;
+
+void *operator new(size_t size) {
+  if (countAllocations) allocations++;
+  void *p = malloc(size ? size : 1);
+  if (p == NULL) throw std::bad_alloc();
+  return p;
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t size) noexcept { (void)size, free(p); }
+void operator delete[](void *p, size_t size) noexcept { (void)size, free(p); }
+
+uint16_t nextSeq = 1;
+
+/**
+ * Builds a packet of the controller with the given commands, as send_command() of the controller does.
+ */
+unsigned int build_commands(unsigned char *data, const unsigned char *ids, const int32_t *values, unsigned int count) {
+  PacketWriter writer(data, PACKET_CAPACITY);
+  writer.put_byte(localAddress);
+  writer.put_byte(destinationAddress);
+  writer.put_byte(count);
+  for (unsigned int i = 0; i < count; i++) {
+    writer.put_int16((int16_t)nextSeq++);
+    writer.put_byte(ids[i]);
+    if (command_has_value(ids[i])) writer.put_int32(values[i]);
+  }
+  append_frame_check(writer);
+  return writer.length();
+}
+
+// One pass of the radio part of loop(): the received packets, their commands and the acknowledgement
+void radio_pass(void) {
+  receive_service();
+  CommandRecord rec;
+  if (next_command(rec)) {
+    do {
+      process_command(rec);
+      command_processed(!rec.valid);
+    } while (next_command(rec));
+    ACK_PENDING = true;
+  }
+  if (ACK_PENDING || NACK_PENDING) send_measured_data(false);
+}
+
+void setUp(void) {
+  allocations = 0;
+  countAllocations = true;
+}
+
+void tearDown(void) {
+  countAllocations = false;
+}
+
+void test_commands_are_received_and_acknowledged_without_the_heap(void) {
+  const unsigned char ids[] = {all_ids.UP, all_ids.SET_EXACT_HEIGHT, all_ids.CONTROL_SETPOINT, all_ids.SAY_HI};
+  const int32_t values[] = {0, 250, -30 * 256 + 120, 0};
+  unsigned char data[PACKET_CAPACITY];
+  unsigned int length = build_commands(data, ids, values, 4);
+  unsigned long sent = LoRa.sentCount;
+  LoRa.inject(data, length);
+  radio_pass();
+  TEST_ASSERT_EQUAL_UINT(0, allocations);
+  TEST_ASSERT_EQUAL_INT(250, RECEIVED_REQ_HEIGHT);
+  TEST_ASSERT_EQUAL_UINT(sent + 1, LoRa.sentCount);  // the acknowledgement
+}
+
+void test_corrected_and_corrupted_frames_without_the_heap(void) {
+  const unsigned char ids[] = {all_ids.DOWN};
+  const int32_t values[] = {0};
+  unsigned char data[PACKET_CAPACITY];
+  unsigned int length = build_commands(data, ids, values, 1);
+  data[3] ^= 0x10;  // one bit, the FEC corrects it
+  LoRa.inject(data, length);
+  radio_pass();
+  length = build_commands(data, ids, values, 1);
+  data[3] ^= 0x11;  // two bits, the frame is dropped and a retransmission requested
+  LoRa.inject(data, length);
+  radio_pass();
+  TEST_ASSERT_EQUAL_UINT(0, allocations);
+}
+
+void test_telemetry_is_sent_without_the_heap(void) {
+  unsigned long sent = LoRa.sentCount;
+  for (unsigned int i = 0; i < 20; i++) {  // keyframes and delta frames
+    nativeMicros += 700000;
+    send_measured_data(true);
+  }
+  TEST_ASSERT_EQUAL_UINT(0, allocations);
+  TEST_ASSERT_EQUAL_UINT(sent + 20, LoRa.sentCount);
+
+  PacketBuffer packet;
+  memcpy(packet.data, LoRa.lastSent, LoRa.lastSentLength);
+  packet.length = LoRa.lastSentLength;
+  TEST_ASSERT_EQUAL(FRAME_OK, check_frame(packet));
+}
+
+void test_the_counter_sees_string(void) {
+  String text("a");
+  text += String(123456789L) + " and a longer tail that does not fit into any small buffer";
+  TEST_ASSERT_GREATER_THAN(0, allocations);
+}
+
+int main(int argc, char **argv) {
+  nativeSerialOutput = false;
+  localAddress = FLEET_FIRST_ADDRESS;  // joined the fleet
+  LoRa.onReceive(onReceive);
+  UNITY_BEGIN();
+  RUN_TEST(test_the_counter_sees_string);
+  RUN_TEST(test_commands_are_received_and_acknowledged_without_the_heap);
+  RUN_TEST(test_corrected_and_corrupted_frames_without_the_heap);
+  RUN_TEST(test_telemetry_is_sent_without_the_heap);
+  return UNITY_END();
+}
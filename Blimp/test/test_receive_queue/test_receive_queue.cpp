@@ -0,0 +1,149 @@
+/*
+Queue of received packets (see ReceiveQueue.h), the same on the controller. A host thread plays the interrupt of
+the radio and pushes packets as fast as the queue takes them, far above the line rate of the radio, with bursts
+that overflow it, while the main thread takes them as receive_service() does. Every packet carries its number and a content derived from it, so a packet that is
+lost without being counted, taken twice, taken out of order or read while it is being written makes the test fail.
+The free-running indices are also checked across their wrap, and the overflow counter against a full queue.
+Run: pio test -e native -f test_receive_queue -v
+*/
+#include <unity.h>
+#include <atomic>
+#include <thread>
+#include "ReceiveQueue.h"
+#include "Communication.h"
+
+#define STRESS_PACKETS 200000UL
+#define STRESS_BURST_PERIOD 1000    // every this many packets come
+#define STRESS_BURST 20             // this many without waiting for a free slot
+
+extern volatile unsigned int receiveQueueHead;
+extern volatile unsigned int receiveQueueTail;
+
+std::atomic<bool> producerDone;
+
+/**
+ * Builds packet number n: its number and then bytes derived from it, of a length that depends on it.
+ */
+unsigned int build_packet(unsigned char *data, uint32_t n) {
+  unsigned int length = 5 + n % (PACKET_CAPACITY - 4);
+  memcpy(data, &n, sizeof(n));
+  for (unsigned int i = sizeof(n); i < length; i++) data[i] = (unsigned char)(n * 31 + i);
+  return length;
+}
+
+void push(uint32_t n) {
+  unsigned char data[PACKET_CAPACITY];
+  LoRa.inject(data, build_packet(data, n));  // calls onReceive() and so receive_queue_push()
+}
+
+/**
+ * Checks a taken packet against its number and returns the number.
+ */
+uint32_t check_packet(const PacketBuffer &packet) {
+  uint32_t n;
+  memcpy(&n, packet.data, sizeof(n));
+  unsigned char expected[PACKET_CAPACITY];
+  unsigned int length = build_packet(expected, n);
+  TEST_ASSERT_EQUAL_UINT(length, packet.length);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, packet.data, length);
+  return n;
+}
+
+void reset_queue(unsigned int index) {
+  receiveQueueHead = index;
+  receiveQueueTail = index;
+  memset((void *)&receiveStatistics, 0, sizeof(receiveStatistics));
+}
+
+void setUp(void) {
+  reset_queue(0);
+}
+
+void tearDown(void) {}
+
+void test_overflow_is_counted(void) {
+  for (uint32_t n = 0; n < RECEIVE_QUEUE_SIZE + 3; n++) push(n);
+  TEST_ASSERT_EQUAL_UINT32(RECEIVE_QUEUE_SIZE + 3, receiveStatistics.packets);
+  TEST_ASSERT_EQUAL_UINT32(3, receiveStatistics.overflows);
+  TEST_ASSERT_EQUAL_UINT(RECEIVE_QUEUE_SIZE, receiveStatistics.highWater);
+  PacketBuffer packet;
+  for (uint32_t n = 0; n < RECEIVE_QUEUE_SIZE; n++) {
+    TEST_ASSERT_TRUE(receive_queue_pop(packet));
+    TEST_ASSERT_EQUAL_UINT32(n, check_packet(packet));  // the oldest packets are kept
+  }
+  TEST_ASSERT_FALSE(receive_queue_pop(packet));
+  TEST_ASSERT_EQUAL_UINT32(RECEIVE_QUEUE_SIZE, receiveStatistics.processed);
+}
+
+void test_oversized_packet_is_dropped(void) {
+  LoRa.inject((const uint8_t *)"", 0);
+  onReceive(PACKET_CAPACITY + 1);
+  PacketBuffer packet;
+  TEST_ASSERT_FALSE(receive_queue_pop(packet));
+}
+
+void test_indices_wrap(void) {
+  reset_queue(0xFFFFFFFFu - RECEIVE_QUEUE_SIZE / 2);
+  PacketBuffer packet;
+  for (uint32_t n = 0; n < 4 * RECEIVE_QUEUE_SIZE; n++) {
+    push(n);
+    push(n + 1000);
+    TEST_ASSERT_TRUE(receive_queue_pop(packet));
+    TEST_ASSERT_TRUE(receive_queue_pop(packet));
+    TEST_ASSERT_EQUAL_UINT32(n + 1000, check_packet(packet));
+    TEST_ASSERT_FALSE(receive_queue_pop(packet));
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, receiveStatistics.overflows);
+}
+
+void test_line_rate_producer_and_consumer(void) {
+  producerDone = false;
+  std::thread producer([] {
+    for (uint32_t n = 0; n < STRESS_PACKETS; n++) {
+      // The radio does not wait for the main loop, but a queue that is always full tests only the overflow:
+      // the packets wait for a free slot, except a burst now and then
+      while (n % STRESS_BURST_PERIOD >= STRESS_BURST && receiveQueueHead - receiveQueueTail >= RECEIVE_QUEUE_SIZE) std::this_thread::yield();
+      push(n);
+    }
+    producerDone = true;
+  });
+
+  unsigned long taken = 0;
+  uint32_t last = 0;
+  bool first = true;
+  PacketBuffer packet;
+  while (true) {
+    bool done = producerDone;  // read before the last attempt, so that nothing published before it is missed
+    if (receive_queue_pop(packet)) {
+      uint32_t n = check_packet(packet);
+      TEST_ASSERT_TRUE(first || n > last);  // in order and only once
+      first = false;
+      last = n;
+      taken++;
+    } else if (done) {
+      break;
+    } else {
+      std::this_thread::yield();
+    }
+  }
+  producer.join();
+
+  printf("%lu packets pushed, %lu taken, %lu dropped by a full queue, %u of %u slots used at most\n",
+         (unsigned long)receiveStatistics.packets, taken, (unsigned long)receiveStatistics.overflows,
+         receiveStatistics.highWater, RECEIVE_QUEUE_SIZE);
+  TEST_ASSERT_EQUAL_UINT32(STRESS_PACKETS, receiveStatistics.packets);
+  TEST_ASSERT_EQUAL_UINT32(taken, receiveStatistics.processed);
+  TEST_ASSERT_EQUAL_UINT32(STRESS_PACKETS, taken + receiveStatistics.overflows);  // every packet is taken or counted
+  TEST_ASSERT_GREATER_THAN_UINT32(STRESS_PACKETS / 2, taken);
+}
+
+int main(int argc, char **argv) {
+  nativeSerialOutput = false;
+  LoRa.onReceive(onReceive);
+  UNITY_BEGIN();
+  RUN_TEST(test_overflow_is_counted);
+  RUN_TEST(test_oversized_packet_is_dropped);
+  RUN_TEST(test_indices_wrap);
+  RUN_TEST(test_line_rate_producer_and_consumer);
+  return UNITY_END();
+}
@@ -0,0 +1,60 @@
+/*
+Sleeping of the height control between its jobs (see Scheduler.h). The host threads keep their states, and the
+release by heightTimer is played where it can really come: before the wait, or inside threads.suspend(), where
+setState() of TeensyThreads turns the interrupts on before it writes the new state. After every release the thread
+must be running again, otherwise the height control stops for good.
+Run: pio test -e native -f test_scheduler
+*/
+#include <unity.h>
+#include "Scheduler.h"
+
+#define JOBS 1000
+
+void height_thread(void) {}
+
+// heightTimer fires inside the suspension
+void release_height(void) {
+  task_release(TASK_HEIGHT);
+}
+
+void setUp(void) {
+  task_create(TASK_HEIGHT, height_thread);
+  threads.onSuspend = NULL;
+}
+
+void tearDown(void) {
+  threads.onSuspend = NULL;
+}
+
+void test_release_before_the_wait(void) {
+  task_release(TASK_HEIGHT);
+  task_wait_release(TASK_HEIGHT);  // returns at once, without suspending
+  TEST_ASSERT_EQUAL_INT(Threads::RUNNING, threads.getState(tasks[TASK_HEIGHT].thread));
+  task_job_start(TASK_HEIGHT);
+  task_job_end(TASK_HEIGHT);
+}
+
+void test_release_during_the_suspension(void) {
+  Task &task = tasks[TASK_HEIGHT];
+  unsigned long jobs = task.jobs;
+  unsigned long overruns = task.overruns;
+  threads.onSuspend = release_height;
+  for (unsigned int i = 0; i < JOBS; i++) {
+    task_wait_release(TASK_HEIGHT);
+    TEST_ASSERT_EQUAL_INT(Threads::RUNNING, threads.getState(task.thread));  // the restart was not lost
+    TEST_ASSERT_FALSE(task.sleeping);
+    task_job_start(TASK_HEIGHT);
+    nativeMicros += 300;
+    task_job_end(TASK_HEIGHT);
+  }
+  TEST_ASSERT_EQUAL_UINT32(jobs + JOBS, task.jobs);
+  TEST_ASSERT_EQUAL_UINT32(overruns, task.overruns);
+}
+
+int main(int argc, char **argv) {
+  nativeSerialOutput = false;
+  UNITY_BEGIN();
+  RUN_TEST(test_release_before_the_wait);
+  RUN_TEST(test_release_during_the_suspension);
+  return UNITY_END();
+}
@@ -0,0 +1,114 @@
+/*
+Telemetry frame of the airship (see Telemetry.h): the fixed-point conversions, the size and the byte layout
+of a keyframe and the delta frames. The controller decodes the same bytes in its test_telemetry,
+so the two tests together check the round trip through the radio.
+Run: pio test -e native -f test_telemetry
+*/
+#include <unity.h>
+#include "Telemetry.h"
+#include "StateBus.h"
+#include "US_100.h"
+#include <TestVectors.h>
+
+// The frame of the controller's test_telemetry, its keyframe with seq 7 is GOLDEN_KEYFRAME
+const TelemetryFrame GOLDEN_FRAME = {1234, 1500, -20, 2150, TELEMETRY_INVALID_16, 120, 31245, 101325, 1234, 500755381, 144378064};
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_fixed_16_rounds_and_saturates(void) {
+  TEST_ASSERT_EQUAL_INT16(1234, to_fixed_16(12.344, 100));
+  TEST_ASSERT_EQUAL_INT16(1235, to_fixed_16(12.346, 100));
+  TEST_ASSERT_EQUAL_INT16(-20, to_fixed_16(-0.2, 100));
+  TEST_ASSERT_EQUAL_INT16(INT16_MAX, to_fixed_16(1000, 100));
+  TEST_ASSERT_EQUAL_INT16(INT16_MIN + 1, to_fixed_16(-1000, 100));  // never TELEMETRY_INVALID_16
+  TEST_ASSERT_EQUAL_INT16(0, to_fixed_16(NAN, 100));
+}
+
+void test_fixed_32_keeps_gps_precision(void) {
+  TEST_ASSERT_EQUAL_INT32(500755381, to_fixed_32(50.0755381, 1e7));
+  TEST_ASSERT_EQUAL_INT32(-144378064, to_fixed_32(-14.4378064, 1e7));
+  TEST_ASSERT_EQUAL_INT32(101325, to_fixed_32(101325.4, 1));
+  TEST_ASSERT_EQUAL_INT32(INT32_MAX, to_fixed_32(1e3, 1e7));
+}
+
+void test_keyframe_size_and_layout(void) {
+  unsigned char data[PACKET_CAPACITY];
+  PacketWriter writer(data, sizeof(data));
+  TEST_ASSERT_TRUE(encode_telemetry_frame(GOLDEN_FRAME, 7, writer));
+  TEST_ASSERT_EQUAL_UINT(TELEMETRY_FRAME_SIZE, writer.length());
+  TEST_ASSERT_EQUAL_UINT(TELEMETRY_FRAME_SIZE, sizeof(GOLDEN_KEYFRAME));
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(GOLDEN_KEYFRAME, data, TELEMETRY_FRAME_SIZE);
+}
+
+void test_keyframe_does_not_fit(void) {
+  unsigned char data[TELEMETRY_FRAME_SIZE - 1];
+  PacketWriter writer(data, sizeof(data));
+  TEST_ASSERT_FALSE(encode_telemetry_frame(GOLDEN_FRAME, 7, writer));
+}
+
+void test_delta_frame_layout(void) {
+  int32_t reference[TELEMETRY_FIELD_COUNT], fields[TELEMETRY_FIELD_COUNT];
+  frame_to_fields(GOLDEN_FRAME, reference);
+  frame_to_fields(GOLDEN_FRAME, fields);
+  fields[0] += 3;     // height +3 cm -> zig-zag 6
+  fields[7] -= 70;    // pressure -70 Pa -> zig-zag 139, two varint bytes
+  unsigned char data[PACKET_CAPACITY];
+  PacketWriter writer(data, sizeof(data));
+  TEST_ASSERT_TRUE(encode_delta_frame(fields, reference, (1 << 0) | (1 << 7), 9, 7, writer));
+  const unsigned char expected[] = {TELEMETRY_DELTA_FRAME, 9, 7, 0x81, 0x00, 6, 0x8B, 0x01};
+  TEST_ASSERT_EQUAL_UINT(sizeof(expected), writer.length());
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, data, sizeof(expected));
+}
+
+void test_delta_of_extremes_wraps(void) {
+  int32_t reference[TELEMETRY_FIELD_COUNT] = {0}, fields[TELEMETRY_FIELD_COUNT] = {0};
+  reference[9] = INT32_MIN;
+  fields[9] = INT32_MAX;
+  unsigned char data[TELEMETRY_MAX_FRAME_SIZE];
+  PacketWriter writer(data, sizeof(data));
+  TEST_ASSERT_TRUE(encode_delta_frame(fields, reference, 1 << 9, 1, 0, writer));
+  TEST_ASSERT_EQUAL_UINT(5 + 1, writer.length());  // the difference wraps to -1, one varint byte
+  TEST_ASSERT_EQUAL_HEX8(zigzag_encode(-1), data[5]);
+}
+
+void test_zigzag(void) {
+  TEST_ASSERT_EQUAL_UINT32(0, zigzag_encode(0));
+  TEST_ASSERT_EQUAL_UINT32(1, zigzag_encode(-1));
+  TEST_ASSERT_EQUAL_UINT32(2, zigzag_encode(1));
+  TEST_ASSERT_EQUAL_UINT32(0xFFFFFFFF, zigzag_encode(INT32_MIN));
+  TEST_ASSERT_EQUAL_UINT32(0xFFFFFFFE, zigzag_encode(INT32_MAX));
+}
+
+void test_frame_filled_from_the_bus(void) {
+  HumiditySample humidity = {INVALID_VALUE, 21.5};
+  BarometerSample barometer = {101325.2, 312.45, 20};
+  GPSData gps = {};
+  gps.flat = 50.0755, gps.flon = 14.4378, gps.ss = 12.34;
+  bus_publish(TOPIC_HUMIDITY, &humidity, sizeof(humidity), 1);
+  bus_publish(TOPIC_BAROMETER, &barometer, sizeof(barometer), 1);
+  bus_publish(TOPIC_GPS, &gps, sizeof(gps), 1);
+  TelemetryFrame frame;
+  fill_telemetry_frame(frame);
+  TEST_ASSERT_EQUAL_INT16(TELEMETRY_INVALID_16, frame.humidity);
+  TEST_ASSERT_EQUAL_INT16(2150, frame.temperature);
+  TEST_ASSERT_EQUAL_INT32(31245, frame.altitude);
+  TEST_ASSERT_EQUAL_INT32(101325, frame.pressure);
+  TEST_ASSERT_EQUAL_UINT16(1234, frame.speed);
+  TEST_ASSERT_INT32_WITHIN(10, 500755000, frame.latitude);  // the GPS gives a float, about 1e-6 deg at 50 deg
+  TEST_ASSERT_INT32_WITHIN(10, 144378000, frame.longitude);
+}
+
+int main(int argc, char **argv) {
+  nativeSerialOutput = false;
+  UNITY_BEGIN();
+  RUN_TEST(test_fixed_16_rounds_and_saturates);
+  RUN_TEST(test_fixed_32_keeps_gps_precision);
+  RUN_TEST(test_keyframe_size_and_layout);
+  RUN_TEST(test_keyframe_does_not_fit);
+  RUN_TEST(test_delta_frame_layout);
+  RUN_TEST(test_delta_of_extremes_wraps);
+  RUN_TEST(test_zigzag);
+  RUN_TEST(test_frame_filled_from_the_bus);
+  return UNITY_END();
+}
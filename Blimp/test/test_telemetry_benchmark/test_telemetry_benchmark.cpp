@@ -0,0 +1,123 @@
+/*
+Benchmark of the keyframe/delta telemetry stream (see Telemetry.h and TelemetryScheduler.h).
+The repository has no recorded flight data, so a flight is simulated: ten minutes of reports every 700 ms,
+the height following a slowly changing target with noise, the engines working against it, the sensors
+publishing on the state bus at their own rates (barometer 1.3 s, DHT22 2.5 s, GPS 1 s) with drifting readings.
+Every keyframe is acknowledged before the next report, as the controller does.
+It prints the bytes per report of the former ASCII report, the keyframe and the stream, the time on air
+at the rendezvous link profile and the encoding rate on the host, and fails if the stream is not at least
+twice as compact as the keyframes.
+Run: pio test -e native -f test_telemetry_benchmark -v
+*/
+#include <unity.h>
+#include <chrono>
+#include "Telemetry.h"
+#include "TelemetryScheduler.h"
+#include "LinkAdaptation.h"
+#include "StateBus.h"
+
+#define REPORT_PERIOD 700                  // [ms]
+#define FLIGHT_REPORTS (600000 / REPORT_PERIOD)
+
+uint32_t noiseState = 12345;
+
+// Deterministic noise in <-1, 1>
+float noise(void) {
+  noiseState = noiseState * 1664525 + 1013904223;
+  return (float)(noiseState >> 8) / (1 << 23) - 1;
+}
+
+/**
+ * Length of the former ASCII report of the same frame ("Name : value" lines, see print_telemetry_frame() of the controller).
+ */
+unsigned int ascii_report_size(const TelemetryFrame &f) {
+  char text[512];
+  return snprintf(text, sizeof(text),
+                  "CurrentHeight : %.2f\nRequiredHeight : %.2f\nCurrentRequiredHeight : %.2f\nTemperature : %.2f\n"
+                  "Humidity : %.2f\nPower : %u\nAltitude : %.2f\nPressure : %ld\nSpeedGPS : %.2f\n"
+                  "LatitudeGPS : %.2f\nLongitudeGPS : %.2f\n",
+                  f.currentHeight / 100.0, f.requiredHeight / 100.0, f.currentRequiredHeight / 100.0, f.temperature / 100.0,
+                  f.humidity / 100.0, f.power, f.altitude / 100.0, (long)f.pressure, f.speed / 100.0,
+                  f.latitude / 1e7, f.longitude / 1e7);
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_stream_compression(void) {
+  unsigned long asciiBytes = 0, streamBytes = 0, keyframes = 0;
+  double encodeSeconds = 0;
+  float temperature = 18, humidity = 55, pressure = 101300, latitude = 50.0755, longitude = 14.4378;
+  unsigned long nextBarometer = 0, nextHumidity = 0, nextGps = 0;
+
+  for (unsigned int r = 0; r < FLIGHT_REPORTS; r++) {
+    nativeMicros += REPORT_PERIOD * 1000UL;
+    unsigned long now = millis();
+    REQ_HEIGHT = (r / 150) % 2 ? 3.0 : 2.0;       // a new target every 105 s
+    C_R_H += constrain(REQ_HEIGHT - C_R_H, -0.21f, 0.21f);
+    CURRENT_HEIGHT += 0.3 * (C_R_H - CURRENT_HEIGHT) + 0.02 * noise();
+    POWER = constrain(100 + (int)(40 * (C_R_H - CURRENT_HEIGHT)) + (int)(3 * noise()), 0, 180);
+    if (now >= nextBarometer) {
+      pressure += 0.5 * noise();
+      BarometerSample barometer = {pressure + 12 * (2.5f - CURRENT_HEIGHT), 290 + CURRENT_HEIGHT + 0.1f * noise(), temperature};
+      bus_publish(TOPIC_BAROMETER, &barometer, sizeof(barometer), micros());
+      nextBarometer = now + 1300;
+    }
+    if (now >= nextHumidity) {
+      temperature += 0.01 * noise();
+      humidity += 0.05 * noise();
+      HumiditySample sample = {humidity, temperature};
+      bus_publish(TOPIC_HUMIDITY, &sample, sizeof(sample), micros());
+      nextHumidity = now + 2500;
+    }
+    if (now >= nextGps) {
+      latitude += 0.000004 + 0.000001 * noise();  // about 0.5 m/s to the north
+      longitude += 0.000001 * noise();
+      GPSData gps = {};
+      gps.flat = latitude, gps.flon = longitude, gps.ss = 1.8 + 0.3 * noise();
+      bus_publish(TOPIC_GPS, &gps, sizeof(gps), micros());
+      nextGps = now + 1000;
+    }
+
+    TelemetryFrame frame;
+    fill_telemetry_frame(frame);
+    unsigned char data[TELEMETRY_MAX_FRAME_SIZE];
+    PacketWriter writer(data, sizeof(data));
+    bool keyframe = keyframe_is_next();
+    auto start = std::chrono::steady_clock::now();
+    TEST_ASSERT_TRUE(encode_telemetry(frame, writer, TELEMETRY_FIELD_BUDGET));
+    encodeSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (keyframe) {
+      keyframes++;
+      telemetry_acknowledged(data[1]);  // the controller acknowledges every keyframe
+    }
+    asciiBytes += ascii_report_size(frame);
+    streamBytes += writer.length();
+  }
+
+  double ascii = (double)asciiBytes / FLIGHT_REPORTS;
+  double stream = (double)streamBytes / FLIGHT_REPORTS;
+  char text[256];
+  snprintf(text, sizeof(text), "Bytes per report: ASCII %.1f, keyframe %d, stream %.1f (%lu keyframes in %d reports)",
+           ascii, TELEMETRY_FRAME_SIZE, stream, keyframes, FLIGHT_REPORTS);
+  TEST_MESSAGE(text);
+  snprintf(text, sizeof(text), "Compression: %.1fx against the ASCII report, %.1fx against the keyframes",
+           ascii / stream, TELEMETRY_FRAME_SIZE / stream);
+  TEST_MESSAGE(text);
+  snprintf(text, sizeof(text), "Time on air of the telemetry at SF7/125 kHz: ASCII %lu ms, keyframe %lu ms, mean delta frame %lu ms",
+           link_airtime(LINK_RENDEZVOUS_PROFILE, (unsigned int)ascii), link_airtime(LINK_RENDEZVOUS_PROFILE, TELEMETRY_FRAME_SIZE),
+           link_airtime(LINK_RENDEZVOUS_PROFILE, (unsigned int)(stream + 0.5)));
+  TEST_MESSAGE(text);
+  snprintf(text, sizeof(text), "Encoding on the host: %.0f reports/s", FLIGHT_REPORTS / encodeSeconds);
+  TEST_MESSAGE(text);
+
+  TEST_ASSERT_LESS_THAN(TELEMETRY_FRAME_SIZE / 2.0, stream);
+  TEST_ASSERT_GREATER_THAN(FLIGHT_REPORTS / (TELEMETRY_KEYFRAME_PERIOD + 1) - 1, keyframes);  // the periodic keyframes are kept
+}
+
+int main(int argc, char **argv) {
+  nativeSerialOutput = false;
+  UNITY_BEGIN();
+  RUN_TEST(test_stream_compression);
+  return UNITY_END();
+}
@@ -0,0 +1,39 @@
+#ifndef ARQ_H
+#define ARQ_H
+
+#include "GeneralLib.h"
+
+#define ARQ_WINDOW 4          // Number of commands that may wait for a confirmation at once (same on the airship)
+#define ARQ_INITIAL_RTO 500   // Retransmission timeout before the first round-trip time is measured [ms]
+#define ARQ_MIN_RTO 150       // [ms]
+#define ARQ_MAX_RTO 4000      // [ms]
+#define ARQ_BATCH_DELAY 30    // A new command waits at most this long for other commands to share its packet [ms]
+
+// Acknowledgement carried in every MEASURED_DATA packet (see ARQ.h of the airship):
+// [flags, next expected sequence number (2 bytes), held bitmap, refused bitmap]
+#define ARQ_ACK_SIZE 5
+#define ARQ_ACK_SESSION 0x01  // at least one command arrived, the sequence number is valid
+#define ARQ_ACK_RESEND 0x02   // a corrupted frame arrived, retransmit without waiting
+
+// One command waiting for its confirmation
+struct PendingCommand {
+  command cmd;
+  volatile bool inUse;           // the slot holds a command
+  volatile bool acked;           // the airship processed the command (set by receive_service())
+  volatile bool rejected;        // the airship refused the command as invalid
+  volatile bool held;            // the airship already has the command, but waits for an older one
+  volatile unsigned long ackedAt;
+  unsigned long sentAt;          // time of the last transmission (of the submission before the first one)
+  unsigned int rto;              // retransmission timeout of this command, doubled after each timeout
+  unsigned int attempts;
+};
+
+struct VehicleSession;  // see Fleet.h
+
+bool arq_can_send(const VehicleSession &v);
+void arq_submit(VehicleSession &v, const command& cmd);
+bool arq_service(VehicleSession &v);
+void arq_acknowledged(VehicleSession &v, unsigned char flags, uint16_t nextExpected, unsigned char held, unsigned char refused);
+void arq_update_rto(VehicleSession &v, unsigned long rtt);
+
+#endif // ARQ_H
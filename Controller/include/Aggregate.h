@@ -0,0 +1,32 @@
+#ifndef AGGREGATE_H
+#define AGGREGATE_H
+
+#include "GeneralLib.h"
+#include "PacketBuffer.h"
+
+/*
+Windowed aggregates of the fast values, controller side (see Aggregate.h of the airship for the format).
+A beacon of the airship may carry the number of samples, mean, minimum, maximum and standard deviation of each
+field since its previous aggregates. They are printed between "---" and "+++" with "Aggregate : 1",
+as "<name>Samples", "<name>Mean", "<name>Min", "<name>Max" and "<name>Std".
+*/
+
+// Same order as AggregateField of the airship
+enum AggregateField {
+  AGGREGATE_HEIGHT,
+  AGGREGATE_POWER,
+  AGGREGATE_ULTRASONIC,
+  AGGREGATE_FIELD_COUNT
+};
+
+struct AggregateFieldName {
+  const char *name;      // prefix of the printed names
+  float scale;           // sent units per printed unit
+  unsigned int digits;   // decimal places printed
+};
+
+struct VehicleSession;  // see Fleet.h
+
+bool aggregates_received(PacketReader &reader, const VehicleSession &v);
+
+#endif // AGGREGATE_H
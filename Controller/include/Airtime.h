@@ -0,0 +1,26 @@
+#ifndef AIRTIME_H
+#define AIRTIME_H
+
+#include "GeneralLib.h"
+
+#define AIRTIME_DUTY_CYCLE 10.0     // Share of the time this device may transmit [%]
+#define AIRTIME_WINDOW 20000        // The duty cycle is enforced over a rolling window of this length [ms]
+#define AIRTIME_TELEMETRY_RESERVE 25 // Telemetry is sent only while this much of the budget stays free for commands [%]
+#define AIRTIME_BACKGROUND_RESERVE 50 // The same for keepalives and repeated acknowledgements [%]
+
+// Traffic classes, a higher class leaves a bigger reserve for the lower ones
+enum AirtimeClass {
+  AIRTIME_COMMAND,     // commands, their retransmissions and acknowledgements, they may use the whole budget
+  AIRTIME_TELEMETRY,   // periodic telemetry and its acknowledgements
+  AIRTIME_BACKGROUND   // keepalives and acknowledgements of duplicates
+};
+
+extern float airtimeDutyCycle;    // [%], AIRTIME_DUTY_CYCLE by default
+
+void airtime_refill(void);
+bool airtime_allowed(AirtimeClass trafficClass, unsigned int bytes);
+void airtime_charge(unsigned int bytes);
+float airtime_available(void);
+float airtime_capacity(void);
+
+#endif // AIRTIME_H
@@ -0,0 +1,32 @@
+#ifndef BACKLOG_H
+#define BACKLOG_H
+
+#include "GeneralLib.h"
+#include "PacketBuffer.h"
+#include "Telemetry.h"
+
+#define BACKLOG_HELD_FRAMES 8         // Live frames held back per airship while the recorded frames are downloaded
+#define BACKLOG_STALL_TIMEOUT 5000    // The download is considered finished if no records arrive for this long [ms]
+
+/*
+Store-and-forward of the telemetry, controller side (see Backlog.h of the airship).
+Section of the beacon: [number of records, number of records still waiting (2 bytes), records]
+Record: [age (4 bytes) [ms], current height, ..., longitude (as in a keyframe, see Telemetry.h)]
+*/
+
+struct VehicleSession;  // see Fleet.h
+
+// A live frame held back during a download
+struct HeldFrame {
+  unsigned long time;     // millis() when it was received
+  TelemetryFrame frame;
+};
+
+bool backlog_received(PacketReader &reader, VehicleSession &v);
+bool backlog_live_frame(VehicleSession &v, const TelemetryFrame &frame);
+void backlog_service(void);
+void backlog_flush(unsigned int vehicle);
+bool pop_held_frame(unsigned int vehicle, HeldFrame &held);
+void backlog_reset(unsigned int vehicle);
+
+#endif // BACKLOG_H
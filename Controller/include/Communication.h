@@ -3,25 +3,43 @@
 
 #include "GeneralLib.h"
 #include <LoRa.h>
+#include "Telemetry.h"
+#include "PacketBuffer.h"
+#include "Framing.h"
+#include "ARQ.h"
+#include "LinkAdaptation.h"
+#include "TDMA.h"
+#include "LinkStats.h"
+#include "Profiler.h"
+#include "Airtime.h"
+#include "Fleet.h"
+#include "Steering.h"
+#include "Backlog.h"
+#include "Hopping.h"
+#include "Capture.h"
+#include "Query.h"
+#include "Aggregate.h"
+#include "ReceiveQueue.h"
 
 const unsigned int csPin = 10;          // LoRa radio chip select
 const unsigned int resetPin = 14;       // LoRa radio reset
 const unsigned int dio0 = 15;         // hardware interrupt pin
 
+extern PacketBuffer rxPacket;
+
 void onReceive(int packetSize);
+void receive_service(void);
+void process_received_packet(void);
 bool MsgIsForMe(unsigned char recipientAddres);
-void process_airship_status(void);
-void decode_from_byte(bool &x, bool &y, bool &z, bool &w, unsigned char one_byte);
-void updates_landing_status(bool landingStatus, bool landingParity);
-void updates_flying_status(bool flyingStatus, bool flyingParity);
-void handle_confirmation_message(void);
-void handle_measured_data_message(void);
-String read_LoRa_string(void);
-void send_command(const command& cmd);
-bool get_even_parity(unsigned int number);
-bool check_parity(unsigned int number, bool originalParity);
-void ExtractCounterFromByte(unsigned int &counter, bool &counterParity, unsigned char inp);
-unsigned char createCounterByte(unsigned int counter);
-int GetValueWithParity(int value);
+void handle_join_request(PacketReader &reader);
+void process_airship_status(VehicleSession &v, unsigned char one_byte);
+void handle_measured_data_message(VehicleSession &v, PacketReader &reader, bool hop, bool stats, bool backlog, bool query, bool aggregates);
+void print_measured_data(const VehicleSession &v, const TelemetryFrame &frame, unsigned long time, bool recorded);
+bool handle_command_ack(VehicleSession &v, PacketReader &reader);
+bool handle_link_report(PacketReader &reader);
+bool send_command(unsigned char address, const command& cmd, AirtimeClass trafficClass);
+bool send_commands(unsigned char address, const command *cmds[], unsigned int count, AirtimeClass trafficClass);
+bool send_telemetry_ack(VehicleSession &v);
+bool send_assignment(VehicleSession &v, unsigned int slots);
 
 #endif // COMMUNICATION_H
\ No newline at end of file
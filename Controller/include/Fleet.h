@@ -0,0 +1,77 @@
+#ifndef FLEET_H
+#define FLEET_H
+
+#include "GeneralLib.h"
+#include "ARQ.h"
+
+#define FLEET_SIZE 8                 // Number of airships the controller can run at once
+#define FLEET_FIRST_ADDRESS 0x11     // Airship i has the address FLEET_FIRST_ADDRESS + i (same on the airship)
+#define FLEET_JOIN_ADDRESS 0x10      // Address of an airship that has not been assigned one yet (same on the airship)
+#define FLEET_TIMEOUT 30000          // An airship not heard for this long loses its session [ms]
+
+// Everything the controller keeps about one airship
+struct VehicleSession {
+  volatile bool active;
+  unsigned char address;
+  uint16_t nonce;                        // random number from the join request, 0 for an airship found by its telemetry
+  unsigned int slotsSent;                // number of TDMA slots last sent to the airship (see TDMA.h)
+
+  // Command window (see ARQ.h)
+  uint16_t counter;                      // sequence number of the last command
+  PendingCommand sendWindow[ARQ_WINDOW]; // slot = sequence number % ARQ_WINDOW
+  volatile bool nackArrived;             // the airship received a corrupted frame
+  bool lastCmdConfirmed;                 // true if all sent commands were confirmed by the airship
+  unsigned long srtt;                    // smoothed round-trip time [ms]
+  unsigned long rttvar;                  // round-trip time variation [ms]
+  bool rttMeasured;
+  unsigned int currentRTO;
+
+  // Status reported by the airship
+  volatile bool land;
+  volatile bool flyForward;
+  volatile long lastReceivedTime;
+  long lastSendTime;
+
+  // TDMA frame of the airship (see TDMA.h)
+  volatile unsigned long beaconAt;       // time at which the last beacon was received
+  volatile bool beaconHeard;
+
+  // Continuous controls (see Steering.h)
+  uint16_t steeringSeq;                  // sequence number of the last setpoint, separate from the commands
+  int steeringAngle;                     // [degrees]
+  int steeringPower;
+  bool steeringChanged;                  // the setpoint changed since it was last sent
+  unsigned long steeringSentAt;
+
+  // Telemetry (see Telemetry.h)
+  volatile bool telemetryAckPending;     // a keyframe arrived and its acknowledgement has not been sent yet
+  volatile unsigned char telemetryAckSeq;
+
+  // Link (see LinkStats.h)
+  volatile unsigned long packetsReceived;
+  unsigned long packetsSent;
+  unsigned long retransmissions;
+  volatile float snr;                    // of the last packet [dB]
+  volatile int rssi;                     // of the last packet [dBm]
+};
+
+extern VehicleSession fleet[FLEET_SIZE];
+extern unsigned int selectedVehicle;    // the buttons and the serial monitor control this airship
+
+VehicleSession &selected_vehicle(void);
+unsigned int fleet_index(const VehicleSession &v);
+VehicleSession *fleet_vehicle(unsigned char address);
+VehicleSession *fleet_discover(unsigned char address);
+void fleet_join_request(uint16_t nonce);
+void fleet_open(unsigned int index, uint16_t nonce);
+unsigned int fleet_count(void);
+unsigned int fleet_slots(void);
+command fleet_command(VehicleSession &v, unsigned char commandID, float value = -1);
+void fleet_service(void);
+bool fleet_transmit(VehicleSession &v);
+bool send_keepalive(VehicleSession &v);
+void fleet_expire(void);
+void fleet_update_slots(void);
+void print_fleet(void);
+
+#endif // FLEET_H
@@ -0,0 +1,25 @@
+#ifndef FRAMING_H
+#define FRAMING_H
+
+#include "GeneralLib.h"
+#include "PacketBuffer.h"
+
+#define CRC_SIZE 2      // CRC-16/CCITT-FALSE over the whole packet
+#define FEC_SIZE 2      // Hamming check word over the packet and its CRC
+#define FEC_PARITY_BIT 0x8000 // Overall parity of the protected bits, the lower 12 bits hold the Hamming syndrome
+
+// Must be set the same on the blimp and on the controller
+extern bool FRAME_FEC;
+
+enum FrameStatus {
+  FRAME_OK,         // CRC matched
+  FRAME_CORRECTED,  // a single bit error was corrected by the FEC and the CRC matched afterwards
+  FRAME_CORRUPTED   // the frame has to be discarded
+};
+
+bool append_frame_check(PacketWriter &writer);
+FrameStatus check_frame(PacketBuffer &packet);
+uint16_t crc16(const unsigned char *data, unsigned int length);
+uint16_t fec_word(const unsigned char *data, unsigned int length);
+
+#endif // FRAMING_H
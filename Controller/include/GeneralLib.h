@@ -7,7 +7,6 @@
 #include "Potentiometer.h"
 
 extern unsigned char localAddress;         // address of this device
-extern unsigned char destinationAddress;   // address of reciver
 
 const int ERR_VALUE = INT16_MIN;
 
@@ -21,19 +20,31 @@ struct commandID {
   static const unsigned char FLY_FORWARD = 0x99; // Switch on/off the steering motor
   static const unsigned char SET_MOTOR_POWER = 0x3C; // Adjusts the power of the steering motor
   static const unsigned char MOTORS_OFF = 0x55;
+  static const unsigned char TELEMETRY_ACK = 0xAA; // Acknowledges a received telemetry keyframe (not confirmed by the airship)
+  static const unsigned char LINK_PROFILE = 0x5A; // Switches the radio parameters (see LinkAdaptation.h)
+  static const unsigned char ASSIGN_ADDRESS = 0xA5; // Answers a join request with the address of the airship (see Fleet.h)
+  static const unsigned char FLEET_SLOTS = 0xC3; // Number of TDMA slots of the fleet (see TDMA.h)
+  static const unsigned char CONTROL_SETPOINT = 0x6C; // Steering angle and power, newest value wins (see Steering.h)
+  static const unsigned char BACKLOG_REQUEST = 0xB4; // The airship sends all its recorded telemetry frames (see Backlog.h)
+  static const unsigned char HOP_MODE = 0x4B; // Channel mask of the frequency hopping, 0 = off (see Hopping.h)
+  static const unsigned char QUERY = 0x2D; // Snapshot of or subscription to chosen variables of the airship (see Query.h)
+  static const unsigned char PROFILE_DUMP = 0xD2; // The airship prints its runtime profile to its USB serial and SD card (see Profiler.h)
 };extern commandID all_ids;
 
 struct BalloonREPORT {
-  static const unsigned char CONFIRMATION = 0x00;
-  static const unsigned char MEASURED_DATA = 0xFF;
+  static const unsigned char MEASURED_DATA = 0xFF; // telemetry, it also acknowledges the received commands
+  static const unsigned char JOIN_REQUEST = 0x4A; // a new airship asks for an address (see Fleet.h)
 };extern BalloonREPORT report;
 
+bool command_has_value(unsigned char commandID);
+
 class command {
   public:
     unsigned char ID; // Command ID
     int value;
-    unsigned int counter; // The command must also have a special counter. This is in case the message gets lost or damaged on the way.
-    command(unsigned char type, unsigned int cnt, float val = ERR_VALUE) {
+    uint16_t counter; // The command must also have a special counter (sequence number). This is in case the message gets lost or damaged on the way.
+    command() : ID(0x00), value(0), counter(0) {}
+    command(unsigned char type, uint16_t cnt, float val = ERR_VALUE) {
       commandID ids;
       counter = cnt;
       if (type == ids.SET_EXACT_HEIGHT){
@@ -62,6 +73,9 @@ class command {
           Serial.println("INVALID COMMAND!");
         }
 
+      }else if(command_has_value(type)){
+        ID = type;
+        value = val; // carried as it is, see the users of the command (e.g. send_assignment(), steering_command(), query_command())
       }else {
         ID = type;
         value = 0; // TODO
@@ -69,16 +83,9 @@ class command {
     }
 };
 
-extern unsigned int counter;         // msg counter
-extern long lastSendTime;            // last send time
 extern long lastReceivedTime;        // last received time
 extern long timeOfLastCommand;       // time at witch last command was entered
 extern int timeInterval;          // Interval between sending times
 extern int buttonInterval;         // Interval between button presses
-extern bool lastCmdConfirmed;     // true if last command was confirmed by balloon
-extern bool confirmation_arrived; // true if answer(confirmation) from balloon arrived
-
-extern bool LAND;                // Is set by return msg from balloon
-extern bool FLY_FORWARD;           // true if steering motor of airshit is on
 
 #endif
\ No newline at end of file
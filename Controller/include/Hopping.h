@@ -0,0 +1,50 @@
+#ifndef HOPPING_H
+#define HOPPING_H
+
+#include "GeneralLib.h"
+#include "PacketBuffer.h"
+
+#define HOP_CHANNELS 8                  // Hopping channels, HOP_CHANNEL_SPACING apart from HOP_FIRST_FREQUENCY (same on the airship)
+#define HOP_FIRST_FREQUENCY 433175000   // [Hz]
+#define HOP_CHANNEL_SPACING 200000      // [Hz]
+#define HOP_RENDEZVOUS_FREQUENCY 433E6  // Frequency without hopping, also used by every HOP_RENDEZVOUS_PERIOD-th frame [Hz]
+#define HOP_RENDEZVOUS_PERIOD 8         // Frames whose number is divisible by this use the rendezvous frequency
+#define HOP_SEED 0x5EED                 // Seed of the hop sequence (same on the airship)
+#define HOP_ALL_CHANNELS 0xFF
+#define HOP_MAX_MISSED 4                // After this many missed beacons in a row, the controller waits on the rendezvous frequency
+#define HOP_FALLBACK_TIMEOUT 16000      // No beacon for this long while waiting => hopping is considered off [ms], two rendezvous frames
+#define HOP_REVIEW_FRAMES 64            // The blacklist is reviewed after this many frames
+#define HOP_MIN_SAMPLES 4               // Beacons expected on a channel before it may be blacklisted
+#define HOP_BLACKLIST_LOSS 50           // A channel that loses more beacons is blacklisted [%]
+#define HOP_MIN_CHANNELS 3              // Never fewer channels in use
+#define HOP_PROBATION 60000             // A blacklisted channel is tried again after this time [ms]
+
+/*
+Frequency hopping, controller side (see Hopping.h of the airship for the sequence).
+The airship is the master of the sequence: the controller tunes to the channel of the next frame after
+the contention slot of the current one and learns the frame number and the channel mask from every beacon.
+*/
+enum HopState {
+  HOP_OFF,
+  HOP_SEARCHING,   // waiting on the rendezvous frequency for a beacon with the hopping state
+  HOP_FOLLOWING,   // tuned to the channels of the airship
+};
+
+struct VehicleSession;  // see Fleet.h
+
+extern volatile HopState hopState;
+
+void hop_toggle(void);
+bool hop_searching(void);
+bool hop_beacon(PacketReader &reader, VehicleSession &v, unsigned long time);
+void hop_plain_beacon(VehicleSession &v);
+void hop_confirmed(unsigned int mask);
+void hop_refused(void);
+void hop_service(void);
+void hop_review(void);
+void hop_tune(unsigned char frame, unsigned char mask);
+void print_hop_statistics(void);
+int hop_channel(unsigned char frame, unsigned char mask);
+long hop_frequency(int channel);
+
+#endif // HOPPING_H
@@ -0,0 +1,38 @@
+#ifndef LINK_ADAPTATION_H
+#define LINK_ADAPTATION_H
+
+#include "GeneralLib.h"
+#include <LoRa.h>
+
+#define LINK_PROFILE_COUNT 5
+#define LINK_RENDEZVOUS_PROFILE 2     // LoRa library defaults (SF7, 125 kHz), used after start and after a failed switch
+#define LINK_FALLBACK_TIMEOUT 8000    // Nothing heard for this long => back to the rendezvous profile [ms]
+#define LINK_RADIO_CRC false          // Payload CRC of the radio (off in the LoRa library), it lengthens the time on air
+#define LINK_KEEPALIVE_INTERVAL 1000  // "SAY_HI" period outside the rendezvous profile, so the airship does not fall back [ms]
+#define LINK_UP_MARGIN 8.0            // A faster profile is used only with this SNR reserve [dB]
+#define LINK_DOWN_MARGIN 3.0          // A slower profile is used when the SNR reserve drops below this [dB]
+#define LINK_MIN_PACKETS_DOWN 3       // Packets measured on a profile before it may be left for a slower one
+#define LINK_MIN_PACKETS_UP 8         // Packets measured on a profile before it may be left for a faster one
+
+// Radio parameters of one link profile (the same table is on the airship)
+struct LinkProfile {
+  int spreadingFactor;
+  long bandwidth;      // [Hz]
+  int txPower;         // [dBm]
+  float requiredSnr;   // SNR needed for demodulation at this spreading factor [dB]
+};
+
+extern const LinkProfile linkProfiles[LINK_PROFILE_COUNT];
+extern unsigned int currentProfile;
+
+void link_record_packet(float snr, int rssi);
+void link_remote_report(float snr, int rssi);
+unsigned int link_choose_profile(unsigned int profile, float snr);
+void link_service(void);
+void link_switch_confirmed(uint16_t seq, unsigned int profile);
+void link_switch_refused(uint16_t seq);
+void link_apply_profile(unsigned int profile);
+unsigned long link_airtime(unsigned int profile, unsigned int bytes);
+unsigned long link_keepalive_interval(void);
+
+#endif // LINK_ADAPTATION_H
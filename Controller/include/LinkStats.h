@@ -0,0 +1,78 @@
+#ifndef LINK_STATS_H
+#define LINK_STATS_H
+
+#include "GeneralLib.h"
+#include "PacketBuffer.h"
+#include "Framing.h"
+
+#define LINK_HISTOGRAM_BUCKETS 8
+#define LINK_STATS_WINDOW 10000        // Period over which the rates and the loss are computed [ms]
+#define LINK_STATS_REPORT_SIZE 18      // Counters of the airship: [received, corrupted, corrected, duplicates], 16 bits each, and the timing of its height loop
+
+// Timing of the height control loop of an airship in the last report period [us] (see LoopTiming.h of the airship)
+struct LoopTimingReport {
+  bool known;
+  int jitterMin;           // period minus the nominal one
+  int jitterMax;
+  unsigned int jitter99;   // 99th percentile of the absolute jitter, upper edge of a power of two bucket
+  unsigned int execution99;
+  unsigned int executionMax;
+};
+
+/*
+Histogram with fixed buckets. Bucket 0 collects values below 'lowest', bucket i the values
+from lowest + (i - 1) * width, the last bucket also everything above its lower edge.
+*/
+struct LinkHistogram {
+  int lowest;
+  int width;
+  volatile unsigned long counts[LINK_HISTOGRAM_BUCKETS];
+};
+
+// Totals since the start, the airship's counters are the last values it reported
+struct LinkCounters {
+  unsigned long packetsReceived;    // packets for this device that passed the CRC check
+  unsigned long corruptedFrames;    // frames that failed the CRC check even after the FEC
+  unsigned long correctedFrames;    // frames with a bit error corrected by the FEC
+  unsigned long packetsSent;
+  unsigned long commandsSent;       // first transmissions of commands
+  unsigned long retransmissions;    // further transmissions of commands
+  unsigned long commandsConfirmed;
+  unsigned long commandsRetried;    // confirmed commands that needed more than one transmission
+  unsigned long telemetryFrames;
+  unsigned long telemetryLost;      // gaps in the sequence numbers of the telemetry frames
+  unsigned long remoteReceived;     // reported by the airship
+  unsigned long remoteCorrupted;
+  unsigned long remoteCorrected;
+  unsigned long remoteDuplicates;
+};
+
+// Values of the last LINK_STATS_WINDOW
+struct LinkRates {
+  float received;      // [packets/min]
+  float sent;          // [packets/min]
+  float downlinkLoss;  // lost telemetry frames [%]
+  float uplinkLoss;    // sent packets that the airship did not count as received [%]
+};
+
+extern volatile LinkCounters linkCounters;
+extern LinkRates linkRates;
+extern LinkHistogram localRssiHistogram, localSnrHistogram, remoteRssiHistogram, remoteSnrHistogram;
+extern LinkHistogram rttHistogram, attemptsHistogram;
+extern LoopTimingReport heightLoopTiming[];
+
+void histogram_add(LinkHistogram &histogram, int value);
+void print_histogram(const char *name, const LinkHistogram &histogram, const char *unit);
+void link_stats_frame_checked(FrameStatus status);
+void link_stats_packet_received(float snr, int rssi);
+void link_stats_remote_report(float snr, int rssi);
+bool link_stats_remote_counters(PacketReader &reader, unsigned int vehicle);
+void link_stats_telemetry_frame(unsigned int vehicle, unsigned char seq);
+void link_stats_reset(unsigned int vehicle);
+void link_stats_packet_sent(void);
+void link_stats_command_sent(unsigned int attempt);
+void link_stats_command_confirmed(unsigned int attempts, unsigned long rtt);
+void link_stats_service(void);
+void print_link_statistics(void);
+
+#endif // LINK_STATS_H
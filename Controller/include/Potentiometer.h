@@ -4,10 +4,9 @@
 #include <Arduino.h>
 #include <TeensyThreads.h>
 
-extern const unsigned int Potentiometr;
+extern const unsigned int Potentiometer;
 extern float CENTER_value;
 extern volatile float ANGLE;
-extern float last_angle;
 extern bool READING;
 extern float k; //TODO
 extern float q; //TODO
@@ -18,6 +17,5 @@ float get_relative_angle(float voltage_value, float center_value);
 void center_it(void);
 void SetCentreValue(void);
 void thread_upgrade_angle(void);
-bool angle_change(void);
 
 #endif
\ No newline at end of file
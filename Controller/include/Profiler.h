@@ -0,0 +1,83 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "GeneralLib.h"
+
+#define PROFILE_BUCKETS 12               // Histogram of a section: bucket i counts the runs shorter than 2^i us, the last one all longer runs
+#define PROFILE_MAX_THREADS 8            // Threads of TeensyThreads (MAX_THREADS of the library)
+#define PROFILE_STACK_PATTERN 0xA5       // Painted into the free stacks, the used part is where it was overwritten
+#define PROFILE_MAIN_STACK_RESERVE 1024  // Part of the main stack below the stack pointer of setup() that is not painted [bytes]
+#define PROFILE_SAMPLE_PERIOD 997        // Period of the samples of the running thread [us], not a multiple of the tick
+#define THREAD_STACK_SIZE 1024           // Stack of a thread [bytes], the default of TeensyThreads
+
+/*
+Runtime profiler of the controller, the same as on the airship (see Profiler.h of the airship). It is built only
+with PROFILING defined (the environment teensy40_profiling in platformio.ini); without it the macros below are empty
+and no counters are kept.
+- Sections: PROFILE_SECTION(id) at the start of a block measures the block by the cycle counter (DWT): runs, total and
+  maximal time and a histogram of the times. A section in a thread includes the interrupts and the slices of other
+  threads that came during it. Every section has one writer, so the counters are not locked.
+- Threads: profileTimer charges the cycles since its previous sample, without the measured interrupts,
+  to the thread running at the sample (a statistical estimate).
+- Stacks: the stacks of the threads (profile_add_thread()) and the free part of the main stack are painted
+  at the start, the high-water mark is the deepest byte that was overwritten since then.
+The profile is printed by the text command 'profile'.
+*/
+
+enum ProfileSectionId {
+  PROFILE_ON_RECEIVE,           // onReceive(), interrupt of the radio
+  PROFILE_RECEIVE_SERVICE,      // receive_service()
+  PROFILE_MEASURED_DATA,        // handle_measured_data_message()
+  PROFILE_SEND_COMMANDS,        // send_commands()
+  PROFILE_FLEET_SERVICE,        // fleet_service()
+  PROFILE_MAIN_LOOP,            // one pass of loop()
+  PROFILE_SECTION_COUNT
+};
+
+void profiler_begin(void);
+int profile_add_thread(const char *name, void (*entry)(void), unsigned int stackSize = THREAD_STACK_SIZE);
+void print_profile(Print &out);
+
+#ifdef PROFILING
+
+struct ProfileSection {
+  const char *name;
+  bool interrupt;
+  volatile unsigned long runs;
+  volatile uint64_t cycles;
+  volatile uint32_t maxCycles;
+  volatile unsigned long buckets[PROFILE_BUCKETS];
+};
+
+struct ProfileThread {
+  const char *name;                   // NULL if the thread is not known
+  unsigned char *stackLow;            // lowest address of the stack
+  unsigned int stackSize;             // [bytes]
+  volatile uint64_t cycles;           // charged by the samples
+};
+
+extern ProfileSection profileSections[PROFILE_SECTION_COUNT];
+extern ProfileThread profileThreads[PROFILE_MAX_THREADS];
+
+void profile_record(ProfileSectionId id, uint32_t cycles);
+void profile_sample_thread(void);
+
+// Measures the block in which it is declared (see PROFILE_SECTION)
+class ProfileScope {
+  public:
+    ProfileScope(ProfileSectionId id) : id(id), start(ARM_DWT_CYCCNT) {}
+    ~ProfileScope() { profile_record(id, ARM_DWT_CYCCNT - start); }
+  private:
+    ProfileSectionId id;
+    uint32_t start;
+};
+
+#define PROFILE_SECTION(id) ProfileScope profileScope(id)
+
+#else
+
+#define PROFILE_SECTION(id)
+
+#endif // PROFILING
+
+#endif // PROFILER_H
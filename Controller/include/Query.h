@@ -0,0 +1,34 @@
+#ifndef QUERY_H
+#define QUERY_H
+
+#include "GeneralLib.h"
+#include "PacketBuffer.h"
+
+#define QUERY_VARIABLE_COUNT 24   // Variables that can be queried, at most 24 (same on the airship)
+#define QUERY_HEADER_SIZE 3       // Bitmap of the variables in the section
+#define QUERY_PERIOD_UNIT 100     // Unit of the period in the QUERY command [ms]
+#define QUERY_MAX_PERIOD 255      // [QUERY_PERIOD_UNIT]
+
+/*
+Telemetry queries, controller side (see Query.h of the airship for the format).
+'get | names' asks for a snapshot of the variables, 'subscribe | period names' subscribes to them
+(period in ms, 'subscribe | 0' ends the subscription and the telemetry frames come back). The names are
+those of queryVariables, separated by spaces or commas, 'variables' prints them all.
+The answers are printed like the telemetry, between "---" and "+++", with "Query : 1".
+*/
+
+struct QueryVariableName {
+  const char *name;      // printed as "name : value"
+  float scale;           // fixed-point steps per unit
+  unsigned int digits;   // decimal places printed
+};
+
+struct VehicleSession;  // see Fleet.h
+
+bool query_received(PacketReader &reader, const VehicleSession &v);
+void query_input(const String &text, bool subscribe);
+command query_command(VehicleSession &v, uint32_t variables, unsigned int period);
+int query_variable(const String &name);
+void print_query_variables(void);
+
+#endif // QUERY_H
@@ -0,0 +1,37 @@
+#ifndef RECEIVE_QUEUE_H
+#define RECEIVE_QUEUE_H
+
+#include "GeneralLib.h"
+#include "PacketBuffer.h"
+
+#define RECEIVE_QUEUE_SIZE 8  // Must be a power of two; packets received between two passes of the main loop
+
+/*
+Queue of received packets between onReceive() (the only producer, it runs in the LoRa interrupt) and
+receive_service() in the main loop (the only consumer). The interrupt only reads the FIFO of the radio
+into a free slot and stamps it with the time and the signal quality (see receive_packet()); the check of the frame,
+the parsing, the prints and the answers all run in the main loop. No lock is needed: the producer writes only
+the head, the consumer only the tail, and a packet is complete before the index that publishes it is moved.
+If the queue is full, the packet stays in the FIFO of the radio and is overwritten by the next one.
+The statistics show how long the interrupt takes and how long the packets wait, 'stats' prints them (see print_receive_statistics()).
+*/
+
+// Timing of the receive path, all times in microseconds
+struct ReceiveStatistics {
+  unsigned long packets;        // calls of onReceive() with a packet
+  unsigned long interruptMax;   // the longest onReceive()
+  unsigned long interruptTotal;
+  unsigned long processed;      // packets taken by receive_service()
+  unsigned long waitMax;        // the longest time from the reception to the processing
+  unsigned long waitTotal;
+  unsigned long overflows;      // packets dropped because the queue was full
+  unsigned int highWater;       // the largest number of queued packets so far
+};
+
+extern volatile ReceiveStatistics receiveStatistics;
+
+void receive_queue_push(int packetSize);
+bool receive_queue_pop(PacketBuffer &packet);
+void print_receive_statistics(void);
+
+#endif // RECEIVE_QUEUE_H
@@ -0,0 +1,29 @@
+#ifndef STEERING_H
+#define STEERING_H
+
+#include "GeneralLib.h"
+
+#define STEERING_INTERVAL 100   // Shortest period of the setpoint packets to one airship [ms]
+#define STEERING_PERIOD 500     // The setpoint is sent at least this often to an active airship, changed or not [ms]
+#define STEERING_DEADBAND 1     // Smaller changes of the steering angle are not sent [degrees]
+#define STEERING_MAX_ANGLE 90   // The steering angle is limited to +-STEERING_MAX_ANGLE [degrees]
+#define STEERING_DEFAULT_POWER 110 // Power of the steering motor until the user sets it (same as on the airship)
+
+/*
+Latest-value-wins channel for the continuous controls (the steering angle and the power of the steering motor).
+The setpoint is not confirmed or retransmitted by the ARQ (see ARQ.h): it has its own sequence numbers
+and is streamed at a fixed rate, the airship applies only the newest setpoint it has received and stops steering
+when the stream stops (see Steering.h of the airship).
+Value of CONTROL_SETPOINT: steering angle * 256 + power of the steering motor (0 to 180)
+*/
+
+struct VehicleSession;  // see Fleet.h
+
+void steering_input(VehicleSession &v, int angle, int power);
+void steering_service(void);
+bool steering_due(const VehicleSession &v);
+command steering_command(const VehicleSession &v);
+void steering_sent(VehicleSession &v);
+bool send_steering(VehicleSession &v);
+
+#endif // STEERING_H
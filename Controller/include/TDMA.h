@@ -0,0 +1,37 @@
+#ifndef TDMA_H
+#define TDMA_H
+
+#include "GeneralLib.h"
+
+#define TDMA_MIN_FRAME 700        // Shortest period of the beacons (telemetry cadence) [ms]
+#define TDMA_GUARD 10             // Gap around each transmission [ms]
+#define TDMA_MAX_PACKET 48        // Longest packet planned into a slot [bytes]
+#define TDMA_UPLINK_WINDOW 50     // The controller may start its commands this long after the uplink slot opens [ms]
+#define TDMA_LOOP_PERIOD 100      // Period of the airship's main loop, the acknowledgement slot must be longer [ms]
+#define TDMA_CONTENTION_WINDOW 100 // The contention slot accepts transmissions starting within this time [ms]
+
+/*
+Slots of one TDMA frame, as offsets from the end of the beacon (the airship's periodic telemetry packet) [ms].
+Transmissions have to start within their slot, the slots are spaced so that a packet of TDMA_MAX_PACKET
+bytes ends before the next slot opens:
+  beacon (airship) | uplink (controller: commands) | acknowledgement (airship) | contention (controller: "SAY_HI") | next beacon
+*/
+struct TdmaLayout {
+  unsigned long uplinkStart;
+  unsigned long uplinkEnd;
+  unsigned long ackStart;
+  unsigned long ackEnd;
+  unsigned long contentionStart;
+  unsigned long contentionEnd;
+  unsigned long frame;        // from the end of one beacon to the start of the next frame
+};
+
+void tdma_layout(TdmaLayout &layout);
+struct VehicleSession;  // see Fleet.h
+
+void tdma_beacon_received(VehicleSession &v, unsigned long time);
+bool tdma_synchronised(const VehicleSession &v);
+bool tdma_uplink_open(const VehicleSession &v);
+bool tdma_contention_open(const VehicleSession &v);
+
+#endif // TDMA_H
@@ -0,0 +1,45 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "GeneralLib.h"
+#include "PacketBuffer.h"
+
+#define TELEMETRY_FULL_FRAME 0x01   // Format byte of a complete fixed-layout frame (keyframe)
+#define TELEMETRY_DELTA_FRAME 0x02  // Format byte of a frame with varint deltas against an acknowledged frame
+#define TELEMETRY_FRAME_SIZE 31     // Format byte + sequence number + 29 bytes of fixed-point fields
+#define TELEMETRY_MAX_FRAME_SIZE 64 // Worst case of the delta frame is 5 header bytes + 11 five-byte varints
+#define TELEMETRY_FIELD_COUNT 11
+#define TELEMETRY_HISTORY 16        // Number of decoded frames kept as references (same on the blimp)
+#define TELEMETRY_INVALID_16 INT16_MIN // Received instead of a 16-bit field whose sensor reported an invalid value
+#define TELEMETRY_INVALID_VALUE -11111 // Value printed for invalid fields (same as INVALID_VALUE of the blimp)
+
+// Fixed-point image of one telemetry report (all multi-byte fields are sent little-endian)
+struct TelemetryFrame {
+    int16_t currentHeight;         // [cm]
+    int16_t requiredHeight;        // [cm]
+    int16_t currentRequiredHeight; // [cm]
+    int16_t temperature;           // DHT22 temperature [0.01 °C]
+    int16_t humidity;              // DHT22 relative humidity [0.01 %]
+    uint8_t power;                 // power of the height control engines [0 - 180]
+    int32_t altitude;              // barometric altitude [cm]
+    int32_t pressure;              // [Pa]
+    uint16_t speed;                // GPS speed [0.01 km/h]
+    int32_t latitude;              // [1e-7 deg]
+    int32_t longitude;             // [1e-7 deg]
+};
+
+struct VehicleSession;  // see Fleet.h, it holds the pending acknowledgement of the keyframes
+
+bool decode_telemetry(PacketReader &reader, TelemetryFrame &frame, VehicleSession &v);
+void telemetry_reset(unsigned int vehicle);
+bool decode_telemetry_frame(PacketReader &reader, TelemetryFrame &frame);
+bool read_telemetry_fields(PacketReader &reader, TelemetryFrame &frame);
+bool decode_delta_frame(PacketReader &reader, unsigned int vehicle, int32_t *fields);
+void store_telemetry_frame(unsigned int vehicle, unsigned char seq, const int32_t *fields);
+void frame_to_fields(const TelemetryFrame &frame, int32_t *fields);
+void fields_to_frame(const int32_t *fields, TelemetryFrame &frame);
+int32_t zigzag_decode(uint32_t value);
+void print_telemetry_frame(const TelemetryFrame &frame);
+float from_fixed_16(int16_t value, float scale);
+
+#endif // TELEMETRY_H
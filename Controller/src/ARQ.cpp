@@ -0,0 +1,191 @@
+#include "ARQ.h"
+#include "Communication.h"
+#include "Fleet.h"
+
+/*
+Sending side of the selective-repeat ARQ.
+Up to ARQ_WINDOW commands may be in flight, each of them is retransmitted on its own timeout until it is
+acknowledged. The timeout follows the measured round-trip time (smoothed RTT and its variation as in TCP),
+round-trip times of retransmitted commands are not measured, because it is not known which attempt
+was acknowledged. The airship processes the commands in the order of their sequence numbers.
+All commands due for transmission are packed into one packet, the airship acknowledges them all at once
+in its next telemetry packet. Every airship of the fleet has its own window and round-trip time (see Fleet.h).
+*/
+
+/**
+ * Checks whether a new command may be sent, i.e. the slot of the next sequence number is free.
+ * The oldest unacknowledged command is then never more than ARQ_WINDOW sequence numbers behind the new one,
+ * so the new command always fits into the receive window of the airship.
+ */
+bool arq_can_send(const VehicleSession &v) {
+  return !v.sendWindow[(uint16_t)(v.counter + 1) % ARQ_WINDOW].inUse;
+}
+
+/**
+ * Puts a new command into the window. It is sent by arq_service() and kept until it is acknowledged.
+ *
+ * @param v The session of the airship.
+ * @param cmd The command, its counter is the sequence number.
+ */
+void arq_submit(VehicleSession &v, const command& cmd) {
+  PendingCommand& pending = v.sendWindow[cmd.counter % ARQ_WINDOW];
+  pending.cmd = cmd;
+  pending.acked = false;
+  pending.rejected = false;
+  pending.held = false;
+  pending.attempts = 0;
+  pending.rto = v.currentRTO;
+  pending.sentAt = millis();
+  pending.inUse = true;
+  v.lastCmdConfirmed = false;
+}
+
+/**
+ * Releases acknowledged commands and sends the ones that are due in one packet, if the uplink slot is open
+ * and the airtime budget allows it (otherwise they stay due).
+ * It is called by the scheduler of the fleet (see Fleet.h).
+ * A command is due when it is new and has waited ARQ_BATCH_DELAY (or the window is full), or when its timeout expired.
+ * If the airship reported a corrupted frame, the oldest unacknowledged command is due immediately.
+ * Once something is sent, all new commands and a pending telemetry acknowledgement go with it.
+ *
+ * @param v The session of the airship.
+ * @return True if a packet was sent.
+ */
+bool arq_service(VehicleSession &v) {
+  bool slotOpen = tdma_uplink_open(v);  // commands are sent only in the uplink slot (see TDMA.h)
+  bool nack = false;
+  if (slotOpen) {
+    nack = v.nackArrived;
+    v.nackArrived = false;
+  }
+  bool empty = true;
+  unsigned long now = millis();
+  const command *batch[ARQ_WINDOW + 1];
+  PendingCommand *sent[ARQ_WINDOW];
+  unsigned int count = 0;
+  bool due = false;
+
+  // From the oldest sequence number, so that the commands are packed in their original order
+  for (uint16_t seq = v.counter - ARQ_WINDOW + 1; seq != (uint16_t)(v.counter + 1); seq++) {
+    PendingCommand& pending = v.sendWindow[seq % ARQ_WINDOW];
+    if (!pending.inUse || pending.cmd.counter != seq) continue;
+
+    if (pending.acked) {
+      if (pending.attempts == 1) arq_update_rto(v, pending.ackedAt - pending.sentAt);
+      link_stats_command_confirmed(pending.attempts, pending.ackedAt - pending.sentAt);
+      pending.inUse = false;
+      Serial.print("Confirmed "), Serial.println(seq);
+      if (pending.cmd.ID == all_ids.LINK_PROFILE) link_switch_confirmed(seq, pending.cmd.value);
+      if (pending.cmd.ID == all_ids.HOP_MODE) hop_confirmed(pending.cmd.value);
+      continue;
+    }
+    if (pending.rejected) {
+      pending.inUse = false;
+      if (pending.cmd.ID == all_ids.LINK_PROFILE) link_switch_refused(seq);
+      if (pending.cmd.ID == all_ids.HOP_MODE) hop_refused();
+      Serial.print("--- ERROR --- The airship refused the command "), Serial.println(seq);
+      continue;
+    }
+
+    empty = false;
+    if (!slotOpen) continue;
+    if (pending.attempts == 0) {
+      // In a TDMA frame the commands are batched by the slot itself
+      if (now - pending.sentAt >= ARQ_BATCH_DELAY || !arq_can_send(v) || tdma_synchronised(v)) due = true;
+    } else if (pending.held) {
+      continue;  // the airship has it, it only waits for an older command
+    } else if (now - pending.sentAt > pending.rto) {
+      pending.rto = constrain(2 * pending.rto, (unsigned int)ARQ_MIN_RTO, (unsigned int)ARQ_MAX_RTO);  // back off
+      due = true;
+    } else if (nack) {
+      nack = false;
+      due = true;
+    } else {
+      continue;  // sent recently, still waiting for the acknowledgement
+    }
+    batch[count] = &pending.cmd;
+    sent[count++] = &pending;
+  }
+  v.lastCmdConfirmed = empty;
+  if (!due) return false;
+
+  unsigned int total = count;
+  command ack;
+  bool withAck = v.telemetryAckPending;
+  if (withAck) {  // the telemetry acknowledgement travels with the commands
+    ack = command(all_ids.TELEMETRY_ACK, v.counter, v.telemetryAckSeq);
+    batch[total++] = &ack;
+  }
+  command setpoint;
+  bool withSetpoint = total <= ARQ_WINDOW && steering_due(v);  // so does the setpoint (see Steering.h), if the packet has room for it
+  if (withSetpoint) {
+    setpoint = steering_command(v);
+    batch[total++] = &setpoint;
+  }
+  if (!send_commands(v.address, batch, total, AIRTIME_COMMAND)) return false;
+  if (withAck) v.telemetryAckPending = false;
+  if (withSetpoint) steering_sent(v);
+  LoRa.receive();
+
+  for (unsigned int i = 0; i < count; i++) {
+    sent[i]->sentAt = now;
+    sent[i]->attempts++;
+    link_stats_command_sent(sent[i]->attempts);
+    if (sent[i]->attempts > 1) v.retransmissions++;
+    Serial.print(sent[i]->attempts == 1 ? "First attempt sent. Command counter - " : "Another attempt sent. Command counter - ");
+    Serial.print(sent[i]->cmd.counter), Serial.print(", command ID - "), Serial.println(sent[i]->cmd.ID);
+  }
+  return true;
+}
+
+/**
+ * Processes the acknowledgement carried by a telemetry packet. It is called from receive_service().
+ * All commands before nextExpected were processed by the airship (those with a bit in the refused bitmap were refused),
+ * the held bitmap marks the following commands that already arrived.
+ *
+ * @param v The session of the airship that sent the acknowledgement.
+ * @param flags ARQ_ACK_SESSION and ARQ_ACK_RESEND.
+ * @param nextExpected The sequence number of the next command the airship will process.
+ * @param held Bit i is set if the command nextExpected + i has arrived.
+ * @param refused Bit i is set if the command nextExpected - 1 - i was refused.
+ */
+void arq_acknowledged(VehicleSession &v, unsigned char flags, uint16_t nextExpected, unsigned char held, unsigned char refused) {
+  if (flags & ARQ_ACK_RESEND) v.nackArrived = true;
+  if (!(flags & ARQ_ACK_SESSION)) return;  // the airship has not received any command yet
+
+  for (unsigned int i = 0; i < ARQ_WINDOW; i++) {
+    PendingCommand& pending = v.sendWindow[i];
+    if (!pending.inUse || pending.acked || pending.rejected || pending.attempts == 0) continue;
+    int16_t distance = (int16_t)(pending.cmd.counter - nextExpected);
+    if (distance < 0) {
+      unsigned int age = -1 - distance;  // 0 for the last processed command
+      pending.ackedAt = millis();
+      if (age < 8 && (refused >> age) & 1) {
+        pending.rejected = true;
+      } else {
+        pending.acked = true;
+      }
+    } else if (distance < 8) {
+      pending.held = (held >> distance) & 1;
+    }
+  }
+}
+
+/**
+ * Updates the round-trip time estimate and the retransmission timeout of new commands (RFC 6298).
+ *
+ * @param v The session of the airship.
+ * @param rtt Measured round-trip time [ms].
+ */
+void arq_update_rto(VehicleSession &v, unsigned long rtt) {
+  if (!v.rttMeasured) {
+    v.srtt = rtt;
+    v.rttvar = rtt / 2;
+    v.rttMeasured = true;
+  } else {
+    unsigned long deviation = (v.srtt > rtt) ? v.srtt - rtt : rtt - v.srtt;
+    v.rttvar = (3 * v.rttvar + deviation) / 4;
+    v.srtt = (7 * v.srtt + rtt) / 8;
+  }
+  v.currentRTO = constrain(v.srtt + 4 * v.rttvar, (unsigned long)ARQ_MIN_RTO, (unsigned long)ARQ_MAX_RTO);
+}
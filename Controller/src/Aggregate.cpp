@@ -0,0 +1,49 @@
+#include "Aggregate.h"
+#include "Communication.h"
+
+// Indexed by AggregateField
+const AggregateFieldName aggregateFieldNames[AGGREGATE_FIELD_COUNT] = {
+  {"Height", 100, 2},             // sent in cm, printed in m
+  {"Power", 1, 1},
+  {"UltrasonicDistance", 1, 1},   // mm
+};
+
+/**
+ * Reads the aggregates section of a packet and prints it. It is called from receive_service().
+ * Format for each field: [number of samples (varint), optionally(mean (zig-zag varint), mean - minimum (varint),
+ * maximum - mean (varint), standard deviation in tenths (varint))]
+ *
+ * @param reader The received packet, positioned at the aggregates section.
+ * @param v The session of the airship.
+ * @return False if the packet is too short.
+ */
+bool aggregates_received(PacketReader &reader, const VehicleSession &v) {
+  uint32_t count[AGGREGATE_FIELD_COUNT];
+  int32_t mean[AGGREGATE_FIELD_COUNT];
+  uint32_t below[AGGREGATE_FIELD_COUNT], above[AGGREGATE_FIELD_COUNT], deviation[AGGREGATE_FIELD_COUNT];
+  for (unsigned int i = 0; i < AGGREGATE_FIELD_COUNT; i++) {
+    uint32_t raw;
+    if (!reader.read_varint(count[i])) return false;
+    if (count[i] == 0) continue;
+    if (!reader.read_varint(raw) || !reader.read_varint(below[i]) || !reader.read_varint(above[i]) || !reader.read_varint(deviation[i])) return false;
+    mean[i] = zigzag_decode(raw);
+  }
+
+  Serial.println("---");
+  if (fleet_count() > 1) {
+    Serial.print("Airship : "), Serial.println(fleet_index(v) + 1);
+  }
+  Serial.print("Time : "), Serial.println(millis());
+  Serial.println("Aggregate : 1");
+  for (unsigned int i = 0; i < AGGREGATE_FIELD_COUNT; i++) {
+    const AggregateFieldName &f = aggregateFieldNames[i];
+    Serial.print(f.name), Serial.print("Samples : "), Serial.println(count[i]);
+    if (count[i] == 0) continue;
+    Serial.print(f.name), Serial.print("Mean : "), Serial.println(mean[i] / f.scale, f.digits);
+    Serial.print(f.name), Serial.print("Min : "), Serial.println(((float)mean[i] - below[i]) / f.scale, f.digits);
+    Serial.print(f.name), Serial.print("Max : "), Serial.println(((float)mean[i] + above[i]) / f.scale, f.digits);
+    Serial.print(f.name), Serial.print("Std : "), Serial.println(deviation[i] / (10 * f.scale), f.digits + 1);
+  }
+  Serial.println("+++");
+  return true;
+}
@@ -0,0 +1,108 @@
+#include "Backlog.h"
+#include "Communication.h"
+
+/*
+The recorded frames come oldest first, each with its age, from which the controller computes the time
+at which it was recorded. All of them are older than the live frames, so while a download is running,
+the live frames of the airship are held back and printed after the last recorded frame. The serial output
+of every airship thus stays in time order. If more than BACKLOG_HELD_FRAMES live frames arrive during
+the download, the oldest of them is printed right away.
+*/
+
+HeldFrame heldFrames[FLEET_SIZE][BACKLOG_HELD_FRAMES];
+unsigned int heldFirst[FLEET_SIZE];
+unsigned int heldCount[FLEET_SIZE] = {0};
+volatile bool downloading[FLEET_SIZE] = {false};
+volatile unsigned long lastRecordsAt[FLEET_SIZE];
+
+/**
+ * Reads and prints the recorded frames of a beacon. It is called from receive_service().
+ *
+ * @param reader The received packet, positioned at the backlog section.
+ * @param v The session of the airship.
+ * @return False if the packet is too short.
+ */
+bool backlog_received(PacketReader &reader, VehicleSession &v) {
+  unsigned int vehicle = fleet_index(v);
+  unsigned char records;
+  int16_t waiting;
+  if (!reader.read_byte(records) || !reader.read_int16(waiting)) return false;
+  unsigned long now = millis();
+  for (unsigned int i = 0; i < records; i++) {
+    int32_t age;
+    TelemetryFrame frame;
+    if (!reader.read_int32(age) || !read_telemetry_fields(reader, frame)) return false;
+    print_measured_data(v, frame, now - (uint32_t)age, true);
+  }
+  lastRecordsAt[vehicle] = now;
+  downloading[vehicle] = (uint16_t)waiting > 0;
+  if (!downloading[vehicle]) backlog_flush(vehicle);
+  return true;
+}
+
+/**
+ * Holds a live frame back while recorded frames are being downloaded. It is called from receive_service().
+ *
+ * @param v The session of the airship.
+ * @param frame The live frame.
+ * @return True if the frame is held, False if it should be printed now.
+ */
+bool backlog_live_frame(VehicleSession &v, const TelemetryFrame &frame) {
+  unsigned int vehicle = fleet_index(v);
+  if (!downloading[vehicle] && heldCount[vehicle] == 0) return false;  // while older ones are held, it waits behind them
+  HeldFrame oldest;
+  if (heldCount[vehicle] == BACKLOG_HELD_FRAMES && pop_held_frame(vehicle, oldest)) {  // no more room, the oldest one goes out of order
+    print_measured_data(v, oldest.frame, oldest.time, false);
+  }
+  HeldFrame &held = heldFrames[vehicle][(heldFirst[vehicle] + heldCount[vehicle]) % BACKLOG_HELD_FRAMES];
+  held.time = millis();
+  held.frame = frame;
+  heldCount[vehicle]++;
+  return true;
+}
+
+/**
+ * Ends the downloads that have stalled, e.g. because the link was lost again, and prints their held frames.
+ * It is called in every pass of the main loop.
+ */
+void backlog_service(void) {
+  for (unsigned int i = 0; i < FLEET_SIZE; i++) {
+    if (downloading[i] && millis() - lastRecordsAt[i] > BACKLOG_STALL_TIMEOUT) downloading[i] = false;
+    if (downloading[i]) continue;
+    while (true) {
+      HeldFrame held;
+      if (!pop_held_frame(i, held)) break;
+      print_measured_data(fleet[i], held.frame, held.time, false);
+    }
+  }
+}
+
+/**
+ * Prints the live frames held back during a download. It is called from receive_service().
+ */
+void backlog_flush(unsigned int vehicle) {
+  HeldFrame held;
+  while (pop_held_frame(vehicle, held)) print_measured_data(fleet[vehicle], held.frame, held.time, false);
+}
+
+/**
+ * Takes the oldest held frame of an airship.
+ *
+ * @return False if none is held.
+ */
+bool pop_held_frame(unsigned int vehicle, HeldFrame &held) {
+  if (heldCount[vehicle] == 0) return false;
+  held = heldFrames[vehicle][heldFirst[vehicle]];
+  heldFirst[vehicle] = (heldFirst[vehicle] + 1) % BACKLOG_HELD_FRAMES;
+  heldCount[vehicle]--;
+  return true;
+}
+
+/**
+ * Forgets the download of an airship, e.g. when its session starts.
+ */
+void backlog_reset(unsigned int vehicle) {
+  downloading[vehicle] = false;
+  heldFirst[vehicle] = 0;
+  heldCount[vehicle] = 0;
+}
@@ -0,0 +1,127 @@
+#include "Capture.h"
+#include "Communication.h"
+
+/*
+Packets are captured in the main loop, received ones by receive_service() and sent ones by transmit_packet().
+Both only copy the record into a ring buffer. The buffer is printed by capture_service(), so the radio never waits
+for the serial port.
+If the buffer is full, the record is dropped and counted.
+*/
+
+unsigned char captureBuffer[CAPTURE_BUFFER_SIZE];
+volatile unsigned long captureHead = 0;   // bytes put into the buffer so far
+volatile unsigned long captureTail = 0;   // bytes printed so far
+volatile unsigned long captureDropped = 0;
+volatile bool captureOn = false;
+
+/**
+ * Turns the capture on or off (the 'capture' command). Each capture starts with its header.
+ */
+void capture_toggle(void) {
+  if (captureOn) {
+    captureOn = false;
+    Serial.println("Capture off.");
+    return;
+  }
+  unsigned char header[CAPTURE_HEADER_SIZE];
+  PacketWriter writer(header, sizeof(header));
+  write_capture_header(writer, CAPTURE_DEVICE_CONTROLLER);
+  Serial.println("Capture on.");
+  print_capture_line(header, writer.length());
+  noInterrupts();
+  captureTail = captureHead;  // nothing older than the header
+  captureOn = true;
+  interrupts();
+}
+
+/**
+ * Records one packet. It is called from receive_service() and transmit_packet().
+ *
+ * @param direction CAPTURE_RECEIVED or CAPTURE_SENT.
+ * @param data The whole packet, including its CRC and FEC.
+ * @param length Length of the packet.
+ * @param time millis() at the reception or the transmission.
+ * @param rssi RSSI of a received packet [dBm].
+ * @param snr SNR of a received packet [dB].
+ */
+void capture_packet(unsigned char direction, const unsigned char *data, unsigned int length, unsigned long time, int rssi, float snr) {
+  if (!captureOn) return;
+  unsigned char header[CAPTURE_RECORD_HEADER_SIZE];
+  PacketWriter writer(header, sizeof(header));
+  writer.put_int32(time);
+  writer.put_byte(direction);
+  writer.put_byte((int8_t)rssi);
+  writer.put_byte((int8_t)(snr * 4));
+  writer.put_byte(currentProfile);
+  writer.put_byte(length);
+
+  noInterrupts();
+  if (captureHead - captureTail + CAPTURE_RECORD_HEADER_SIZE + length > CAPTURE_BUFFER_SIZE) {
+    captureDropped++;
+    interrupts();
+    return;
+  }
+  for (unsigned int i = 0; i < CAPTURE_RECORD_HEADER_SIZE; i++) captureBuffer[captureHead++ % CAPTURE_BUFFER_SIZE] = header[i];
+  for (unsigned int i = 0; i < length; i++) captureBuffer[captureHead++ % CAPTURE_BUFFER_SIZE] = data[i];
+  interrupts();
+}
+
+/**
+ * Prints the captured records. It is called in every pass of the main loop.
+ */
+void capture_service(void) {
+  unsigned char record[CAPTURE_RECORD_HEADER_SIZE + PACKET_CAPACITY];
+  while (captureTail != captureHead) {  // the records are complete, capture_packet() puts them in with interrupts off
+    unsigned int length = CAPTURE_RECORD_HEADER_SIZE + captureBuffer[(captureTail + CAPTURE_RECORD_HEADER_SIZE - 1) % CAPTURE_BUFFER_SIZE];
+    for (unsigned int i = 0; i < length; i++) record[i] = captureBuffer[(captureTail + i) % CAPTURE_BUFFER_SIZE];
+    captureTail += length;
+    print_capture_line(record, length);
+  }
+  if (captureDropped > 0) {
+    Serial.print("Capture: "), Serial.print(captureDropped), Serial.println(" packets not recorded, the buffer was full");
+    captureDropped = 0;
+  }
+}
+
+/**
+ * Passes a captured packet to the receive path, as if the radio had received it (the same path as receive_service()).
+ * It is used by the replay of Tools/CaptureTool in a native build. The packet gets the current time
+ * and a signal quality of 0, not the captured ones.
+ *
+ * @param data The whole packet, including its CRC and FEC.
+ * @param length Length of the packet.
+ */
+void capture_replay(const unsigned char *data, unsigned int length) {
+  if (length > PACKET_CAPACITY) return;
+  memcpy(rxPacket.data, data, length);
+  rxPacket.length = length;
+  rxPacket.time = millis();
+  rxPacket.timeMicros = micros();
+  rxPacket.rssi = 0;
+  rxPacket.snr = 0;
+  process_received_packet();
+}
+
+/**
+ * Writes the header of a capture session.
+ *
+ * @param device CAPTURE_DEVICE_CONTROLLER or CAPTURE_DEVICE_AIRSHIP.
+ */
+void write_capture_header(PacketWriter &writer, unsigned char device) {
+  writer.put_int32(CAPTURE_MAGIC);
+  writer.put_byte(CAPTURE_VERSION);
+  writer.put_byte(device);
+  writer.put_int16(0);
+}
+
+/**
+ * Prints a header or a record as one line of the serial capture: "CAP " and the bytes in hex.
+ */
+void print_capture_line(const unsigned char *data, unsigned int length) {
+  Serial.print("CAP ");
+  for (unsigned int i = 0; i < length; i++) {
+    if (data[i] < 0x10) Serial.print('0');
+    Serial.print(data[i], HEX);
+  }
+  Serial.println();
+}
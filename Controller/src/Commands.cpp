@@ -3,6 +3,18 @@
 commandID all_ids;
 BalloonREPORT report;
 
+/**
+ * Checks whether a command carries a value in its packet (see send_commands()), the same list as on the airship.
+ *
+ * @param commandID The ID of the command.
+ * @return True if a 4-byte value follows the ID.
+ */
+bool command_has_value(unsigned char commandID) {
+  return commandID == all_ids.SET_EXACT_HEIGHT || commandID == all_ids.POTENTIOMETER_ANGLE || commandID == all_ids.SET_MOTOR_POWER
+      || commandID == all_ids.TELEMETRY_ACK || commandID == all_ids.LINK_PROFILE || commandID == all_ids.ASSIGN_ADDRESS
+      || commandID == all_ids.FLEET_SLOTS || commandID == all_ids.CONTROL_SETPOINT || commandID == all_ids.HOP_MODE || commandID == all_ids.QUERY;
+}
+
 /**
  * Reads user input and generates commands for balloon control.
  * Handles button presses and serial input.
@@ -24,10 +36,6 @@ bool get_command(command& cmd){
     process_command(cmd, all_ids.DOWN, neww);
   }else if(!digitalRead(FlyForwardButton) and (millis() - timeOfLastCommand) > buttonInterval) {
     process_command(cmd, all_ids.FLY_FORWARD, neww);
-  }else if(angle_change()){
-    process_command(cmd, all_ids.POTENTIOMETER_ANGLE, neww, last_angle);
-  }else if((millis() - lastSendTime) > timeInterval){
-    process_command(cmd, all_ids.SAY_HI, neww);
   }
 
   if(neww && cmd.ID != all_ids.SAY_HI){
@@ -82,14 +90,26 @@ String read_serial_input() {
 void process_value_input(const String& lowerInput, command& cmd, bool& neww, int index) {
   String text = lowerInput.substring(0, index);
   text.replace(" ", ""); // Replace spaces
+  if (text == "get" || text == "subscribe") {
+    query_input(lowerInput.substring(index + 1), text == "subscribe");  // names of variables (see Query.h)
+    return;
+  }
   float value = lowerInput.substring(index + 1).toFloat(); // +1 for skipping "|"
 
   if (text == "height" && value != 0) {
     process_command(cmd, all_ids.SET_EXACT_HEIGHT, neww, value);
     Serial.print("NEW HEIGHT: "), Serial.print(value), Serial.println(" [m]");
-  } else if (text == "power" && value != 0) {
-    process_command(cmd, all_ids.SET_MOTOR_POWER, neww, value);
+  } else if (text == "power" && value > 0 && value <= 180) {
+    VehicleSession &v = selected_vehicle();
+    steering_input(v, v.steeringAngle, value);  // sent with the steering angle (see Steering.h)
     Serial.print("NEW POWER OF STEERING MOTOR: "), Serial.print(value), Serial.println(" [-]");
+  } else if (text == "vehicle" && value >= 1 && value <= FLEET_SIZE) {
+    selectedVehicle = (unsigned int)value - 1;  // the commands go to this airship from now on
+    Serial.print("SELECTED AIRSHIP: "), Serial.print((unsigned int)value);
+    Serial.println(selected_vehicle().active ? "" : " (not in the fleet yet)");
+  } else if (text == "duty" && value > 0 && value <= 100) {
+    airtimeDutyCycle = value;  // only for the controller's transmissions (see Airtime.h)
+    Serial.print("NEW DUTY CYCLE OF THE CONTROLLER: "), Serial.print(value), Serial.println(" [%]");
   } else {
     Serial.println("INVALID COMMAND!");
   }
@@ -118,6 +138,21 @@ void process_text_input(const String& lowerInput, command& cmd, bool& neww) {
       Serial.println("The rotary potentiometer (steering encoder) has been centered.");
     } else if(lowerInput == "off" || lowerInput == "off\n") {
       process_command(cmd, all_ids.MOTORS_OFF, neww);
+    }else if (lowerInput == "stats" || lowerInput == "stats\n") {
+        print_link_statistics();
+    }else if (lowerInput == "fleet" || lowerInput == "fleet\n") {
+        print_fleet();
+    }else if (lowerInput == "backlog" || lowerInput == "backlog\n") {
+      process_command(cmd, all_ids.BACKLOG_REQUEST, neww);
+    }else if (lowerInput == "hop" || lowerInput == "hop\n") {
+        hop_toggle();
+    }else if (lowerInput == "capture" || lowerInput == "capture\n") {
+        capture_toggle();
+    }else if (lowerInput == "variables" || lowerInput == "variables\n") {
+        print_query_variables();
+    }else if (lowerInput == "profile" || lowerInput == "profile\n") {
+      print_profile(Serial);  // of the controller, the airship prints its own (see Profiler.h)
+      process_command(cmd, all_ids.PROFILE_DUMP, neww);
     }else if (lowerInput == "help" || lowerInput == "help\n") {
         display_help();
     } else {
@@ -127,30 +162,20 @@ void process_text_input(const String& lowerInput, command& cmd, bool& neww) {
 
 /**
  * Processes a command based on the provided command ID. 
- * It resets the counter if needed, updates the command structure with the new command ID and counter, 
+ * It updates the command structure with the new command ID and the next sequence number of the selected airship
  * and sets the flag indicating that a new command has been processed.
+ * "SAY_HI" (also an invalid command turns into it) is not confirmed, so it does not take a sequence number,
+ * otherwise the airship would wait for it (see fleet_command()).
  *
  * @param cmd A reference to the command structure where the command details are stored.
  * @param commandID The ID of the command to be processed.
  * @param neww A reference to a boolean flag indicating if a new command is received.
  */
 void process_command(command& cmd, int commandID, bool& neww, float value = -1) {
-  reset_counter_if_needed();
-  command temporary_cmd(commandID, counter, value);
-  cmd = temporary_cmd;
+  cmd = fleet_command(selected_vehicle(), commandID, value);
   neww = true;
 }
 
-/**
- * Resets the global counter to zero if it reaches its maximum value (127).
- * This ensures that the counter always fits into one byte, useful for packet size constraints.
- */
-void reset_counter_if_needed() {
-    if (counter++ >= 127) {
-        counter = 0;
-    }
-}
-
 /**
  * Displays help information on the serial monitor.
  * Provides guidance on the commands that can be used to control the balloon.
@@ -168,6 +193,20 @@ void display_help() {
   Serial.println();
   Serial.println("If you want to centre the rotation potentiometer (rotary encoder) type 'centre'.");
   Serial.println();
+  Serial.println("If you want to change the share of time the controller may transmit, enter 'duty' followed by the duty cycle in percent, separated by '|'. E.g. 'duty | 10'.");
+  Serial.println();
+  Serial.println("If you want to see the link statistics (packet rates, loss, retransmissions, RSSI, SNR and round-trip time) type 'stats'.");
+  Serial.println();
+  Serial.println("If you want to download all telemetry recorded by the airship (it is downloaded automatically after a loss of the link) type 'backlog'.");
+  Serial.println("If you want to switch the frequency hopping on or off (only with a single airship) type 'hop'.");
+  Serial.println("If you want to print every packet sent or received in the capture format (see Tools/CaptureTool) type 'capture'.");
+  Serial.println("If you want a snapshot of chosen variables of the airship type 'get | names', e.g. 'get | IntegralPart FixAge'.");
+  Serial.println("If you want only chosen variables instead of the telemetry type 'subscribe | period names', e.g. 'subscribe | 500 CurrentHeight'; 'subscribe | 0' ends it.");
+  Serial.println("If you want the names of the variables type 'variables'.");
+  Serial.println("If you want the runtime profile (CPU of the threads, stacks, times of the measured functions) type 'profile'. The airship prints its own to its USB serial and SD card. It needs the firmware built with the profiler (see Profiler.h).");
+  Serial.println();
+  Serial.println("If you want to see the airships in the fleet type 'fleet'. To control another one, enter 'vehicle' followed by its number, separated by '|'. E.g. 'vehicle | 2'.");
+  Serial.println();
   Serial.println("Another option is to control the balloon directly from the controller.");
   Serial.println();
 }
\ No newline at end of file
@@ -1,50 +1,104 @@
 #include "Communication.h"
 
-bool LAND = false;
-bool FLY_FORWARD = false;
+unsigned char localAddress = 0xBB;         // address of this device, the airships have their addresses from the fleet (see Fleet.h)
 
-unsigned char localAddress = 0xBB;         // address of this device
-unsigned char destinationAddress = 0x11;   // address of reciver
-
-unsigned int counter = 0;         // msg counter
-long lastSendTime = 0;            // last send time
-long lastReceivedTime = 0;        // last received time
+long lastReceivedTime = 0;        // last received time (from any airship)
 long timeOfLastCommand = 0;       // time at witch last command was entered
 int timeInterval = 5400;          // Interval between sending times
 int buttonInterval = 800;         // Interval between button presses
-bool lastCmdConfirmed = true;     // true if last command was confirmed by balloon
-bool confirmation_arrived = true; // true if answer(confirmation) from balloon arrived
+
+PacketBuffer rxPacket; // The packet being processed, it is written only from receive_service() (and capture_replay())
 
 /**
- * Handles the incoming LoRa messages. It processes different types of messages based on their format and content.
- * If the message is not for this device or if the packet size is zero, the function returns without processing.
- * It also checks for parity to ensure data integrity.
+ * Handles the incoming LoRa messages. If the packet size is zero, the function returns without processing.
+ * It runs in the LoRa interrupt, so it only puts the packet into the receive queue (see ReceiveQueue.h),
+ * the packet is processed by receive_service().
  * 
  * @param packetSize The size of the incoming packet.
  */
 void onReceive(int packetSize) {
+  PROFILE_SECTION(PROFILE_ON_RECEIVE);  // see Profiler.h
   if (packetSize == 0) return;  // exit the function if no packet received
+  receive_queue_push(packetSize);
+}
 
-  unsigned char recipientAddres = LoRa.read(); // recipient address
-  if (!MsgIsForMe(recipientAddres)) return;  // if not for this device, exit
-  lastReceivedTime = millis(); // update time of the last received message
+/**
+ * Processes the packets received since the last pass of the main loop.
+ */
+void receive_service(void) {
+  PROFILE_SECTION(PROFILE_RECEIVE_SERVICE);
+  while (receive_queue_pop(rxPacket)) {
+    capture_packet(CAPTURE_RECEIVED, rxPacket.data, rxPacket.length, rxPacket.time, rxPacket.rssi, rxPacket.snr);  // see Capture.h
+    process_received_packet();
+  }
+}
 
-  unsigned char sender = LoRa.read();  // sender address
+/**
+ * Processes the packet in rxPacket based on its format and content.
+ * If the message is not for this device, the function returns without processing.
+ * It also checks the CRC (see Framing.h) to ensure data integrity.
+ * Telemetry is passed to the session of its sender (see Fleet.h), join requests open a new session.
+ */
+void process_received_packet(void) {
+  FrameStatus frameStatus = check_frame(rxPacket);
+  link_stats_frame_checked(frameStatus);
+  if (frameStatus == FRAME_CORRUPTED) {  // CRC does not match and the error could not be corrected
+    Serial.println("Corrupted frame.");
+    return;
+  }
+  PacketReader reader(rxPacket.data, rxPacket.length);
+
+  unsigned char recipientAddres; // recipient address
+  if (!reader.read_byte(recipientAddres) || !MsgIsForMe(recipientAddres)) return;  // if not for this device, exit
+  lastReceivedTime = rxPacket.time; // update time of the last received message
+  link_record_packet(rxPacket.snr, rxPacket.rssi); // SNR and RSSI for the link adaptation
+
+  unsigned char sender;  // sender address
+  unsigned char status;  // airship status
+  unsigned char type_of_msg;
+  reader.read_byte(sender);
+  reader.read_byte(status);
+  reader.read_byte(type_of_msg);
+  if (!reader.ok()) return;  // truncated header
+
+  if (type_of_msg == report.JOIN_REQUEST){
+    handle_join_request(reader);
+    return;
+  }
+  VehicleSession *v = fleet_vehicle(sender);
+  if (v == NULL) v = fleet_discover(sender);
+  if (v == NULL) {
+    Serial.println("Unknown sender.");
+    return;
+  }
+  v->lastReceivedTime = lastReceivedTime;
+  v->packetsReceived++;
+  v->snr = rxPacket.snr;
+  v->rssi = rxPacket.rssi;
 
   // Process airship status message
-  process_airship_status();
+  process_airship_status(*v, status);
 
   // Determine the type of the message and handle accordingly
-  unsigned char type_of_msg = LoRa.read();
-  if (type_of_msg == report.CONFIRMATION){
-    handle_confirmation_message();
-  }else if (type_of_msg == report.MEASURED_DATA){
-    handle_measured_data_message();
+  if (type_of_msg == report.MEASURED_DATA){
+    handle_measured_data_message(*v, reader, (status >> 5) & 1, (status >> 3) & 1, (status >> 4) & 1, (status >> 6) & 1, (status >> 7) & 1);
   }else{
     Serial.println("Corrupted or unknown message type.");
   }
 }
 
+/**
+ * Handles a join request of a new airship (see Fleet.h).
+ * Format: [random number of the airship (2 bytes)]
+ *
+ * @param reader The received packet, positioned behind the message type.
+ */
+void handle_join_request(PacketReader &reader) {
+  int16_t nonce;
+  if (!reader.read_int16(nonce)) return;
+  fleet_join_request((uint16_t)nonce);
+}
+
 /**
  * Determines if a received message is intended for this device.
  * 
@@ -60,184 +114,204 @@ bool MsgIsForMe(byte recipientAddres) {
 }
 
 /**
- * Processes actual airship status message received from the LoRa module. 
- * Reads actual states and its parity bit, checks for parity correctness
- * and updates the global variable accordingly.
- */
-void process_airship_status(void) {
-  bool landingStatus = 0;
-  bool landingParity = 0;
-  bool flyingStatus = 0;
-  bool flyingParity = 0;
-
-  unsigned char one_byte = LoRa.read();
-  decode_from_byte(landingStatus, landingParity, flyingStatus, flyingParity, one_byte);
-  updates_landing_status(landingStatus, landingParity);
-  updates_flying_status(flyingStatus, flyingParity);
-}
-
-/**
- * Function to read the values of boolean variables x, y, z, w from a single unsigned char variable one_byte.
-*/
-void decode_from_byte(bool &x, bool &y, bool &z, bool &w, unsigned char one_byte){
-  x = (one_byte >> 6) & 1;
-  y = (one_byte >> 4) & 1;
-  z = (one_byte >> 2) & 1;
-  w = one_byte & 1;
-}
-
-/**
- * Checks for parity correctness and updates the global landing status accordingly.
+ * Processes actual airship status byte received from the LoRa module and updates the session of the airship accordingly.
+ * Format is 'AQHK SBLF' (A = aggregates in the packet, Q = query section instead of the telemetry frame, H = hopping state in the packet, K = recorded frames in the packet, S = link statistics in the packet,
+ * see handle_measured_data_message(), B = beacon of a TDMA frame, L = land, F = fly_forward).
  */
-void updates_landing_status(bool landingStatus, bool landingParity) {
-  if (check_parity(landingStatus, landingParity)) {
-      LAND = (landingStatus == 1); // update landing status
-  }
+void process_airship_status(VehicleSession &v, unsigned char one_byte) {
+  if ((one_byte >> 2) & 1) tdma_beacon_received(v, rxPacket.time); // synchronise the slots (see TDMA.h)
+  if (((one_byte >> 2) & 1) && !((one_byte >> 5) & 1)) hop_plain_beacon(v); // the airship does not hop (see Hopping.h)
+  v.land = (one_byte >> 1) & 1; // update landing status
+  v.flyForward = one_byte & 1; // update flying status
 }
 
 /**
- * Checks for parity correctness and updates the global flying forward status accordingly.
+ * Handles measured data messages received from the LoRa module.
+ * Passes the acknowledgement of the commands to the command window (see ARQ.h),
+ * then decodes the binary telemetry frame (keyframe or delta) and prints the values to the serial monitor.
+ * Format: [command acknowledgement, link report, optionally(hopping state), optionally(link statistics), optionally(recorded frames),
+ * optionally(aggregates), telemetry frame or query section]
+ * The recorded frames (see Backlog.h) are printed first, the live frame may be held back behind them.
+ *
+ * @param v The session of the airship that sent the message.
+ * @param reader The received packet, positioned behind the message type.
+ * @param hop True if the frame number and the channel mask follow the link report (see Hopping.h).
+ * @param stats True if the airship's link statistics precede the telemetry frame (see LinkStats.h).
+ * @param backlog True if recorded frames precede the telemetry frame.
+ * @param query True if the variables asked for by a query (see Query.h) come instead of the telemetry frame.
+ * @param aggregates True if the aggregates of the fast values (see Aggregate.h) precede the telemetry frame.
  */
-void updates_flying_status(bool flyingStatus, bool flyingParity) {
-  if (check_parity(flyingStatus, flyingParity)) {
-      FLY_FORWARD = (flyingStatus == 1); // update flying status
-  }
-}
+void handle_measured_data_message(VehicleSession &v, PacketReader &reader, bool hop, bool stats, bool backlog, bool query, bool aggregates) {
+  PROFILE_SECTION(PROFILE_MEASURED_DATA);
+    if (!handle_command_ack(v, reader) || !handle_link_report(reader) || (hop && !hop_beacon(reader, v, rxPacket.time)) || (stats && !link_stats_remote_counters(reader, fleet_index(v)))) {
+        Serial.println("Truncated acknowledgement.");
+        return;
+    }
+    if (backlog && !backlog_received(reader, v)) {
+        Serial.println("Truncated backlog.");
+        return;
+    }
+    if (aggregates && !aggregates_received(reader, v)) {
+        Serial.println("Truncated aggregates.");
+        return;
+    }
+    if (query) {
+        if (!query_received(reader, v)) Serial.println("Truncated query answer.");
+        return;
+    }
 
-/**
- * Handles confirmation messages received from the LoRa module.
- * Reads the confirmation counter and its parity bit, checks for parity correctness,
- * and validates the confirmation. If valid, updates global confirmation variable.
- */
-void handle_confirmation_message() {
-  unsigned int confirmedCounter; 
-  bool counterParity;
-  ExtractCounterFromByte(confirmedCounter, counterParity, LoRa.read());
-  if (check_parity(confirmedCounter, counterParity)) {
-    String confirmationResponse = read_LoRa_string(); // Read the rest of the message
-
-    if (confirmationResponse == "VALID" && confirmedCounter == counter) {
-        lastCmdConfirmed = true;
-        confirmation_arrived = true;
-        Serial.println("Confirmed");
-    } else {
-        Serial.print("--- ERROR --- Counter: "), Serial.print(confirmedCounter);
-        Serial.print(", Response: "), Serial.println(confirmationResponse);
+    TelemetryFrame frame;
+    if (!decode_telemetry(reader, frame, v)) {
+        Serial.print("Corrupted telemetry frame, length: "), Serial.println(rxPacket.length);
+        return;
+    }
+    if (!backlog_live_frame(v, frame)) {
+        print_measured_data(v, frame, millis(), false);
     }
-  }
 }
 
 /**
- * Handles measured data messages received from the LoRa module.
- * Reads the entire data message as a string and prints it to the serial monitor.
+ * Prints one telemetry frame of an airship to the serial monitor.
+ * With more than one airship, the number of the airship is printed before the values.
+ *
+ * @param v The session of the airship.
+ * @param frame The frame.
+ * @param time The time at which the values were measured (controller's millis()).
+ * @param recorded True for a frame from the backlog of the airship (see Backlog.h).
  */
-void handle_measured_data_message() {
-    String dataReport = read_LoRa_string(); // Read the data report
+void print_measured_data(const VehicleSession &v, const TelemetryFrame &frame, unsigned long time, bool recorded) {
     Serial.println("---"); // start new data
-    Serial.print(dataReport);
-    Serial.println("+++"); // end new data
-}
-
-/**
- * Reads a string from the LoRa module.
- * 
- * @return The concatenated string from the LoRa module.
- */
-String read_LoRa_string() {
-    String data = "";
-    while (LoRa.available()) {
-        data += (char)LoRa.read(); // Concatenate bytes into a string
+    if (fleet_count() > 1) {
+        Serial.print("Airship : "), Serial.println(fleet_index(v) + 1);
     }
-    return data;
+    Serial.print("Time : "), Serial.println(time);
+    if (recorded) Serial.println("Recorded : 1");
+    print_telemetry_frame(frame);
+    Serial.println("+++"); // end new data
 }
 
 /**
- * Sends a command using LoRa communication in a specific format.
- * Format: [recipient address, local address, counter, parity for counter, command ID, optionally (parity bit, required height)]
- * Note: When using "LoRa.write()", the argument must be less than or equal to one byte.
- * 
- * @param cmd The command structure containing the details of the command to be sent.
+ * Reads the acknowledgement of the commands at the beginning of a telemetry packet.
+ * Format: [flags, next expected sequence number (2 bytes), held bitmap, refused bitmap]
+ *
+ * @param v The session of the airship that sent the acknowledgement.
+ * @param reader The received packet, positioned behind the message type.
+ * @return False if the packet is too short.
  */
-void send_command(const command& cmd) {
-  LoRa.beginPacket();                        // start packet
-  LoRa.write(destinationAddress);            // add destination address
-  LoRa.write(localAddress);                  // add sender's (local) address
-  LoRa.write(createCounterByte(cmd.counter));           // add counter and its parity
-  LoRa.write(cmd.ID);                        // add command ID to identify the command type
-
-  // For specific commands, add additional data and parity bit
-  if (cmd.ID == all_ids.SET_EXACT_HEIGHT || cmd.ID == all_ids.POTENTIOMETER_ANGLE || cmd.ID == all_ids.SET_MOTOR_POWER) {
-    LoRa.println(GetValueWithParity(cmd.value));
-  }
-  LoRa.endPacket();                          // finish and send the packet
+bool handle_command_ack(VehicleSession &v, PacketReader &reader) {
+  unsigned char flags, held, refused;
+  int16_t nextExpected;
+  reader.read_byte(flags);
+  reader.read_int16(nextExpected);
+  reader.read_byte(held);
+  reader.read_byte(refused);
+  if (!reader.ok()) return false;
+  arq_acknowledged(v, flags, nextExpected, held, refused);
+  return true;
 }
 
 /**
- * Combines a counter value with a parity bit.
- * 
- * @param counter The counter value to be encoded.
- * @return Returns the encoded counter as an unsigned char, with parity information in the MSB.
+ * Reads the signal quality of the controller's packets as measured by the airship (see LinkAdaptation.h).
+ * Format: [SNR in quarters of dB, RSSI in dBm] (both signed bytes)
+ *
+ * @param reader The received packet, positioned behind the command acknowledgement.
+ * @return False if the packet is too short.
  */
-unsigned char createCounterByte(unsigned int counter){
-  unsigned char inp = (unsigned char)(counter & 0x7F);
-  bool parityBit = get_even_parity(counter);
-  if (parityBit)
-    inp |= 0x80; // set MSB to 1
-  return inp;
+bool handle_link_report(PacketReader &reader) {
+  unsigned char snr, rssi;
+  reader.read_byte(snr);
+  reader.read_byte(rssi);
+  if (!reader.ok()) return false;
+  link_remote_report((int8_t)snr / 4.0, (int8_t)rssi);
+  link_stats_remote_report((int8_t)snr / 4.0, (int8_t)rssi);
+  return true;
 }
 
 /**
- * Extracts counter value and its parity from a received byte.
+ * Sends one command using LoRa communication (see send_commands()).
  * 
- * @param counter Reference to store the extracted counter.
- * @param counterParity Reference to store the extracted parity.
- * @param rByte The byte from which the counter and parity are extracted.
+ * @param address The address of the airship.
+ * @param cmd The command structure containing the details of the command to be sent.
+ * @param trafficClass Traffic class for the airtime budget.
+ * @return False if the airtime budget did not allow the packet.
  */
-void ExtractCounterFromByte(unsigned int &counter, bool &counterParity, unsigned char rByte){
-  counter = rByte & 0x7F;
-  counterParity = (rByte >> 7) & 1;
+bool send_command(unsigned char address, const command& cmd, AirtimeClass trafficClass) {
+  const command *cmds[1] = {&cmd};
+  return send_commands(address, cmds, 1, trafficClass);
 }
 
 /**
- * Encodes an integer value by appending a parity bit.
- * This function calculates the even parity for the input value, then shifts the value left by 1 bit and appends the parity bit at the least significant bit.
+ * Sends several commands in one packet using LoRa communication in a specific format.
+ * Format: [recipient address, local address, number of commands, commands, CRC, FEC]
+ * Command: [counter (2 bytes), command ID, optionally (value)]
  * 
- * @param value The integer value to encode with a parity bit.
- * @return Returns the value encoded with a parity bit.
+ * The packet is sent only if the airtime budget of its traffic class allows it (see Airtime.h).
+ *
+ * @param address The address of the airship.
+ * @param cmds The commands to be sent.
+ * @param count Number of the commands.
+ * @param trafficClass Traffic class for the airtime budget.
+ * @return False if the airtime budget did not allow the packet, nothing was sent then.
  */
-int GetValueWithParity(int value){
-  bool parity = get_even_parity((unsigned int)value);
-  int modifiedNumber = (value << 1) | parity;
-  return modifiedNumber;
+bool send_commands(unsigned char address, const command *cmds[], unsigned int count, AirtimeClass trafficClass) {
+  PROFILE_SECTION(PROFILE_SEND_COMMANDS);
+  unsigned char data[PACKET_CAPACITY];       // the packet is built on the stack, no heap is used
+  PacketWriter writer(data, sizeof(data));
+  writer.put_byte(address);                  // add destination address
+  writer.put_byte(localAddress);             // add sender's (local) address
+  writer.put_byte(count);                    // add number of commands
+
+  for (unsigned int i = 0; i < count; i++) {
+    const command& cmd = *cmds[i];
+    writer.put_int16(cmd.counter);           // add counter (sequence number)
+    writer.put_byte(cmd.ID);                 // add command ID to identify the command type
+
+    // For specific commands, add additional data
+    if (command_has_value(cmd.ID)) {
+      writer.put_int32(cmd.value);
+    }
+  }
+  if (!airtime_allowed(trafficClass, writer.length() + CRC_SIZE + FEC_SIZE)) return false;
+  if (transmit_packet(writer)) {             // add CRC and FEC and send the whole packet
+    link_stats_packet_sent();
+  }
+  return true;
 }
 
 /**
- * Calculates the even parity bit for a given number.
- * 
- * @param number The number for which to calculate the parity bit.
- * @return The calculated parity bit (0 or 1).
+ * Acknowledges the last received telemetry keyframe of an airship, so that the blimp can send deltas against it.
+ * The acknowledgement carries the counter of the last command, the blimp neither confirms it nor uses the counter.
+ * If the airtime budget does not allow it, it stays pending.
+ *
+ * @param v The session of the airship.
+ * @return True if it was sent.
  */
-bool get_even_parity(unsigned int number) {
-  bool parityBit = 0;
-  while (number) {
-    parityBit ^= number & 1; // XOR operation between the least significant bit and the current parity bit
-    number >>= 1;  /// Shift the number right by one bit to process the next bit
-  }
-
-  return parityBit;
+bool send_telemetry_ack(VehicleSession &v) {
+  command ack(all_ids.TELEMETRY_ACK, v.counter, v.telemetryAckSeq);
+  if (!send_command(v.address, ack, AIRTIME_TELEMETRY)) return false;
+  v.telemetryAckPending = false;
+  LoRa.receive();
+  return true;
 }
 
 /**
- * Checks if the parity of a given number matches the provided original parity.
- * 
- * @param number The number whose parity is to be checked.
- * @param originalParity The original parity bit received with the number.
- * @return True if the calculated parity matches the original parity, False otherwise.
+ * Answers a join request (see Fleet.h). The airship is still at FLEET_JOIN_ADDRESS, the command is not confirmed,
+ * the airship repeats its request if the answer is lost.
+ * Value of ASSIGN_ADDRESS: [random number of the airship (upper 2 bytes), index in the fleet, number of TDMA slots]
+ *
+ * @param v The new session of the airship.
+ * @param slots The number of TDMA slots.
+ * @return True if it was sent.
  */
-bool check_parity(unsigned int number, bool originalParity) {
-  bool currentParity = get_even_parity(number);
-  if (currentParity == originalParity){return true;}
-  else {return false;}
+bool send_assignment(VehicleSession &v, unsigned int slots) {
+  command assign(all_ids.ASSIGN_ADDRESS, 0, 0);
+  uint32_t value = ((uint32_t)v.nonce << 16) | (fleet_index(v) << 8) | slots;  // unsigned, a nonce from 0x8000 up reaches the sign bit
+  assign.value = (int32_t)value;  // too wide for the float argument of the constructor
+  if (!send_command(FLEET_JOIN_ADDRESS, assign, AIRTIME_COMMAND)) return false;
+  v.slotsSent = slots;
+  LoRa.receive();
+  Serial.print("Address assigned to airship "), Serial.println(fleet_index(v) + 1);
+  return true;
 }
 
 /*
@@ -0,0 +1,277 @@
+#include "Fleet.h"
+#include "Communication.h"
+
+/*
+Sessions of the airships run by the controller.
+A new airship starts with the address FLEET_JOIN_ADDRESS and sends join requests with a random number.
+The controller opens a session in a free slot of the fleet and answers with the ASSIGN_ADDRESS command
+(the random number, the index of the slot and the number of TDMA slots), which is repeated until the airship
+stops asking. Airship i then uses the address FLEET_FIRST_ADDRESS + i and sends its beacon in the i-th frame
+of every superframe (see TDMA.h), so the airships never transmit at the same time. An airship that is already
+flying with an address (e.g. after a restart of the controller) is taken into the fleet when its telemetry arrives.
+Every session has its own sequence numbers, command window, status, TDMA frame and telemetry references.
+The transmissions are scheduled round robin: in each pass of the main loop at most one packet is sent and the next
+pass starts with the following airship, so one busy airship cannot delay the others by more than one packet.
+*/
+
+VehicleSession fleet[FLEET_SIZE];
+unsigned int selectedVehicle = 0;
+unsigned int nextVehicle = 0;             // the first airship offered a transmission in the next pass
+volatile int assignmentPending = -1;      // session whose airship waits for ASSIGN_ADDRESS, -1 if there is none
+
+/**
+ * Returns the session controlled by the buttons and the serial monitor.
+ */
+VehicleSession &selected_vehicle(void) {
+  return fleet[selectedVehicle];
+}
+
+/**
+ * Returns the index of a session in the fleet.
+ */
+unsigned int fleet_index(const VehicleSession &v) {
+  return &v - fleet;
+}
+
+/**
+ * Finds the active session of an address.
+ *
+ * @return The session, or NULL if the address has none.
+ */
+VehicleSession *fleet_vehicle(unsigned char address) {
+  if (address < FLEET_FIRST_ADDRESS || address >= FLEET_FIRST_ADDRESS + FLEET_SIZE) return NULL;
+  VehicleSession &v = fleet[address - FLEET_FIRST_ADDRESS];
+  return v.active ? &v : NULL;
+}
+
+/**
+ * Opens a session for an airship that already has an address, when its first packet arrives. It is called from receive_service().
+ *
+ * @return The session, or NULL if the address is out of the fleet.
+ */
+VehicleSession *fleet_discover(unsigned char address) {
+  if (address < FLEET_FIRST_ADDRESS || address >= FLEET_FIRST_ADDRESS + FLEET_SIZE) return NULL;
+  unsigned int index = address - FLEET_FIRST_ADDRESS;
+  fleet_open(index, 0);
+  Serial.print("Airship "), Serial.print(index + 1), Serial.println(" found");
+  return &fleet[index];
+}
+
+/**
+ * Handles a join request. The airship gets the session it already has (its previous answer was lost) or a free one.
+ * The answer is sent by fleet_service(). It is called from receive_service().
+ *
+ * @param nonce The random number of the airship.
+ */
+void fleet_join_request(uint16_t nonce) {
+  int index = -1;
+  for (unsigned int i = 0; i < FLEET_SIZE && index < 0; i++) {
+    if (fleet[i].active && fleet[i].nonce == nonce) index = i;
+  }
+  for (unsigned int i = 0; i < FLEET_SIZE && index < 0; i++) {
+    if (!fleet[i].active) {
+      fleet_open(i, nonce);
+      index = i;
+      Serial.print("Airship "), Serial.print(i + 1), Serial.println(" joined");
+    }
+  }
+  if (index < 0) {
+    Serial.println("The fleet is full, join request refused.");
+    return;
+  }
+  fleet[index].lastReceivedTime = millis();
+  assignmentPending = index;
+}
+
+/**
+ * Starts a new session.
+ *
+ * @param index Slot of the fleet.
+ * @param nonce The random number of the airship, 0 if it did not join.
+ */
+void fleet_open(unsigned int index, uint16_t nonce) {
+  VehicleSession &v = fleet[index];
+  v.active = false;  // set last, the main loop skips the session until then
+  v.address = FLEET_FIRST_ADDRESS + index;
+  v.nonce = nonce;
+  v.slotsSent = 0;
+  // Start with a random sequence number, so that the airship does not take the first commands after a restart for duplicates
+  v.counter = random(0x10000);
+  for (unsigned int i = 0; i < ARQ_WINDOW; i++) v.sendWindow[i].inUse = false;
+  v.nackArrived = false;
+  v.lastCmdConfirmed = true;
+  v.rttMeasured = false;
+  v.currentRTO = ARQ_INITIAL_RTO;
+  v.land = false;
+  v.flyForward = false;
+  v.lastReceivedTime = millis();
+  v.lastSendTime = 0;
+  v.beaconHeard = false;
+  v.steeringSeq = 0;
+  v.steeringAngle = 0;
+  v.steeringPower = STEERING_DEFAULT_POWER;
+  v.steeringChanged = false;
+  v.steeringSentAt = 0;
+  v.telemetryAckPending = false;
+  v.packetsReceived = 0;
+  v.packetsSent = 0;
+  v.retransmissions = 0;
+  telemetry_reset(index);
+  link_stats_reset(index);
+  backlog_reset(index);
+  v.active = true;
+}
+
+/**
+ * Returns the number of active sessions.
+ */
+unsigned int fleet_count(void) {
+  unsigned int count = 0;
+  for (unsigned int i = 0; i < FLEET_SIZE; i++) {
+    if (fleet[i].active) count++;
+  }
+  return count;
+}
+
+/**
+ * Returns the number of frames in a TDMA superframe, i.e. the highest active slot + 1.
+ */
+unsigned int fleet_slots(void) {
+  unsigned int slots = 1;
+  for (unsigned int i = 0; i < FLEET_SIZE; i++) {
+    if (fleet[i].active) slots = i + 1;
+  }
+  return slots;
+}
+
+/**
+ * Creates a command for an airship with its next sequence number (see process_command()).
+ *
+ * @param v The session of the airship.
+ * @param commandID The ID of the command.
+ * @param value The value of the command.
+ * @return The command.
+ */
+command fleet_command(VehicleSession &v, unsigned char commandID, float value) {
+  command cmd(commandID, v.counter + 1, value);
+  if (cmd.ID != all_ids.SAY_HI) {
+    v.counter = cmd.counter;  // 16-bit sequence number, wraps around naturally
+  }
+  return cmd;
+}
+
+/**
+ * Maintains the sessions and sends at most one packet. It is called in every pass of the main loop.
+ */
+void fleet_service(void) {
+  PROFILE_SECTION(PROFILE_FLEET_SERVICE);  // see Profiler.h
+  fleet_expire();
+
+  int pending = assignmentPending;
+  if (pending >= 0) {  // before the slots are updated, the new airship gets the number of slots with its address
+    if (send_assignment(fleet[pending], fleet_slots())) assignmentPending = -1;
+    return;
+  }
+  fleet_update_slots();
+  if (hop_searching()) return;  // the airship is on another channel (see Hopping.h)
+
+  for (unsigned int n = 0; n < FLEET_SIZE; n++) {
+    unsigned int i = (nextVehicle + n) % FLEET_SIZE;
+    if (!fleet[i].active) continue;
+    if (fleet_transmit(fleet[i])) {
+      nextVehicle = (i + 1) % FLEET_SIZE;
+      return;
+    }
+  }
+}
+
+/**
+ * Sends the next packet of an airship, if one is due: its commands (with the telemetry acknowledgement and the setpoint),
+ * the setpoint of the continuous controls, the telemetry acknowledgement alone, or "SAY_HI".
+ *
+ * @param v The session of the airship.
+ * @return True if a packet was sent.
+ */
+bool fleet_transmit(VehicleSession &v) {
+  bool sent = arq_service(v);
+  if (!sent && steering_due(v) && (tdma_uplink_open(v) || tdma_contention_open(v))) {
+    sent = send_steering(v);
+  }
+  if (!sent && v.telemetryAckPending && tdma_uplink_open(v)) {
+    sent = send_telemetry_ack(v);
+  }
+  if (!sent && millis() - v.lastSendTime > link_keepalive_interval() && tdma_contention_open(v)) {
+    sent = send_keepalive(v);
+  }
+  if (sent) {
+    v.lastSendTime = millis();
+    v.packetsSent++;
+  }
+  return sent;
+}
+
+/**
+ * Sends "SAY_HI", so that the airship knows the controller is there. It is left out when the airtime budget is tight (see Airtime.h).
+ *
+ * @param v The session of the airship.
+ * @return True if it was sent.
+ */
+bool send_keepalive(VehicleSession &v) {
+  command hi = fleet_command(v, all_ids.SAY_HI);
+  if (!send_command(v.address, hi, AIRTIME_BACKGROUND)) return false;
+  LoRa.receive();
+  Serial.print("Sent the informational command 'SAY_HI' to airship "), Serial.println(fleet_index(v) + 1);
+  return true;
+}
+
+/**
+ * Closes the sessions of the airships that have not been heard for FLEET_TIMEOUT.
+ */
+void fleet_expire(void) {
+  for (unsigned int i = 0; i < FLEET_SIZE; i++) {
+    VehicleSession &v = fleet[i];
+    if (v.active && millis() - (unsigned long)v.lastReceivedTime > FLEET_TIMEOUT) {
+      v.active = false;
+      Serial.print("Airship "), Serial.print(i + 1), Serial.println(" lost, its session was closed");
+    }
+  }
+}
+
+/**
+ * Tells every airship the number of TDMA slots when it changes (by the FLEET_SLOTS command, confirmed as usual).
+ */
+void fleet_update_slots(void) {
+  unsigned int slots = fleet_slots();
+  for (unsigned int i = 0; i < FLEET_SIZE; i++) {
+    VehicleSession &v = fleet[i];
+    if (!v.active || v.slotsSent == slots || !arq_can_send(v)) continue;
+    arq_submit(v, fleet_command(v, all_ids.FLEET_SLOTS, slots));
+    v.slotsSent = slots;
+  }
+}
+
+/**
+ * Prints the sessions to the serial monitor.
+ */
+void print_fleet(void) {
+  Serial.println();
+  for (unsigned int i = 0; i < FLEET_SIZE; i++) {
+    VehicleSession &v = fleet[i];
+    if (!v.active) continue;
+    Serial.print(i == selectedVehicle ? "* Airship " : "  Airship "), Serial.print(i + 1);
+    Serial.print(" (address 0x"), Serial.print(v.address, HEX), Serial.print("): heard ");
+    Serial.print(millis() - (unsigned long)v.lastReceivedTime), Serial.print(" ms ago");
+    Serial.print(tdma_synchronised(v) ? ", synchronised" : ", not synchronised");
+    if (v.land) Serial.print(", landing");
+    if (v.flyForward) Serial.print(", flying forward");
+    if (!v.lastCmdConfirmed) Serial.print(", commands waiting");
+    Serial.println();
+    Serial.print("    Received : "), Serial.print(v.packetsReceived);
+    Serial.print(", sent : "), Serial.print(v.packetsSent);
+    Serial.print(", retransmissions : "), Serial.print(v.retransmissions);
+    Serial.print(", RSSI : "), Serial.print(v.rssi), Serial.print(" dBm, SNR : "), Serial.print(v.snr), Serial.println(" dB");
+  }
+  if (fleet_count() == 0) Serial.println("No airship has joined yet.");
+  Serial.print("TDMA slots : "), Serial.println(fleet_slots());
+  Serial.println();
+}
@@ -0,0 +1,277 @@
+#include "Hopping.h"
+#include "Communication.h"
+#include "Commands.h"
+
+/*
+After a missed beacon the controller keeps hopping by the schedule, the airship keeps it too. After HOP_MAX_MISSED
+missed beacons in a row it waits on the rendezvous frequency, where the airship sends every HOP_RENDEZVOUS_PERIOD-th
+beacon, and takes the frame number and the mask from it. The same happens after a restart of the controller.
+A beacon without the hopping state ends the search at once, the airship has stopped hopping.
+The controller counts the beacons expected and received on each channel. A channel that loses more than
+HOP_BLACKLIST_LOSS % of them is left out of the mask, the airship gets the new mask by the HOP_MODE command
+and uses it from the next rendezvous frame; after HOP_PROBATION the channel is tried again.
+Hopping is used with a single airship only: all airships would have to follow one sequence, and new airships
+are heard on the rendezvous frequency only.
+*/
+
+volatile HopState hopState = HOP_OFF;
+int hopVehicle = -1;                       // the hopping airship
+volatile unsigned char hopFrame = 0;       // number of the current frame
+volatile unsigned char hopMask = 0;        // mask used by the airship
+volatile int confirmedMask = -1;           // new mask acknowledged by the airship, used from its next rendezvous frame
+volatile unsigned long frameStart = 0;     // end of the beacon of the current frame (estimated if it was missed)
+volatile bool tunedAhead = false;          // the radio is already on the channel of the next frame
+volatile unsigned int missedBeacons = 0;   // in a row
+volatile unsigned long searchSince = 0;
+unsigned char wantedMask = HOP_ALL_CHANNELS;  // mask without the blacklisted channels
+bool maskInFlight = false;                 // a HOP_MODE command waits for its acknowledgement
+unsigned int framesSinceReview = 0;
+volatile unsigned long beaconsExpected[HOP_CHANNELS + 1] = {0};  // the last one is the rendezvous frequency
+volatile unsigned long beaconsHeard[HOP_CHANNELS + 1] = {0};
+unsigned long blacklistedAt[HOP_CHANNELS];
+
+/**
+ * Turns hopping on for the only airship of the fleet, or off. It is called by the 'hop' command.
+ */
+void hop_toggle(void) {
+  if (hopVehicle < 0) {
+    if (fleet_count() != 1) {
+      Serial.println("Hopping needs exactly one airship in the fleet.");
+      return;
+    }
+    for (unsigned int i = 0; i < FLEET_SIZE && hopVehicle < 0; i++) {
+      if (fleet[i].active) hopVehicle = i;
+    }
+  }
+  VehicleSession &v = fleet[hopVehicle];
+  if (maskInFlight || !arq_can_send(v)) {
+    Serial.println("Hopping: the airship has not confirmed the previous change yet.");
+    return;
+  }
+  bool on = hopState == HOP_OFF;
+  arq_submit(v, fleet_command(v, all_ids.HOP_MODE, on ? wantedMask : 0));
+  maskInFlight = true;
+  Serial.println(on ? "Hopping requested." : "Hopping off requested.");
+}
+
+/**
+ * Checks whether the controller waits for the airship on the rendezvous frequency. It does not transmit then.
+ */
+bool hop_searching(void) {
+  return hopState == HOP_SEARCHING;
+}
+
+/**
+ * Reads the hopping state of a beacon and follows the sequence from it. It is called from receive_service().
+ * Format: [frame number, channel mask]
+ *
+ * @param reader The received packet, positioned at the hopping state.
+ * @param v The session of the airship.
+ * @param time millis() at the reception of the beacon.
+ * @return False if the packet is too short.
+ */
+bool hop_beacon(PacketReader &reader, VehicleSession &v, unsigned long time) {
+  unsigned char frame, mask;
+  if (!reader.read_byte(frame) || !reader.read_byte(mask)) return false;
+  if (hopVehicle >= 0 && (unsigned int)hopVehicle != fleet_index(v)) return true;  // another airship, not followed
+  int channel = hop_channel(frame, mask);
+  if (hopState != HOP_FOLLOWING) {
+    beaconsExpected[channel < 0 ? HOP_CHANNELS : channel]++;  // it was not tuned by hop_service()
+    Serial.print("Hopping: following the airship from frame "), Serial.println(frame);
+  }
+  beaconsHeard[channel < 0 ? HOP_CHANNELS : channel]++;
+  hopVehicle = fleet_index(v);
+  hopFrame = frame;
+  hopMask = mask;
+  if (confirmedMask == mask) confirmedMask = -1;
+  frameStart = time;
+  tunedAhead = false;
+  missedBeacons = 0;
+  hopState = HOP_FOLLOWING;
+  return true;
+}
+
+/**
+ * Handles a beacon without the hopping state. If it comes from the followed or searched airship, it has stopped hopping.
+ * It is called from receive_service().
+ */
+void hop_plain_beacon(VehicleSession &v) {
+  if (hopState == HOP_OFF || (unsigned int)hopVehicle != fleet_index(v)) return;
+  hopState = HOP_OFF;
+  hopVehicle = -1;
+  Serial.println("Hopping: the airship stopped hopping.");
+}
+
+/**
+ * The airship acknowledged the HOP_MODE command.
+ *
+ * @param mask The mask sent, 0 if hopping was turned off.
+ */
+void hop_confirmed(unsigned int mask) {
+  maskInFlight = false;
+  if (mask == 0) {
+    hopState = HOP_OFF;
+    hopVehicle = -1;
+    hop_tune(0, 0);
+    Serial.println("Hopping off.");
+  } else if (hopState == HOP_OFF) {
+    hopState = HOP_SEARCHING;  // the airship starts with a beacon on the rendezvous frequency
+    searchSince = millis();
+  } else {
+    confirmedMask = mask;  // in case the beacon of the rendezvous frame is missed
+  }
+}
+
+/**
+ * The airship refused the HOP_MODE command.
+ */
+void hop_refused(void) {
+  maskInFlight = false;
+  if (hopState == HOP_OFF) hopVehicle = -1;
+}
+
+/**
+ * Tunes to the next channel at the end of each frame, detects missed beacons and reviews the blacklist.
+ * It is called in every pass of the main loop.
+ */
+void hop_service(void) {
+  if (hopVehicle >= 0 && !fleet[hopVehicle].active) {  // the session expired
+    hopState = HOP_OFF;
+    hopVehicle = -1;
+    maskInFlight = false;
+    hop_tune(0, 0);
+    return;
+  }
+  if (hopState != HOP_OFF && fleet_count() != 1 && !maskInFlight) {
+    Serial.println("Hopping: more than one airship in the fleet.");
+    hop_toggle();
+  }
+  if (hopState == HOP_SEARCHING) {
+    if (millis() - searchSince > HOP_FALLBACK_TIMEOUT) {
+      hopState = HOP_OFF;
+      hopVehicle = -1;
+      Serial.println("Hopping: the airship was not found, hopping off.");
+    }
+    return;
+  }
+  if (hopState != HOP_FOLLOWING) return;
+
+  TdmaLayout layout;
+  tdma_layout(layout);
+  unsigned long t = millis() - frameStart;
+  unsigned char next = hopFrame + 1;
+  unsigned char mask = hopMask;
+  bool tune = !tunedAhead && t >= layout.contentionEnd;
+  bool missed = tunedAhead && t >= layout.frame + link_airtime(currentProfile, PACKET_CAPACITY) + TDMA_GUARD;
+  if (tune) tunedAhead = true;
+  if (tune && next % HOP_RENDEZVOUS_PERIOD == 0 && confirmedMask >= 0) {  // the airship changes the mask in this frame
+    hopMask = confirmedMask;
+    confirmedMask = -1;
+  }
+  if (missed) {  // the beacon should have ended by now, the frame goes on without it
+    hopFrame = next;
+    frameStart += layout.frame + link_airtime(currentProfile, TDMA_MAX_PACKET);
+    tunedAhead = false;
+    missedBeacons++;
+  }
+
+  if (tune) {
+    int channel = hop_channel(next, mask);
+    beaconsExpected[channel < 0 ? HOP_CHANNELS : channel]++;
+    hop_tune(next, mask);
+    if (++framesSinceReview >= HOP_REVIEW_FRAMES) hop_review();
+  }
+  if (missed && missedBeacons >= HOP_MAX_MISSED) {
+    hopState = HOP_SEARCHING;
+    searchSince = millis();
+    hop_tune(0, 0);
+    Serial.println("Hopping: beacons lost, waiting on the rendezvous frequency.");
+  }
+}
+
+/**
+ * Blacklists the channels that lose too many beacons and returns those whose probation has passed.
+ * The counters are halved, so that the decisions follow the recent conditions.
+ */
+void hop_review(void) {
+  framesSinceReview = 0;
+  unsigned long now = millis();
+  unsigned int used = 0;
+  for (unsigned int i = 0; i < HOP_CHANNELS; i++) used += (wantedMask >> i) & 1;
+  for (unsigned int i = 0; i < HOP_CHANNELS; i++) {
+    bool inUse = (wantedMask >> i) & 1;
+    if (inUse && used > HOP_MIN_CHANNELS && beaconsExpected[i] >= HOP_MIN_SAMPLES
+        && beaconsHeard[i] * 100 < beaconsExpected[i] * (100 - HOP_BLACKLIST_LOSS)) {
+      wantedMask &= ~(1 << i);
+      blacklistedAt[i] = now;
+      used--;
+      Serial.print("Hopping: channel "), Serial.print(i), Serial.println(" blacklisted");
+    } else if (!inUse && now - blacklistedAt[i] > HOP_PROBATION) {
+      wantedMask |= 1 << i;
+      used++;
+      beaconsExpected[i] = beaconsHeard[i] = 0;
+    }
+  }
+  for (unsigned int i = 0; i <= HOP_CHANNELS; i++) {
+    beaconsExpected[i] /= 2;
+    beaconsHeard[i] /= 2;
+  }
+
+  VehicleSession &v = fleet[hopVehicle];
+  if (wantedMask != hopMask && !maskInFlight && v.active && arq_can_send(v)) {
+    arq_submit(v, fleet_command(v, all_ids.HOP_MODE, wantedMask));  // the airship applies it from the next rendezvous frame
+    maskInFlight = true;
+  }
+}
+
+/**
+ * Tunes the radio to the channel of a frame and continues receiving.
+ */
+void hop_tune(unsigned char frame, unsigned char mask) {
+  LoRa.idle();
+  LoRa.setFrequency(hop_frequency(hop_channel(frame, mask)));
+  LoRa.receive();
+}
+
+/**
+ * Prints the state of hopping and the beacons received on each channel (see print_link_statistics()).
+ */
+void print_hop_statistics(void) {
+  Serial.print("Hopping : "), Serial.println(hopState == HOP_OFF ? "off" : (hopState == HOP_SEARCHING ? "waiting on the rendezvous frequency" : "on"));
+  if (hopState == HOP_OFF) return;
+  for (unsigned int i = 0; i <= HOP_CHANNELS; i++) {
+    Serial.print("  "), Serial.print(hop_frequency(i < HOP_CHANNELS ? i : -1)), Serial.print(" Hz : ");
+    Serial.print(beaconsHeard[i]), Serial.print(" of "), Serial.print(beaconsExpected[i]), Serial.print(" beacons");
+    if (i < HOP_CHANNELS && !((wantedMask >> i) & 1)) Serial.print(", blacklisted");
+    Serial.println();
+  }
+}
+
+/**
+ * Chooses the channel of a frame. The same function is on the airship.
+ *
+ * @param frame The frame number.
+ * @param mask Channels in use, bit i = channel i.
+ * @return The channel, or -1 for the rendezvous frequency.
+ */
+int hop_channel(unsigned char frame, unsigned char mask) {
+  if (frame % HOP_RENDEZVOUS_PERIOD == 0 || mask == 0) return -1;
+  uint32_t h = ((uint32_t)frame << 16 | HOP_SEED) * 2654435761u;  // multiplicative hash
+  h ^= h >> 15;
+  h *= 0x2C1B3C6Du;
+  h ^= h >> 12;
+  unsigned int count = 0;
+  for (unsigned int i = 0; i < HOP_CHANNELS; i++) count += (mask >> i) & 1;
+  unsigned int pick = h % count;
+  for (unsigned int i = 0; i < HOP_CHANNELS; i++) {
+    if (((mask >> i) & 1) && pick-- == 0) return i;
+  }
+  return -1;
+}
+
+/**
+ * Returns the frequency of a channel (-1 = the rendezvous frequency) [Hz].
+ */
+long hop_frequency(int channel) {
+  return (channel < 0) ? (long)HOP_RENDEZVOUS_FREQUENCY : HOP_FIRST_FREQUENCY + channel * HOP_CHANNEL_SPACING;
+}
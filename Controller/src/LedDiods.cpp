@@ -1,4 +1,5 @@
 #include "LedDiods.h"
+#include "Fleet.h"
 
 bool LAND_LED_shine = false;      // true if land led shine
 bool UP_LED_shine = false;        // true if up led shine
@@ -7,7 +8,7 @@ bool FLY_FORWARD_LED_shine = false; // true if fly_forward led shine
 
 /**
  * Controls the LED indicators based on the command and system state.
- * It includes logic for LAND, UP, and DOWN LEDs.
+ * It includes logic for LAND, UP, and DOWN LEDs. They show the airship selected in the fleet (see Fleet.h).
  *
  * @param cmd A reference to the command structure containing the current command.
  * @param neww A boolean indicating if a new command has been received.
@@ -15,16 +16,17 @@ bool FLY_FORWARD_LED_shine = false; // true if fly_forward led shine
 void control_diodes(command& cmd, bool neww) {
   update_LAND_LED();
   update_FORWARD_FLY_LED();
-  if (lastCmdConfirmed) {
+  if (selected_vehicle().lastCmdConfirmed) {
     turn_off_LEDS_after_interval();
-    light_up_after_new_cmd(cmd, neww);
   }
+  light_up_after_new_cmd(cmd, neww);
 }
 
 /**
  * Updates the state of the LAND LED based on the LAND status.
  */
 void update_LAND_LED() {
+  bool LAND = selected_vehicle().land;
   if (LAND && !LAND_LED_shine) {
     digitalWrite(LAND_LED, HIGH);
     LAND_LED_shine = true;
@@ -38,6 +40,7 @@ void update_LAND_LED() {
  * Updates the state of the FORWARD_FLY LED based on the FORWARD_FLY status.
  */
 void update_FORWARD_FLY_LED() {
+  bool FLY_FORWARD = selected_vehicle().flyForward;
   if (FLY_FORWARD && !FLY_FORWARD_LED_shine) {
     digitalWrite(FLY_FORWARD_LED, HIGH);
     FLY_FORWARD_LED_shine = true;
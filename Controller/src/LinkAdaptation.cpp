@@ -0,0 +1,181 @@
+#include "LinkAdaptation.h"
+#include "Commands.h"
+#include "ARQ.h"
+#include "LinkStats.h"
+#include "Hopping.h"
+
+/*
+Link adaptation, controller side.
+Both ends measure the SNR and RSSI of every packet, the airship reports its values in each telemetry packet.
+The controller compares the worse of the two smoothed SNRs with the needs of the neighbouring profiles
+(link_choose_profile()) and asks for a switch by the LINK_PROFILE command. The airship switches after it has
+acknowledged the command, the controller when the acknowledgement arrives. If the acknowledgement is lost,
+the ends do not hear each other, and both return to the rendezvous profile after LINK_FALLBACK_TIMEOUT.
+All airships of a fleet share the radio parameters and new ones join on the rendezvous profile (see Fleet.h),
+so the profile is adapted only while a single airship is in the fleet.
+*/
+
+const LinkProfile linkProfiles[LINK_PROFILE_COUNT] = {
+  {10, 125000, 20, -15.0},  // the most robust
+  {9, 125000, 20, -12.5},
+  {7, 125000, 17, -7.5},    // rendezvous
+  {7, 250000, 17, -7.5},
+  {7, 500000, 14, -7.5},    // the fastest
+};
+
+unsigned int currentProfile = LINK_RENDEZVOUS_PROFILE;
+volatile float localSnr = 0;          // smoothed SNR of the packets from the airship [dB]
+volatile int localRssi = 0;           // RSSI of the last packet from the airship [dBm]
+volatile unsigned int localPackets = 0;  // packets measured since the last switch
+volatile float remoteSnr = 0;         // smoothed SNR reported by the airship [dB]
+volatile int remoteRssi = 0;          // RSSI reported by the airship [dBm]
+volatile unsigned int remoteReports = 0;  // reports received since the last switch
+bool switchInFlight = false;          // a LINK_PROFILE command waits for its acknowledgement
+uint16_t switchSeq = 0;               // sequence number of that command
+unsigned long profileSince = 0;       // time of the last switch
+
+/**
+ * Records the signal quality of the packet just received. It is called from receive_service().
+ *
+ * @param snr SNR of the packet [dB].
+ * @param rssi RSSI of the packet [dBm].
+ */
+void link_record_packet(float snr, int rssi) {
+  localSnr = (localPackets == 0) ? snr : 0.75 * localSnr + 0.25 * snr;
+  localRssi = rssi;
+  localPackets++;
+  link_stats_packet_received(snr, localRssi);
+}
+
+/**
+ * Records the signal quality of the controller's packets as measured by the airship. It is called from receive_service().
+ */
+void link_remote_report(float snr, int rssi) {
+  remoteSnr = (remoteReports == 0) ? snr : 0.75 * remoteSnr + 0.25 * snr;
+  remoteRssi = rssi;
+  remoteReports++;
+}
+
+/**
+ * Chooses the profile for the measured SNR. Only the neighbouring profiles are considered, one step at a time.
+ * For a faster profile the SNR is estimated from the current one: a wider bandwidth lets in more noise
+ * and a lower transmit power means a weaker signal.
+ *
+ * @param profile The current profile.
+ * @param snr SNR measured on the current profile [dB].
+ * @return The profile to be used.
+ */
+unsigned int link_choose_profile(unsigned int profile, float snr) {
+  const LinkProfile &cur = linkProfiles[profile];
+  if (profile > 0 && snr < cur.requiredSnr + LINK_DOWN_MARGIN) return profile - 1;
+
+  if (profile + 1 < LINK_PROFILE_COUNT) {
+    const LinkProfile &next = linkProfiles[profile + 1];
+    float expected = snr - 10 * log10f((float)next.bandwidth / cur.bandwidth) - (cur.txPower - next.txPower);
+    if (expected >= next.requiredSnr + LINK_UP_MARGIN) return profile + 1;
+  }
+  return profile;
+}
+
+/**
+ * Decides whether to switch the profile and handles the fallback. It is called in every pass of the main loop.
+ */
+void link_service(void) {
+  unsigned long lastHeard = ((unsigned long)lastReceivedTime > profileSince) ? (unsigned long)lastReceivedTime : profileSince;
+  if ((currentProfile != LINK_RENDEZVOUS_PROFILE || switchInFlight) && millis() - lastHeard > LINK_FALLBACK_TIMEOUT) {
+    Serial.println("Airship lost, back to the rendezvous link profile");
+    switchInFlight = false;  // a late acknowledgement of the switch is ignored
+    link_apply_profile(LINK_RENDEZVOUS_PROFILE);  // also on it already: the old measurements must not start a new switch at once
+    return;
+  }
+
+  if (switchInFlight || fleet_count() != 1 || localPackets < LINK_MIN_PACKETS_DOWN || remoteReports == 0) return;
+  VehicleSession *v = NULL;
+  for (unsigned int i = 0; i < FLEET_SIZE && v == NULL; i++) {
+    if (fleet[i].active) v = &fleet[i];
+  }
+  if (!arq_can_send(*v)) return;
+  float snr = (remoteSnr < localSnr) ? remoteSnr : localSnr;  // the worse direction decides
+  unsigned int target = link_choose_profile(currentProfile, snr);
+  if (target == currentProfile || (target > currentProfile && localPackets < LINK_MIN_PACKETS_UP)) return;
+
+  command cmd = fleet_command(*v, all_ids.LINK_PROFILE, target);
+  arq_submit(*v, cmd);
+  switchInFlight = true;
+  switchSeq = cmd.counter;
+  Serial.print("Link profile switch requested: "), Serial.print(target);
+  Serial.print(", SNR "), Serial.print(snr), Serial.print(" dB, RSSI "), Serial.print(localRssi), Serial.print("/"), Serial.println(remoteRssi);
+}
+
+/**
+ * Switches to the profile after the airship acknowledged the LINK_PROFILE command.
+ * Only the command of the switch in flight counts, a late acknowledgement of an older one
+ * (retransmitted after a fallback) is ignored.
+ *
+ * @param seq Sequence number of the command.
+ * @param profile Its value.
+ */
+void link_switch_confirmed(uint16_t seq, unsigned int profile) {
+  if (!switchInFlight || seq != switchSeq) return;
+  switchInFlight = false;
+  link_apply_profile(profile);
+}
+
+/**
+ * The airship refused the LINK_PROFILE command, the profile stays.
+ *
+ * @param seq Sequence number of the command.
+ */
+void link_switch_refused(uint16_t seq) {
+  if (seq != switchSeq) return;
+  switchInFlight = false;
+}
+
+/**
+ * Sets the radio parameters of a profile and starts receiving again. The measurements start from scratch.
+ *
+ * @param profile Index into linkProfiles.
+ */
+void link_apply_profile(unsigned int profile) {
+  const LinkProfile &p = linkProfiles[profile];
+  LoRa.idle();
+  LoRa.setSpreadingFactor(p.spreadingFactor);
+  LoRa.setSignalBandwidth(p.bandwidth);
+  LoRa.setTxPower(p.txPower);
+  LoRa.receive();
+  currentProfile = profile;
+  profileSince = millis();
+  localPackets = 0;
+  remoteReports = 0;
+  Serial.print("Link profile "), Serial.print(profile);
+  Serial.print(": SF"), Serial.print(p.spreadingFactor), Serial.print(", BW "), Serial.print(p.bandwidth);
+  Serial.print(" Hz, "), Serial.print(p.txPower), Serial.println(" dBm");
+}
+
+/**
+ * Returns how often "SAY_HI" has to be sent when there are no other commands.
+ */
+unsigned long link_keepalive_interval(void) {
+  if (hopState != HOP_OFF) return LINK_KEEPALIVE_INTERVAL;  // the airship stops hopping without the controller (see Hopping.h)
+  return (currentProfile == LINK_RENDEZVOUS_PROFILE) ? (unsigned long)timeInterval : LINK_KEEPALIVE_INTERVAL;
+}
+
+/**
+ * Estimates the time on air of a packet (formula from the Semtech datasheet: explicit header, coding rate 4/5,
+ * 8 preamble symbols, low data rate optimisation for symbols longer than 16 ms). The LoRa library leaves the radio's
+ * payload CRC off, the frames carry their own (see Framing.h).
+ *
+ * @param profile Index into linkProfiles.
+ * @param bytes Length of the packet.
+ * @return Time on air [ms].
+ */
+unsigned long link_airtime(unsigned int profile, unsigned int bytes) {
+  const LinkProfile &p = linkProfiles[profile];
+  int sf = p.spreadingFactor;
+  float symbolTime = (float)(1L << sf) * 1000 / p.bandwidth;  // [ms]
+  bool lowDataRate = symbolTime > 16;
+  long numerator = 8L * bytes - 4 * sf + 28 + (LINK_RADIO_CRC ? 16 : 0);
+  long denominator = 4L * (sf - (lowDataRate ? 2 : 0));
+  long payloadSymbols = 8 + ((numerator > 0) ? (numerator + denominator - 1) / denominator * 5 : 0);
+  return (unsigned long)((12.25 + payloadSymbols) * symbolTime) + 1;
+}
@@ -0,0 +1,280 @@
+#include "LinkStats.h"
+#include "LinkAdaptation.h"
+#include "Airtime.h"
+#include "Fleet.h"
+#include "Hopping.h"
+#include "ReceiveQueue.h"
+
+/*
+Link statistics, controller side.
+The controller measures its own direction of the link (packets from the airship, CRC and FEC results, RSSI and SNR)
+and gets the other one from the airship: the RSSI and SNR in every link report and the counters of received,
+corrupted and corrected frames and duplicate commands every few seconds (see LinkStats.h of the airship).
+The uplink loss is estimated by comparing the packets sent by the controller with the ones counted by the airship,
+the downlink loss from the gaps in the sequence numbers of the telemetry frames. The totals cover the whole fleet,
+the counters of the airships and the sequence numbers are followed separately for each airship (see Fleet.h).
+Type 'stats' in the serial monitor to print everything.
+*/
+
+volatile LinkCounters linkCounters = {};
+LinkRates linkRates = {0, 0, 0, 0};
+
+LinkHistogram localRssiHistogram = {-120, 10, {0}};    // [dBm]
+LinkHistogram localSnrHistogram = {-20, 5, {0}};       // [dB]
+LinkHistogram remoteRssiHistogram = {-120, 10, {0}};
+LinkHistogram remoteSnrHistogram = {-20, 5, {0}};
+LinkHistogram rttHistogram = {250, 250, {0}};          // [ms], only commands confirmed after the first transmission
+LinkHistogram attemptsHistogram = {2, 1, {0}};         // transmissions per confirmed command, bucket 0 = first time
+
+bool remoteCountersKnown[FLEET_SIZE] = {false};
+uint16_t lastRemoteReceived[FLEET_SIZE];      // the last counters reported by each airship (lower 16 bits)
+uint16_t lastRemoteCorrupted[FLEET_SIZE];
+uint16_t lastRemoteCorrected[FLEET_SIZE];
+uint16_t lastRemoteDuplicates[FLEET_SIZE];
+LoopTimingReport heightLoopTiming[FLEET_SIZE] = {};  // the last one reported by each airship
+unsigned long sentAtLastReport[FLEET_SIZE];   // packets sent to the airship when its last counters arrived
+volatile unsigned long uplinkSent = 0;   // packets sent and received according to the airships' reports in this window
+volatile unsigned long uplinkDelivered = 0;
+int lastTelemetrySeq[FLEET_SIZE];
+
+unsigned long windowStart = 0;
+unsigned long windowReceived = 0;        // counters at the start of the window
+unsigned long windowSent = 0;
+unsigned long windowFrames = 0;
+unsigned long windowLost = 0;
+
+/**
+ * Adds a value to a histogram.
+ */
+void histogram_add(LinkHistogram &histogram, int value) {
+  int bucket = 0;
+  if (value >= histogram.lowest) {
+    bucket = 1 + (value - histogram.lowest) / histogram.width;
+    if (bucket >= LINK_HISTOGRAM_BUCKETS) bucket = LINK_HISTOGRAM_BUCKETS - 1;
+  }
+  histogram.counts[bucket]++;
+}
+
+/**
+ * Prints a histogram as one line: "name [unit]: <lowest: count | lowest..next: count | ... | >=edge: count".
+ */
+void print_histogram(const char *name, const LinkHistogram &histogram, const char *unit) {
+  Serial.print(name), Serial.print(" ["), Serial.print(unit), Serial.print("]: <"), Serial.print(histogram.lowest);
+  Serial.print(": "), Serial.print(histogram.counts[0]);
+  for (int i = 1; i < LINK_HISTOGRAM_BUCKETS; i++) {
+    int edge = histogram.lowest + (i - 1) * histogram.width;
+    Serial.print(" | ");
+    if (i == LINK_HISTOGRAM_BUCKETS - 1) {
+      Serial.print(">="), Serial.print(edge);
+    } else {
+      Serial.print(edge), Serial.print(".."), Serial.print(edge + histogram.width);
+    }
+    Serial.print(": "), Serial.print(histogram.counts[i]);
+  }
+  Serial.println();
+}
+
+/**
+ * Counts the result of the CRC and FEC check of a received frame. It is called from receive_service().
+ */
+void link_stats_frame_checked(FrameStatus status) {
+  if (status == FRAME_CORRUPTED) linkCounters.corruptedFrames++;
+  else if (status == FRAME_CORRECTED) linkCounters.correctedFrames++;
+}
+
+/**
+ * Records a packet from the airship. It is called from receive_service().
+ */
+void link_stats_packet_received(float snr, int rssi) {
+  linkCounters.packetsReceived++;
+  histogram_add(localSnrHistogram, (int)floorf(snr));
+  histogram_add(localRssiHistogram, rssi);
+}
+
+/**
+ * Records the signal quality of the controller's packets as reported by the airship. It is called from receive_service().
+ */
+void link_stats_remote_report(float snr, int rssi) {
+  histogram_add(remoteSnrHistogram, (int)floorf(snr));
+  histogram_add(remoteRssiHistogram, rssi);
+}
+
+/**
+ * Reads the counters of the airship from a telemetry packet. It is called from receive_service().
+ * Format: [received, corrupted, corrected, duplicates (lower 16 bits of each counter),
+ *          jitter min, jitter max, jitter 99th percentile, execution 99th percentile, execution max (of the height loop)]
+ *
+ * @param reader The received packet, positioned behind the link report.
+ * @param vehicle Index of the airship in the fleet.
+ * @return False if the packet is too short.
+ */
+bool link_stats_remote_counters(PacketReader &reader, unsigned int vehicle) {
+  int16_t received, corrupted, corrected, duplicates;
+  reader.read_int16(received);
+  reader.read_int16(corrupted);
+  reader.read_int16(corrected);
+  reader.read_int16(duplicates);
+  int16_t jitterMin, jitterMax, jitter99, execution99, executionMax;
+  reader.read_int16(jitterMin);
+  reader.read_int16(jitterMax);
+  reader.read_int16(jitter99);
+  reader.read_int16(execution99);
+  reader.read_int16(executionMax);
+  if (!reader.ok()) return false;
+
+  LoopTimingReport &timing = heightLoopTiming[vehicle];
+  timing.known = true;
+  timing.jitterMin = jitterMin;
+  timing.jitterMax = jitterMax;
+  timing.jitter99 = (uint16_t)jitter99;
+  timing.execution99 = (uint16_t)execution99;
+  timing.executionMax = (uint16_t)executionMax;
+
+  unsigned long sent = fleet[vehicle].packetsSent;
+  if (remoteCountersKnown[vehicle]) {  // the first report after a restart of either side only sets the base
+    uint16_t delivered = (uint16_t)received - lastRemoteReceived[vehicle];
+    linkCounters.remoteReceived += delivered;
+    linkCounters.remoteCorrupted += (uint16_t)((uint16_t)corrupted - lastRemoteCorrupted[vehicle]);
+    linkCounters.remoteCorrected += (uint16_t)((uint16_t)corrected - lastRemoteCorrected[vehicle]);
+    linkCounters.remoteDuplicates += (uint16_t)((uint16_t)duplicates - lastRemoteDuplicates[vehicle]);
+    uplinkSent += sent - sentAtLastReport[vehicle];
+    uplinkDelivered += delivered;
+  }
+  remoteCountersKnown[vehicle] = true;
+  lastRemoteReceived[vehicle] = received;
+  lastRemoteCorrupted[vehicle] = corrupted;
+  lastRemoteCorrected[vehicle] = corrected;
+  lastRemoteDuplicates[vehicle] = duplicates;
+  sentAtLastReport[vehicle] = sent;
+  return true;
+}
+
+/**
+ * Records a received telemetry frame, a gap in the sequence numbers means lost frames. It is called from receive_service().
+ *
+ * @param vehicle Index of the airship in the fleet.
+ * @param seq Sequence number of the frame.
+ */
+void link_stats_telemetry_frame(unsigned int vehicle, unsigned char seq) {
+  linkCounters.telemetryFrames++;
+  if (lastTelemetrySeq[vehicle] >= 0) {
+    unsigned char gap = seq - lastTelemetrySeq[vehicle] - 1;
+    if (gap < 0x80) linkCounters.telemetryLost += gap;  // otherwise an old frame arrived or the airship restarted
+  }
+  lastTelemetrySeq[vehicle] = seq;
+}
+
+/**
+ * Forgets the counters and the sequence numbers of an airship, e.g. when its session starts.
+ */
+void link_stats_reset(unsigned int vehicle) {
+  remoteCountersKnown[vehicle] = false;
+  heightLoopTiming[vehicle].known = false;
+  lastTelemetrySeq[vehicle] = -1;
+}
+
+/**
+ * Counts a transmitted packet.
+ */
+void link_stats_packet_sent(void) {
+  linkCounters.packetsSent++;
+}
+
+/**
+ * Counts a transmission of a command.
+ *
+ * @param attempt 1 for the first transmission.
+ */
+void link_stats_command_sent(unsigned int attempt) {
+  if (attempt == 1) linkCounters.commandsSent++;
+  else linkCounters.retransmissions++;
+}
+
+/**
+ * Records a confirmed command.
+ *
+ * @param attempts Number of its transmissions.
+ * @param rtt Time from the last transmission to the acknowledgement [ms], it is recorded only for a single transmission.
+ */
+void link_stats_command_confirmed(unsigned int attempts, unsigned long rtt) {
+  linkCounters.commandsConfirmed++;
+  if (attempts > 1) linkCounters.commandsRetried++;
+  else histogram_add(rttHistogram, rtt);
+  histogram_add(attemptsHistogram, attempts);
+}
+
+/**
+ * Computes the rates and the loss of the last window. It is called in every pass of the main loop.
+ */
+void link_stats_service(void) {
+  unsigned long now = millis();
+  unsigned long elapsed = now - windowStart;
+  if (elapsed < LINK_STATS_WINDOW) return;
+
+  unsigned long received = linkCounters.packetsReceived;
+  unsigned long sent = linkCounters.packetsSent;
+  unsigned long frames = linkCounters.telemetryFrames;
+  unsigned long lost = linkCounters.telemetryLost;
+  linkRates.received = (received - windowReceived) * 60000.0 / elapsed;
+  linkRates.sent = (sent - windowSent) * 60000.0 / elapsed;
+  unsigned long expected = (frames - windowFrames) + (lost - windowLost);
+  linkRates.downlinkLoss = (expected > 0) ? 100.0 * (lost - windowLost) / expected : 0;
+  unsigned long uplink = uplinkSent, delivered = uplinkDelivered;
+  linkRates.uplinkLoss = (uplink > 0 && delivered < uplink) ? 100.0 * (uplink - delivered) / uplink : 0;
+
+  windowStart = now;
+  windowReceived = received;
+  windowSent = sent;
+  windowFrames = frames;
+  windowLost = lost;
+  uplinkSent = 0;
+  uplinkDelivered = 0;
+}
+
+/**
+ * Prints the link statistics to the serial monitor.
+ */
+void print_link_statistics(void) {
+  Serial.println();
+  Serial.print("Link profile : "), Serial.println(currentProfile);
+  Serial.print("Airtime budget : "), Serial.print(airtime_available()), Serial.print(" of "), Serial.print(airtime_capacity());
+  Serial.print(" ms ("), Serial.print(airtimeDutyCycle), Serial.println(" % duty cycle)");
+  Serial.print("Last "), Serial.print(LINK_STATS_WINDOW / 1000), Serial.println(" s:");
+  Serial.print("  Received : "), Serial.print(linkRates.received), Serial.println(" packets/min");
+  Serial.print("  Sent : "), Serial.print(linkRates.sent), Serial.println(" packets/min");
+  Serial.print("  Downlink loss : "), Serial.print(linkRates.downlinkLoss), Serial.println(" %");
+  Serial.print("  Uplink loss : "), Serial.print(linkRates.uplinkLoss), Serial.println(" %");
+  Serial.println("Controller:");
+  Serial.print("  Received : "), Serial.println(linkCounters.packetsReceived);
+  Serial.print("  Corrupted frames : "), Serial.println(linkCounters.corruptedFrames);
+  Serial.print("  Corrected frames : "), Serial.println(linkCounters.correctedFrames);
+  Serial.print("  Sent : "), Serial.println(linkCounters.packetsSent);
+  Serial.print("  Commands : "), Serial.println(linkCounters.commandsSent);
+  Serial.print("  Retransmissions : "), Serial.println(linkCounters.retransmissions);
+  Serial.print("  Confirmed : "), Serial.print(linkCounters.commandsConfirmed);
+  Serial.print(" (after a retry: "), Serial.print(linkCounters.commandsRetried), Serial.println(")");
+  Serial.print("  Telemetry frames : "), Serial.print(linkCounters.telemetryFrames);
+  Serial.print(" (lost: "), Serial.print(linkCounters.telemetryLost), Serial.println(")");
+  Serial.println("Airship:");
+  Serial.print("  Received : "), Serial.println(linkCounters.remoteReceived);
+  Serial.print("  Corrupted frames : "), Serial.println(linkCounters.remoteCorrupted);
+  Serial.print("  Corrected frames : "), Serial.println(linkCounters.remoteCorrected);
+  Serial.print("  Duplicate commands : "), Serial.println(linkCounters.remoteDuplicates);
+  for (unsigned int i = 0; i < FLEET_SIZE; i++) {
+    const LoopTimingReport &timing = heightLoopTiming[i];
+    if (!fleet[i].active || !timing.known) continue;
+    Serial.print("  Height loop of 0x"), Serial.print(fleet[i].address, HEX);
+    Serial.print(" : jitter "), Serial.print(timing.jitterMin), Serial.print(" .. "), Serial.print(timing.jitterMax);
+    Serial.print(" us (99 %: "), Serial.print(timing.jitter99), Serial.print(" us), execution 99 %: ");
+    Serial.print(timing.execution99), Serial.print(" us, max: "), Serial.print(timing.executionMax), Serial.println(" us");
+  }
+  print_histogram("RSSI at controller", localRssiHistogram, "dBm");
+  print_histogram("SNR at controller", localSnrHistogram, "dB");
+  print_histogram("RSSI at airship", remoteRssiHistogram, "dBm");
+  print_histogram("SNR at airship", remoteSnrHistogram, "dB");
+  print_histogram("Round-trip time", rttHistogram, "ms");
+  print_histogram("Transmissions per command", attemptsHistogram, "-");
+  print_hop_statistics();
+  print_receive_statistics();
+  Serial.println();
+}
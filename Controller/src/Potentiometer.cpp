@@ -4,37 +4,10 @@
 const unsigned int Potentiometer = A9;
 float CENTER_value = 526;
 volatile float ANGLE = 0;
-float last_angle = 0;
 bool READING = false;
 float k = 3.91;
 float q = -8.91;
 
-/**
- * Check if the rotation angle of the encoder has changed.
- * 
- * @return Returns true if the value has changed, otherwise returns false.
-*/
-bool angle_change(void){
-  // setting limits
-  /*if (current > 130){
-    current = 130;
-  }else if (current < -130){
-    current = -130;
-  }*/
-  float current = ANGLE;
-  if (current > 90){
-    current = 90;
-  }else if (current < -90){
-    current = -90;
-  }
-
-  if (abs(last_angle - current) >= 5 && !READING){
-    last_angle = current;
-    return true;
-  }
-  return false;
-}
-
 // Přednastaví 
 void SetCentreValue(void){
   CENTER_value = get_voltage_value();
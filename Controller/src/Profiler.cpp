@@ -0,0 +1,176 @@
+#include "Profiler.h"
+
+#ifdef PROFILING
+
+extern unsigned long _ebss;    // end of the static data in DTCM, the main stack grows down towards it (linker script of Teensy 4)
+extern unsigned long _estack;  // top of the main stack
+
+// Indexed by ProfileSectionId
+ProfileSection profileSections[PROFILE_SECTION_COUNT] = {
+  {"onReceive", true},
+  {"receive_service", false},
+  {"handle_measured_data_message", false},
+  {"send_commands", false},
+  {"fleet_service", false},
+  {"loop", false},
+};
+
+ProfileThread profileThreads[PROFILE_MAX_THREADS];         // indexed by the ID of the thread
+volatile uint64_t interruptCycles = 0;                     // spent in the sections of interrupts, they have the same priority and do not nest
+volatile uint64_t sampledCycles = 0;                       // covered by the samples of the threads
+IntervalTimer profileTimer;                                // takes the samples of the running thread
+uint32_t lastSampleCycle = 0;
+uint64_t lastSampleInterruptCycles = 0;
+unsigned long profileStart = 0;                            // millis() at profiler_begin()
+
+/**
+ * @param cycles Cycles of the CPU.
+ * @return The same time [us].
+ */
+float cycles_to_us(uint64_t cycles) {
+  return (float)cycles / (F_CPU_ACTUAL / 1000000);
+}
+
+/**
+ * @param thread A thread with a painted stack.
+ * @return The deepest use of its stack since it was painted [bytes].
+ */
+unsigned int stack_used(const ProfileThread &thread) {
+  unsigned int untouched = 0;
+  while (untouched < thread.stackSize && thread.stackLow[untouched] == PROFILE_STACK_PATTERN) untouched++;
+  return thread.stackSize - untouched;
+}
+
+/**
+ * Accounts one run of a section. It is called by ProfileScope at the end of the block.
+ *
+ * @param id The section.
+ * @param cycles Length of the run [cycles].
+ */
+void profile_record(ProfileSectionId id, uint32_t cycles) {
+  ProfileSection &section = profileSections[id];
+  uint32_t us = cycles / (F_CPU_ACTUAL / 1000000);
+  unsigned int bucket = 0;
+  while (bucket < PROFILE_BUCKETS - 1 && us >= (1UL << bucket)) bucket++;
+  section.runs++;
+  section.cycles += cycles;
+  if (cycles > section.maxCycles) section.maxCycles = cycles;
+  section.buckets[bucket]++;
+  if (section.interrupt) interruptCycles += cycles;
+}
+
+/**
+ * Charges the cycles since the previous sample, without the measured interrupts, to the running thread.
+ * It runs in the interrupt of profileTimer.
+ */
+void profile_sample_thread(void) {
+  uint32_t now = ARM_DWT_CYCCNT;
+  uint32_t elapsed = now - lastSampleCycle;  // the counter wraps every 7 s at 600 MHz, the samples are much closer
+  uint64_t inInterrupts = interruptCycles - lastSampleInterruptCycles;
+  lastSampleCycle = now;
+  lastSampleInterruptCycles = interruptCycles;
+  sampledCycles += elapsed;
+  int thread = threads.id();
+  if (thread >= 0 && thread < PROFILE_MAX_THREADS && elapsed > inInterrupts) profileThreads[thread].cycles += elapsed - inInterrupts;
+}
+
+#endif // PROFILING
+
+/**
+ * Starts the profiler. It is called from setup(), which runs on the main stack in the thread of the main loop,
+ * before the threads are created.
+ */
+void profiler_begin(void) {
+#ifdef PROFILING
+  ARM_DEMCR |= ARM_DEMCR_TRCENA;  // the cycle counter, the startup code of Teensy 4 already enables it
+  ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA;
+
+  ProfileThread &main = profileThreads[threads.id()];
+  unsigned char *low = (unsigned char *)&_ebss;
+  unsigned char *sp = (unsigned char *)__builtin_frame_address(0);
+  main.name = "loop";
+  main.stackLow = low;
+  main.stackSize = (unsigned char *)&_estack - low;
+  if (sp - PROFILE_MAIN_STACK_RESERVE > low) {  // the reserve keeps the frames of this call and of the interrupts
+    memset(low, PROFILE_STACK_PATTERN, sp - PROFILE_MAIN_STACK_RESERVE - low);
+  }
+  profileStart = millis();
+  lastSampleCycle = ARM_DWT_CYCCNT;
+  profileTimer.begin(profile_sample_thread, PROFILE_SAMPLE_PERIOD);
+#endif
+}
+
+/**
+ * Starts a thread. With the profiler, its stack is allocated and painted here, so that its use can be measured.
+ *
+ * @param name Name of the thread in the profile.
+ * @param entry The function of the thread.
+ * @param stackSize [bytes]
+ * @return ID of the thread, negative if it could not be created.
+ */
+int profile_add_thread(const char *name, void (*entry)(void), unsigned int stackSize) {
+#ifdef PROFILING
+  unsigned char *stack = new unsigned char[stackSize];
+  memset(stack, PROFILE_STACK_PATTERN, stackSize);
+  int thread = threads.addThread(entry, 0, stackSize, stack);
+  if (thread < 0) {
+    delete[] stack;
+  } else if (thread < PROFILE_MAX_THREADS) {
+    profileThreads[thread].name = name;
+    profileThreads[thread].stackLow = stack;
+    profileThreads[thread].stackSize = stackSize;
+  }
+  return thread;
+#else
+  return threads.addThread(entry, 0, stackSize);
+#endif
+}
+
+/**
+ * Prints the profile since the start: the threads with their share of the CPU and the high-water marks
+ * of their stacks, the share of the measured interrupts and the sections with the histograms of their times.
+ *
+ * @param out Where it is printed (Serial or a file).
+ */
+void print_profile(Print &out) {
+#ifdef PROFILING
+  noInterrupts();
+  double total = sampledCycles;
+  double inInterrupts = interruptCycles;
+  interrupts();
+  out.print("Profile after "), out.print((millis() - profileStart) / 1000), out.print(" s, CPU "), out.print(F_CPU_ACTUAL / 1000000), out.println(" MHz");
+  out.println("Threads (CPU by the samples, without the measured interrupts):");
+  for (unsigned int i = 0; i < PROFILE_MAX_THREADS; i++) {
+    const ProfileThread &t = profileThreads[i];
+    noInterrupts();
+    double cycles = t.cycles;
+    interrupts();
+    if (t.name == NULL && cycles == 0) continue;
+    out.print("  ");
+    if (t.name != NULL) out.print(t.name);
+    else out.print("thread "), out.print(i);
+    out.print(" : CPU "), out.print(total > 0 ? 100.0 * cycles / total : 0.0), out.print(" %");
+    if (t.stackLow != NULL) out.print(", stack "), out.print(stack_used(t)), out.print(" of "), out.print(t.stackSize), out.print(" bytes");
+    out.println();
+  }
+  out.print("  measured interrupts : CPU "), out.print(total > 0 ? 100.0 * inInterrupts / total : 0.0), out.println(" %");
+  out.println("Sections (times in us, histogram: runs shorter than the bound):");
+  for (unsigned int i = 0; i < PROFILE_SECTION_COUNT; i++) {
+    noInterrupts();
+    ProfileSection s = profileSections[i];
+    interrupts();
+    out.print("  "), out.print(s.name), out.print(s.interrupt ? " (interrupt)" : ""), out.print(" : "), out.print(s.runs);
+    out.print(" runs, mean "), out.print(s.runs > 0 ? cycles_to_us(s.cycles) / s.runs : 0.0);
+    out.print(", max "), out.print(cycles_to_us(s.maxCycles)), out.print(",");
+    for (unsigned int b = 0; b < PROFILE_BUCKETS; b++) {
+      if (s.buckets[b] == 0) continue;
+      if (b < PROFILE_BUCKETS - 1) out.print(" <"), out.print(1UL << b);
+      else out.print(" >="), out.print(1UL << (PROFILE_BUCKETS - 2));
+      out.print(":"), out.print(s.buckets[b]);
+    }
+    out.println();
+  }
+#else
+  out.println("The firmware is built without the profiler (see Profiler.h).");
+#endif
+}
@@ -0,0 +1,158 @@
+#include "Query.h"
+#include "Communication.h"
+
+// Indexed by the id of the variable (same order as queryVariables of the airship)
+const QueryVariableName queryVariableNames[QUERY_VARIABLE_COUNT] = {
+  {"CurrentHeight", 100, 2},
+  {"RequiredHeight", 100, 2},
+  {"CurrentRequiredHeight", 100, 2},
+  {"Temperature", 100, 2},
+  {"Humidity", 100, 2},
+  {"Power", 1, 0},
+  {"Altitude", 100, 2},
+  {"Pressure", 1, 0},
+  {"SpeedGPS", 100, 2},
+  {"LatitudeGPS", 1e7, 7},
+  {"LongitudeGPS", 1e7, 7},
+  {"TemperatureMPL", 100, 2},
+  {"AltitudeGPS", 100, 2},
+  {"FixAge", 1, 0},
+  {"UltrasonicDistance", 1, 0},
+  {"USValidityRate", 1000, 3},
+  {"FilteredD", 1000, 3},
+  {"ClasicD", 1000, 3},
+  {"IntegralPart", 1000, 3},
+  {"Angle", 1, 0},
+  {"SteeringPower", 1, 0},
+  {"HumiditySamples", 1, 0},
+  {"PressureSamples", 1, 0},
+  {"GpsSamples", 1, 0},
+};
+
+/**
+ * Reads the query section of a packet and prints the variables. It is called from receive_service().
+ * Format: [bitmap of the variables (3 bytes), zig-zag varint of each of them]
+ *
+ * @param reader The received packet, positioned at the query section.
+ * @param v The session of the airship.
+ * @return False if the packet is too short.
+ */
+bool query_received(PacketReader &reader, const VehicleSession &v) {
+  unsigned char bitmap[QUERY_HEADER_SIZE];
+  for (unsigned int i = 0; i < QUERY_HEADER_SIZE; i++) reader.read_byte(bitmap[i]);
+  if (!reader.ok()) return false;
+  uint32_t variables = bitmap[0] | ((uint32_t)bitmap[1] << 8) | ((uint32_t)bitmap[2] << 16);
+  if (variables == 0) return true;  // a subscribed packet whose variables are not due yet
+
+  int32_t values[QUERY_VARIABLE_COUNT];
+  for (unsigned int i = 0; i < QUERY_VARIABLE_COUNT; i++) {
+    uint32_t raw;
+    if (!(variables & ((uint32_t)1 << i))) continue;
+    if (!reader.read_varint(raw)) return false;
+    values[i] = zigzag_decode(raw);
+  }
+
+  Serial.println("---");
+  if (fleet_count() > 1) {
+    Serial.print("Airship : "), Serial.println(fleet_index(v) + 1);
+  }
+  Serial.print("Time : "), Serial.println(millis());
+  Serial.println("Query : 1");
+  for (unsigned int i = 0; i < QUERY_VARIABLE_COUNT; i++) {
+    if (!(variables & ((uint32_t)1 << i))) continue;
+    const QueryVariableName &q = queryVariableNames[i];
+    Serial.print(q.name), Serial.print(" : ");
+    if (q.digits == 0) Serial.println((long)values[i]);
+    else Serial.println(values[i] / q.scale, q.digits);
+  }
+  Serial.println("+++");
+  return true;
+}
+
+/**
+ * Sends a query of the serial command 'get | names' or 'subscribe | period names' to the selected airship.
+ *
+ * @param text The part of the command behind "|".
+ * @param subscribe True for 'subscribe', the text starts with the period [ms].
+ */
+void query_input(const String &text, bool subscribe) {
+  uint32_t variables = 0;
+  long period = 0;
+  bool periodRead = !subscribe;
+  String name = "";
+  for (unsigned int i = 0; i <= text.length(); i++) {
+    char c = (i < text.length()) ? text.charAt(i) : ' ';
+    if (c != ' ' && c != ',' && c != '\n' && c != '\r') {
+      name += c;
+      continue;
+    }
+    if (name.length() == 0) continue;
+    if (!periodRead) {
+      period = name.toInt();
+      periodRead = true;
+    } else {
+      int id = query_variable(name);
+      if (id < 0) {
+        Serial.print("Unknown variable: "), Serial.println(name);
+        return;
+      }
+      variables |= (uint32_t)1 << id;
+    }
+    name = "";
+  }
+
+  unsigned int units = (period + QUERY_PERIOD_UNIT - 1) / QUERY_PERIOD_UNIT;
+  if (subscribe && (period < 0 || units > QUERY_MAX_PERIOD)) {
+    Serial.println("INVALID COMMAND!");
+    return;
+  }
+  if (!subscribe && variables == 0) {
+    Serial.println("No variables. Type 'variables' for their names.");
+    return;
+  }
+  if (subscribe && period == 0) variables = 0;  // the subscription ends
+  if (subscribe && variables == 0) units = 1;   // period 0 would be a snapshot
+
+  VehicleSession &v = selected_vehicle();
+  if (!v.active || !arq_can_send(v)) {
+    Serial.println("The airship is not in the fleet or its command window is full.");
+    return;
+  }
+  arq_submit(v, query_command(v, variables, subscribe ? units : 0));
+  if (!subscribe) Serial.println("Snapshot requested.");
+  else if (variables == 0) Serial.println("Subscription ended.");
+  else Serial.print("Subscribed, period "), Serial.print(units * QUERY_PERIOD_UNIT), Serial.println(" ms.");
+}
+
+/**
+ * Builds the QUERY command. Value: [period (upper byte, in QUERY_PERIOD_UNIT, 0 = snapshot), bitmap of the variables (3 bytes)]
+ * The value is put together here, a float (see fleet_command()) would not hold all its bits.
+ */
+command query_command(VehicleSession &v, uint32_t variables, unsigned int period) {
+  command cmd = fleet_command(v, all_ids.QUERY, 0);
+  cmd.value = (int32_t)(((uint32_t)period << 24) | (variables & 0xFFFFFF));
+  return cmd;
+}
+
+/**
+ * Finds a variable by its name, the case does not matter.
+ *
+ * @return Id of the variable, or -1 if there is no such variable.
+ */
+int query_variable(const String &name) {
+  for (unsigned int i = 0; i < QUERY_VARIABLE_COUNT; i++) {
+    if (strcasecmp(name.c_str(), queryVariableNames[i].name) == 0) return i;
+  }
+  return -1;
+}
+
+/**
+ * Prints the names of all variables (the 'variables' command).
+ */
+void print_query_variables(void) {
+  Serial.print("Variables :");
+  for (unsigned int i = 0; i < QUERY_VARIABLE_COUNT; i++) {
+    Serial.print(" "), Serial.print(queryVariableNames[i].name);
+  }
+  Serial.println();
+}
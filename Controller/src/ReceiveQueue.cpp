@@ -0,0 +1,69 @@
+#include "ReceiveQueue.h"
+
+PacketBuffer receiveQueue[RECEIVE_QUEUE_SIZE];
+volatile unsigned int receiveQueueHead = 0;  // next slot to be written, free running
+volatile unsigned int receiveQueueTail = 0;  // next slot to be read, free running
+volatile ReceiveStatistics receiveStatistics;
+
+/**
+ * Reads a received packet from the radio into the next free slot. It is called only from onReceive().
+ *
+ * @param packetSize The size of the received packet reported by the LoRa library.
+ */
+void receive_queue_push(int packetSize) {
+  unsigned long start = micros();
+  unsigned int head = receiveQueueHead;
+  unsigned int used = head - receiveQueueTail;
+  if (used >= RECEIVE_QUEUE_SIZE) {
+    receiveStatistics.overflows++;
+  } else if (receive_packet(receiveQueue[head % RECEIVE_QUEUE_SIZE], packetSize)) {  // oversized packets are dropped
+    receiveQueue[head % RECEIVE_QUEUE_SIZE].timeMicros = start;
+    __sync_synchronize();  // the packet must be written before it is published
+    receiveQueueHead = head + 1;
+    if (used + 1 > receiveStatistics.highWater) receiveStatistics.highWater = used + 1;
+  }
+  unsigned long duration = micros() - start;
+  receiveStatistics.packets++;
+  receiveStatistics.interruptTotal += duration;
+  if (duration > receiveStatistics.interruptMax) receiveStatistics.interruptMax = duration;
+}
+
+/**
+ * Takes the oldest received packet from the queue. It is called only from receive_service().
+ *
+ * @param packet Buffer to store the packet.
+ * @return False if the queue is empty.
+ */
+bool receive_queue_pop(PacketBuffer &packet) {
+  unsigned int tail = receiveQueueTail;
+  if (tail == receiveQueueHead) return false;
+  __sync_synchronize();  // the packet is read only after the head that published it
+  packet = receiveQueue[tail % RECEIVE_QUEUE_SIZE];
+  __sync_synchronize();  // the slot is released only after it was read
+  receiveQueueTail = tail + 1;
+
+  unsigned long wait = micros() - packet.timeMicros;
+  noInterrupts();  // onReceive() updates the other statistics
+  receiveStatistics.processed++;
+  receiveStatistics.waitTotal += wait;
+  if (wait > receiveStatistics.waitMax) receiveStatistics.waitMax = wait;
+  interrupts();
+  return true;
+}
+
+/**
+ * Prints the timing of the receive path to the serial monitor.
+ */
+void print_receive_statistics(void) {
+  noInterrupts();
+  ReceiveStatistics s;
+  memcpy(&s, (const void *)&receiveStatistics, sizeof(s));
+  interrupts();
+  Serial.println("Receive path:");
+  Serial.print("  Interrupt : "), Serial.print(s.packets > 0 ? s.interruptTotal / s.packets : 0);
+  Serial.print(" us mean, "), Serial.print(s.interruptMax), Serial.print(" us max ("), Serial.print(s.packets), Serial.println(" packets)");
+  Serial.print("  Wait for the main loop : "), Serial.print(s.processed > 0 ? s.waitTotal / s.processed : 0);
+  Serial.print(" us mean, "), Serial.print(s.waitMax), Serial.println(" us max");
+  Serial.print("  Queue : "), Serial.print(s.highWater), Serial.print(" of "), Serial.print(RECEIVE_QUEUE_SIZE);
+  Serial.print(" slots used at most, "), Serial.print(s.overflows), Serial.println(" packets dropped");
+}
@@ -0,0 +1,82 @@
+#include "Steering.h"
+#include "Communication.h"
+
+/*
+Continuous controls, controller side.
+The rotary potentiometer is read in every pass of the main loop, every change of at least STEERING_DEADBAND
+goes out with the next transmission to the selected airship: with its commands (see arq_service()) or in
+a packet of its own in the uplink or contention slot of the TDMA frame (see TDMA.h). Unlike the commands,
+a lost setpoint is not retransmitted, the next one replaces it. Without a change, the current setpoint is still
+sent every STEERING_PERIOD to every active airship, so a silent stream means a lost link to the airship,
+which then holds its servo and stops the steering motor.
+*/
+
+/**
+ * Takes new values of the continuous controls of an airship. A change is sent with the next transmission.
+ *
+ * @param v The session of the airship.
+ * @param angle Steering angle [degrees].
+ * @param power Power of the steering motor (0 to 180).
+ */
+void steering_input(VehicleSession &v, int angle, int power) {
+  angle = constrain(angle, -STEERING_MAX_ANGLE, STEERING_MAX_ANGLE);
+  power = constrain(power, 0, 180);
+  if (abs(angle - v.steeringAngle) < STEERING_DEADBAND && power == v.steeringPower) return;
+  v.steeringAngle = angle;
+  v.steeringPower = power;
+  v.steeringChanged = true;
+}
+
+/**
+ * Reads the steering angle from the rotary potentiometer for the selected airship. It is called in every pass of the main loop.
+ */
+void steering_service(void) {
+  VehicleSession &v = selected_vehicle();
+  if (!v.active) return;
+  steering_input(v, round(ANGLE), v.steeringPower);
+}
+
+/**
+ * Checks whether a setpoint should be sent to an airship: a change after STEERING_INTERVAL,
+ * the unchanged setpoint after STEERING_PERIOD.
+ */
+bool steering_due(const VehicleSession &v) {
+  if (!v.active) return false;
+  unsigned long since = millis() - v.steeringSentAt;
+  return since >= STEERING_INTERVAL && (v.steeringChanged || since >= STEERING_PERIOD);
+}
+
+/**
+ * Creates the setpoint record with the next sequence number of the channel.
+ *
+ * @param v The session of the airship.
+ * @return The CONTROL_SETPOINT command.
+ */
+command steering_command(const VehicleSession &v) {
+  command cmd(all_ids.CONTROL_SETPOINT, v.steeringSeq + 1, 0);
+  cmd.value = v.steeringAngle * 256 + v.steeringPower;  // no shift, the angle can be negative
+  return cmd;
+}
+
+/**
+ * Counts the setpoint as sent, after it has been transmitted.
+ */
+void steering_sent(VehicleSession &v) {
+  v.steeringSeq++;
+  v.steeringSentAt = millis();
+  v.steeringChanged = false;
+}
+
+/**
+ * Sends the setpoint in a packet of its own. It is left out when the airtime budget is tight (see Airtime.h),
+ * a later setpoint replaces it anyway.
+ *
+ * @param v The session of the airship.
+ * @return True if it was sent.
+ */
+bool send_steering(VehicleSession &v) {
+  if (!send_command(v.address, steering_command(v), AIRTIME_TELEMETRY)) return false;
+  steering_sent(v);
+  LoRa.receive();
+  return true;
+}
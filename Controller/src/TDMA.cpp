@@ -0,0 +1,73 @@
+#include "TDMA.h"
+#include "LinkAdaptation.h"
+#include "Fleet.h"
+
+/*
+Time-slotted channel access, controller side.
+The frame starts when a beacon (telemetry packet marked in the status byte) from the airship is received.
+Commands are sent only in the uplink slot and "SAY_HI" only in the contention slot, so the controller
+never transmits while the airship does. Without beacons (start, lost link, switch of the link profile)
+the controller is not synchronised and transmits whenever it needs to.
+With several airships, each of them sends its beacon in its own frame of a superframe of fleet_slots() frames
+(see Fleet.h), the controller follows the frame of every airship separately.
+*/
+
+/**
+ * Computes the slots of the TDMA frame for the current link profile (see LinkAdaptation.h).
+ * Both ends compute the same layout, so only the beacon has to be transmitted.
+ *
+ * @param layout Reference to store the slots.
+ */
+void tdma_layout(TdmaLayout &layout) {
+  unsigned long slot = link_airtime(currentProfile, TDMA_MAX_PACKET) + TDMA_GUARD;  // one packet with its guard
+  layout.uplinkStart = TDMA_GUARD;
+  layout.uplinkEnd = layout.uplinkStart + TDMA_UPLINK_WINDOW;
+  layout.ackStart = layout.uplinkEnd + slot;
+  layout.ackEnd = layout.ackStart + TDMA_LOOP_PERIOD + TDMA_GUARD;
+  layout.contentionStart = layout.ackEnd + slot;
+  layout.contentionEnd = layout.contentionStart + TDMA_CONTENTION_WINDOW;
+  layout.frame = layout.contentionEnd + slot;
+  if (layout.frame < TDMA_MIN_FRAME) layout.frame = TDMA_MIN_FRAME;
+}
+
+/**
+ * Starts a new frame of an airship. It is called from receive_service() when its beacon arrives.
+ *
+ * @param v The session of the airship.
+ * @param time millis() at the reception of the beacon.
+ */
+void tdma_beacon_received(VehicleSession &v, unsigned long time) {
+  v.beaconAt = time;
+  v.beaconHeard = true;
+}
+
+/**
+ * Checks whether the controller follows the schedule of an airship, i.e. its beacon arrived within the last three superframes.
+ */
+bool tdma_synchronised(const VehicleSession &v) {
+  TdmaLayout layout;
+  tdma_layout(layout);
+  return v.beaconHeard && millis() - v.beaconAt < 3 * layout.frame * fleet_slots();
+}
+
+/**
+ * Checks whether commands may be sent to an airship now.
+ */
+bool tdma_uplink_open(const VehicleSession &v) {
+  if (!tdma_synchronised(v)) return true;
+  TdmaLayout layout;
+  tdma_layout(layout);
+  unsigned long t = millis() - v.beaconAt;
+  return t >= layout.uplinkStart && t < layout.uplinkEnd;
+}
+
+/**
+ * Checks whether an unscheduled packet ("SAY_HI") may be sent to an airship now.
+ */
+bool tdma_contention_open(const VehicleSession &v) {
+  if (!tdma_synchronised(v)) return true;
+  TdmaLayout layout;
+  tdma_layout(layout);
+  unsigned long t = millis() - v.beaconAt;
+  return t >= layout.contentionStart && t < layout.contentionEnd;
+}
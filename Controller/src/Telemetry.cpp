@@ -0,0 +1,201 @@
+#include "Telemetry.h"
+#include "LinkStats.h"
+#include "Fleet.h"
+
+// Every airship of the fleet has its own references (see Fleet.h)
+int32_t telemetryHistory[FLEET_SIZE][TELEMETRY_HISTORY][TELEMETRY_FIELD_COUNT]; // fields of the recently decoded frames, indexed by seq
+unsigned char telemetryHistorySeq[FLEET_SIZE][TELEMETRY_HISTORY];
+bool telemetryHistoryValid[FLEET_SIZE][TELEMETRY_HISTORY] = {{false}};
+int32_t telemetryLatest[FLEET_SIZE][TELEMETRY_FIELD_COUNT]; // the last received value of each field
+
+/**
+ * Decodes one report of the telemetry stream, which is either a keyframe or a delta frame.
+ * Every decoded frame is stored as a possible reference and every keyframe is scheduled for acknowledgement,
+ * so that the blimp can start sending deltas against it.
+ *
+ * @param reader The received packet, positioned at the beginning of the telemetry frame.
+ * @param frame Reference to store the decoded frame.
+ * @param v The session of the airship that sent the frame.
+ * @return True if the frame was decoded, False if it is corrupted or its reference is unknown.
+ */
+bool decode_telemetry(PacketReader &reader, TelemetryFrame &frame, VehicleSession &v) {
+  unsigned int vehicle = fleet_index(v);
+  unsigned char format, seq;
+  if (!reader.read_byte(format) || !reader.read_byte(seq)) return false;
+  link_stats_telemetry_frame(vehicle, seq);
+  int32_t fields[TELEMETRY_FIELD_COUNT];
+
+  if (format == TELEMETRY_FULL_FRAME) {
+    if (!decode_telemetry_frame(reader, frame)) return false;
+    frame_to_fields(frame, fields);
+    v.telemetryAckSeq = seq;
+    v.telemetryAckPending = true;
+  } else if (format == TELEMETRY_DELTA_FRAME) {
+    if (!decode_delta_frame(reader, vehicle, fields)) return false;
+    fields_to_frame(fields, frame);
+  } else {
+    return false;
+  }
+  store_telemetry_frame(vehicle, seq, fields);
+  return true;
+}
+
+/**
+ * Forgets the references of an airship, e.g. when its session starts.
+ */
+void telemetry_reset(unsigned int vehicle) {
+  for (unsigned int i = 0; i < TELEMETRY_HISTORY; i++) telemetryHistoryValid[vehicle][i] = false;
+  for (unsigned int i = 0; i < TELEMETRY_FIELD_COUNT; i++) telemetryLatest[vehicle][i] = 0;
+}
+
+/**
+ * Deserializes the body of a keyframe sent by the blimp.
+ * Format: [TELEMETRY_FULL_FRAME, seq, current height, required height, current required height, temperature, humidity,
+ * power, altitude, pressure, speed, latitude, longitude]
+ *
+ * @param reader The received packet, positioned behind the sequence number.
+ * @param frame Reference to store the decoded frame.
+ * @return True if the rest of the packet is exactly one keyframe body, False otherwise.
+ */
+bool decode_telemetry_frame(PacketReader &reader, TelemetryFrame &frame) {
+  return read_telemetry_fields(reader, frame) && reader.remaining() == 0;
+}
+
+/**
+ * Reads the fields of a keyframe body (also used by the backlog records, see Backlog.h).
+ *
+ * @param reader The received packet, positioned at the fields.
+ * @param frame Reference to store the decoded frame.
+ * @return False if the packet is too short.
+ */
+bool read_telemetry_fields(PacketReader &reader, TelemetryFrame &frame) {
+  int16_t speed;
+  reader.read_int16(frame.currentHeight);
+  reader.read_int16(frame.requiredHeight);
+  reader.read_int16(frame.currentRequiredHeight);
+  reader.read_int16(frame.temperature);
+  reader.read_int16(frame.humidity);
+  reader.read_byte(frame.power);
+  reader.read_int32(frame.altitude);
+  reader.read_int32(frame.pressure);
+  reader.read_int16(speed);
+  reader.read_int32(frame.latitude);
+  reader.read_int32(frame.longitude);
+  frame.speed = (uint16_t)speed;
+  return reader.ok();
+}
+
+/**
+ * Applies a delta frame to the stored reference frame.
+ * Format: [TELEMETRY_DELTA_FRAME, seq, reference seq, presence bitmap (2 bytes), zig-zag varint delta of each present field]
+ * The blimp sends only the fields with new samples (its telemetry scheduler decides), a missing field keeps the last received value.
+ *
+ * @param reader The received packet, positioned behind the sequence number.
+ * @param vehicle Index of the airship in the fleet.
+ * @param fields Output array of TELEMETRY_FIELD_COUNT fields.
+ * @return True if the reference is known and the whole packet was consumed, False otherwise.
+ */
+bool decode_delta_frame(PacketReader &reader, unsigned int vehicle, int32_t *fields) {
+  unsigned char refSeq;
+  int16_t bitmap;
+  if (!reader.read_byte(refSeq) || !reader.read_int16(bitmap)) return false;
+  unsigned int slot = refSeq % TELEMETRY_HISTORY;
+  if (!telemetryHistoryValid[vehicle][slot] || telemetryHistorySeq[vehicle][slot] != refSeq) {
+    Serial.print("Unknown telemetry reference: "), Serial.println(refSeq);
+    return false;
+  }
+
+  for (unsigned int i = 0; i < TELEMETRY_FIELD_COUNT; i++) {
+    fields[i] = telemetryLatest[vehicle][i];
+    if ((uint16_t)bitmap & (1 << i)) {
+      uint32_t delta;
+      if (!reader.read_varint(delta)) return false;
+      fields[i] = (int32_t)((uint32_t)telemetryHistory[vehicle][slot][i] + (uint32_t)zigzag_decode(delta));
+    }
+  }
+  return reader.remaining() == 0;
+}
+
+/**
+ * Stores the fields of a decoded frame so that later delta frames of the same airship can refer to it.
+ */
+void store_telemetry_frame(unsigned int vehicle, unsigned char seq, const int32_t *fields) {
+  unsigned int slot = seq % TELEMETRY_HISTORY;
+  for (unsigned int i = 0; i < TELEMETRY_FIELD_COUNT; i++) {
+    telemetryHistory[vehicle][slot][i] = fields[i];
+    telemetryLatest[vehicle][i] = fields[i];
+  }
+  telemetryHistorySeq[vehicle][slot] = seq;
+  telemetryHistoryValid[vehicle][slot] = true;
+}
+
+/**
+ * Copies the fields of a frame into an array in the order of TelemetryFrame, so that they can be processed in a loop.
+ */
+void frame_to_fields(const TelemetryFrame &frame, int32_t *fields) {
+  fields[0] = frame.currentHeight;
+  fields[1] = frame.requiredHeight;
+  fields[2] = frame.currentRequiredHeight;
+  fields[3] = frame.temperature;
+  fields[4] = frame.humidity;
+  fields[5] = frame.power;
+  fields[6] = frame.altitude;
+  fields[7] = frame.pressure;
+  fields[8] = frame.speed;
+  fields[9] = frame.latitude;
+  fields[10] = frame.longitude;
+}
+
+/**
+ * Inverse of frame_to_fields().
+ */
+void fields_to_frame(const int32_t *fields, TelemetryFrame &frame) {
+  frame.currentHeight = fields[0];
+  frame.requiredHeight = fields[1];
+  frame.currentRequiredHeight = fields[2];
+  frame.temperature = fields[3];
+  frame.humidity = fields[4];
+  frame.power = fields[5];
+  frame.altitude = fields[6];
+  frame.pressure = fields[7];
+  frame.speed = fields[8];
+  frame.latitude = fields[9];
+  frame.longitude = fields[10];
+}
+
+/**
+ * Inverse of the zig-zag mapping used by the blimp (0, 1, 2, 3 -> 0, -1, 1, -2).
+ */
+int32_t zigzag_decode(uint32_t value) {
+  return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+/**
+ * Prints a telemetry frame to the serial monitor in the "Name : value" format of the former text report,
+ * so that the control application can parse it without changes.
+ */
+void print_telemetry_frame(const TelemetryFrame &frame) {
+  Serial.print("CurrentHeight : "), Serial.println(from_fixed_16(frame.currentHeight, 100));
+  Serial.print("RequiredHeight : "), Serial.println(from_fixed_16(frame.requiredHeight, 100));
+  Serial.print("CurrentRequiredHeight : "), Serial.println(from_fixed_16(frame.currentRequiredHeight, 100));
+  Serial.print("Temperature : "), Serial.println(from_fixed_16(frame.temperature, 100));
+  Serial.print("Humidity : "), Serial.println(from_fixed_16(frame.humidity, 100));
+  Serial.print("Power : "), Serial.println(frame.power);
+  Serial.print("Altitude : "), Serial.println(frame.altitude / 100.0);
+  Serial.print("Pressure : "), Serial.println(frame.pressure);
+  Serial.print("SpeedGPS : "), Serial.println(frame.speed / 100.0);
+  Serial.print("LatitudeGPS : "), Serial.println(frame.latitude / 1e7, 7);
+  Serial.print("LongitudeGPS : "), Serial.println(frame.longitude / 1e7, 7);
+}
+
+/**
+ * Converts a 16-bit fixed-point number back to base units.
+ *
+ * @param value The fixed-point value.
+ * @param scale Number of fixed-point steps per base unit (e.g. 100 for cm).
+ * @return The value in base units, or TELEMETRY_INVALID_VALUE if the blimp marked the field as invalid.
+ */
+float from_fixed_16(int16_t value, float scale) {
+  if (value == TELEMETRY_INVALID_16) return TELEMETRY_INVALID_VALUE;
+  return value / scale;
+}
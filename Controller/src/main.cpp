@@ -10,6 +10,7 @@
 #include "Communication.h"
 #include "Commands.h"
 #include "LedDiods.h"
+#include "Profiler.h"
 
 void setup() {
   Serial.begin(9600); // initialize serial
@@ -43,7 +44,11 @@ void setup() {
 
   SetCentreValue();
 
-  threads.addThread(thread_upgrade_angle);
+  // The sessions start with random sequence numbers, so that the airships do not take the first commands after a restart for duplicates
+  randomSeed(analogRead(Potentiometer) ^ micros());
+
+  profiler_begin();  // before the threads, it paints the main stack (see Profiler.h)
+  profile_add_thread("steering angle", thread_upgrade_angle);
 
   LoRa.onReceive(onReceive);
   LoRa.receive();
@@ -52,33 +57,27 @@ void setup() {
 
 command cmd(0x00, 0); // command
 void loop() {
+  PROFILE_SECTION(PROFILE_MAIN_LOOP);  // see Profiler.h
+  receive_service();  // the packets received since the last pass (see ReceiveQueue.h)
   control_diodes(cmd, false);
-  if (lastCmdConfirmed ){ // The previous command has already been processed and a new one has just been entered.
+  VehicleSession &v = selected_vehicle();
+  if (!v.active || arq_can_send(v)){ // There is room in the command window (see ARQ.h) of the selected airship for a new command.
     bool neww = get_command(cmd);
     if(neww){
       control_diodes(cmd, neww);
-      if(cmd.ID == all_ids.SAY_HI){ 
-        // With no acknowledgment of receipt
-        send_command(cmd);
-        Serial.println("Sent the informational command 'SAY_HI'.");
-      }else{ 
-        // With acknowledgment of receipt
-        send_command(cmd);
-        lastCmdConfirmed = false;
-        confirmation_arrived = false;
-        Serial.print("First attempt sent. Command counter is - "), Serial.print(cmd.counter), Serial.print(",  command ID - "), Serial.println(cmd.ID);
+      if(!v.active){
+        Serial.println("The selected airship is not in the fleet, type 'fleet' to see the airships.");
+      }else if(cmd.ID != all_ids.SAY_HI){
+        // With acknowledgment of receipt, sent and retransmitted by arq_service() until it is confirmed
+        arq_submit(v, cmd);
       }
-      lastSendTime = millis();
-      LoRa.receive();
-    }
-  }else{
-    if(confirmation_arrived or ((millis() - lastSendTime) > 500)){
-      send_command(cmd);
-      confirmation_arrived = false;
-      lastSendTime = millis();
-      Serial.print("Another attempt sent. Command counter - "), Serial.print(cmd.counter), Serial.print(", command ID - "), Serial.println(cmd.ID);
-      Serial.println();
-      LoRa.receive();
     }
   }
+  steering_service();  // the steering angle goes by its own channel, not as a command
+  fleet_service();  // commands, telemetry acknowledgements and "SAY_HI" of all airships, one packet per pass
+  link_service();
+  link_stats_service();
+  backlog_service();
+  hop_service();  // the next channel at the end of each frame
+  capture_service();
 }
\ No newline at end of file
@@ -0,0 +1,186 @@
+#ifndef AIRSHIP_SIM_H
+#define AIRSHIP_SIM_H
+
+/*
+Fixture of the simulations of the controller against a model of the airship (test_link_adaptation, test_tdma,
+test_fleet, test_hopping). It is included by the tests, it is not a test itself.
+- sim_random(): deterministic random numbers, every test seeds simRandomState itself.
+- The packets of the model: write_airship_report() and finish_airship_report() build the telemetry packet with the
+  acknowledgement, read_controller_packet() takes the commands out of a packet of send_commands() as the airship does,
+  and SimWindow keeps the order of the commands as the receive window of the airship.
+- The channel: sim_transmit() puts a packet on the air, two packets on the same frequency that overlap in time are
+  both lost, and sim_take_finished() returns the packets that ended.
+*/
+#include <unity.h>
+#include <TestVectors.h>
+#include "Communication.h"
+
+#define SIM_ON_AIR 32                // packets on the air at once
+#define SIM_MAX_COMMANDS (ARQ_WINDOW + 2)  // commands in one packet: the window, the telemetry acknowledgement and the setpoint
+
+inline uint32_t simRandomState = 1;
+
+// Deterministic uniform numbers in <0, 1) (xorshift)
+inline double sim_random(void) {
+  simRandomState ^= simRandomState << 13;
+  simRandomState ^= simRandomState >> 17;
+  simRandomState ^= simRandomState << 5;
+  return simRandomState / 4294967296.0;
+}
+
+// One command of a packet of the controller
+struct SimCommand {
+  uint16_t seq;
+  unsigned char id;
+  int32_t value;
+};
+
+// Receive window of the airship (see ARQ.h of the airship): the commands are taken in order, the others are repeated
+struct SimWindow {
+  bool started;
+  uint16_t expected;                 // next command sequence number
+};
+
+/**
+ * Takes the commands out of a packet sent by send_commands(). The frame check must pass.
+ *
+ * @param data The packet.
+ * @param length Its length.
+ * @param recipient Reference to store the address of the recipient.
+ * @param cmds Array of SIM_MAX_COMMANDS to store the commands.
+ * @return The number of commands.
+ */
+inline unsigned int read_controller_packet(const unsigned char *data, unsigned int length, unsigned char &recipient, SimCommand *cmds) {
+  PacketBuffer frame;
+  memcpy(frame.data, data, length);
+  frame.length = length;
+  TEST_ASSERT_EQUAL(FRAME_OK, check_frame(frame));
+  PacketReader reader(frame.data, frame.length);
+  unsigned char sender, count;
+  reader.read_byte(recipient), reader.read_byte(sender), reader.read_byte(count);
+  TEST_ASSERT_TRUE(count <= SIM_MAX_COMMANDS);
+  for (unsigned int i = 0; i < count; i++) {
+    int16_t seq;
+    cmds[i].value = 0;
+    reader.read_int16(seq), reader.read_byte(cmds[i].id);
+    if (command_has_value(cmds[i].id)) reader.read_int32(cmds[i].value);
+    cmds[i].seq = seq;
+  }
+  TEST_ASSERT_TRUE(reader.ok());
+  return count;
+}
+
+/**
+ * Passes a command through the receive window of the airship.
+ *
+ * @return True if it is the next one in order and is processed now; false for a duplicate, a command out of order
+ * (the controller repeats it) and the commands outside the window ("SAY_HI", the telemetry acknowledgement, the setpoint).
+ */
+inline bool sim_window_accept(SimWindow &window, const SimCommand &cmd) {
+  if (cmd.id == all_ids.SAY_HI || cmd.id == all_ids.TELEMETRY_ACK || cmd.id == all_ids.CONTROL_SETPOINT) return false;
+  if (!window.started) window.started = true, window.expected = cmd.seq;
+  if (cmd.seq != window.expected) return false;
+  window.expected++;
+  return true;
+}
+
+/**
+ * Writes the telemetry packet of the airship up to its link report, as send_measured_data() of the airship does.
+ * Format: [controller, airship, status, MEASURED_DATA, command acknowledgement, link report]
+ *
+ * @param writer The packet.
+ * @param address The address of the airship.
+ * @param status The status byte (B = beacon 0x04, H = hopping state 0x20, ...).
+ * @param window The receive window, its next expected command is acknowledged.
+ * @param snr The SNR of the last packet from the controller [dB].
+ */
+inline void write_airship_report(PacketWriter &writer, unsigned char address, unsigned char status, const SimWindow &window, float snr = 7) {
+  writer.put_byte(localAddress);
+  writer.put_byte(address);
+  writer.put_byte(status);
+  writer.put_byte(report.MEASURED_DATA);
+  writer.put_byte(window.started ? ARQ_ACK_SESSION : 0);
+  writer.put_int16(window.expected);
+  writer.put_byte(0);                                 // held
+  writer.put_byte(0);                                 // refused
+  writer.put_byte((unsigned char)(int8_t)constrain((int)(snr * 4), -128, 127));
+  writer.put_byte((unsigned char)(int8_t)-90);        // RSSI
+}
+
+/**
+ * Ends the telemetry packet with the keyframe and the frame check.
+ */
+inline void finish_airship_report(PacketWriter &writer) {
+  writer.put_bytes(GOLDEN_KEYFRAME, sizeof(GOLDEN_KEYFRAME));
+  append_frame_check(writer);
+}
+
+// One packet on the air
+struct Transmission {
+  bool used;
+  unsigned int sender;
+  long frequency;
+  unsigned long start, end;
+  bool collided;
+  bool receiverTuned;                // noted by the test: the receiver was on the frequency at the start
+  unsigned int length;
+  unsigned char data[PACKET_CAPACITY];
+};
+
+inline Transmission simOnAir[SIM_ON_AIR];
+
+/**
+ * Clears the channel.
+ */
+inline void sim_channel_reset(void) {
+  memset(simOnAir, 0, sizeof(simOnAir));
+}
+
+/**
+ * Puts a packet on the air from now for its time on air with the current profile. It collides with every packet
+ * of another sender on the same frequency that overlaps it.
+ *
+ * @param sender The sender, numbered by the test.
+ * @param frequency [Hz]
+ * @param data The packet.
+ * @param length Its length.
+ * @return The transmission, the test may note more about it.
+ */
+inline Transmission &sim_transmit(unsigned int sender, long frequency, const unsigned char *data, unsigned int length) {
+  Transmission *t = NULL;
+  for (unsigned int i = 0; i < SIM_ON_AIR && t == NULL; i++) if (!simOnAir[i].used) t = &simOnAir[i];
+  TEST_ASSERT_NOT_NULL(t);
+  t->used = true;
+  t->sender = sender;
+  t->frequency = frequency;
+  t->start = millis();
+  t->end = t->start + link_airtime(currentProfile, length);
+  t->collided = false;
+  t->receiverTuned = true;
+  t->length = length;
+  memcpy(t->data, data, length);
+  for (unsigned int i = 0; i < SIM_ON_AIR; i++) {
+    Transmission &o = simOnAir[i];
+    if (&o != t && o.used && o.sender != sender && o.frequency == frequency && o.start < t->end && t->start < o.end) o.collided = t->collided = true;
+  }
+  return *t;
+}
+
+/**
+ * Takes a packet that has ended from the air.
+ *
+ * @param now millis()
+ * @param t Reference to store the packet.
+ * @return False if no packet has ended.
+ */
+inline bool sim_take_finished(unsigned long now, Transmission &t) {
+  for (unsigned int i = 0; i < SIM_ON_AIR; i++) {
+    if (!simOnAir[i].used || simOnAir[i].end > now) continue;
+    t = simOnAir[i];
+    simOnAir[i].used = false;
+    return true;
+  }
+  return false;
+}
+
+#endif // AIRSHIP_SIM_H
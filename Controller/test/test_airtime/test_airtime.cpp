@@ -0,0 +1,64 @@
+/*
+Time on air of the link profiles (link_airtime(), see LinkAdaptation.h) against the reference values of the Semtech
+LoRa calculator for the SX1276 (explicit header, coding rate 4/5, 8 preamble symbols, payload CRC off as the LoRa
+library leaves it, low data rate optimisation for symbols over 16 ms). link_airtime() rounds up to whole milliseconds,
+so it must return the reference cut to milliseconds plus one.
+Run: pio test -e native -f test_airtime
+*/
+#include <unity.h>
+#include "LinkAdaptation.h"
+#include "PacketBuffer.h"
+
+struct AirtimeReference {
+  unsigned int profile;
+  unsigned int bytes;
+  double ms;
+};
+
+const AirtimeReference REFERENCES[] = {
+  {0, 1, 165.888}, {0, 10, 247.808}, {0, 31, 411.648}, {0, 48, 575.488}, {0, 255, 2254.848},  // SF10, 125 kHz
+  {1, 1, 82.944}, {1, 10, 123.904}, {1, 31, 226.304}, {1, 48, 308.224}, {1, 255, 1250.304},   // SF9, 125 kHz
+  {2, 1, 25.856}, {2, 10, 36.096}, {2, 31, 66.816}, {2, 48, 92.416}, {2, 255, 394.496},       // SF7, 125 kHz
+  {3, 1, 12.928}, {3, 10, 18.048}, {3, 31, 33.408}, {3, 48, 46.208}, {3, 255, 197.248},       // SF7, 250 kHz
+  {4, 1, 6.464}, {4, 10, 9.024}, {4, 31, 16.704}, {4, 48, 23.104}, {4, 255, 98.624},          // SF7, 500 kHz
+};
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void test_profiles_are_the_reference_ones(void) {
+  const int sf[LINK_PROFILE_COUNT] = {10, 9, 7, 7, 7};
+  const long bw[LINK_PROFILE_COUNT] = {125000, 125000, 125000, 250000, 500000};
+  for (unsigned int i = 0; i < LINK_PROFILE_COUNT; i++) {
+    TEST_ASSERT_EQUAL_INT(sf[i], linkProfiles[i].spreadingFactor);
+    TEST_ASSERT_EQUAL_INT32(bw[i], linkProfiles[i].bandwidth);
+  }
+  TEST_ASSERT_FALSE(LINK_RADIO_CRC);
+}
+
+void test_airtime_matches_the_calculator(void) {
+  for (unsigned int i = 0; i < sizeof(REFERENCES) / sizeof(REFERENCES[0]); i++) {
+    const AirtimeReference &r = REFERENCES[i];
+    char message[64];
+    snprintf(message, sizeof(message), "profile %u, %u bytes", r.profile, r.bytes);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE((unsigned long)r.ms + 1, link_airtime(r.profile, r.bytes), message);
+  }
+}
+
+void test_airtime_grows_with_the_packet(void) {
+  for (unsigned int profile = 0; profile < LINK_PROFILE_COUNT; profile++) {
+    for (unsigned int bytes = 1; bytes < PACKET_CAPACITY; bytes++) {
+      TEST_ASSERT_TRUE(link_airtime(profile, bytes) <= link_airtime(profile, bytes + 1));
+      if (profile > 0) TEST_ASSERT_TRUE(link_airtime(profile, bytes) < link_airtime(profile - 1, bytes));  // the faster profiles are faster
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_profiles_are_the_reference_ones);
+  RUN_TEST(test_airtime_matches_the_calculator);
+  RUN_TEST(test_airtime_grows_with_the_packet);
+  return UNITY_END();
+}
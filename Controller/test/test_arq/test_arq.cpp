@@ -0,0 +1,329 @@
+/*
+Sending side of the selective-repeat ARQ (see ARQ.h). The round-trip estimate is checked against RFC 6298 and
+Karn's rule, the backoff and the acknowledgement across the wrap of the 16-bit sequence numbers.
+Then the commands are sent to a model of the airship's receive window over a channel that loses packets in both
+directions and delays them by their time on air and a jitter. The model acknowledges after every received packet
+and in its periodic telemetry, as the airship does. Every command must be delivered once and in order; the test
+prints the throughput and the latency of the window and of stop-and-wait (one command in flight) and checks that the
+window is faster.
+Run: pio test -e native -f test_arq -v
+*/
+#include <unity.h>
+#include "ARQ.h"
+#include "Fleet.h"
+#include "Communication.h"
+#include "LinkAdaptation.h"
+
+#define CHANNEL_LOSS 0.2           // probability that a packet is lost, in each direction
+#define CHANNEL_JITTER 40          // [ms]
+#define AIRSHIP_PROCESSING 5       // from the command packet to the telemetry packet with the acknowledgement [ms]
+#define AIRSHIP_REPORT_PERIOD 700  // the periodic telemetry [ms]
+#define SIM_COMMANDS 300
+#define SIM_MAX_TIME 3600000UL     // [ms]
+#define SIM_DELAYED 32             // packets on the way in one direction
+
+uint32_t channelState = 88172645UL;
+
+// Deterministic uniform numbers in <0, 1)
+double channel_random(void) {
+  channelState ^= channelState << 13;
+  channelState ^= channelState >> 17;
+  channelState ^= channelState << 5;
+  return channelState / 4294967296.0;
+}
+
+// A packet on the way: the commands to the airship, or the acknowledgement to the controller
+struct Delayed {
+  bool used;
+  unsigned long at;                // arrival [ms]
+  unsigned int count;
+  uint16_t seqs[ARQ_WINDOW];
+  int32_t values[ARQ_WINDOW];
+  unsigned char flags, held;
+  uint16_t nextExpected;
+};
+
+Delayed uplink[SIM_DELAYED], downlink[SIM_DELAYED];
+
+// Receive window of the airship (see ARQ.cpp of the airship)
+bool airshipStarted;
+uint16_t airshipExpected;
+bool airshipHeld[ARQ_WINDOW];
+int32_t airshipValues[ARQ_WINDOW];
+unsigned long airshipNextReport;
+
+unsigned int delivered;            // commands processed by the airship, in order
+unsigned long duplicates;
+bool outOfWindow;                  // the controller sent a command the airship could not hold
+bool wrongOrder;
+unsigned long offeredAt[SIM_COMMANDS];
+unsigned long maxLatency, totalLatency;
+
+void schedule(Delayed *queue, const Delayed &packet) {
+  for (unsigned int i = 0; i < SIM_DELAYED; i++) {
+    if (!queue[i].used) {
+      queue[i] = packet;
+      queue[i].used = true;
+      return;
+    }
+  }
+  TEST_FAIL_MESSAGE("Too many packets on the way");
+}
+
+unsigned long one_way_delay(unsigned int bytes) {
+  return link_airtime(currentProfile, bytes) + (unsigned long)(channel_random() * CHANNEL_JITTER);
+}
+
+/**
+ * The airship answers with its telemetry, which carries the state of its receive window.
+ */
+void airship_report(unsigned long now) {
+  airshipNextReport = now + AIRSHIP_REPORT_PERIOD;
+  if (channel_random() < CHANNEL_LOSS) return;
+  Delayed ack = {};
+  ack.at = now + AIRSHIP_PROCESSING + one_way_delay(40);
+  ack.flags = airshipStarted ? ARQ_ACK_SESSION : 0;
+  ack.nextExpected = airshipExpected;
+  for (unsigned int i = 0; i < ARQ_WINDOW; i++) {
+    if (airshipHeld[(uint16_t)(airshipExpected + i) % ARQ_WINDOW]) ack.held |= 1 << i;
+  }
+  schedule(downlink, ack);
+}
+
+void airship_receive(const Delayed &packet, unsigned long now) {
+  for (unsigned int i = 0; i < packet.count; i++) {
+    uint16_t seq = packet.seqs[i];
+    if (!airshipStarted) airshipStarted = true, airshipExpected = seq;
+    int16_t distance = (int16_t)(seq - airshipExpected);
+    if (distance < 0) {
+      duplicates++;
+    } else if (distance >= ARQ_WINDOW) {
+      outOfWindow = true;
+    } else {
+      airshipHeld[seq % ARQ_WINDOW] = true;
+      airshipValues[seq % ARQ_WINDOW] = packet.values[i];
+    }
+  }
+  while (airshipHeld[airshipExpected % ARQ_WINDOW]) {
+    airshipHeld[airshipExpected % ARQ_WINDOW] = false;
+    if (airshipValues[airshipExpected % ARQ_WINDOW] != (int32_t)delivered * 100) wrongOrder = true;
+    if (delivered < SIM_COMMANDS) {
+      unsigned long latency = now - offeredAt[delivered];
+      totalLatency += latency;
+      if (latency > maxLatency) maxLatency = latency;
+    }
+    delivered++;
+    airshipExpected++;
+  }
+  airship_report(now);
+}
+
+/**
+ * Takes the commands out of a packet sent by send_commands(). The commands of the window come first,
+ * the telemetry acknowledgement and the setpoint that may follow them are not part of the window.
+ */
+void on_transmit(const uint8_t *data, size_t length) {
+  unsigned long now = millis();
+  if (channel_random() < CHANNEL_LOSS) return;
+  PacketBuffer frame;
+  memcpy(frame.data, data, length);
+  frame.length = length;
+  TEST_ASSERT_EQUAL(FRAME_OK, check_frame(frame));
+  PacketReader reader(frame.data, frame.length);
+  unsigned char recipient, sender, count, id;
+  reader.read_byte(recipient), reader.read_byte(sender), reader.read_byte(count);
+  Delayed packet = {};
+  packet.at = now + one_way_delay(length);
+  for (unsigned int i = 0; i < count; i++) {
+    int16_t seq;
+    int32_t value;
+    reader.read_int16(seq), reader.read_byte(id), reader.read_int32(value);
+    if (id != all_ids.SET_EXACT_HEIGHT) break;
+    TEST_ASSERT_TRUE(packet.count < ARQ_WINDOW);
+    packet.seqs[packet.count] = seq;
+    packet.values[packet.count++] = value;
+  }
+  TEST_ASSERT_TRUE(reader.ok());
+  if (packet.count > 0) schedule(uplink, packet);
+}
+
+void deliver(unsigned long now) {
+  for (unsigned int i = 0; i < SIM_DELAYED; i++) {
+    if (uplink[i].used && uplink[i].at <= now) {
+      uplink[i].used = false;
+      airship_receive(uplink[i], now);
+    }
+    if (downlink[i].used && downlink[i].at <= now) {
+      downlink[i].used = false;
+      arq_acknowledged(fleet[0], downlink[i].flags, downlink[i].nextExpected, downlink[i].held, 0);
+    }
+  }
+}
+
+bool window_empty(const VehicleSession &v) {
+  for (unsigned int i = 0; i < ARQ_WINDOW; i++) if (v.sendWindow[i].inUse) return false;
+  return true;
+}
+
+/**
+ * Runs the controller against the model of the airship until all commands are delivered.
+ *
+ * @param stopAndWait Only one command in flight, as the controller did before the window.
+ * @param offerInterval The user enters a command this often [ms], 0 = all at once.
+ * @return Time until the last command was delivered [ms].
+ */
+unsigned long simulate(bool stopAndWait, unsigned long offerInterval) {
+  memset(uplink, 0, sizeof(uplink));
+  memset(downlink, 0, sizeof(downlink));
+  airshipStarted = false;
+  memset(airshipHeld, 0, sizeof(airshipHeld));
+  delivered = 0, duplicates = 0, outOfWindow = false, wrongOrder = false;
+  maxLatency = 0, totalLatency = 0;
+  nativeMicros += 60000000UL;  // the airtime budget is full again
+  fleet_open(0, 1);
+  VehicleSession &v = fleet[0];
+  v.counter = 0xFFFF - 20;     // the sequence numbers wrap during the run
+  unsigned long start = millis();
+  airshipNextReport = start;
+  for (unsigned int i = 0; i < SIM_COMMANDS; i++) offeredAt[i] = start + i * offerInterval;
+
+  unsigned int submitted = 0;
+  while (delivered < SIM_COMMANDS && millis() - start < SIM_MAX_TIME) {
+    unsigned long now = millis();
+    deliver(now);
+    if (now >= airshipNextReport) airship_report(now);
+    if (submitted < SIM_COMMANDS && offeredAt[submitted] <= now && arq_can_send(v) && (!stopAndWait || window_empty(v))) {
+      arq_submit(v, fleet_command(v, all_ids.SET_EXACT_HEIGHT, submitted));
+      submitted++;
+    }
+    arq_service(v);
+    nativeMicros += 1000;
+  }
+  TEST_ASSERT_EQUAL_UINT(SIM_COMMANDS, delivered);
+  TEST_ASSERT_FALSE(outOfWindow);
+  TEST_ASSERT_FALSE(wrongOrder);
+  return millis() - start;
+}
+
+void setUp(void) {
+  fleet_open(0, 1);
+}
+
+void tearDown(void) {}
+
+void test_rto_follows_rfc_6298(void) {
+  VehicleSession &v = fleet[0];
+  TEST_ASSERT_EQUAL_UINT(ARQ_INITIAL_RTO, v.currentRTO);
+  arq_update_rto(v, 200);                // first sample: SRTT = R, RTTVAR = R / 2
+  TEST_ASSERT_EQUAL_UINT32(200, v.srtt);
+  TEST_ASSERT_EQUAL_UINT32(100, v.rttvar);
+  TEST_ASSERT_EQUAL_UINT(600, v.currentRTO);
+  arq_update_rto(v, 100);                // RTTVAR = 3/4 RTTVAR + 1/4 |SRTT - R|, then SRTT = 7/8 SRTT + 1/8 R
+  TEST_ASSERT_EQUAL_UINT32(100, v.rttvar);
+  TEST_ASSERT_EQUAL_UINT32(187, v.srtt);
+  TEST_ASSERT_EQUAL_UINT(587, v.currentRTO);
+  for (unsigned int i = 0; i < 50; i++) arq_update_rto(v, 20);
+  TEST_ASSERT_EQUAL_UINT(ARQ_MIN_RTO, v.currentRTO);
+  arq_update_rto(v, 10000);
+  TEST_ASSERT_EQUAL_UINT(ARQ_MAX_RTO, v.currentRTO);
+}
+
+void test_karn_rule_and_backoff(void) {
+  VehicleSession &v = fleet[0];
+  LoRa.onTransmit = NULL;
+  arq_submit(v, fleet_command(v, all_ids.UP));
+  PendingCommand &pending = v.sendWindow[v.counter % ARQ_WINDOW];
+  nativeMicros += ARQ_BATCH_DELAY * 1000;
+  TEST_ASSERT_TRUE(arq_service(v));
+  TEST_ASSERT_EQUAL_UINT(1, pending.attempts);
+
+  // Each timeout retransmits the command and doubles its timeout, the timeout of new commands stays
+  for (unsigned int expected = 2 * ARQ_INITIAL_RTO; expected <= ARQ_MAX_RTO; expected *= 2) {
+    nativeMicros += (pending.rto + 1) * 1000UL;
+    TEST_ASSERT_TRUE(arq_service(v));
+    TEST_ASSERT_EQUAL_UINT(expected, pending.rto);
+  }
+  nativeMicros += (pending.rto + 1) * 1000UL;
+  TEST_ASSERT_TRUE(arq_service(v));
+  TEST_ASSERT_EQUAL_UINT(ARQ_MAX_RTO, pending.rto);
+  TEST_ASSERT_EQUAL_UINT(ARQ_INITIAL_RTO, v.currentRTO);
+
+  // The acknowledgement of a retransmitted command is not a round-trip sample
+  nativeMicros += 100000;
+  arq_acknowledged(v, ARQ_ACK_SESSION, v.counter + 1, 0, 0);
+  arq_service(v);
+  TEST_ASSERT_FALSE(pending.inUse);
+  TEST_ASSERT_FALSE(v.rttMeasured);
+
+  // The acknowledgement of a command sent once is
+  arq_submit(v, fleet_command(v, all_ids.DOWN));
+  nativeMicros += ARQ_BATCH_DELAY * 1000;
+  TEST_ASSERT_TRUE(arq_service(v));
+  nativeMicros += 120000;
+  arq_acknowledged(v, ARQ_ACK_SESSION, v.counter + 1, 0, 0);
+  arq_service(v);
+  TEST_ASSERT_TRUE(v.rttMeasured);
+  TEST_ASSERT_EQUAL_UINT32(120, v.srtt);
+  TEST_ASSERT_EQUAL_UINT(360, v.currentRTO);
+}
+
+void test_acknowledgement_across_the_wrap(void) {
+  VehicleSession &v = fleet[0];
+  LoRa.onTransmit = NULL;
+  v.counter = 0xFFFE;
+  for (unsigned int i = 0; i < ARQ_WINDOW; i++) arq_submit(v, fleet_command(v, all_ids.UP));  // 0xFFFF, 0, 1, 2
+  TEST_ASSERT_EQUAL_UINT16(2, v.counter);
+  TEST_ASSERT_FALSE(arq_can_send(v));
+  nativeMicros += ARQ_BATCH_DELAY * 1000;
+  TEST_ASSERT_TRUE(arq_service(v));
+
+  // 0xFFFF and 0 processed (0 refused), 2 arrived and waits for 1
+  arq_acknowledged(v, ARQ_ACK_SESSION, 1, 0x02, 0x01);
+  TEST_ASSERT_TRUE(v.sendWindow[0xFFFF % ARQ_WINDOW].acked);
+  TEST_ASSERT_TRUE(v.sendWindow[0].rejected);
+  TEST_ASSERT_FALSE(v.sendWindow[1].acked);
+  TEST_ASSERT_FALSE(v.sendWindow[1].held);
+  TEST_ASSERT_TRUE(v.sendWindow[2].held);
+  arq_service(v);
+  TEST_ASSERT_TRUE(arq_can_send(v));
+
+  // Only 1 is retransmitted, 2 is held by the airship
+  nativeMicros += (v.sendWindow[1].rto + 1) * 1000UL;
+  unsigned long sent = LoRa.sentCount;
+  TEST_ASSERT_TRUE(arq_service(v));
+  TEST_ASSERT_EQUAL_UINT(sent + 1, LoRa.sentCount);
+  TEST_ASSERT_EQUAL_UINT(2, v.sendWindow[1].attempts);
+  TEST_ASSERT_EQUAL_UINT(1, v.sendWindow[2].attempts);
+}
+
+void test_lossy_channel(void) {
+  LoRa.onTransmit = on_transmit;
+  unsigned long windowTime = simulate(false, 0);
+  unsigned long windowDuplicates = duplicates;
+  unsigned long stopTime = simulate(true, 0);
+  printf("%u commands at once, %.0f %% loss: window %.2f commands/s (%lu duplicates), stop-and-wait %.2f commands/s (%lu duplicates)\n",
+         SIM_COMMANDS, CHANNEL_LOSS * 100, SIM_COMMANDS * 1000.0 / windowTime, windowDuplicates, SIM_COMMANDS * 1000.0 / stopTime, duplicates);
+  TEST_ASSERT_TRUE(windowTime * 2 < stopTime);
+
+  const unsigned long offerInterval = 1000;
+  simulate(false, offerInterval);
+  unsigned long windowMax = maxLatency, windowMean = totalLatency / SIM_COMMANDS;
+  simulate(true, offerInterval);
+  printf("A command every %lu ms: latency of the window mean %lu ms, max %lu ms; stop-and-wait mean %lu ms, max %lu ms\n",
+         offerInterval, windowMean, windowMax, totalLatency / SIM_COMMANDS, maxLatency);
+  printf("RTT estimate: SRTT %lu ms, RTTVAR %lu ms, RTO %u ms\n", fleet[0].srtt, fleet[0].rttvar, fleet[0].currentRTO);
+  TEST_ASSERT_TRUE(windowMax < maxLatency);
+  TEST_ASSERT_TRUE(fleet[0].rttMeasured);
+  TEST_ASSERT_EQUAL_UINT(constrain(fleet[0].srtt + 4 * fleet[0].rttvar, (unsigned long)ARQ_MIN_RTO, (unsigned long)ARQ_MAX_RTO), fleet[0].currentRTO);
+  LoRa.onTransmit = NULL;
+}
+
+int main(int argc, char **argv) {
+  nativeSerialOutput = false;
+  UNITY_BEGIN();
+  RUN_TEST(test_rto_follows_rfc_6298);
+  RUN_TEST(test_karn_rule_and_backoff);
+  RUN_TEST(test_acknowledgement_across_the_wrap);
+  RUN_TEST(test_lossy_channel);
+  return UNITY_END();
+}
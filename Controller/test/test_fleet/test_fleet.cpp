@@ -0,0 +1,250 @@
+/*
+A fleet of FLEET_SIZE airships on one channel (see Fleet.h). The controller runs its main loop (receive_service(),
+fleet_service()); every airship is a model of the airship's main loop, which runs every TDMA_LOOP_PERIOD: it sends
+join requests until it gets its address, then its beacon in its own frame of the superframe (aligned to the beacons
+of the others it hears) and the acknowledgement of commands in its acknowledgement slot (see TDMA.h).
+Two transmissions that overlap in time are both lost. The airships are switched on one after another, and once all of
+them have joined, the user enters commands for every airship at random times. The test checks that every airship
+joins with its own address, that the channel is then free of collisions, and prints and checks the command latency
+(from entering the command to its processing on the airship) of every airship: it must be bounded by a superframe
+and about the same for all.
+A frame lasts from one beacon to the next: the beacon itself, the frame of the layout and up to one pass of the loop.
+Run: pio test -e native -f test_fleet -v
+*/
+#include "../airship_sim.h"
+#include "Fleet.h"
+#include "LinkAdaptation.h"
+#include "TDMA.h"
+
+#define SIM_AIRSHIPS FLEET_SIZE
+#define SWITCH_ON_INTERVAL 3000       // the airships are switched on one after another [ms]
+#define JOIN_TIME 60000UL             // all airships must have joined by then [ms]
+#define SETTLE_TIME 20000UL           // then the frames settle [ms]
+#define MEASURE_TIME 1200000UL        // the commands are measured for this long [ms]
+#define MEAN_COMMAND_INTERVAL 20000   // the user enters a command for an airship this often on average [ms]
+#define JOIN_INTERVAL 1000            // FLEET_JOIN_INTERVAL of the airship [ms]
+#define MAX_COMMANDS 256
+#define CONTROLLER SIM_AIRSHIPS       // index of the controller as a sender
+
+unsigned long controllerBusyUntil;    // endPacket() blocks the main loop until the packet is sent
+bool measuring;
+unsigned long packets, collided;
+
+// Model of one airship
+struct Airship {
+  bool on;
+  unsigned char address;              // FLEET_JOIN_ADDRESS until it has joined
+  unsigned int index, slots;
+  uint16_t nonce;
+  SimWindow window;
+  bool ackPending;
+  unsigned long nextLoop, busyUntil, nextJoin, beaconEnd;
+  unsigned long enteredAt[MAX_COMMANDS];  // indexed by sequence number % MAX_COMMANDS
+  unsigned long nextCommand;
+  unsigned long commands, latencyTotal, latencyMax;
+} airships[SIM_AIRSHIPS];
+
+void on_transmit(const uint8_t *data, size_t length) {
+  controllerBusyUntil = sim_transmit(CONTROLLER, HOP_RENDEZVOUS_FREQUENCY, data, length).end;
+}
+
+void airship_send(Airship &a, unsigned char type, bool beacon) {
+  unsigned char data[PACKET_CAPACITY];
+  PacketWriter writer(data, sizeof(data));
+  if (type == report.JOIN_REQUEST) {                  // [controller, airship, status, JOIN_REQUEST, nonce]
+    writer.put_byte(localAddress);
+    writer.put_byte(a.address);
+    writer.put_byte(0);
+    writer.put_byte(type);
+    writer.put_int16(a.nonce);
+    append_frame_check(writer);
+  } else {
+    write_airship_report(writer, a.address, beacon ? 0x04 : 0, a.window);  // status: B = beacon of a TDMA frame
+    finish_airship_report(writer);
+    a.ackPending = false;
+  }
+  a.busyUntil = sim_transmit(&a - airships, HOP_RENDEZVOUS_FREQUENCY, data, writer.length()).end;
+  if (beacon) a.beaconEnd = a.busyUntil;              // tdma_beacon_sent() after the blocking endPacket()
+}
+
+/**
+ * One pass of the airship's main loop (see loop() of the airship).
+ */
+void airship_loop(Airship &a, unsigned long now) {
+  a.nextLoop = now + TDMA_LOOP_PERIOD;
+  if (now < a.busyUntil) return;
+  if (a.address == FLEET_JOIN_ADDRESS) {
+    if (now >= a.nextJoin) {
+      a.nextJoin = now + JOIN_INTERVAL + (unsigned long)(sim_random() * JOIN_INTERVAL);
+      airship_send(a, report.JOIN_REQUEST, false);
+    }
+    return;
+  }
+  TdmaLayout layout;
+  tdma_layout(layout);
+  unsigned long t = now - a.beaconEnd;
+  if (t >= a.slots * layout.frame) airship_send(a, report.MEASURED_DATA, true);  // the beacon carries the acknowledgement too
+  else if (a.ackPending && t >= layout.ackStart && t < layout.ackEnd) airship_send(a, report.MEASURED_DATA, false);
+}
+
+/**
+ * A packet heard by an airship: its commands, its address, or the beacon of another airship (tdma_fleet_beacon()).
+ */
+void airship_receive(Airship &a, const Transmission &t) {
+  if (t.sender != CONTROLLER) {  // [controller, airship, status, type, ...]
+    unsigned char sender = t.data[1], status = t.data[2], type = t.data[3];
+    if (a.address == FLEET_JOIN_ADDRESS || type != report.MEASURED_DATA || !((status >> 2) & 1)) return;
+    unsigned int index = sender - FLEET_FIRST_ADDRESS;
+    if (index >= a.slots || index == a.index) return;
+    TdmaLayout layout;
+    tdma_layout(layout);
+    unsigned int ahead = (a.index + a.slots - index) % a.slots;
+    a.beaconEnd = t.end - (a.slots - ahead) * layout.frame;
+    return;
+  }
+
+  SimCommand cmds[SIM_MAX_COMMANDS];
+  unsigned char recipient;
+  unsigned int count = read_controller_packet(t.data, t.length, recipient, cmds);
+  if (recipient != a.address) return;
+  for (unsigned int i = 0; i < count; i++) {
+    const SimCommand &cmd = cmds[i];
+    if (cmd.id == all_ids.ASSIGN_ADDRESS) {     // fleet_assign(), not in the window
+      if (a.address == FLEET_JOIN_ADDRESS && (uint16_t)((uint32_t)cmd.value >> 16) == a.nonce) {
+        a.index = (cmd.value >> 8) & 0xFF;
+        a.slots = cmd.value & 0xFF;
+        a.address = FLEET_FIRST_ADDRESS + a.index;
+        a.beaconEnd = t.end;
+      }
+      continue;
+    }
+    if (!sim_window_accept(a.window, cmd)) continue;
+    if (cmd.id == all_ids.FLEET_SLOTS) a.slots = cmd.value;
+    if (cmd.id == all_ids.UP && measuring) {
+      unsigned long latency = t.end - a.enteredAt[cmd.seq % MAX_COMMANDS];
+      a.commands++;
+      a.latencyTotal += latency;
+      if (latency > a.latencyMax) a.latencyMax = latency;
+    }
+  }
+  if (a.address != FLEET_JOIN_ADDRESS) a.ackPending = true;
+}
+
+/**
+ * Delivers the transmissions that ended, unless they collided.
+ */
+void deliver(unsigned long now) {
+  Transmission t;
+  while (sim_take_finished(now, t)) {
+    if (measuring) {
+      packets++;
+      if (t.collided) collided++;
+    }
+    if (t.collided) continue;
+    if (t.sender != CONTROLLER) LoRa.inject(t.data, t.length);
+    for (unsigned int n = 0; n < SIM_AIRSHIPS; n++) {
+      if (n != t.sender && airships[n].on) airship_receive(airships[n], t);
+    }
+  }
+}
+
+/**
+ * Runs the channel, the controller and the airships.
+ *
+ * @param ms Length [ms].
+ * @param commands The user enters commands.
+ */
+void run(unsigned long ms, bool commands) {
+  unsigned long end = millis() + ms;
+  while (millis() < end) {
+    unsigned long now = millis();
+    deliver(now);
+    for (unsigned int n = 0; n < SIM_AIRSHIPS; n++) {
+      Airship &a = airships[n];
+      if (!a.on && now >= n * SWITCH_ON_INTERVAL + 1000) {
+        a.on = true;
+        a.nextLoop = now + (unsigned long)(sim_random() * TDMA_LOOP_PERIOD);
+        a.nextJoin = now + (unsigned long)(sim_random() * JOIN_INTERVAL);
+      }
+      if (a.on && now >= a.nextLoop) airship_loop(a, now);
+    }
+    if (now >= controllerBusyUntil) {
+      receive_service();
+      for (unsigned int n = 0; n < SIM_AIRSHIPS && commands; n++) {
+        Airship &a = airships[n];
+        VehicleSession &v = fleet[a.index];
+        if (now >= a.nextCommand && arq_can_send(v)) {
+          command cmd = fleet_command(v, all_ids.UP);
+          a.enteredAt[cmd.counter % MAX_COMMANDS] = a.nextCommand;
+          arq_submit(v, cmd);
+          a.nextCommand += 1 + (unsigned long)(-log(1 - sim_random()) * MEAN_COMMAND_INTERVAL);
+        }
+      }
+      fleet_service();
+    }
+    nativeMicros += 1000;
+  }
+}
+
+void setUp(void) {
+  LoRa.onTransmit = on_transmit;
+}
+
+void tearDown(void) {
+  LoRa.onTransmit = NULL;
+}
+
+void test_fleet_of_airships(void) {
+  nativeMicros = 0;
+  for (unsigned int n = 0; n < SIM_AIRSHIPS; n++) airships[n].address = FLEET_JOIN_ADDRESS, airships[n].nonce = 1 + n * 7919;
+  run(JOIN_TIME, false);
+
+  bool taken[FLEET_SIZE] = {false};
+  for (unsigned int n = 0; n < SIM_AIRSHIPS; n++) {
+    Airship &a = airships[n];
+    TEST_ASSERT_TRUE(a.address != FLEET_JOIN_ADDRESS);
+    TEST_ASSERT_FALSE(taken[a.index]);
+    taken[a.index] = true;
+    TEST_ASSERT_TRUE(fleet[a.index].active);
+    TEST_ASSERT_EQUAL_UINT16(a.nonce, fleet[a.index].nonce);
+  }
+  TEST_ASSERT_EQUAL_UINT(SIM_AIRSHIPS, fleet_count());
+
+  run(SETTLE_TIME, false);
+  measuring = true;
+  for (unsigned int n = 0; n < SIM_AIRSHIPS; n++) {
+    TEST_ASSERT_EQUAL_UINT(SIM_AIRSHIPS, airships[n].slots);
+    airships[n].nextCommand = millis() + (unsigned long)(sim_random() * MEAN_COMMAND_INTERVAL);
+  }
+  run(MEASURE_TIME, true);
+  measuring = false;
+
+  TdmaLayout layout;
+  tdma_layout(layout);
+  // A frame lasts from the start of a beacon to the next one: the beacon, the frame of the layout and the wait for the loop of the airship
+  unsigned long airtime = link_airtime(currentProfile, TDMA_MAX_PACKET);
+  unsigned long superframe = SIM_AIRSHIPS * (airtime + layout.frame + TDMA_LOOP_PERIOD);
+  printf("%u airships, superframe at most %lu ms: %lu packets, %lu collided\n", SIM_AIRSHIPS, superframe, packets, collided);
+  unsigned long meanMin = 0xFFFFFFFFUL, meanMax = 0;
+  for (unsigned int n = 0; n < SIM_AIRSHIPS; n++) {
+    Airship &a = airships[n];
+    TEST_ASSERT_GREATER_THAN_UINT32(MEASURE_TIME / MEAN_COMMAND_INTERVAL / 2, a.commands);
+    unsigned long mean = a.latencyTotal / a.commands;
+    printf("  airship %u (0x%02X): %lu commands, latency mean %lu ms, max %lu ms\n", a.index + 1, a.address, a.commands, mean, a.latencyMax);
+    // A command waits at most for the uplink slot of its airship in the next superframe
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(superframe + layout.uplinkEnd + airtime, a.latencyMax);
+    if (mean < meanMin) meanMin = mean;
+    if (mean > meanMax) meanMax = mean;
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, collided);
+  TEST_ASSERT_TRUE(meanMax < 2 * meanMin);  // no airship is served worse than the others
+}
+
+int main(int argc, char **argv) {
+  nativeSerialOutput = false;
+  simRandomState = 2718281828UL;
+  LoRa.onReceive(onReceive);
+  UNITY_BEGIN();
+  RUN_TEST(test_fleet_of_airships);
+  return UNITY_END();
+}
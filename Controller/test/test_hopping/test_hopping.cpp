@@ -0,0 +1,314 @@
+/*
+Frequency hopping (see Hopping.h) against a jammed channel. The controller runs its main loop (receive_service(),
+fleet_service(), hop_service()) and the airship is a model of its firmware: its main loop runs every TDMA_LOOP_PERIOD,
+sends the beacon of every frame on the channel of the frame (hop_next_frame() of the airship) with the frame number
+and the channel mask, processes the commands in order and acknowledges them in its acknowledgement slot (see TDMA.h).
+A packet arrives only if the receiver is tuned to its frequency from its start to its end and neither the interferer
+nor the other end sends on that frequency meanwhile. The interferer is narrowband: it sends bursts of JAM_BURST ms at
+random on one frequency.
+The user enters a command every USER_INTERVAL ms whenever the command window has room.
+- With the interferer on the fixed frequency, hopping delivers many more commands than staying on it.
+- With the interferer sitting on one hopping channel, the channel is blacklisted on both ends.
+- After a wideband outage the controller loses the sequence, finds it again on the rendezvous frequency and hops on.
+Run: pio test -e native -f test_hopping -v
+*/
+#include "../airship_sim.h"
+#include "Fleet.h"
+#include "Hopping.h"
+#include "TDMA.h"
+
+#define AIRSHIP_ADDRESS FLEET_FIRST_ADDRESS
+#define USER_INTERVAL 250       // [ms]
+#define JAM_BURST 50            // [ms]
+#define JAM_DUTY 0.4            // share of the bursts the interferer sends on its frequency
+#define MEASURE_TIME 300000UL   // [ms]
+#define AIRSHIP_HOP_FALLBACK_TIMEOUT 20000  // HOP_FALLBACK_TIMEOUT of the airship [ms]
+#define CONTROLLER 0            // senders on the channel
+#define AIRSHIP 1
+
+extern unsigned char wantedMask;  // see Hopping.cpp
+extern int hopVehicle;
+extern bool maskInFlight;
+extern volatile unsigned long beaconsExpected[HOP_CHANNELS + 1];
+extern volatile unsigned long beaconsHeard[HOP_CHANNELS + 1];
+
+long jamFrequency = 0;                     // frequency of the interferer, 0 = none
+double jamDuty = JAM_DUTY;
+unsigned long outageFrom = 0, outageTo = 0;  // wideband outage: nothing arrives on any frequency
+
+/**
+ * Checks whether the interferer sends during a burst, the same for every run (a hash of the burst number).
+ */
+bool burst_jammed(unsigned long burst) {
+  uint32_t h = (uint32_t)burst * 2654435761u;
+  h ^= h >> 16;
+  h *= 0x45D9F3Bu;
+  h ^= h >> 16;
+  return h / 4294967296.0 < jamDuty;
+}
+
+/**
+ * Checks whether a packet on a frequency is destroyed by the interferer or by an outage.
+ */
+bool jammed(long frequency, unsigned long start, unsigned long end) {
+  if (start < outageTo && outageFrom < end) return true;
+  if (frequency != jamFrequency) return false;
+  for (unsigned long burst = start / JAM_BURST; burst <= end / JAM_BURST; burst++) {
+    if (burst_jammed(burst)) return true;
+  }
+  return false;
+}
+
+unsigned long controllerBusyUntil;
+bool userPaused;                           // the user waits, e.g. while typing 'hop'
+
+// Model of the airship
+struct Airship {
+  bool hopping;
+  unsigned char frame, mask;
+  int requestedMask;
+  long frequency;
+  SimWindow window;
+  bool ackPending;
+  unsigned long nextLoop, busyUntil, beaconEnd, lastHeard;
+  unsigned long delivered;           // user commands processed
+  unsigned long beacons, beaconsLost;
+} airship;
+
+/**
+ * Puts a packet on the air, it arrives only if the receiver is on its frequency at its start.
+ */
+unsigned long transmit(unsigned int sender, long frequency, long receiverFrequency, const unsigned char *data, unsigned int length) {
+  Transmission &t = sim_transmit(sender, frequency, data, length);
+  t.receiverTuned = receiverFrequency == frequency;
+  return t.end;
+}
+
+void on_transmit(const uint8_t *data, size_t length) {
+  controllerBusyUntil = transmit(CONTROLLER, LoRa.frequency, airship.frequency, data, length);
+}
+
+/**
+ * The beacon starts the next frame on its channel, as hop_next_frame() of the airship does.
+ */
+void airship_next_frame(void) {
+  int requested = airship.requestedMask;
+  if (airship.hopping && (requested == 0 || millis() - airship.lastHeard > AIRSHIP_HOP_FALLBACK_TIMEOUT)) {
+    airship.hopping = false;
+    airship.requestedMask = -1;
+    airship.frequency = HOP_RENDEZVOUS_FREQUENCY;
+    return;
+  }
+  if (!airship.hopping) {
+    if (requested <= 0) return;
+    airship.hopping = true;
+    airship.frame = 0;
+  } else {
+    airship.frame++;
+  }
+  if (requested > 0 && airship.frame % HOP_RENDEZVOUS_PERIOD == 0) {
+    airship.mask = requested;
+    airship.requestedMask = -1;
+  }
+  airship.frequency = hop_frequency(hop_channel(airship.frame, airship.mask));
+}
+
+void airship_send(bool beacon) {
+  if (beacon) airship_next_frame();
+  bool hop = beacon && airship.hopping;
+  unsigned char data[PACKET_CAPACITY];
+  PacketWriter writer(data, sizeof(data));
+  write_airship_report(writer, AIRSHIP_ADDRESS, (beacon ? 0x04 : 0) | (hop ? 0x20 : 0), airship.window);  // status: B = beacon, H = hopping state
+  if (hop) writer.put_byte(airship.frame), writer.put_byte(airship.mask);
+  finish_airship_report(writer);
+  airship.ackPending = false;
+  airship.busyUntil = transmit(AIRSHIP, airship.frequency, LoRa.frequency, data, writer.length());
+  if (beacon) {
+    airship.beaconEnd = airship.busyUntil;
+    airship.beacons++;
+  }
+}
+
+void airship_loop(unsigned long now) {
+  airship.nextLoop = now + TDMA_LOOP_PERIOD;
+  if (now < airship.busyUntil) return;
+  TdmaLayout layout;
+  tdma_layout(layout);
+  unsigned long t = now - airship.beaconEnd;
+  if (t >= layout.frame) airship_send(true);  // a single airship, the superframe is one frame
+  else if (airship.ackPending && t >= layout.ackStart && t < layout.ackEnd) airship_send(false);
+}
+
+void airship_receive(const Transmission &t) {
+  SimCommand cmds[SIM_MAX_COMMANDS];
+  unsigned char recipient;
+  unsigned int count = read_controller_packet(t.data, t.length, recipient, cmds);
+  if (recipient != AIRSHIP_ADDRESS) return;
+  airship.lastHeard = t.end;
+  for (unsigned int i = 0; i < count; i++) {
+    if (!sim_window_accept(airship.window, cmds[i])) continue;
+    if (cmds[i].id == all_ids.HOP_MODE) airship.requestedMask = cmds[i].value & 0xFF;  // hop_request(), applied with the next beacon
+    if (cmds[i].id == all_ids.UP) airship.delivered++;
+  }
+  airship.ackPending = true;
+}
+
+/**
+ * Delivers the packets that ended, if the receiver stayed on their frequency and they were neither jammed nor collided.
+ */
+void deliver(unsigned long now) {
+  Transmission t;
+  while (sim_take_finished(now, t)) {
+    bool fromController = t.sender == CONTROLLER;
+    long receiverFrequency = fromController ? airship.frequency : LoRa.frequency;
+    if (!t.receiverTuned || receiverFrequency != t.frequency || t.collided || jammed(t.frequency, t.start, t.end)) {
+      if (!fromController && ((t.data[2] >> 2) & 1)) airship.beaconsLost++;
+      continue;
+    }
+    if (fromController) airship_receive(t);
+    else LoRa.inject(t.data, t.length);
+  }
+}
+
+/**
+ * Runs both ends for a while.
+ *
+ * @param ms Length [ms].
+ */
+void run(unsigned long ms) {
+  unsigned long end = millis() + ms;
+  unsigned long nextUser = millis();
+  while (millis() < end) {
+    unsigned long now = millis();
+    deliver(now);
+    if (now >= airship.nextLoop) airship_loop(now);
+    if (now >= controllerBusyUntil) {
+      receive_service();
+      VehicleSession &v = fleet[0];
+      if (now >= nextUser && !userPaused && v.active && arq_can_send(v)) {
+        arq_submit(v, fleet_command(v, all_ids.UP));
+        nextUser = now + USER_INTERVAL;
+      }
+      fleet_service();
+      hop_service();
+    }
+    nativeMicros += 1000;
+  }
+}
+
+/**
+ * Turns hopping on or off by the 'hop' command and waits until both ends agree.
+ */
+void switch_hopping(bool on) {
+  userPaused = true;  // 'hop' needs room in the command window
+  for (unsigned int attempt = 0; attempt < 10 && (hopState == HOP_FOLLOWING) != on; attempt++) {
+    if (!maskInFlight) hop_toggle();
+    run(10000);
+  }
+  userPaused = false;
+  TEST_ASSERT_EQUAL(on ? HOP_FOLLOWING : HOP_OFF, hopState);
+  TEST_ASSERT_EQUAL(on, airship.hopping);
+}
+
+void setUp(void) {
+  nativeMicros += 60000000UL;  // the airtime budget is full again
+  memset(&airship, 0, sizeof(airship));
+  sim_channel_reset();
+  airship.requestedMask = -1;
+  airship.frequency = HOP_RENDEZVOUS_FREQUENCY;
+  airship.nextLoop = airship.lastHeard = millis();
+  controllerBusyUntil = 0;
+  userPaused = false;
+  for (unsigned int i = 0; i < FLEET_SIZE; i++) fleet[i].active = false;  // the airship is found by its first beacon
+  hopState = HOP_OFF;
+  hopVehicle = -1;
+  maskInFlight = false;
+  wantedMask = HOP_ALL_CHANNELS;
+  for (unsigned int i = 0; i <= HOP_CHANNELS; i++) beaconsExpected[i] = beaconsHeard[i] = 0;
+  hop_tune(0, 0);
+  jamFrequency = 0;
+  jamDuty = JAM_DUTY;
+  outageFrom = outageTo = 0;
+  LoRa.onTransmit = on_transmit;
+}
+
+void tearDown(void) {
+  LoRa.onTransmit = NULL;
+}
+
+void test_hopping_escapes_a_jammed_frequency(void) {
+  jamFrequency = HOP_RENDEZVOUS_FREQUENCY;
+  run(10000);
+  unsigned long delivered = airship.delivered;
+  unsigned long retransmissions = fleet[0].retransmissions;
+  run(MEASURE_TIME);
+  unsigned long fixed = airship.delivered - delivered;
+  unsigned long fixedRetransmissions = fleet[0].retransmissions - retransmissions;
+
+  switch_hopping(true);
+  delivered = airship.delivered;
+  retransmissions = fleet[0].retransmissions;
+  run(MEASURE_TIME);
+  unsigned long hopping = airship.delivered - delivered;
+  unsigned long hoppingRetransmissions = fleet[0].retransmissions - retransmissions;
+  printf("Interferer on %.0f Hz (%.0f %% of the time), %lu s: fixed frequency %lu commands (%lu retransmissions), hopping %lu commands (%lu retransmissions)\n",
+         (double)jamFrequency, 100 * jamDuty, MEASURE_TIME / 1000, fixed, fixedRetransmissions, hopping, hoppingRetransmissions);
+  TEST_ASSERT_EQUAL(HOP_FOLLOWING, hopState);
+  TEST_ASSERT_TRUE(hopping > 2 * fixed);
+  TEST_ASSERT_TRUE(hoppingRetransmissions < fixedRetransmissions);
+}
+
+void test_jammed_channel_is_blacklisted(void) {
+  const int channel = 3;
+  jamFrequency = hop_frequency(channel);
+  jamDuty = 1;
+  run(5000);
+  switch_hopping(true);
+  unsigned long blacklistedAt = 0;
+  for (unsigned long t = 0; t < 4 * HOP_REVIEW_FRAMES * TDMA_MIN_FRAME && blacklistedAt == 0; t += 100) {
+    run(100);
+    if (!((airship.mask >> channel) & 1)) blacklistedAt = millis();
+  }
+  printf("Interferer on channel %d: the airship uses the mask 0x%02X from frame %u\n", channel, airship.mask, airship.frame);
+  TEST_ASSERT_TRUE(blacklistedAt > 0);
+  TEST_ASSERT_FALSE((wantedMask >> channel) & 1);
+  TEST_ASSERT_EQUAL_HEX8(HOP_ALL_CHANNELS & ~(1 << channel), airship.mask);  // no other channel was blacklisted
+
+  unsigned long lost = airship.beaconsLost;
+  run(HOP_PROBATION / 2);  // before the channel is tried again
+  TEST_ASSERT_FALSE((airship.mask >> channel) & 1);
+  TEST_ASSERT_EQUAL_UINT32(lost, airship.beaconsLost);  // the interferer does not hit the beacons any more
+}
+
+void test_resynchronisation_after_an_outage(void) {
+  run(5000);
+  switch_hopping(true);
+  run(20000);
+  outageFrom = millis();
+  outageTo = outageFrom + 5000;
+  bool searched = false;
+  for (unsigned int i = 0; i < 5000; i++) {
+    run(1);
+    if (hopState == HOP_SEARCHING) searched = true;
+  }
+  TEST_ASSERT_TRUE(searched);  // the controller lost the sequence
+  TEST_ASSERT_TRUE(airship.hopping);
+
+  run(HOP_RENDEZVOUS_PERIOD * TDMA_MIN_FRAME * 2);  // the next rendezvous frames
+  printf("Outage of 5 s: the controller follows the airship again at frame %u\n", airship.frame);
+  TEST_ASSERT_EQUAL(HOP_FOLLOWING, hopState);
+  TEST_ASSERT_TRUE(airship.hopping);
+  unsigned long delivered = airship.delivered;
+  run(20000);
+  TEST_ASSERT_GREATER_THAN_UINT32(delivered + 20000 / USER_INTERVAL / 2, airship.delivered);  // the commands flow again
+}
+
+int main(int argc, char **argv) {
+  nativeSerialOutput = false;
+  LoRa.onReceive(onReceive);
+  UNITY_BEGIN();
+  RUN_TEST(test_hopping_escapes_a_jammed_frequency);
+  RUN_TEST(test_jammed_channel_is_blacklisted);
+  RUN_TEST(test_resynchronisation_after_an_outage);
+  return UNITY_END();
+}
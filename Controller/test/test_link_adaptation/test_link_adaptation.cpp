@@ -0,0 +1,248 @@
+/*
+Link adaptation (see LinkAdaptation.h) against a mock radio channel. The controller runs its main loop
+(receive_service(), fleet_service(), link_service()) and the airship is a model that follows the rules of its
+firmware: it processes the commands in order, answers each packet and every 700 ms with telemetry carrying the
+acknowledgement and its link report, switches the profile after the telemetry with the acknowledgement of
+LINK_PROFILE and falls back to the rendezvous profile when it has not heard the controller for LINK_FALLBACK_TIMEOUT.
+A packet arrives only if both ends use the same spreading factor and bandwidth and its SNR is above the limit of
+the profile. The SNR follows a flight: close, flying away, far, and back. A switch whose acknowledgement is lost
+must end with both ends back on the rendezvous profile, the link working again and the adaptation going on.
+Run: pio test -e native -f test_link_adaptation -v
+*/
+#include "../airship_sim.h"
+#include "Fleet.h"
+#include "LinkAdaptation.h"
+
+#define AIRSHIP_REPORT_PERIOD 700    // [ms]
+#define AIRSHIP_ADDRESS FLEET_FIRST_ADDRESS
+#define CHANNEL_NOISE 1.0            // random part of the SNR [dB]
+#define CHANNEL_DELAYED 16
+
+float baseSnr = 12;                  // SNR at 125 kHz and 17 dBm [dB], set by the flight
+
+/**
+ * SNR of a packet sent on a profile: the transmit power adds to it, the noise grows with the bandwidth.
+ */
+float profile_snr(unsigned int profile) {
+  const LinkProfile &p = linkProfiles[profile];
+  return baseSnr + (p.txPower - 17) - 10 * log10f(p.bandwidth / 125000.0f) + CHANNEL_NOISE * (2 * sim_random() - 1);
+}
+
+// Model of the airship
+struct Airship {
+  unsigned int profile;
+  int requested;                     // profile to be used after the next telemetry
+  SimWindow window;
+  float snr;                         // of the last packet from the controller
+  unsigned long lastHeard, profileSince, nextReport;
+  bool loseAckOfSwitch;              // the telemetry that acknowledges the next LINK_PROFILE is lost
+  bool ackOfSwitch;
+  unsigned long switches, fallbacks;
+} airship;
+
+// A telemetry packet on the way to the controller
+struct Delayed {
+  bool used;
+  unsigned long at;
+  unsigned int profile;
+  float snr;
+  unsigned int length;
+  unsigned char data[PACKET_CAPACITY];
+} downlink[CHANNEL_DELAYED];
+
+/**
+ * The airship sends its telemetry, as send_measured_data() of the airship does, and then applies a requested profile.
+ */
+void airship_report(unsigned long now) {
+  airship.nextReport = now + AIRSHIP_REPORT_PERIOD;
+  unsigned char data[PACKET_CAPACITY];
+  PacketWriter writer(data, sizeof(data));
+  write_airship_report(writer, AIRSHIP_ADDRESS, 0, airship.window, airship.snr);  // status: no optional sections, no TDMA beacon
+  finish_airship_report(writer);
+
+  bool lost = airship.ackOfSwitch && airship.loseAckOfSwitch;
+  if (lost) airship.loseAckOfSwitch = false;
+  airship.ackOfSwitch = false;
+  for (unsigned int i = 0; i < CHANNEL_DELAYED && !lost; i++) {
+    if (downlink[i].used) continue;
+    Delayed &d = downlink[i];
+    d.used = true;
+    d.at = now + link_airtime(airship.profile, writer.length());
+    d.profile = airship.profile;
+    d.snr = profile_snr(airship.profile);
+    d.length = writer.length();
+    memcpy(d.data, data, d.length);
+    break;
+  }
+
+  if (airship.requested >= 0) {
+    airship.profile = airship.requested;
+    airship.profileSince = now;
+    airship.requested = -1;
+    airship.switches++;
+  }
+}
+
+/**
+ * A packet of the controller, it arrives at once (the time on air is charged to the answer).
+ */
+void on_transmit(const uint8_t *data, size_t length) {
+  unsigned long now = millis();
+  float snr = profile_snr(currentProfile);
+  if (currentProfile != airship.profile || snr < linkProfiles[currentProfile].requiredSnr) return;
+  SimCommand cmds[SIM_MAX_COMMANDS];
+  unsigned char recipient;
+  unsigned int count = read_controller_packet(data, length, recipient, cmds);
+  if (recipient != AIRSHIP_ADDRESS) return;
+  airship.lastHeard = now;
+  airship.snr = snr;
+  for (unsigned int i = 0; i < count; i++) {
+    if (!sim_window_accept(airship.window, cmds[i])) continue;
+    if (cmds[i].id == all_ids.LINK_PROFILE) {
+      airship.requested = cmds[i].value;
+      airship.ackOfSwitch = true;
+    }
+  }
+  airship_report(now);
+}
+
+void airship_service(unsigned long now) {
+  if (now >= airship.nextReport) airship_report(now);
+  unsigned long lastHeard = airship.lastHeard > airship.profileSince ? airship.lastHeard : airship.profileSince;
+  if (airship.profile != LINK_RENDEZVOUS_PROFILE && now - lastHeard > LINK_FALLBACK_TIMEOUT) {
+    airship.profile = LINK_RENDEZVOUS_PROFILE;
+    airship.profileSince = now;
+    airship.requested = -1;
+    airship.fallbacks++;
+  }
+}
+
+void deliver(unsigned long now) {
+  for (unsigned int i = 0; i < CHANNEL_DELAYED; i++) {
+    Delayed &d = downlink[i];
+    if (!d.used || d.at > now) continue;
+    d.used = false;
+    if (d.profile == currentProfile && d.snr >= linkProfiles[d.profile].requiredSnr) LoRa.inject(d.data, d.length, -90, d.snr);
+  }
+}
+
+/**
+ * Runs both ends for a while.
+ *
+ * @param ms Length [ms].
+ * @param snrTo The SNR at the end, it changes linearly from the current one.
+ */
+void run(unsigned long ms, float snrTo) {
+  float snrFrom = baseSnr;
+  for (unsigned long t = 0; t < ms; t++) {
+    baseSnr = snrFrom + (snrTo - snrFrom) * t / ms;
+    unsigned long now = millis();
+    deliver(now);
+    receive_service();
+    fleet_service();
+    link_service();
+    airship_service(now);
+    TEST_ASSERT_EQUAL_INT(linkProfiles[currentProfile].spreadingFactor, LoRa.spreadingFactor);  // the radio follows the profile
+    TEST_ASSERT_EQUAL_INT32(linkProfiles[currentProfile].bandwidth, LoRa.bandwidth);
+    TEST_ASSERT_EQUAL_INT(linkProfiles[currentProfile].txPower, LoRa.txPower);
+    nativeMicros += 1000;
+  }
+  baseSnr = snrTo;
+}
+
+/**
+ * Returns the profile that link_choose_profile() keeps at the given SNR.
+ */
+unsigned int stable_profile(float snr) {
+  unsigned int profile = LINK_RENDEZVOUS_PROFILE;
+  for (unsigned int i = 0; i < LINK_PROFILE_COUNT; i++) {
+    float measured = snr + (linkProfiles[profile].txPower - 17) - 10 * log10f(linkProfiles[profile].bandwidth / 125000.0f);
+    unsigned int next = link_choose_profile(profile, measured);
+    if (next == profile) break;
+    profile = next;
+  }
+  return profile;
+}
+
+void start(void) {
+  memset(&airship, 0, sizeof(airship));
+  memset(downlink, 0, sizeof(downlink));
+  airship.profile = LINK_RENDEZVOUS_PROFILE;
+  airship.requested = -1;
+  airship.nextReport = millis();
+  link_apply_profile(LINK_RENDEZVOUS_PROFILE);
+  for (unsigned int i = 0; i < FLEET_SIZE; i++) fleet[i].active = false;
+  LoRa.onTransmit = on_transmit;
+}
+
+void setUp(void) {
+  nativeMicros += 60000000UL;  // the airtime budget is full again
+  start();
+}
+
+void tearDown(void) {
+  LoRa.onTransmit = NULL;
+}
+
+void test_profile_choice(void) {
+  TEST_ASSERT_EQUAL_UINT(3, link_choose_profile(2, 9));                     // 9 - 3 dB for the wider band is above the need
+  TEST_ASSERT_EQUAL_UINT(2, link_choose_profile(2, 0));                     // between the margins
+  TEST_ASSERT_EQUAL_UINT(1, link_choose_profile(2, -7.5 + LINK_DOWN_MARGIN - 0.1));
+  TEST_ASSERT_EQUAL_UINT(0, link_choose_profile(0, -20));                   // nothing more robust
+  TEST_ASSERT_EQUAL_UINT(LINK_PROFILE_COUNT - 1, link_choose_profile(LINK_PROFILE_COUNT - 1, 30));
+}
+
+void test_flight_adapts_the_profile(void) {
+  baseSnr = 12;
+  run(60000, 12);                                       // close: the fastest profile
+  printf("Close (SNR %.0f dB): profile %u, %lu switches\n", baseSnr, currentProfile, airship.switches);
+  TEST_ASSERT_EQUAL_UINT(LINK_PROFILE_COUNT - 1, currentProfile);
+  TEST_ASSERT_EQUAL_UINT(currentProfile, airship.profile);
+  unsigned long fastAirtime = link_airtime(currentProfile, 50);
+
+  run(90000, -14);                                      // flying away, the link must follow without being lost
+  run(20000, -14);
+  printf("Far (SNR %.0f dB): profile %u, %lu switches, %lu fallbacks\n", baseSnr, currentProfile, airship.switches, airship.fallbacks);
+  TEST_ASSERT_EQUAL_UINT(stable_profile(-14), currentProfile);
+  TEST_ASSERT_EQUAL_UINT(0, currentProfile);
+  TEST_ASSERT_EQUAL_UINT(currentProfile, airship.profile);
+  TEST_ASSERT_EQUAL_UINT32(0, airship.fallbacks);
+  TEST_ASSERT_TRUE(millis() - (unsigned long)fleet[0].lastReceivedTime < 3 * AIRSHIP_REPORT_PERIOD);
+
+  run(60000, 12);                                       // back again
+  printf("Back (SNR %.0f dB): profile %u, %lu switches; 50 bytes on air: %lu ms fastest, %lu ms most robust\n",
+         baseSnr, currentProfile, airship.switches, fastAirtime, link_airtime(0, 50));
+  TEST_ASSERT_EQUAL_UINT(LINK_PROFILE_COUNT - 1, currentProfile);
+  TEST_ASSERT_EQUAL_UINT(currentProfile, airship.profile);
+  TEST_ASSERT_EQUAL_UINT32(0, airship.fallbacks);
+}
+
+void test_lost_acknowledgement_falls_back_to_rendezvous(void) {
+  baseSnr = 12;
+  airship.loseAckOfSwitch = true;
+  run(5000, 12);
+  TEST_ASSERT_EQUAL_UINT(1, airship.switches);         // the airship switched, the controller did not hear it
+  TEST_ASSERT_TRUE(currentProfile != airship.profile);
+
+  run(LINK_FALLBACK_TIMEOUT + 2000, 12);               // neither hears the other until both fall back
+  TEST_ASSERT_EQUAL_UINT(1, airship.fallbacks);
+  TEST_ASSERT_EQUAL_UINT(currentProfile, airship.profile);
+  unsigned long received = fleet[0].packetsReceived;
+  run(3000, 12);
+  TEST_ASSERT_GREATER_THAN_UINT32(received, fleet[0].packetsReceived);  // the link works again
+
+  run(60000, 12);                                       // and the adaptation goes on
+  TEST_ASSERT_EQUAL_UINT(LINK_PROFILE_COUNT - 1, currentProfile);
+  TEST_ASSERT_EQUAL_UINT(currentProfile, airship.profile);
+}
+
+int main(int argc, char **argv) {
+  nativeSerialOutput = false;
+  simRandomState = 3141592653UL;
+  LoRa.onReceive(onReceive);
+  UNITY_BEGIN();
+  RUN_TEST(test_profile_choice);
+  RUN_TEST(test_flight_adapts_the_profile);
+  RUN_TEST(test_lost_acknowledgement_falls_back_to_rendezvous);
+  return UNITY_END();
+}
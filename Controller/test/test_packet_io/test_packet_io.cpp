@@ -0,0 +1,111 @@
+/*
+The radio path of the controller must not use the heap, as on the airship (see test_packet_io of the airship).
+The global operator new is replaced by one that counts the allocations. A telemetry packet of an airship goes through
+the receive interrupt, the receive queue, the check of the frame and the decoding, then the controller acknowledges
+the keyframe and sends commands, and the count must stay zero.
+Run: pio test -e native -f test_packet_io
+*/
+#include <unity.h>
+#include <new>
+#include "Communication.h"
+#include "Fleet.h"
+#include <TestVectors.h>
+
+unsigned long allocations = 0;
+bool countAllocations = false;
+
+void *operator new(size_t size) {
+  if (countAllocations) allocations++;
+  void *p = malloc(size ? size : 1);
+  if (p == NULL) throw std::bad_alloc();
+  return p;
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t size) noexcept { (void)size, free(p); }
+void operator delete[](void *p, size_t size) noexcept { (void)size, free(p); }
+
+/**
+ * Builds a telemetry packet of the first airship, as send_measured_data() of the airship does.
+ */
+unsigned int build_telemetry(unsigned char *data) {
+  PacketWriter writer(data, PACKET_CAPACITY);
+  writer.put_byte(localAddress);
+  writer.put_byte(FLEET_FIRST_ADDRESS);
+  writer.put_byte(0);                        // status: no optional sections
+  writer.put_byte(report.MEASURED_DATA);
+  writer.put_byte(0);                        // acknowledgement: flags, next expected, held and refused
+  writer.put_int16(1);
+  writer.put_byte(0);
+  writer.put_byte(0);
+  writer.put_byte(7 * 4);                    // link report: SNR, RSSI
+  writer.put_byte((unsigned char)-80);
+  writer.put_bytes(GOLDEN_KEYFRAME, sizeof(GOLDEN_KEYFRAME));
+  append_frame_check(writer);
+  return writer.length();
+}
+
+void setUp(void) {
+  allocations = 0;
+  countAllocations = true;
+}
+
+void tearDown(void) {
+  countAllocations = false;
+}
+
+void test_the_counter_sees_string(void) {
+  String text("a");
+  text += String(123456789L) + " and a longer tail that does not fit into any small buffer";
+  TEST_ASSERT_GREATER_THAN(0, allocations);
+}
+
+void test_telemetry_is_received_and_acknowledged_without_the_heap(void) {
+  unsigned char data[PACKET_CAPACITY];
+  unsigned int length = build_telemetry(data);
+  unsigned long sent = LoRa.sentCount;
+  LoRa.inject(data, length);
+  receive_service();
+  TEST_ASSERT_TRUE(fleet[0].active);
+  TEST_ASSERT_TRUE(fleet[0].telemetryAckPending);
+  TEST_ASSERT_TRUE(send_telemetry_ack(fleet[0]));
+  TEST_ASSERT_EQUAL_UINT(0, allocations);
+  TEST_ASSERT_EQUAL_UINT(sent + 1, LoRa.sentCount);
+}
+
+void test_corrupted_telemetry_without_the_heap(void) {
+  unsigned char data[PACKET_CAPACITY];
+  unsigned int length = build_telemetry(data);
+  data[20] ^= 0x11;  // two bits, the FEC cannot correct them
+  LoRa.inject(data, length);
+  receive_service();
+  TEST_ASSERT_EQUAL_UINT(0, allocations);
+}
+
+void test_commands_are_sent_without_the_heap(void) {
+  command up(all_ids.UP, 1, 0);
+  command height(all_ids.SET_EXACT_HEIGHT, 2, 250);
+  const command *cmds[2] = {&up, &height};
+  unsigned long sent = LoRa.sentCount;
+  TEST_ASSERT_TRUE(send_commands(fleet[0].address, cmds, 2, AIRTIME_COMMAND));
+  TEST_ASSERT_EQUAL_UINT(0, allocations);
+  TEST_ASSERT_EQUAL_UINT(sent + 1, LoRa.sentCount);
+
+  PacketBuffer packet;
+  memcpy(packet.data, LoRa.lastSent, LoRa.lastSentLength);
+  packet.length = LoRa.lastSentLength;
+  TEST_ASSERT_EQUAL(FRAME_OK, check_frame(packet));
+}
+
+int main(int argc, char **argv) {
+  nativeSerialOutput = false;
+  LoRa.onReceive(onReceive);
+  UNITY_BEGIN();
+  RUN_TEST(test_the_counter_sees_string);
+  RUN_TEST(test_telemetry_is_received_and_acknowledged_without_the_heap);
+  RUN_TEST(test_corrupted_telemetry_without_the_heap);
+  RUN_TEST(test_commands_are_sent_without_the_heap);
+  return UNITY_END();
+}
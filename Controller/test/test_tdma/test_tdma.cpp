@@ -0,0 +1,174 @@
+/*
+Collisions on the half-duplex link with and without the TDMA schedule (see TDMA.h). The controller runs its main
+loop (receive_service(), fleet_service()); the airship is a model of its main loop, which runs every TDMA_LOOP_PERIOD:
+without the schedule it sends its telemetry every 700 ms and acknowledges the commands at once, with it the telemetry
+is the beacon and the acknowledgement waits for its slot. The user enters a command at random times, the steering
+setpoint and "SAY_HI" go out as usual. A radio cannot receive while it transmits, so two transmissions that overlap
+in time are both lost. The test prints the collision rate and the command latency (from entering the command to its
+processing on the airship) of both, and checks that the schedule has no collisions and a bounded latency.
+Run: pio test -e native -f test_tdma -v
+*/
+#include "../airship_sim.h"
+#include "Fleet.h"
+#include "LinkAdaptation.h"
+#include "TDMA.h"
+
+#define SIM_TIME 600000UL             // [ms]
+#define MEAN_COMMAND_INTERVAL 3000    // the user enters a command this often on average [ms]
+#define AIRSHIP_ADDRESS FLEET_FIRST_ADDRESS
+#define REPORT_PERIOD 700             // the telemetry period of the airship without the schedule [ms]
+#define MAX_COMMANDS 1024
+#define CONTROLLER 0                  // senders on the channel
+#define AIRSHIP 1
+
+bool scheduled;                       // TDMA on
+unsigned long controllerBusyUntil;    // endPacket() blocks the main loop until the packet is sent
+unsigned long packets, collided;
+
+// Model of the airship
+struct Airship {
+  SimWindow window;
+  bool ackPending;
+  unsigned long nextLoop, busyUntil;
+  unsigned long lastSend, beaconEnd;
+} airship;
+
+unsigned long enteredAt[MAX_COMMANDS];  // indexed by sequence number % MAX_COMMANDS
+unsigned long commands, latencyTotal, latencyMax;
+
+void on_transmit(const uint8_t *data, size_t length) {
+  controllerBusyUntil = sim_transmit(CONTROLLER, HOP_RENDEZVOUS_FREQUENCY, data, length).end;
+  packets++;
+}
+
+void airship_send(bool beacon) {
+  unsigned char data[PACKET_CAPACITY];
+  PacketWriter writer(data, sizeof(data));
+  write_airship_report(writer, AIRSHIP_ADDRESS, beacon ? 0x04 : 0, airship.window);  // status: B = beacon of a TDMA frame
+  finish_airship_report(writer);
+  airship.busyUntil = sim_transmit(AIRSHIP, HOP_RENDEZVOUS_FREQUENCY, data, writer.length()).end;
+  packets++;
+  airship.lastSend = millis();
+  airship.ackPending = false;
+  if (beacon) airship.beaconEnd = airship.busyUntil;  // tdma_beacon_sent() after the blocking endPacket()
+}
+
+void airship_receive(const Transmission &t) {
+  SimCommand cmds[SIM_MAX_COMMANDS];
+  unsigned char recipient;
+  unsigned int count = read_controller_packet(t.data, t.length, recipient, cmds);
+  for (unsigned int i = 0; i < count; i++) {
+    if (!sim_window_accept(airship.window, cmds[i])) continue;
+    if (cmds[i].id == all_ids.UP) {
+      unsigned long latency = t.end - enteredAt[cmds[i].seq % MAX_COMMANDS];
+      commands++;
+      latencyTotal += latency;
+      if (latency > latencyMax) latencyMax = latency;
+    }
+  }
+  airship.ackPending = true;
+}
+
+/**
+ * One pass of the airship's main loop: the telemetry, or the acknowledgement of the received commands.
+ */
+void airship_loop(unsigned long now) {
+  airship.nextLoop = now + TDMA_LOOP_PERIOD;
+  if (now < airship.busyUntil) return;
+  if (!scheduled) {
+    if (now - airship.lastSend > REPORT_PERIOD || airship.ackPending) airship_send(false);
+    return;
+  }
+  TdmaLayout layout;
+  tdma_layout(layout);
+  unsigned long t = now - airship.beaconEnd;
+  if (t >= layout.frame) airship_send(true);  // the beacon carries the acknowledgement too
+  else if (airship.ackPending && t >= layout.ackStart && t < layout.ackEnd) airship_send(false);
+}
+
+/**
+ * Delivers the transmissions that ended, unless they collided.
+ */
+void deliver(unsigned long now) {
+  Transmission t;
+  while (sim_take_finished(now, t)) {
+    if (t.collided) {
+      collided++;
+    } else if (t.sender == AIRSHIP) {
+      LoRa.inject(t.data, t.length);
+    } else {
+      airship_receive(t);
+    }
+  }
+}
+
+void simulate(bool withSchedule) {
+  scheduled = withSchedule;
+  sim_channel_reset();
+  memset(&airship, 0, sizeof(airship));
+  packets = collided = commands = latencyTotal = latencyMax = 0;
+  nativeMicros += 60000000UL;  // the airtime budget is full again
+  unsigned long start = millis();
+  airship.nextLoop = start + 37;
+  airship.lastSend = start;
+  airship.beaconEnd = start;
+  controllerBusyUntil = start;
+  for (unsigned int i = 0; i < FLEET_SIZE; i++) fleet[i].active = false;
+  unsigned long nextCommand = start + 1000;
+
+  while (millis() - start < SIM_TIME) {
+    unsigned long now = millis();
+    deliver(now);
+    if (now >= airship.nextLoop) airship_loop(now);
+    if (now >= controllerBusyUntil) {
+      receive_service();
+      VehicleSession &v = fleet[0];
+      if (v.active && now >= nextCommand && arq_can_send(v)) {
+        command cmd = fleet_command(v, all_ids.UP);
+        enteredAt[cmd.counter % MAX_COMMANDS] = nextCommand;
+        arq_submit(v, cmd);
+        nextCommand += 1 + (unsigned long)(-log(1 - sim_random()) * MEAN_COMMAND_INTERVAL);
+      }
+      fleet_service();
+    }
+    nativeMicros += 1000;
+  }
+  TEST_ASSERT_TRUE(fleet[0].active);
+  TEST_ASSERT_GREATER_THAN_UINT32(SIM_TIME / MEAN_COMMAND_INTERVAL / 2, commands);
+}
+
+void setUp(void) {
+  LoRa.onTransmit = on_transmit;
+}
+
+void tearDown(void) {
+  LoRa.onTransmit = NULL;
+}
+
+void test_schedule_removes_collisions(void) {
+  simulate(false);
+  double rateBefore = (double)collided / packets;
+  unsigned long maxBefore = latencyMax, meanBefore = latencyTotal / commands;
+  printf("Without the schedule: %lu packets, %.2f %% collided, command latency mean %lu ms, max %lu ms\n",
+         packets, 100 * rateBefore, meanBefore, maxBefore);
+  simulate(true);
+  printf("With the schedule: %lu packets, %.2f %% collided, command latency mean %lu ms, max %lu ms\n",
+         packets, 100.0 * collided / packets, latencyTotal / commands, latencyMax);
+
+  TEST_ASSERT_TRUE(rateBefore > 0);
+  TEST_ASSERT_EQUAL_UINT32(0, collided);
+  // A command waits at most for the uplink slot of the next frame, the beacon ends at most one loop period late
+  TdmaLayout layout;
+  tdma_layout(layout);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(layout.frame + TDMA_LOOP_PERIOD + layout.uplinkEnd + link_airtime(currentProfile, TDMA_MAX_PACKET), latencyMax);
+  TEST_ASSERT_TRUE(latencyMax < maxBefore);
+}
+
+int main(int argc, char **argv) {
+  nativeSerialOutput = false;
+  simRandomState = 1234567UL;
+  LoRa.onReceive(onReceive);
+  UNITY_BEGIN();
+  RUN_TEST(test_schedule_removes_collisions);
+  return UNITY_END();
+}
@@ -0,0 +1,99 @@
+/*
+Telemetry decoder of the controller (see Telemetry.h): it decodes the keyframe that test_telemetry of the airship
+checks byte by byte, and delta frames against the stored references, so the two tests together check the round trip.
+Run: pio test -e native -f test_telemetry
+*/
+#include <unity.h>
+#include "Telemetry.h"
+#include "Fleet.h"
+#include <TestVectors.h>
+
+void setUp(void) {
+  telemetry_reset(0);
+  fleet[0].telemetryAckPending = false;
+}
+
+void tearDown(void) {}
+
+void assert_golden_frame(const TelemetryFrame &frame) {
+  TEST_ASSERT_EQUAL_INT16(1234, frame.currentHeight);
+  TEST_ASSERT_EQUAL_INT16(1500, frame.requiredHeight);
+  TEST_ASSERT_EQUAL_INT16(-20, frame.currentRequiredHeight);
+  TEST_ASSERT_EQUAL_INT16(2150, frame.temperature);
+  TEST_ASSERT_EQUAL_INT16(TELEMETRY_INVALID_16, frame.humidity);
+  TEST_ASSERT_EQUAL_UINT8(120, frame.power);
+  TEST_ASSERT_EQUAL_INT32(31245, frame.altitude);
+  TEST_ASSERT_EQUAL_INT32(101325, frame.pressure);
+  TEST_ASSERT_EQUAL_UINT16(1234, frame.speed);
+  TEST_ASSERT_EQUAL_INT32(500755381, frame.latitude);
+  TEST_ASSERT_EQUAL_INT32(144378064, frame.longitude);
+}
+
+void test_keyframe_decodes_to_the_sent_frame(void) {
+  PacketReader reader(GOLDEN_KEYFRAME, sizeof(GOLDEN_KEYFRAME));
+  TelemetryFrame frame;
+  TEST_ASSERT_TRUE(decode_telemetry(reader, frame, fleet[0]));
+  assert_golden_frame(frame);
+  TEST_ASSERT_TRUE(fleet[0].telemetryAckPending);  // a keyframe becomes the reference of the deltas
+  TEST_ASSERT_EQUAL_UINT8(7, fleet[0].telemetryAckSeq);
+  TEST_ASSERT_FLOAT_WITHIN(0.001, 12.34, from_fixed_16(frame.currentHeight, 100));
+  TEST_ASSERT_EQUAL_FLOAT(TELEMETRY_INVALID_VALUE, from_fixed_16(frame.humidity, 100));
+}
+
+void test_keyframe_of_a_wrong_length_is_rejected(void) {
+  TelemetryFrame frame;
+  PacketReader shorter(GOLDEN_KEYFRAME, sizeof(GOLDEN_KEYFRAME) - 1);
+  TEST_ASSERT_FALSE(decode_telemetry(shorter, frame, fleet[0]));
+  unsigned char longer[TELEMETRY_FRAME_SIZE + 1];
+  memcpy(longer, GOLDEN_KEYFRAME, sizeof(GOLDEN_KEYFRAME));
+  longer[TELEMETRY_FRAME_SIZE] = 0;
+  PacketReader reader(longer, sizeof(longer));
+  TEST_ASSERT_FALSE(decode_telemetry(reader, frame, fleet[0]));
+}
+
+void test_delta_frame_applies_to_its_reference(void) {
+  PacketReader key(GOLDEN_KEYFRAME, sizeof(GOLDEN_KEYFRAME));
+  TelemetryFrame frame;
+  TEST_ASSERT_TRUE(decode_telemetry(key, frame, fleet[0]));
+
+  // Height +3 cm and pressure -70 Pa against frame 7, the bytes of the airship's test_delta_frame_layout
+  const unsigned char delta[] = {TELEMETRY_DELTA_FRAME, 9, 7, 0x81, 0x00, 6, 0x8B, 0x01};
+  PacketReader reader(delta, sizeof(delta));
+  TEST_ASSERT_TRUE(decode_telemetry(reader, frame, fleet[0]));
+  TEST_ASSERT_EQUAL_INT16(1237, frame.currentHeight);
+  TEST_ASSERT_EQUAL_INT32(101255, frame.pressure);
+  TEST_ASSERT_EQUAL_INT32(500755381, frame.latitude);  // missing fields keep their last value
+
+  // A delta against frame 9 builds on the decoded deltas
+  const unsigned char next[] = {TELEMETRY_DELTA_FRAME, 10, 9, 0x01, 0x00, 1};
+  PacketReader nextReader(next, sizeof(next));
+  TEST_ASSERT_TRUE(decode_telemetry(nextReader, frame, fleet[0]));
+  TEST_ASSERT_EQUAL_INT16(1236, frame.currentHeight);
+  TEST_ASSERT_EQUAL_INT32(101255, frame.pressure);
+}
+
+void test_delta_against_an_unknown_reference_is_rejected(void) {
+  const unsigned char delta[] = {TELEMETRY_DELTA_FRAME, 9, 7, 0x01, 0x00, 6};
+  PacketReader reader(delta, sizeof(delta));
+  TelemetryFrame frame;
+  TEST_ASSERT_FALSE(decode_telemetry(reader, frame, fleet[0]));
+}
+
+void test_zigzag_decode(void) {
+  TEST_ASSERT_EQUAL_INT32(0, zigzag_decode(0));
+  TEST_ASSERT_EQUAL_INT32(-1, zigzag_decode(1));
+  TEST_ASSERT_EQUAL_INT32(1, zigzag_decode(2));
+  TEST_ASSERT_EQUAL_INT32(INT32_MIN, zigzag_decode(0xFFFFFFFF));
+  TEST_ASSERT_EQUAL_INT32(INT32_MAX, zigzag_decode(0xFFFFFFFE));
+}
+
+int main(int argc, char **argv) {
+  nativeSerialOutput = false;
+  UNITY_BEGIN();
+  RUN_TEST(test_keyframe_decodes_to_the_sent_frame);
+  RUN_TEST(test_keyframe_of_a_wrong_length_is_rejected);
+  RUN_TEST(test_delta_frame_applies_to_its_reference);
+  RUN_TEST(test_delta_against_an_unknown_reference_is_rejected);
+  RUN_TEST(test_zigzag_decode);
+  return UNITY_END();
+}
@@ -0,0 +1,423 @@
+/*
+Host tool for the radio captures of the airship and the controller (see Capture.h in Blimp/include and Controller/include).
+
+Build:   g++ -std=c++17 -O2 -o capture_tool capture_tool.cpp
+Usage:   capture_tool decode <capture>             readable trace of every packet
+         capture_tool summary <capture>            counts of packets, frame check results and commands
+         capture_tool replay <airship|controller> <capture>
+
+A capture is either the binary file written by the airship to its SD card (capture.bin) or a serial log of the
+controller; in a log only the lines starting with "CAP " are used, so the whole output of the serial monitor
+can be saved and passed to the tool.
+
+Replay passes the packets that the chosen device received (or that the other device sent) to its receive path
+in the order of the capture, through capture_replay() of the firmware. It needs a native build of the firmware:
+the tool is compiled with -DCAPTURE_REPLAY together with the sources of Blimp/src or Controller/src and the host
+implementations of the Arduino, radio and sensor libraries in Tools/NativeShims, e.g. for the airship:
+
+  g++ -std=gnu++17 -fpermissive -O2 -DCAPTURE_REPLAY -I../NativeShims -I../../Blimp/include -o replay_airship \
+      capture_tool.cpp ../../Blimp/src/<all>.cpp ../NativeShims/NativeShims.cpp
+  replay_airship replay airship capture.bin
+
+where <all>.cpp stands for every source file in Blimp/src (a wildcard in the shell), and the same with Controller
+for the controller. The host clock of the shims is set to the time of each packet
+before it is replayed, so all timeouts of the firmware see the captured times and the replay is deterministic.
+The firmware prints to stdout as it would to the serial monitor, QUIET=1 in the environment silences it.
+The tool prints the time spent in the receive path.
+*/
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#define CAPTURE_MAGIC 0x50434C42
+#define CAPTURE_VERSION 1
+#define CAPTURE_HEADER_SIZE 8
+#define CAPTURE_RECORD_HEADER_SIZE 9
+#define CAPTURE_DEVICE_CONTROLLER 0
+#define CAPTURE_DEVICE_AIRSHIP 1
+#define CAPTURE_RECEIVED 0
+#define CAPTURE_SENT 1
+#define CONTROLLER_ADDRESS 0xBB     // localAddress of the controller, packets to it come from an airship
+#define CRC_SIZE 2
+#define FEC_SIZE 2
+#define LINK_STATS_REPORT_SIZE 18
+#define BACKLOG_RECORD_SIZE 33
+
+struct CaptureRecord {
+  int session;              // number of the header the record follows
+  unsigned char device;     // device that captured the record
+  uint32_t time;            // [ms]
+  unsigned char direction;
+  int rssi;                 // [dBm]
+  float snr;                // [dB]
+  unsigned char profile;
+  std::vector<unsigned char> packet;
+};
+
+enum FrameCheck { CHECK_CRC_FEC, CHECK_CRC, CHECK_FAILED };
+
+struct CommandName {
+  unsigned char id;
+  const char *name;
+  bool value;               // a value of 4 bytes follows the ID
+};
+
+const CommandName commandNames[] = {
+  {0xFF, "LAND", false}, {0xF0, "UP", false}, {0x0F, "DOWN", false}, {0xCC, "SET_EXACT_HEIGHT", true},
+  {0x33, "SAY_HI", false}, {0x66, "POTENTIOMETER_ANGLE", true}, {0x99, "FLY_FORWARD", false},
+  {0x3C, "SET_MOTOR_POWER", true}, {0x55, "MOTORS_OFF", false}, {0xAA, "TELEMETRY_ACK", true},
+  {0x5A, "LINK_PROFILE", true}, {0xA5, "ASSIGN_ADDRESS", true}, {0xC3, "FLEET_SLOTS", true},
+  {0x6C, "CONTROL_SETPOINT", true}, {0xB4, "BACKLOG_REQUEST", false}, {0x4B, "HOP_MODE", true},
+  {0x2D, "QUERY", true}, {0xD2, "PROFILE_DUMP", false},
+};
+
+#ifdef CAPTURE_REPLAY
+void capture_replay(const unsigned char *data, unsigned int length);  // see Capture.cpp of the firmware
+extern unsigned long nativeMicros;  // host clock of the shims [us]
+extern bool nativeSerialOutput;
+#endif
+
+/**
+ * Reads a little-endian number of the given size.
+ */
+static uint32_t get_le(const unsigned char *data, unsigned int size) {
+  uint32_t value = 0;
+  for (unsigned int i = 0; i < size; i++) value |= (uint32_t)data[i] << (8 * i);
+  return value;
+}
+
+/**
+ * Converts a serial log of the controller ("CAP " lines in hex) to the bytes of a binary capture.
+ */
+static std::vector<unsigned char> bytes_from_log(const std::string &text) {
+  std::vector<unsigned char> bytes;
+  std::istringstream lines(text);
+  std::string line;
+  while (std::getline(lines, line)) {
+    if (line.compare(0, 4, "CAP ") != 0) continue;
+    for (size_t i = 4; i + 1 < line.size(); i += 2) {
+      if (!isxdigit((unsigned char)line[i]) || !isxdigit((unsigned char)line[i + 1])) break;
+      bytes.push_back((unsigned char)std::stoi(line.substr(i, 2), nullptr, 16));
+    }
+  }
+  return bytes;
+}
+
+/**
+ * Loads a capture, binary or serial log.
+ *
+ * @param path The file.
+ * @param records Filled with the records of all sessions in the file.
+ * @return False if the file cannot be read or does not start with a capture header.
+ */
+static bool load_capture(const char *path, std::vector<CaptureRecord> &records) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    fprintf(stderr, "Cannot open %s\n", path);
+    return false;
+  }
+  std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  std::vector<unsigned char> bytes(content.begin(), content.end());
+  if (bytes.size() < 4 || get_le(bytes.data(), 4) != CAPTURE_MAGIC) bytes = bytes_from_log(content);
+
+  int session = -1;
+  unsigned char device = 0;
+  size_t pos = 0;
+  while (pos < bytes.size()) {
+    if (bytes.size() - pos >= CAPTURE_HEADER_SIZE && get_le(&bytes[pos], 4) == CAPTURE_MAGIC) {
+      if (bytes[pos + 4] != CAPTURE_VERSION) {
+        fprintf(stderr, "Unsupported capture version %d\n", bytes[pos + 4]);
+        return false;
+      }
+      device = bytes[pos + 5];
+      session++;
+      pos += CAPTURE_HEADER_SIZE;
+      continue;
+    }
+    if (session < 0) {
+      fprintf(stderr, "%s is not a capture\n", path);
+      return false;
+    }
+    if (bytes.size() - pos < CAPTURE_RECORD_HEADER_SIZE || bytes.size() - pos < (size_t)CAPTURE_RECORD_HEADER_SIZE + bytes[pos + 8]) {
+      fprintf(stderr, "Truncated record at byte %zu, the rest is ignored\n", pos);
+      break;
+    }
+    CaptureRecord record;
+    record.session = session;
+    record.device = device;
+    record.time = get_le(&bytes[pos], 4);
+    record.direction = bytes[pos + 4];
+    record.rssi = (int8_t)bytes[pos + 5];
+    record.snr = (int8_t)bytes[pos + 6] / 4.0f;
+    record.profile = bytes[pos + 7];
+    record.packet.assign(bytes.begin() + pos + CAPTURE_RECORD_HEADER_SIZE, bytes.begin() + pos + CAPTURE_RECORD_HEADER_SIZE + bytes[pos + 8]);
+    records.push_back(record);
+    pos += CAPTURE_RECORD_HEADER_SIZE + bytes[pos + 8];
+  }
+  return true;
+}
+
+/**
+ * CRC-16/CCITT-FALSE, the same as crc16() of Framing.cpp.
+ */
+static uint16_t crc16(const unsigned char *data, unsigned int length) {
+  uint16_t crc = 0xFFFF;
+  for (unsigned int i = 0; i < length; i++) {
+    crc ^= (uint16_t)data[i] << 8;
+    for (unsigned int bit = 0; bit < 8; bit++) crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+  }
+  return crc;
+}
+
+/**
+ * Finds the trailer of a packet (see Framing.h). Both settings of FRAME_FEC are tried.
+ *
+ * @param packet The captured packet.
+ * @param length Set to the length of the packet without the trailer.
+ */
+static FrameCheck check_trailer(const std::vector<unsigned char> &packet, unsigned int &length) {
+  length = packet.size();
+  if (packet.size() > CRC_SIZE + FEC_SIZE) {
+    unsigned int n = packet.size() - CRC_SIZE - FEC_SIZE;
+    if (crc16(packet.data(), n) == get_le(&packet[n], 2)) {
+      length = n;
+      return CHECK_CRC_FEC;
+    }
+  }
+  if (packet.size() > CRC_SIZE) {
+    unsigned int n = packet.size() - CRC_SIZE;
+    if (crc16(packet.data(), n) == get_le(&packet[n], 2)) {
+      length = n;
+      return CHECK_CRC;
+    }
+  }
+  return CHECK_FAILED;
+}
+
+static const CommandName *find_command(unsigned char id) {
+  for (const CommandName &c : commandNames) {
+    if (c.id == id) return &c;
+  }
+  return nullptr;
+}
+
+static std::string hex(const unsigned char *data, unsigned int length) {
+  std::string text;
+  char digits[4];
+  for (unsigned int i = 0; i < length; i++) {
+    snprintf(digits, sizeof(digits), "%02X", data[i]);
+    text += digits;
+  }
+  return text;
+}
+
+/**
+ * Describes a packet of the controller: [recipient, sender, number of commands, commands]
+ * Command: [counter (2 bytes), command ID, optionally(value (4 bytes))]
+ *
+ * @param commands Counts of the command IDs, updated.
+ */
+static std::string describe_commands(const unsigned char *p, unsigned int length, std::map<std::string, unsigned long> &commands) {
+  std::ostringstream out;
+  if (length < 3) return "truncated header";
+  out << "controller -> 0x" << hex(p, 1) << ", " << (int)p[2] << " command(s)";
+  unsigned int pos = 3;
+  for (unsigned int i = 0; i < p[2]; i++) {
+    if (length - pos < 3) return out.str() + " | truncated";
+    unsigned int seq = get_le(p + pos, 2);
+    const CommandName *c = find_command(p[pos + 2]);
+    std::string name = c ? c->name : "0x" + hex(p + pos + 2, 1);
+    commands[name]++;
+    out << " | #" << seq << " " << name;
+    pos += 3;
+    if (c && c->value) {
+      if (length - pos < 4) return out.str() + " truncated";
+      out << " " << (int32_t)get_le(p + pos, 4);
+      pos += 4;
+    }
+  }
+  if (pos != length) out << " | " << length - pos << " trailing bytes";
+  return out.str();
+}
+
+/**
+ * Reads a varint (7 bits per byte, least significant first) of a packet.
+ *
+ * @param pos Position in the packet, moved behind the varint.
+ * @return False if the packet ends inside it.
+ */
+static bool get_varint(const unsigned char *p, unsigned int length, unsigned int &pos, uint32_t &value) {
+  value = 0;
+  for (unsigned int shift = 0; shift < 35 && pos < length; shift += 7) {
+    unsigned char byte = p[pos++];
+    value |= (uint32_t)(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) return true;
+  }
+  return false;
+}
+
+/**
+ * Describes a packet of an airship: [recipient, sender, status, message type, ...] (see write_message_header()).
+ */
+static std::string describe_report(const unsigned char *p, unsigned int length) {
+  std::ostringstream out;
+  if (length < 4) return "truncated header";
+  unsigned char status = p[2];
+  out << "airship 0x" << hex(p + 1, 1) << " ->";
+  if (status & 0x04) out << " beacon";
+  if (status & 0x02) out << " land";
+  if (status & 0x01) out << " fly_forward";
+  if (p[3] == 0x4A) {
+    if (length < 6) return out.str() + " | join request truncated";
+    out << " | join request, nonce " << get_le(p + 4, 2);
+    return out.str();
+  }
+  if (p[3] != 0xFF) return out.str() + " | unknown message type 0x" + hex(p + 3, 1);
+
+  unsigned int pos = 4;
+  if (length - pos < 7) return out.str() + " | truncated acknowledgement";
+  out << " | ack flags 0x" << hex(p + pos, 1) << " next " << get_le(p + pos + 1, 2) << " held 0x" << hex(p + pos + 3, 1)
+      << " refused 0x" << hex(p + pos + 4, 1);
+  out << " | link " << (int8_t)p[pos + 5] / 4.0 << " dB " << (int)(int8_t)p[pos + 6] << " dBm";
+  pos += 7;
+  if (status & 0x20) {
+    if (length - pos < 2) return out.str() + " | truncated hopping state";
+    out << " | hop frame " << (int)p[pos] << " mask 0x" << hex(p + pos + 1, 1);
+    pos += 2;
+  }
+  if (status & 0x08) {
+    if (length - pos < LINK_STATS_REPORT_SIZE) return out.str() + " | truncated link statistics";
+    out << " | stats rx " << get_le(p + pos, 2) << " corrupted " << get_le(p + pos + 2, 2) << " corrected " << get_le(p + pos + 4, 2)
+        << " duplicates " << get_le(p + pos + 6, 2) << " height loop jitter " << (int16_t)get_le(p + pos + 8, 2) << ".."
+        << (int16_t)get_le(p + pos + 10, 2) << " p99 " << get_le(p + pos + 12, 2) << " exec p99 " << get_le(p + pos + 14, 2)
+        << " max " << get_le(p + pos + 16, 2);
+    pos += LINK_STATS_REPORT_SIZE;
+  }
+  if (status & 0x10) {
+    if (length - pos < 3 || length - pos - 3 < p[pos] * BACKLOG_RECORD_SIZE) return out.str() + " | truncated backlog";
+    out << " | backlog " << (int)p[pos] << " record(s), " << get_le(p + pos + 1, 2) << " waiting";
+    pos += 3 + p[pos] * BACKLOG_RECORD_SIZE;
+  }
+  if (status & 0x80) {
+    static const char *fields[] = {"height", "power", "ultrasonic"};
+    out << " | aggregates";
+    for (const char *field : fields) {
+      uint32_t count, raw;
+      if (!get_varint(p, length, pos, count)) return out.str() + " truncated";
+      out << " " << field << " " << count;
+      if (count == 0) continue;
+      for (unsigned int i = 0; i < 4; i++) {
+        if (!get_varint(p, length, pos, raw)) return out.str() + " truncated";
+        if (i == 0) out << " mean " << (int32_t)((raw >> 1) ^ -(raw & 1));
+      }
+    }
+  }
+  out << ((status & 0x40) ? " | query " : " | telemetry ") << hex(p + pos, length - pos);
+  return out.str();
+}
+
+/**
+ * Prints every record of the capture.
+ */
+static int decode(const std::vector<CaptureRecord> &records) {
+  std::map<std::string, unsigned long> commands;
+  int session = -1;
+  for (const CaptureRecord &r : records) {
+    if (r.session != session) {
+      session = r.session;
+      printf("=== session %d, captured by the %s\n", session, r.device == CAPTURE_DEVICE_AIRSHIP ? "airship" : "controller");
+    }
+    unsigned int length;
+    FrameCheck check = check_trailer(r.packet, length);
+    printf("%10u ms %s", r.time, r.direction == CAPTURE_SENT ? "TX" : "RX");
+    if (r.direction == CAPTURE_RECEIVED) printf(" %4d dBm %6.2f dB", r.rssi, r.snr);
+    else printf("                   ");
+    printf(" P%d %3zu B ", r.profile, r.packet.size());
+    if (check == CHECK_FAILED) {
+      printf("CRC FAILED %s\n", hex(r.packet.data(), r.packet.size()).c_str());
+      continue;
+    }
+    const unsigned char *p = r.packet.data();
+    printf("%s\n", (length > 0 && p[0] == CONTROLLER_ADDRESS) ? describe_report(p, length).c_str() : describe_commands(p, length, commands).c_str());
+  }
+  return 0;
+}
+
+/**
+ * Prints the counts of packets, frame check results and commands.
+ */
+static int summary(const std::vector<CaptureRecord> &records) {
+  std::map<std::string, unsigned long> commands;
+  unsigned long sent = 0, received = 0, failed = 0, bytes = 0;
+  for (const CaptureRecord &r : records) {
+    (r.direction == CAPTURE_SENT ? sent : received)++;
+    bytes += r.packet.size();
+    unsigned int length;
+    if (check_trailer(r.packet, length) == CHECK_FAILED) {
+      failed++;
+    } else if (length > 0 && r.packet[0] != CONTROLLER_ADDRESS) {
+      describe_commands(r.packet.data(), length, commands);
+    }
+  }
+  printf("Packets : %zu (sent %lu, received %lu), %lu bytes\n", records.size(), sent, received, bytes);
+  printf("Frame check failed : %lu\n", failed);
+  if (!records.empty()) printf("Duration : %u ms\n", records.back().time - records.front().time);
+  printf("Commands :\n");
+  for (const auto &c : commands) printf("  %-20s %lu\n", c.first.c_str(), c.second);
+  return 0;
+}
+
+/**
+ * Passes the packets received by the target device to its receive path (see the top of this file).
+ */
+static int replay(const std::vector<CaptureRecord> &records, unsigned char target) {
+#ifdef CAPTURE_REPLAY
+  unsigned long count = 0;
+  std::chrono::nanoseconds spent(0);
+  nativeSerialOutput = getenv("QUIET") == NULL;
+  for (const CaptureRecord &r : records) {
+    bool toTarget = (r.device == target) ? r.direction == CAPTURE_RECEIVED : r.direction == CAPTURE_SENT;
+    if (!toTarget) continue;
+    nativeMicros = (unsigned long)r.time * 1000;
+    auto start = std::chrono::steady_clock::now();
+    capture_replay(r.packet.data(), r.packet.size());
+    spent += std::chrono::steady_clock::now() - start;
+    count++;
+  }
+  printf("Replayed %lu packets, %.2f us per packet in the receive path\n", count, count ? spent.count() / 1000.0 / count : 0.0);
+  return 0;
+#else
+  (void)records, (void)target;
+  fprintf(stderr, "Replay needs a native build of the firmware, see the top of capture_tool.cpp\n");
+  return 1;
+#endif
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    fprintf(stderr, "Usage: %s decode|summary <capture>\n       %s replay airship|controller <capture>\n", argv[0], argv[0]);
+    return 2;
+  }
+  std::string mode = argv[1];
+  std::vector<CaptureRecord> records;
+  if (mode == "replay") {
+    if (argc < 4 || (strcmp(argv[2], "airship") != 0 && strcmp(argv[2], "controller") != 0)) {
+      fprintf(stderr, "Usage: %s replay airship|controller <capture>\n", argv[0]);
+      return 2;
+    }
+    if (!load_capture(argv[3], records)) return 1;
+    return replay(records, strcmp(argv[2], "airship") == 0 ? CAPTURE_DEVICE_AIRSHIP : CAPTURE_DEVICE_CONTROLLER);
+  }
+  if (!load_capture(argv[2], records)) return 1;
+  if (mode == "decode") return decode(records);
+  if (mode == "summary") return summary(records);
+  fprintf(stderr, "Unknown mode %s\n", mode.c_str());
+  return 2;
+}
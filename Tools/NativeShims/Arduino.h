@@ -0,0 +1,170 @@
+#ifndef NATIVE_ARDUINO_H
+#define NATIVE_ARDUINO_H
+
+/*
+Host implementations of the Arduino and Teensy functions that the firmwares call, for the native builds:
+the unit tests (env:native in platformio.ini of Blimp and Controller) and the replay of captures (see Tools/CaptureTool).
+Only the behaviour the firmwares rely on is modelled:
+- Time stands still unless the host moves nativeMicros (delay() and threads.delay() move it too), so the tests
+  and the replay are deterministic.
+- Serial prints to stdout (nothing if nativeSerialOutput is false) and reads the characters put into its input.
+- The radio (LoRa.h) keeps the last sent packet and delivers injected ones through its onReceive() callback.
+- The sensors return fixed readings, the SD card is absent and the threads are never started.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <string>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define CHANGE 4
+#define FALLING 2
+#define RISING 3
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+#define LSBFIRST 0
+#define MSBFIRST 1
+#define A9 23
+
+extern unsigned long nativeMicros;    // host clock [us]
+extern bool nativeSerialOutput;       // Serial prints to stdout
+extern int nativeAnalogValue;         // returned by analogRead()
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void pinMode(int pin, int mode);
+void digitalWrite(int pin, int value);
+void digitalWriteFast(int pin, int value);
+int digitalRead(int pin);
+int analogRead(int pin);
+void attachInterrupt(int pin, void (*function)(void), int mode);
+int digitalPinToInterrupt(int pin);
+void noInterrupts(void);
+void interrupts(void);
+void __disable_irq(void);
+void __enable_irq(void);
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+long map(long x, long in_min, long in_max, long out_min, long out_max);
+
+template<class T> T abs(T x) { return x > 0 ? x : -x; }  // also for unsigned differences, as the macro of Arduino
+template<class T, class L, class H> T constrain(T x, L low, H high) { return x < low ? low : (x > high ? high : x); }
+
+class String {
+  public:
+    String(const char *text = "") : s(text) {}
+    String(const std::string &text) : s(text) {}
+    String(char c) : s(1, c) {}
+    String(int value, unsigned char base = DEC) : s(to_text(value, base)) {}
+    String(unsigned int value, unsigned char base = DEC) : s(to_text(value, base)) {}
+    String(long value, unsigned char base = DEC) : s(to_text(value, base)) {}
+    String(unsigned long value, unsigned char base = DEC) : s(to_text(value, base)) {}
+    String(double value, unsigned char digits = 2);
+    String operator+(const String &other) const { return String(s + other.s); }
+    friend String operator+(const char *a, const String &b) { return String(std::string(a) + b.s); }
+    String &operator+=(const String &other) { s += other.s; return *this; }
+    String &operator+=(const char *other) { s += other; return *this; }
+    String &operator+=(char c) { s += c; return *this; }
+    bool operator==(const String &other) const { return s == other.s; }
+    bool operator==(const char *other) const { return s == other; }
+    bool operator!=(const String &other) const { return s != other.s; }
+    bool operator!=(const char *other) const { return s != other; }
+    char operator[](unsigned int index) const { return index < s.size() ? s[index] : 0; }
+    unsigned int length(void) const { return s.size(); }
+    const char *c_str(void) const { return s.c_str(); }
+    char charAt(unsigned int index) const { return (*this)[index]; }
+    int indexOf(char c, unsigned int from = 0) const;
+    int indexOf(const char *text, unsigned int from = 0) const;
+    String substring(unsigned int from) const { return from < s.size() ? String(s.substr(from)) : String(); }
+    String substring(unsigned int from, unsigned int to) const;
+    bool startsWith(const char *prefix) const { return s.compare(0, strlen(prefix), prefix) == 0; }
+    bool endsWith(const char *suffix) const;
+    void replace(const char *find, const char *with);
+    String &toLowerCase(void);
+    String &toUpperCase(void);
+    void trim(void);
+    long toInt(void) const { return atol(s.c_str()); }
+    float toFloat(void) const { return atof(s.c_str()); }
+  private:
+    std::string s;
+    static std::string to_text(unsigned long value, unsigned char base);
+    static std::string to_text(long value, unsigned char base);
+    static std::string to_text(int value, unsigned char base) { return to_text((long)value, base); }
+    static std::string to_text(unsigned int value, unsigned char base) { return to_text((unsigned long)value, base); }
+};
+
+class Print {
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size);
+    size_t write(const char *text) { return write((const uint8_t *)text, strlen(text)); }
+    size_t print(const char *text) { return write(text); }
+    size_t print(const String &text) { return write(text.c_str()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(int value, int base = DEC) { return print((long)value, base); }
+    size_t print(unsigned int value, int base = DEC) { return print((unsigned long)value, base); }
+    size_t print(long value, int base = DEC);
+    size_t print(unsigned long value, int base = DEC);
+    size_t print(long long value, int base = DEC) { return print((long)value, base); }
+    size_t print(unsigned long long value, int base = DEC) { return print((unsigned long)value, base); }
+    size_t print(double value, int digits = 2);
+    size_t println(void) { return write("\r\n"); }
+    template<class T> size_t println(T value) { size_t n = print(value); return n + println(); }
+    template<class T> size_t println(T value, int format) { size_t n = print(value, format); return n + println(); }
+};
+
+class Stream : public Print {
+  public:
+    virtual int available(void) { return 0; }
+    virtual int read(void) { return -1; }
+    virtual int peek(void) { return -1; }
+    virtual void flush(void) {}
+    size_t readBytes(char *buffer, size_t length);
+    size_t readBytes(uint8_t *buffer, size_t length) { return readBytes((char *)buffer, length); }
+};
+
+class HardwareSerial : public Stream {
+  public:
+    void begin(unsigned long baud) { (void)baud; }
+    void end(void) {}
+    operator bool(void) const { return true; }
+    size_t write(uint8_t c) override;
+    using Print::write;
+    int available(void) override { return input.size() - inputPos; }
+    int read(void) override { return inputPos < input.size() ? (unsigned char)input[inputPos++] : -1; }
+    int peek(void) override { return inputPos < input.size() ? (unsigned char)input[inputPos] : -1; }
+    void type(const char *text) { input.erase(0, inputPos), inputPos = 0, input += text; }  // host only: characters to be read
+  private:
+    std::string input;
+    size_t inputPos = 0;
+};
+
+extern HardwareSerial Serial, Serial1, Serial2, Serial3, Serial4;
+
+class IntervalTimer {
+  public:
+    bool begin(void (*function)(void), unsigned long period) { callback = function, periodMicros = period; return true; }
+    void end(void) { callback = NULL; }
+    void priority(uint8_t level) { (void)level; }
+    void (*callback)(void) = NULL;     // host only: the tests call it to fire the timer
+    unsigned long periodMicros = 0;
+};
+
+#endif // NATIVE_ARDUINO_H
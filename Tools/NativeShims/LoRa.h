@@ -0,0 +1,75 @@
+#ifndef NATIVE_LORA_H
+#define NATIVE_LORA_H
+
+#include <Arduino.h>
+#include <SPI.h>
+#define LORA_DEFAULT_SPI_FREQUENCY 8E6
+#define NATIVE_LORA_FIFO 256
+
+/*
+Host radio. The last packet sent by endPacket() is kept in lastSent (and passed to onTransmit, if set); a test or
+the replay delivers a packet with inject(), which puts it into the FIFO and calls the onReceive() callback as the
+interrupt of the radio would. The FIFO is read by LoRa.read() or by a burst read over SPI (see read_fifo() of the
+firmwares). The buffers are fixed, so the radio itself never allocates memory (see test_packet_io).
+*/
+class LoRaClass : public Stream {
+  public:
+    int begin(long frequency) { this->frequency = frequency; return 1; }
+    void end(void) {}
+    void setPins(int ss = 10, int reset = 9, int dio0 = 2) { (void)ss, (void)reset, (void)dio0; }
+    void setSPI(SPIClass &spi) { (void)spi; }
+    void setSPIFrequency(uint32_t frequency) { (void)frequency; }
+    int beginPacket(int implicitHeader = false) { (void)implicitHeader; packetLength = 0; return 1; }
+    int endPacket(bool async = false);
+    int parsePacket(int size = 0) { (void)size; return 0; }
+    int packetRssi(void) { return rssi; }
+    float packetSnr(void) { return snr; }
+    long packetFrequencyError(void) { return 0; }
+    size_t write(uint8_t byte) override { return write(&byte, 1); }
+    size_t write(const uint8_t *buffer, size_t size) override;
+    int available(void) override { return fifoLength - fifoPos; }
+    int read(void) override { return fifoPos < fifoLength ? fifo[fifoPos++] : -1; }
+    int peek(void) override { return fifoPos < fifoLength ? fifo[fifoPos] : -1; }
+    void onReceive(void (*callback)(int)) { receiveCallback = callback; }
+    void onTxDone(void (*callback)(void)) { (void)callback; }
+    void receive(int size = 0) { (void)size; receiving = true; }
+    void idle(void) { receiving = false; }
+    void sleep(void) { receiving = false; }
+    void setTxPower(int level, int outputPin = 1) { (void)outputPin; txPower = level; }
+    void setFrequency(long frequency) { this->frequency = frequency; }
+    void setSpreadingFactor(int sf) { spreadingFactor = sf; }
+    void setSignalBandwidth(long sbw) { bandwidth = sbw; }
+    void setCodingRate4(int denominator) { codingRate = denominator; }
+    void setPreambleLength(long length) { (void)length; }
+    void setSyncWord(int sw) { (void)sw; }
+    void enableCrc(void) {}
+    void disableCrc(void) {}
+    uint8_t random(void) { return (uint8_t)::random(256); }
+
+    // Host only
+    void inject(const uint8_t *data, size_t length, int rssi = -80, float snr = 7.25);
+    size_t read_fifo(uint8_t *data, size_t length);
+    uint8_t lastSent[NATIVE_LORA_FIFO];                               // the last packet sent
+    size_t lastSentLength = 0;
+    unsigned long sentCount = 0;                                      // packets sent so far
+    void (*onTransmit)(const uint8_t *data, size_t length) = NULL;
+    long frequency = 0;
+    int spreadingFactor = 7;
+    long bandwidth = 125000;
+    int codingRate = 5;
+    int txPower = 17;
+    bool receiving = false;
+    int rssi = -80;
+    float snr = 7.25;
+  private:
+    uint8_t packet[NATIVE_LORA_FIFO];
+    size_t packetLength = 0;
+    uint8_t fifo[NATIVE_LORA_FIFO];
+    size_t fifoLength = 0;
+    size_t fifoPos = 0;
+    void (*receiveCallback)(int) = NULL;
+};
+
+extern LoRaClass LoRa;
+
+#endif // NATIVE_LORA_H
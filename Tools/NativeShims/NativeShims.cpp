@@ -0,0 +1,202 @@
+#include <Arduino.h>
+#include <LoRa.h>
+#include <SPI.h>
+#include <SD.h>
+#include <Wire.h>
+#include <TeensyThreads.h>
+
+unsigned long nativeMicros = 0;
+bool nativeSerialOutput = true;
+int nativeAnalogValue = 512;
+
+HardwareSerial Serial, Serial1, Serial2, Serial3, Serial4;
+LoRaClass LoRa;
+SPIClass SPI;
+SDClass SD;
+TwoWire Wire;
+Threads threads;
+
+unsigned long millis(void) { return nativeMicros / 1000; }
+unsigned long micros(void) { return nativeMicros; }
+void delay(unsigned long ms) { nativeMicros += ms * 1000; }
+void delayMicroseconds(unsigned int us) { nativeMicros += us; }
+void pinMode(int pin, int mode) { (void)pin, (void)mode; }
+void digitalWrite(int pin, int value) { (void)pin, (void)value; }
+void digitalWriteFast(int pin, int value) { (void)pin, (void)value; }
+int digitalRead(int pin) { (void)pin; return HIGH; }  // the buttons have pull-ups, HIGH is released
+int analogRead(int pin) { (void)pin; return nativeAnalogValue; }
+void attachInterrupt(int pin, void (*function)(void), int mode) { (void)pin, (void)function, (void)mode; }
+int digitalPinToInterrupt(int pin) { return pin; }
+void noInterrupts(void) {}
+void interrupts(void) {}
+void __disable_irq(void) {}
+void __enable_irq(void) {}
+long random(long howbig) { return howbig > 0 ? rand() % howbig : 0; }
+long random(long howsmall, long howbig) { return howbig > howsmall ? howsmall + random(howbig - howsmall) : howsmall; }
+void randomSeed(unsigned long seed) { srand(seed); }
+
+long map(long x, long in_min, long in_max, long out_min, long out_max) {
+  return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+String::String(double value, unsigned char digits) {
+  char text[64];
+  snprintf(text, sizeof(text), "%.*f", digits, value);
+  s = text;
+}
+
+std::string String::to_text(unsigned long value, unsigned char base) {
+  if (value == 0) return "0";
+  std::string text;
+  for (; value > 0; value /= base) text.insert(text.begin(), "0123456789ABCDEF"[value % base]);
+  return text;
+}
+
+std::string String::to_text(long value, unsigned char base) {
+  if (value < 0 && base == DEC) return "-" + to_text((unsigned long)-value, base);
+  return to_text((unsigned long)value, base);
+}
+
+int String::indexOf(char c, unsigned int from) const {
+  size_t at = s.find(c, from);
+  return at == std::string::npos ? -1 : (int)at;
+}
+
+int String::indexOf(const char *text, unsigned int from) const {
+  size_t at = s.find(text, from);
+  return at == std::string::npos ? -1 : (int)at;
+}
+
+String String::substring(unsigned int from, unsigned int to) const {
+  if (from > to) {
+    unsigned int swap = from;
+    from = to, to = swap;
+  }
+  if (from >= s.size()) return String();
+  return String(s.substr(from, to - from));
+}
+
+bool String::endsWith(const char *suffix) const {
+  size_t length = strlen(suffix);
+  return s.size() >= length && s.compare(s.size() - length, length, suffix) == 0;
+}
+
+void String::replace(const char *find, const char *with) {
+  size_t length = strlen(find);
+  if (length == 0) return;
+  for (size_t at = s.find(find); at != std::string::npos; at = s.find(find, at + strlen(with))) s.replace(at, length, with);
+}
+
+String &String::toLowerCase(void) {
+  for (char &c : s) if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+  return *this;
+}
+
+String &String::toUpperCase(void) {
+  for (char &c : s) if (c >= 'a' && c <= 'z') c -= 'a' - 'A';
+  return *this;
+}
+
+void String::trim(void) {
+  size_t first = s.find_first_not_of(" \t\r\n");
+  size_t last = s.find_last_not_of(" \t\r\n");
+  s = first == std::string::npos ? "" : s.substr(first, last - first + 1);
+}
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+  size_t n = 0;
+  while (size--) n += write(*buffer++);
+  return n;
+}
+
+// The numbers are formatted on the stack, as the Print of Teensy does, so printing does not allocate (see test_packet_io)
+size_t Print::print(long value, int base) {
+  if (value < 0 && base == DEC) return print('-') + print((unsigned long)-value, base);
+  return print((unsigned long)value, base);
+}
+
+size_t Print::print(unsigned long value, int base) {
+  char text[8 * sizeof(value) + 1];
+  char *p = text + sizeof(text) - 1;
+  *p = 0;
+  if (base < 2) base = DEC;
+  do {
+    *--p = "0123456789ABCDEF"[value % base];
+    value /= base;
+  } while (value > 0);
+  return write(p);
+}
+
+size_t Print::print(double value, int digits) {
+  char text[64];
+  snprintf(text, sizeof(text), "%.*f", digits, value);
+  return write(text);
+}
+
+size_t Stream::readBytes(char *buffer, size_t length) {
+  size_t n = 0;
+  int c;
+  while (n < length && (c = read()) >= 0) buffer[n++] = (char)c;
+  return n;
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+  if (nativeSerialOutput) putchar(c);
+  return 1;
+}
+
+size_t LoRaClass::write(const uint8_t *buffer, size_t size) {
+  if (size > NATIVE_LORA_FIFO - packetLength) size = NATIVE_LORA_FIFO - packetLength;  // the FIFO of the SX127x
+  memcpy(packet + packetLength, buffer, size);
+  packetLength += size;
+  return size;
+}
+
+int LoRaClass::endPacket(bool async) {
+  (void)async;
+  memcpy(lastSent, packet, packetLength);
+  lastSentLength = packetLength;
+  sentCount++;
+  if (onTransmit != NULL) onTransmit(packet, packetLength);
+  return 1;
+}
+
+/**
+ * Delivers a packet as if the radio received it: it is put into the FIFO and the onReceive() callback is called.
+ */
+void LoRaClass::inject(const uint8_t *data, size_t length, int rssi, float snr) {
+  if (length > NATIVE_LORA_FIFO) length = NATIVE_LORA_FIFO;
+  memcpy(fifo, data, length);
+  fifoLength = length;
+  fifoPos = 0;
+  this->rssi = rssi;
+  this->snr = snr;
+  if (receiveCallback != NULL) receiveCallback(length);
+}
+
+size_t LoRaClass::read_fifo(uint8_t *data, size_t length) {
+  size_t n = 0;
+  while (n < length && fifoPos < fifoLength) data[n++] = fifo[fifoPos++];
+  return n;
+}
+
+/**
+ * Suspends a thread as setState() of TeensyThreads does: the interrupts are on again between reading and writing the state.
+ */
+int Threads::suspend(int id) {
+  if (id < 0 || id >= NATIVE_MAX_THREADS) return 0;
+  if (onSuspend != NULL) onSuspend();
+  state[id] = SUSPENDED;
+  return 1;
+}
+
+int Threads::restart(int id) {
+  if (id < 0 || id >= NATIVE_MAX_THREADS) return 0;
+  state[id] = RUNNING;
+  return 1;
+}
+
+void SPIClass::transfer(void *buffer, size_t count) {
+  size_t n = LoRa.read_fifo((uint8_t *)buffer, count);
+  memset((uint8_t *)buffer + n, 0, count - n);
+}
@@ -0,0 +1,35 @@
+#ifndef NATIVE_SD_H
+#define NATIVE_SD_H
+
+#include <Arduino.h>
+
+#define FILE_READ 0
+#define FILE_WRITE 1
+#define BUILTIN_SDCARD 254
+
+// There is no card: SD.begin() fails and no file opens
+class File : public Stream {
+  public:
+    operator bool(void) const { return false; }
+    size_t write(uint8_t c) override { (void)c; return 0; }
+    size_t write(const uint8_t *buffer, size_t size) override { (void)buffer, (void)size; return 0; }
+    using Print::write;
+    void close(void) {}
+    unsigned long size(void) { return 0; }
+    unsigned long position(void) { return 0; }
+    bool seek(unsigned long position) { (void)position; return false; }
+    int read(void *buffer, size_t size) { (void)buffer, (void)size; return 0; }
+    int read(void) override { return -1; }
+};
+
+class SDClass {
+  public:
+    bool begin(int csPin = BUILTIN_SDCARD) { (void)csPin; return false; }
+    File open(const char *path, int mode = FILE_READ) { (void)path, (void)mode; return File(); }
+    bool exists(const char *path) { (void)path; return false; }
+    bool remove(const char *path) { (void)path; return false; }
+};
+
+extern SDClass SD;
+
+#endif // NATIVE_SD_H
@@ -0,0 +1,25 @@
+#ifndef NATIVE_SPI_H
+#define NATIVE_SPI_H
+
+#include <Arduino.h>
+
+#define SPI_MODE0 0x00
+
+struct SPISettings {
+  SPISettings(void) {}
+  SPISettings(uint32_t clock, uint8_t bitOrder, uint8_t dataMode) { (void)clock, (void)bitOrder, (void)dataMode; }
+};
+
+// Only the radio is on the bus: a burst transfer reads its FIFO (see LoRa.h)
+class SPIClass {
+  public:
+    void begin(void) {}
+    void beginTransaction(SPISettings settings) { (void)settings; }
+    void endTransaction(void) {}
+    uint8_t transfer(uint8_t data) { (void)data; return 0; }
+    void transfer(void *buffer, size_t count);
+};
+
+extern SPIClass SPI;
+
+#endif // NATIVE_SPI_H
@@ -0,0 +1,22 @@
+#ifndef NATIVE_SERVO_H
+#define NATIVE_SERVO_H
+
+#include <Arduino.h>
+
+// Keeps the last pulse, so that a test can check what the actuators were told
+class Servo {
+  public:
+    uint8_t attach(int pin) { this->pin = pin; return 1; }
+    uint8_t attach(int pin, int min, int max) { (void)min, (void)max; return attach(pin); }
+    void detach(void) { pin = -1; }
+    bool attached(void) { return pin >= 0; }
+    void write(int value) { pulse = value < 200 ? map(value, 0, 180, 544, 2400) : value; }
+    void writeMicroseconds(int value) { pulse = value; }
+    int read(void) { return map(pulse, 544, 2400, 0, 180); }
+    int readMicroseconds(void) { return pulse; }
+  private:
+    int pin = -1;
+    int pulse = 1500;
+};
+
+#endif // NATIVE_SERVO_H
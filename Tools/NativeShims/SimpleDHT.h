@@ -0,0 +1,14 @@
+#ifndef NATIVE_SIMPLE_DHT_H
+#define NATIVE_SIMPLE_DHT_H
+
+#include <Arduino.h>
+
+#define SimpleDHTErrSuccess 0
+
+class SimpleDHT22 {
+  public:
+    SimpleDHT22(int pin) { (void)pin; }
+    int read2(float *temperature, float *humidity, byte *data) { (void)data; *temperature = 20, *humidity = 50; return SimpleDHTErrSuccess; }
+};
+
+#endif // NATIVE_SIMPLE_DHT_H
@@ -0,0 +1,22 @@
+#ifndef NATIVE_MPL3115A2_H
+#define NATIVE_MPL3115A2_H
+
+#include <Arduino.h>
+
+class MPL3115A2 {
+  public:
+    void begin(void) {}
+    void setModeBarometer(void) {}
+    void setModeAltimeter(void) {}
+    void setModeStandby(void) {}
+    void setModeActive(void) {}
+    void setOversampleRate(byte rate) { (void)rate; }
+    void enableEventFlags(void) {}
+    void toggleOneShot(void) {}
+    float readPressure(void) { return 101325; }
+    float readAltitude(void) { return 0; }
+    float readTemp(void) { return 20; }
+    float readTempF(void) { return 68; }
+};
+
+#endif // NATIVE_MPL3115A2_H
@@ -0,0 +1,42 @@
+#ifndef NATIVE_TEENSY_THREADS_H
+#define NATIVE_TEENSY_THREADS_H
+
+#include <Arduino.h>
+
+// The threads are registered but never run, the host runs everything in the thread of the main loop (ID 0).
+// Their states are kept, and suspend() calls onSuspend where the library turns the interrupts on (see test_scheduler).
+#define NATIVE_MAX_THREADS 8
+class Threads {
+  public:
+    typedef void (*ThreadFunction)(void *);
+    typedef void (*ThreadFunctionNone)(void);
+    static const int RUNNING = 1;
+    static const int SUSPENDED = 4;
+    int addThread(ThreadFunctionNone p, int arg = 0, int stack_size = -1, void *stack = 0) { (void)p, (void)arg, (void)stack_size, (void)stack; return ++created; }
+    int addThread(ThreadFunction p, void *arg = 0, int stack_size = -1, void *stack = 0) { (void)p, (void)arg, (void)stack_size, (void)stack; return ++created; }
+    int id(void) { return 0; }
+    void yield(void) {}
+    void delay(int ms) { nativeMicros += (unsigned long)ms * 1000; }
+    int setTimeSlice(int id, unsigned int ticks) { (void)id, (void)ticks; return 1; }
+    int stop(void) { return RUNNING; }
+    int start(int state = -1) { (void)state; return RUNNING; }
+    int suspend(int id);
+    int restart(int id);
+    int getState(int id) { return id >= 0 && id < NATIVE_MAX_THREADS ? state[id] : -1; }
+    int getStackUsed(int id) { (void)id; return 0; }
+    int getStackRemaining(int id) { (void)id; return 0; }
+    class Mutex {
+      public:
+        int lock(unsigned int timeout_ms = 0) { (void)timeout_ms; return 1; }
+        int try_lock(void) { return 1; }
+        int unlock(void) { return 1; }
+    };
+    void (*onSuspend)(void) = NULL;   // host only: an interrupt inside setState() of the library, before the new state is written
+  private:
+    int created = 0;
+    int state[NATIVE_MAX_THREADS] = {RUNNING, RUNNING, RUNNING, RUNNING, RUNNING, RUNNING, RUNNING, RUNNING};
+};
+
+extern Threads threads;
+
+#endif // NATIVE_TEENSY_THREADS_H
@@ -0,0 +1,15 @@
+#ifndef NATIVE_TEST_VECTORS_H
+#define NATIVE_TEST_VECTORS_H
+
+/*
+Test vectors shared by the native tests of the airship and of the controller, so that both sides check the same bytes.
+*/
+
+// Telemetry keyframe with seq 7 (see Telemetry.h): the airship encodes it from the frame of its test_telemetry,
+// the controller decodes it in its test_telemetry and sends it in the packets of its simulated airships
+const unsigned char GOLDEN_KEYFRAME[] = {
+  0x01, 0x07, 0xD2, 0x04, 0xDC, 0x05, 0xEC, 0xFF, 0x66, 0x08, 0x00, 0x80, 0x78, 0x0D, 0x7A, 0x00,
+  0x00, 0xCD, 0x8B, 0x01, 0x00, 0xD2, 0x04, 0xB5, 0xEB, 0xD8, 0x1D, 0xD0, 0x08, 0x9B, 0x08,
+};
+
+#endif // NATIVE_TEST_VECTORS_H
@@ -0,0 +1,27 @@
+#ifndef NATIVE_TINY_GPS_H
+#define NATIVE_TINY_GPS_H
+
+#include <Arduino.h>
+
+// Never gets a fix
+class TinyGPS {
+  public:
+    enum { GPS_INVALID_AGE = 0xFFFFFFFF, GPS_INVALID_ALTITUDE = 999999999, GPS_INVALID_SPEED = 999999999 };
+    static constexpr float GPS_INVALID_F_ANGLE = 1000.0, GPS_INVALID_F_ALTITUDE = 1000000.0, GPS_INVALID_F_SPEED = -1.0;
+    bool encode(char c) { (void)c; return false; }
+    void f_get_position(float *latitude, float *longitude, unsigned long *fix_age = 0) {
+      *latitude = GPS_INVALID_F_ANGLE, *longitude = GPS_INVALID_F_ANGLE;
+      if (fix_age) *fix_age = GPS_INVALID_AGE;
+    }
+    void get_datetime(unsigned long *date, unsigned long *time, unsigned long *age = 0) {
+      *date = 0, *time = 0;
+      if (age) *age = GPS_INVALID_AGE;
+    }
+    float f_altitude(void) { return GPS_INVALID_F_ALTITUDE; }
+    float f_speed_kmph(void) { return GPS_INVALID_F_SPEED; }
+    float f_course(void) { return GPS_INVALID_F_ANGLE; }
+    unsigned short satellites(void) { return 0; }
+    unsigned long hdop(void) { return 0; }
+};
+
+#endif // NATIVE_TINY_GPS_H
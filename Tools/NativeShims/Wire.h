@@ -0,0 +1,18 @@
+#ifndef NATIVE_WIRE_H
+#define NATIVE_WIRE_H
+
+#include <Arduino.h>
+
+class TwoWire : public Stream {
+  public:
+    void begin(void) {}
+    void beginTransmission(int address) { (void)address; }
+    int endTransmission(bool stop = true) { (void)stop; return 0; }
+    int requestFrom(int address, int quantity) { (void)address, (void)quantity; return 0; }
+    size_t write(uint8_t c) override { (void)c; return 1; }
+    using Print::write;
+};
+
+extern TwoWire Wire;
+
+#endif // NATIVE_WIRE_H
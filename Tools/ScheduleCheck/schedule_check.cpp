@@ -0,0 +1,253 @@
+/*
+Host tool that checks the schedule of the airship's threads (see Scheduler.h and TaskTable.h in Blimp/include).
+
+Build:   g++ -std=c++17 -O2 -I../../Blimp/include -o schedule_check schedule_check.cpp
+Usage:   schedule_check [period of the height control in us] [simulated seconds] [spreading factor] [bandwidth in Hz]
+         (the link profile defaults to SF10 at 125 kHz, the most robust one with the longest packets)
+
+The tool simulates the threads on a clock of microseconds the way TeensyThreads and Scheduler.cpp run them:
+the threads take turns in the order in which setup() creates them, each one for its time slice, which ends at a tick
+(1 ms) of the scheduler; a thread without work yields at once. A job of a task is released by the timer (the height
+control) or when its thread comes to it after the period; it starts only when no task of a higher priority waits
+to start, busy waits for its spin time, runs its atomic part with the switching stopped (only when the next release
+of the height control is far enough) and then the rest of its work. Every job takes the whole worst case of the table.
+The main loop (the radio task) sends the beacon of every TDMA frame and one acknowledgement in its slot, each pass that
+sends busy waits for the time on air of a packet of TDMA_MAX_PACKET bytes (see TaskTable.h).
+The utilization is the processing of the table per period. The busy waiting is not counted in it: a wait ends at
+a given time whether its thread runs or not, what it takes from the other threads shows in their response times.
+The tool prints the response times and exits with 1 if the utilization exceeds 100 % or a job missed its deadline.
+*/
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "TaskTable.h"
+
+#define TICK 1000           // [us]
+#define SWITCH_COST 2       // A switch of threads with a pass through threads.yield() or threads.delay() [us]
+
+// The TDMA frame of one airship, the same as tdma_layout() with the constants of TDMA.h [ms]
+#define TDMA_GUARD 10
+#define TDMA_MAX_PACKET 48
+#define TDMA_UPLINK_WINDOW 50
+#define TDMA_LOOP_PERIOD 100
+#define TDMA_CONTENTION_WINDOW 100
+#define TDMA_MIN_FRAME 700
+
+struct TaskSpec {
+  const char *name;
+  long period, deadline, wcet, spin, atomic, slice;
+};
+
+#define TASK_SPEC(id, name, period, deadline, wcet, spin, atomic, slice) {name, period, deadline, wcet, spin, atomic, slice},
+
+static const TaskSpec SPECS[TASK_COUNT] = {TASK_TABLE(TASK_SPEC)};
+
+// Order of the threads in TeensyThreads: the main loop first, then as created in setup()
+static const TaskId THREAD_ORDER[TASK_COUNT] = {TASK_RADIO, TASK_ULTRASONIC, TASK_HUMIDITY, TASK_BAROMETER,
+                                                TASK_GPS, TASK_HEIGHT, TASK_ACTUATORS};
+
+enum JobState { IDLE, WAITING, SPINNING, WORKING };
+
+struct SimTask {
+  TaskSpec spec;
+  bool timed;
+  JobState state;
+  long nextRelease;
+  long releasedAt;
+  long spinEnd;
+  long remaining;       // work of the current job
+  bool atomicDone;
+  long jobs, responseMax, misses, overruns;
+};
+
+static std::vector<SimTask> tasks(TASK_COUNT);
+static long now = 0;
+static long spinning = 0;     // time in which the running thread busy waited
+
+// Transmissions of the main loop [us]
+static long airtime = 0;      // of one packet
+static long ackStart, ackEnd, frame;
+static long beaconEnd = -1000000000L;
+static bool ackSent = true;
+
+/**
+ * Time on air of a packet, the same formula as link_airtime() in LinkAdaptation.cpp of the airship.
+ *
+ * @return [ms]
+ */
+static long packet_airtime(int sf, long bandwidth, int bytes) {
+  double symbolTime = (double)(1L << sf) * 1000 / bandwidth;
+  bool lowDataRate = symbolTime > 16;
+  long numerator = 8L * bytes - 4 * sf + 28;
+  long denominator = 4L * (sf - (lowDataRate ? 2 : 0));
+  long payloadSymbols = 8 + ((numerator > 0) ? (numerator + denominator - 1) / denominator * 5 : 0);
+  return (long)((12.25 + payloadSymbols) * symbolTime) + 1;
+}
+
+static void tdma_layout(int sf, long bandwidth) {
+  long packet = packet_airtime(sf, bandwidth, TDMA_MAX_PACKET);
+  long slot = packet + TDMA_GUARD;
+  ackStart = TDMA_GUARD + TDMA_UPLINK_WINDOW + slot;
+  ackEnd = ackStart + TDMA_LOOP_PERIOD + TDMA_GUARD;
+  frame = ackEnd + slot + TDMA_CONTENTION_WINDOW + slot;
+  if (frame < TDMA_MIN_FRAME) frame = TDMA_MIN_FRAME;
+  airtime = packet * 1000, ackStart *= 1000, ackEnd *= 1000, frame *= 1000;
+}
+
+// Busy waiting of a pass of the main loop that starts now: the beacon when the frame is over,
+// otherwise the acknowledgement once per frame in its slot
+static long radio_transmission(void) {
+  if (now - beaconEnd >= frame) {
+    beaconEnd = now + airtime;
+    ackSent = false;
+    return airtime;
+  }
+  if (!ackSent && now - beaconEnd >= ackStart && now - beaconEnd < ackEnd) {
+    ackSent = true;
+    return airtime;
+  }
+  return 0;
+}
+
+static void release(SimTask &t, long time) {
+  t.state = WAITING;
+  t.releasedAt = time;
+}
+
+// Releases of the timer, they only set the state, as the interrupt does
+static void timer_releases(void) {
+  for (SimTask &t : tasks) {
+    while (t.timed && t.nextRelease <= now) {
+      if (t.state == IDLE) release(t, t.nextRelease);
+      else t.overruns++;
+      t.nextRelease += t.spec.period;
+    }
+  }
+}
+
+static bool higher_waiting(int id) {
+  for (int i = 0; i < id; i++) {
+    if (tasks[i].state == WAITING) return true;
+  }
+  return false;
+}
+
+static bool atomic_window(int id, long length) {
+  if (higher_waiting(id)) return false;
+  for (int i = 0; i < id; i++) {
+    if (tasks[i].timed && tasks[i].nextRelease - now < length) return false;
+  }
+  return true;
+}
+
+static void end_job(SimTask &t) {
+  long response = now - t.releasedAt;
+  t.jobs++;
+  if (response > t.responseMax) t.responseMax = response;
+  if (response > t.spec.deadline) t.misses++;
+  t.state = IDLE;
+  if (!t.timed) t.nextRelease = t.releasedAt + t.spec.period;
+}
+
+// Runs the current thread until it yields or its slice ends, returns false if it had nothing to do
+static bool run(int id, long sliceEnd) {
+  SimTask &t = tasks[id];
+  if (t.state == IDLE && !t.timed && t.nextRelease <= now) release(t, now);
+  if (t.state == WAITING) {
+    if (higher_waiting(id)) return false;
+    t.state = SPINNING;
+    t.spinEnd = now + t.spec.spin + (id == TASK_RADIO ? radio_transmission() : 0);
+    t.remaining = t.spec.wcet;
+    t.atomicDone = t.spec.atomic == 0;
+  }
+  if (t.state == SPINNING) {
+    if (now < t.spinEnd) {
+      long until = t.spinEnd < sliceEnd ? t.spinEnd : sliceEnd;
+      spinning += until - now;
+      now = until;
+      return true;
+    }
+    t.state = WORKING;
+  }
+  if (t.state == WORKING) {
+    if (!t.atomicDone) {
+      if (!atomic_window(id, t.spec.atomic)) return false;
+      now += t.spec.atomic;  // no switches, the timer only sets the state
+      t.remaining -= t.spec.atomic;
+      t.atomicDone = true;
+      timer_releases();
+    }
+    long step = t.remaining < sliceEnd - now ? t.remaining : sliceEnd - now;
+    if (step > 0) {
+      now += step;
+      t.remaining -= step;
+    }
+    if (t.remaining <= 0) end_job(t);
+    return true;
+  }
+  return false;
+}
+
+// Time of the next release or tick, to skip the time in which all threads only yield
+static long next_event(void) {
+  long next = (now / TICK + 1) * TICK;
+  for (SimTask &t : tasks) {
+    if (t.state == IDLE && t.nextRelease < next) next = t.nextRelease;
+  }
+  return next > now ? next : now + 1;
+}
+
+int main(int argc, char **argv) {
+  long heightPeriod = argc > 1 ? atol(argv[1]) : SPECS[TASK_HEIGHT].period;
+  long duration = (argc > 2 ? atol(argv[2]) : 600) * 1000000L;
+  int sf = argc > 3 ? atoi(argv[3]) : 10;
+  long bandwidth = argc > 4 ? atol(argv[4]) : 125000;
+  if (sf < 6 || sf > 12 || bandwidth <= 0) {
+    fprintf(stderr, "The spreading factor must be 6 to 12 and the bandwidth positive\n");
+    return 2;
+  }
+  tdma_layout(sf, bandwidth);
+  for (int i = 0; i < TASK_COUNT; i++) {
+    tasks[i] = SimTask{SPECS[i], i == TASK_HEIGHT, IDLE, 0, 0, 0, 0, true, 0, 0, 0, 0};
+  }
+  tasks[TASK_HEIGHT].spec.period = heightPeriod;
+  tasks[TASK_HEIGHT].nextRelease = 137;  // not aligned with the ticks
+
+  int current = 0;
+  int idleTurns = 0;
+  while (now < duration) {
+    timer_releases();
+    long sliceEnd = (now / TICK + tasks[THREAD_ORDER[current]].spec.slice) * TICK;
+    bool busy = false;
+    while (now < sliceEnd && now < duration) {
+      timer_releases();
+      if (!run(THREAD_ORDER[current], sliceEnd)) break;
+      busy = true;
+    }
+    if (!busy && ++idleTurns >= TASK_COUNT) {  // a whole round of yields
+      now = next_event();
+      idleTurns = 0;
+    } else if (busy) {
+      idleTurns = 0;
+    }
+    now += SWITCH_COST;
+    current = (current + 1) % TASK_COUNT;
+  }
+
+  double utilization = 0;
+  bool ok = true;
+  printf("%-12s %10s %10s %10s %8s %8s %8s\n", "task", "period", "deadline", "response", "jobs", "missed", "overruns");
+  for (SimTask &t : tasks) {
+    printf("%-12s %10ld %10ld %10ld %8ld %8ld %8ld\n", t.spec.name, t.spec.period, t.spec.deadline, t.responseMax,
+           t.jobs, t.misses, t.overruns);
+    utilization += (double)t.spec.wcet / t.spec.period;
+    if (t.misses > 0 || t.responseMax > t.spec.deadline || t.jobs == 0) ok = false;
+  }
+  printf("Link SF%d at %ld Hz: %ld ms on air per packet, TDMA frame %ld ms\n", sf, bandwidth, airtime / 1000, frame / 1000);
+  printf("Utilization: %.1f %%, busy waiting %.1f %% of the time, %ld s simulated\n", utilization * 100,
+         100.0 * spinning / now, duration / 1000000);
+  if (utilization > 1) printf("Overloaded: the processing exceeds the CPU\n");
+  else printf(ok ? "All deadlines met\n" : "Deadlines missed\n");
+  return ok && utilization <= 1 ? 0 : 1;
+}